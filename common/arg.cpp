@@ -1452,7 +1452,7 @@ common_params_context common_params_parser_init(common_params & params, llama_ex
         [](common_params & params, const std::string & value) {
             params.lookup_cache_static = value;
         }
-    ).set_examples({LLAMA_EXAMPLE_LOOKUP}));
+    ).set_examples({LLAMA_EXAMPLE_LOOKUP, LLAMA_EXAMPLE_SERVER}));
     add_opt(common_arg(
         {"-lcd", "--lookup-cache-dynamic"}, "FNAME",
         "path to dynamic lookup cache to use for lookup decoding (updated by generation)",
@@ -2156,6 +2156,13 @@ common_params_context common_params_parser_init(common_params & params, llama_ex
             params.no_extra_bufts = true;
         }
     ).set_env("LLAMA_ARG_NO_REPACK"));
+    add_opt(common_arg(
+        {"--repack-cache"},
+        "store the repacked weights in a file next to the model and map it on later loads instead of repacking again (requires mmap)",
+        [](common_params & params) {
+            params.repack_cache = true;
+        }
+    ).set_env("LLAMA_ARG_REPACK_CACHE"));
     add_opt(common_arg(
         {"-ctk", "--cache-type-k"}, "TYPE",
         string_format(
@@ -2355,12 +2362,14 @@ common_params_context common_params_parser_init(common_params & params, llama_ex
         "- distribute: spread execution evenly over all nodes\n"
         "- isolate: only spawn threads on CPUs on the node that execution started on\n"
         "- numactl: use the CPU map provided by numactl\n"
+        "- mirror: like distribute, and keep a copy of the weights on each node (uses more memory)\n"
         "if run without this previously, it is recommended to drop the system page cache before using this\n"
         "see https://github.com/ggml-org/llama.cpp/issues/1437",
         [](common_params & params, const std::string & value) {
             /**/ if (value == "distribute" || value == "") { params.numa = GGML_NUMA_STRATEGY_DISTRIBUTE; }
             else if (value == "isolate") { params.numa = GGML_NUMA_STRATEGY_ISOLATE; }
             else if (value == "numactl") { params.numa = GGML_NUMA_STRATEGY_NUMACTL; }
+            else if (value == "mirror") { params.numa = GGML_NUMA_STRATEGY_MIRROR; }
             else { throw std::invalid_argument("invalid value"); }
         }
     ).set_env("LLAMA_ARG_NUMA"));
@@ -3052,6 +3061,75 @@ common_params_context common_params_parser_init(common_params & params, llama_ex
             params.slot_prompt_similarity = std::stof(value);
         }
     ).set_examples({LLAMA_EXAMPLE_SERVER}));
+    add_opt(common_arg(
+        {"-kvps", "--kv-prefix-share"},
+        string_format("share the KV cache of common prompt prefixes across all slots, any slot can reuse a prefix computed by another slot\n"
+            "requires --kv-unified, disables --cache-reuse and context shift (default: %s)", params.kv_prefix_share ? "enabled" : "disabled"),
+        [](common_params & params) {
+            params.kv_prefix_share = true;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_KV_PREFIX_SHARE"));
+    add_opt(common_arg(
+        {"-cram", "--cache-ram"}, "N",
+        string_format("maximum host memory in MiB for the KV cache of evicted slots, restored when a later prompt extends it (default: %zu, 0 = disabled)", params.cache_ram),
+        [](common_params & params, int value) {
+            params.cache_ram = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_CACHE_RAM"));
+    add_opt(common_arg(
+        {"--cache-disk"}, "N",
+        string_format("maximum disk space in MiB for the KV cache entries moved out of --cache-ram (default: %zu)", params.cache_disk),
+        [](common_params & params, int value) {
+            params.cache_disk = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_CACHE_DISK"));
+    add_opt(common_arg(
+        {"--cache-disk-path"}, "PATH",
+        "directory for the KV cache entries moved out of --cache-ram (default: disabled)",
+        [](common_params & params, const std::string & value) {
+            params.cache_disk_path = value;
+            // if doesn't end with DIRECTORY_SEPARATOR, add it
+            if (!params.cache_disk_path.empty() && params.cache_disk_path[params.cache_disk_path.size() - 1] != DIRECTORY_SEPARATOR) {
+                params.cache_disk_path += DIRECTORY_SEPARATOR;
+            }
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_CACHE_DISK_PATH"));
+    add_opt(common_arg(
+        {"--cache-tokenize"}, "N",
+        string_format("maximum memory in MiB for the tokens of recent prompt strings, reused when the same text is sent again (default: %zu, 0 = disabled)", params.cache_tokenize),
+        [](common_params & params, int value) {
+            params.cache_tokenize = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_CACHE_TOKENIZE"));
+    add_opt(common_arg(
+        {"-pfb", "--prefill-budget"}, "N",
+        string_format("max number of prompt tokens to process per batch while other slots are generating, bounds the inter-token latency\n"
+            "prompts of slots with a higher request \"priority\" are processed first (default: %d, 0 = n_batch)", params.n_prefill_budget),
+        [](common_params & params, int value) {
+            if (value < 0) {
+                throw std::invalid_argument("invalid value");
+            }
+            params.n_prefill_budget = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_PREFILL_BUDGET"));
+    add_opt(common_arg(
+        {"--model-pool"}, "NAME", "FNAME",
+        "add a model that requests select with \"model\": \"NAME\", loaded on first use and swapped in when the slots are idle\n"
+        "the model must use the same vocabulary as the main model (can be repeated to add multiple models)",
+        [](common_params & params, const std::string & name, const std::string & fname) {
+            params.model_pool.push_back({ name, fname });
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}));
+    add_opt(common_arg(
+        {"--model-pool-mem"}, "N",
+        string_format("max MiB of pool models kept loaded, the least recently used ones are unloaded first (default: %zu, 0 = no limit)", params.model_pool_mem),
+        [](common_params & params, int value) {
+            if (value < 0) {
+                throw std::invalid_argument("invalid value");
+            }
+            params.model_pool_mem = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_MODEL_POOL_MEM"));
     add_opt(common_arg(
         {"--lora-init-without-apply"},
         string_format("load LoRA adapters without applying them (apply later via POST /lora-adapters) (default: %s)", params.lora_init_without_apply ? "enabled" : "disabled"),
@@ -3300,7 +3378,14 @@ common_params_context common_params_parser_init(common_params & params, llama_ex
         [](common_params & params, const std::string & value) {
             params.speculative.p_split = std::stof(value);
         }
-    ).set_examples({LLAMA_EXAMPLE_SPECULATIVE}).set_env("LLAMA_ARG_DRAFT_P_SPLIT"));
+    ).set_examples({LLAMA_EXAMPLE_SPECULATIVE, LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_DRAFT_P_SPLIT"));
+    add_opt(common_arg(
+        {"--draft-branches"}, "N",
+        string_format("max number of branches of the draft tree, a new branch starts at each draft token with a probability of at least --draft-p-split (default: %d, requires --kv-unified)", params.speculative.n_branch),
+        [](common_params & params, int value) {
+            params.speculative.n_branch = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_DRAFT_BRANCHES"));
     add_opt(common_arg(
         {"--draft-p-min"}, "P",
         string_format("minimum speculative decoding probability (greedy) (default: %.1f)", (double)params.speculative.p_min),
@@ -3308,6 +3393,20 @@ common_params_context common_params_parser_init(common_params & params, llama_ex
             params.speculative.p_min = std::stof(value);
         }
     ).set_examples({LLAMA_EXAMPLE_SPECULATIVE, LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_DRAFT_P_MIN"));
+    add_opt(common_arg(
+        {"--draft-ngram"},
+        string_format("without a draft model, draft the continuations of the n-grams of the context, validated by --lookup-cache-static if any (default: %s)", params.speculative.ngram ? "enabled" : "disabled"),
+        [](common_params & params) {
+            params.speculative.ngram = true;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_DRAFT_NGRAM"));
+    add_opt(common_arg(
+        {"--draft-layers"}, "N",
+        string_format("without a draft model, draft with the first N layers of the main model, sharing its KV cache (default: %d, 0 = disabled)", params.speculative.n_layer_self),
+        [](common_params & params, int value) {
+            params.speculative.n_layer_self = value;
+        }
+    ).set_examples({LLAMA_EXAMPLE_SERVER}).set_env("LLAMA_ARG_DRAFT_LAYERS"));
     add_opt(common_arg(
         {"-cd", "--ctx-size-draft"}, "N",
         string_format("size of the prompt context for the draft model (default: %d, 0 = loaded from model)", params.speculative.n_ctx),
@@ -10,10 +10,12 @@
 #include "llama.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cinttypes>
 #include <climits>
 #include <cmath>
 #include <codecvt>
+#include <condition_variable>
 #include <cstdarg>
 #include <cstring>
 #include <ctime>
@@ -21,6 +23,7 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <mutex>
 #include <regex>
 #include <sstream>
 #include <string>
@@ -193,6 +196,125 @@ int32_t cpu_get_num_math() {
     return cpu_get_num_physical_cores();
 }
 
+struct common_thread_pool::impl {
+    std::vector<std::thread> workers;
+
+    std::mutex              mutex_use; // held by the thread running parallel_for
+    std::mutex              mutex;
+    std::condition_variable cv_start;
+    std::condition_variable cv_done;
+
+    // current job, protected by mutex
+    const std::function<void(int)> * f = nullptr;
+    int      n         = 0;
+    uint64_t job_id    = 0;
+    int      n_running = 0;
+    bool     stop      = false;
+
+    std::atomic<int>   next { 0 };
+    std::exception_ptr error;
+
+    void run(const std::function<void(int)> & fn, int n_items) {
+        for (int i = next++; i < n_items; i = next++) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = n_items;
+            }
+        }
+    }
+
+    void worker() {
+        uint64_t job_seen = 0;
+
+        while (true) {
+            const std::function<void(int)> * fn;
+            int n_items;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv_start.wait(lock, [&] { return stop || job_id != job_seen; });
+                if (stop) {
+                    return;
+                }
+                job_seen = job_id;
+                fn       = f;
+                n_items  = n;
+            }
+
+            run(*fn, n_items);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--n_running == 0) {
+                    cv_done.notify_one();
+                }
+            }
+        }
+    }
+};
+
+common_thread_pool::common_thread_pool(int n_threads) : pimpl(new impl) {
+    for (int i = 1; i < n_threads; ++i) {
+        pimpl->workers.emplace_back([this] { pimpl->worker(); });
+    }
+}
+
+common_thread_pool::~common_thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(pimpl->mutex);
+        pimpl->stop = true;
+    }
+    pimpl->cv_start.notify_all();
+
+    for (auto & w : pimpl->workers) {
+        w.join();
+    }
+}
+
+void common_thread_pool::parallel_for(int n, const std::function<void(int)> & f) {
+    std::unique_lock<std::mutex> lock_use(pimpl->mutex_use, std::try_to_lock);
+
+    if (!lock_use.owns_lock() || pimpl->workers.empty() || n <= 1) {
+        for (int i = 0; i < n; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pimpl->mutex);
+        pimpl->f         = &f;
+        pimpl->n         = n;
+        pimpl->next      = 0;
+        pimpl->error     = nullptr;
+        pimpl->n_running = pimpl->workers.size();
+        pimpl->job_id++;
+    }
+    pimpl->cv_start.notify_all();
+
+    pimpl->run(f, n);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(pimpl->mutex);
+        pimpl->cv_done.wait(lock, [&] { return pimpl->n_running == 0; });
+        pimpl->f = nullptr;
+        error = pimpl->error;
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+int common_thread_pool::n_threads() const {
+    return pimpl->workers.size() + 1;
+}
+
 // Helper for setting process priority
 
 #if defined(_WIN32)
@@ -1092,6 +1214,12 @@ void common_set_adapter_lora(struct llama_context * ctx, std::vector<common_adap
     }
 }
 
+void common_set_adapter_lora_seq(struct llama_context * ctx, llama_seq_id seq_id, const std::vector<common_adapter_lora_info> & lora) {
+    for (const auto & la : lora) {
+        llama_set_adapter_lora_seq(ctx, la.ptr, seq_id, la.scale);
+    }
+}
+
 struct llama_model_params common_model_params_to_llama(common_params & params) {
     auto mparams = llama_model_default_params();
 
@@ -1103,13 +1231,14 @@ struct llama_model_params common_model_params_to_llama(common_params & params) {
         mparams.n_gpu_layers = params.n_gpu_layers;
     }
 
-    mparams.main_gpu        = params.main_gpu;
-    mparams.split_mode      = params.split_mode;
-    mparams.tensor_split    = params.tensor_split;
-    mparams.use_mmap        = params.use_mmap;
-    mparams.use_mlock       = params.use_mlock;
-    mparams.check_tensors   = params.check_tensors;
-    mparams.use_extra_bufts = !params.no_extra_bufts;
+    mparams.main_gpu         = params.main_gpu;
+    mparams.split_mode       = params.split_mode;
+    mparams.tensor_split     = params.tensor_split;
+    mparams.use_mmap         = params.use_mmap;
+    mparams.use_mlock        = params.use_mlock;
+    mparams.check_tensors    = params.check_tensors;
+    mparams.use_extra_bufts  = !params.no_extra_bufts;
+    mparams.use_repack_cache = params.repack_cache;
 
     if (params.kv_overrides.empty()) {
         mparams.kv_overrides = NULL;
@@ -1136,6 +1265,12 @@ struct llama_context_params common_context_params_to_llama(const common_params &
 
     cparams.n_ctx             = params.n_ctx;
     cparams.n_seq_max         = params.n_parallel;
+
+    // the extra branches of the draft trees are decoded as sequences of their own, sharing the cells of the main one
+    if (params.kv_unified && params.speculative.n_branch > 1 &&
+            params.n_parallel*params.speculative.n_branch <= (int) llama_max_parallel_sequences()) {
+        cparams.n_seq_max = params.n_parallel*params.speculative.n_branch;
+    }
     cparams.n_batch           = params.n_batch;
     cparams.n_ubatch          = params.n_ubatch;
     cparams.n_threads         = params.cpuparams.n_threads;
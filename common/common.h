@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
@@ -63,6 +65,22 @@ struct cpu_params {
 int32_t cpu_get_num_physical_cores();
 int32_t cpu_get_num_math();
 
+// worker threads kept alive between calls, for small parallel work done too often to spawn threads each time
+struct common_thread_pool {
+    explicit common_thread_pool(int n_threads);
+    ~common_thread_pool();
+
+    // run f(i) for i in [0, n) on the workers and the calling thread, the first exception thrown by f is rethrown
+    // while another thread is using the pool, the call runs on the calling thread only
+    void parallel_for(int n, const std::function<void(int)> & f);
+
+    int n_threads() const;
+
+private:
+    struct impl;
+    std::unique_ptr<impl> pimpl;
+};
+
 //
 // Common params
 //
@@ -203,8 +221,11 @@ struct common_params_speculative {
     int32_t n_max        =    16; // maximum number of tokens to draft during speculative decoding
     int32_t n_min        =     0; // minimum number of draft tokens to use for speculative decoding
     int32_t n_gpu_layers =    -1; // number of layers to store in VRAM for the draft model (-1 - use default)
+    int32_t n_branch     =     1; // max number of branches of the draft tree per sequence (1 = linear draft, requires kv_unified)
     float   p_split      =  0.1f; // speculative decoding split probability
     float   p_min        = 0.75f; // minimum speculative decoding probability (greedy)
+    bool    ngram        = false; // draft from the n-grams of the context when there is no draft model
+    int32_t n_layer_self =     0; // without a draft model, draft with the first n layers of the main model (0 = disabled)
     std::vector<std::pair<std::string, std::string>> replacements; // main to speculative model replacements
     std::vector<llama_model_tensor_buft_override> tensor_buft_overrides;
 
@@ -388,6 +409,7 @@ struct common_params {
     bool check_tensors     = false; // validate tensor data
     bool no_op_offload     = false; // globally disable offload host tensor operations to device
     bool no_extra_bufts    = false; // disable extra buffer types (used for weight repacking)
+    bool repack_cache      = false; // cache the repacked weights in a file next to the model
 
     bool single_turn       = false; // single turn chat conversation
 
@@ -451,6 +473,19 @@ struct common_params {
 
     float slot_prompt_similarity = 0.5f;
 
+    bool kv_prefix_share = false; // let slots attach to KV cache prefixes computed by other slots (requires kv_unified)
+
+    size_t      cache_ram  = 0;    // MiB of host memory for the KV cache of evicted slots (0 = disabled)
+    size_t      cache_disk = 4096; // MiB of disk space for entries moved out of the host memory tier
+    std::string cache_disk_path;   // directory for the disk tier (empty = disabled)
+
+    size_t cache_tokenize = 64; // MiB for the tokens of recent prompt strings (0 = disabled)
+
+    int32_t n_prefill_budget = 0; // max prompt tokens per batch while other slots are generating (0 = n_batch)
+
+    std::vector<std::pair<std::string, std::string>> model_pool; // models that requests can select by name (name, path)
+    size_t model_pool_mem = 0; // MiB for the pool models loaded at the same time (0 = no limit)
+
     // batched-bench params
     bool is_pp_shared = false;
 
@@ -620,6 +655,9 @@ struct ggml_threadpool_params ggml_threadpool_params_from_cpu_params(const cpu_p
 // clear LoRA adapters from context, then apply new list of adapters
 void common_set_adapter_lora(struct llama_context * ctx, std::vector<common_adapter_lora_info> & lora);
 
+// set the scales of the LoRA adapters applied to the tokens of a sequence (scale 0.0f removes the adapter)
+void common_set_adapter_lora_seq(struct llama_context * ctx, llama_seq_id seq_id, const std::vector<common_adapter_lora_info> & lora);
+
 std::string                   get_model_endpoint();
 
 //
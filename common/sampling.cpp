@@ -3,9 +3,9 @@
 #include "common.h"
 #include "log.h"
 
+#include <algorithm>
 #include <cmath>
 #include <unordered_map>
-#include <algorithm>
 
 // the ring buffer works similarly to std::deque, but with a fixed capacity
 // TODO: deduplicate with llama-impl.h
@@ -112,21 +112,11 @@ struct common_sampler {
 
     llama_token_data_array cur_p;
 
-    void set_logits(struct llama_context * ctx, int idx) {
-        const auto * logits = llama_get_logits_ith(ctx, idx);
-
-        const llama_model * model = llama_get_model(ctx);
-        const llama_vocab * vocab = llama_model_get_vocab(model);
-
-        const int n_vocab = llama_vocab_n_tokens(vocab);
-
+    // only the candidates that can be selected by the first sampler applied are copied, see llama_sampler_fill_candidates
+    void set_logits(const float * logits, int n_vocab, const struct llama_sampler * first) {
         cur.resize(n_vocab);
 
-        for (llama_token token_id = 0; token_id < n_vocab; token_id++) {
-            cur[token_id] = llama_token_data{token_id, logits[token_id], 0.0f};
-        }
-
-        cur_p = { cur.data(), cur.size(), -1, false };
+        llama_sampler_fill_candidates(first, logits, n_vocab, cur.data(), &cur_p);
     }
 };
 
@@ -335,8 +325,8 @@ void common_perf_print(const struct llama_context * ctx, const struct common_sam
     }
 }
 
-llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_context * ctx, int idx, bool grammar_first) {
-    gsmpl->set_logits(ctx, idx);
+static llama_token common_sampler_sample_logits(struct common_sampler * gsmpl, const float * logits, int n_vocab, bool grammar_first) {
+    gsmpl->set_logits(logits, n_vocab, grammar_first ? gsmpl->grmr : gsmpl->chain);
 
     auto & grmr  = gsmpl->grmr;
     auto & chain = gsmpl->chain;
@@ -371,7 +361,7 @@ llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_co
 
     // resampling:
     // if the token is not valid, sample again, but first apply the grammar sampler and then the sampling chain
-    gsmpl->set_logits(ctx, idx);
+    gsmpl->set_logits(logits, n_vocab, grmr);
 
     llama_sampler_apply(grmr,  &cur_p);
     llama_sampler_apply(chain, &cur_p);
@@ -381,6 +371,70 @@ llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_co
     return cur_p.data[cur_p.selected].id;
 }
 
+llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_context * ctx, int idx, bool grammar_first) {
+    const llama_vocab * vocab = llama_model_get_vocab(llama_get_model(ctx));
+
+    return common_sampler_sample_logits(gsmpl, llama_get_logits_ith(ctx, idx), llama_vocab_n_tokens(vocab), grammar_first);
+}
+
+// adapts a common_sampler to llama_sampler_sample_batch
+// the candidates are set from the logits by common_sampler_sample_logits, so that common_sampler_get_candidates returns them,
+// and the token is accepted by the caller with common_sampler_accept, as with common_sampler_sample
+struct common_sampler_batch_item {
+    common_sampler * gsmpl;
+    const float    * logits;
+    int              n_vocab;
+    bool             grammar_first;
+};
+
+static const char * common_sampler_batch_name(const struct llama_sampler * /*smpl*/) {
+    return "common";
+}
+
+static void common_sampler_batch_apply(struct llama_sampler * smpl, llama_token_data_array * cur_p) {
+    auto * item = (common_sampler_batch_item *) smpl->ctx;
+
+    const llama_token id = common_sampler_sample_logits(item->gsmpl, item->logits, item->n_vocab, item->grammar_first);
+
+    *cur_p = item->gsmpl->cur_p;
+
+    GGML_ASSERT(cur_p->data[cur_p->selected].id == id);
+}
+
+static struct llama_sampler_i common_sampler_batch_i = {
+    /* .name   = */ common_sampler_batch_name,
+    /* .accept = */ nullptr,
+    /* .apply  = */ common_sampler_batch_apply,
+    /* .reset  = */ nullptr,
+    /* .clone  = */ nullptr,
+    /* .free   = */ nullptr,
+};
+
+std::vector<llama_token> common_sampler_sample_batch(const std::vector<common_sampler *> & gsmpls, struct llama_context * ctx, const std::vector<int> & idxs, bool grammar_first) {
+    GGML_ASSERT(gsmpls.size() == idxs.size());
+
+    const llama_vocab * vocab = llama_model_get_vocab(llama_get_model(ctx));
+
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+    const int n       = gsmpls.size();
+
+    std::vector<common_sampler_batch_item> items(n);
+    std::vector<llama_sampler>             smpls(n);
+    std::vector<llama_sampler *>           smpls_p(n);
+
+    for (int i = 0; i < n; ++i) {
+        items[i]   = { gsmpls[i], llama_get_logits_ith(ctx, idxs[i]), n_vocab, grammar_first };
+        smpls[i]   = { &common_sampler_batch_i, &items[i] };
+        smpls_p[i] = &smpls[i];
+    }
+
+    std::vector<llama_token> result(n);
+
+    llama_sampler_sample_batch(smpls_p.data(), ctx, idxs.data(), result.data(), n);
+
+    return result;
+}
+
 std::vector<llama_token> common_sampler_sample_and_accept_n(struct common_sampler * gsmpl, struct llama_context * ctx, const std::vector<int> & idxs, const llama_tokens & draft, bool grammar_first) {
     GGML_ASSERT(idxs.size() == draft.size() + 1 && "idxs.size() must be draft.size() + 1");
 
@@ -420,6 +474,50 @@ std::vector<llama_token> common_sampler_sample_and_accept_n(struct common_sample
     return common_sampler_sample_and_accept_n(gsmpl, ctx, idxs, draft, grammar_first);
 }
 
+std::vector<llama_token> common_sampler_sample_and_accept_tree(
+        struct common_sampler * gsmpl,
+         struct llama_context * ctx,
+       const std::vector<int> & idxs,
+           const llama_tokens & draft,
+       const std::vector<int> & parents,
+             std::vector<int> & path,
+                         bool   grammar_first) {
+    GGML_ASSERT(idxs.size() == draft.size() + 1 && "idxs.size() must be draft.size() + 1");
+    GGML_ASSERT(parents.size() == draft.size());
+
+    std::vector<llama_token> result;
+
+    path.clear();
+
+    // follow the tree from the root for as long as the sampled token is one of the children of the last one
+    int node = -1;
+
+    while (true) {
+        const llama_token id = common_sampler_sample(gsmpl, ctx, idxs[node + 1], grammar_first);
+
+        common_sampler_accept(gsmpl, id, true);
+
+        result.push_back(id);
+
+        int next = -1;
+        for (int i = node + 1; i < (int) draft.size(); ++i) {
+            if (parents[i] == node && draft[i] == id) {
+                next = i;
+                break;
+            }
+        }
+
+        if (next < 0) {
+            break;
+        }
+
+        path.push_back(next);
+        node = next;
+    }
+
+    return result;
+}
+
 uint32_t common_sampler_get_seed(const struct common_sampler * gsmpl) {
     return llama_sampler_get_seed(gsmpl->chain);
 }
@@ -60,6 +60,13 @@ void common_perf_print(const struct llama_context * ctx, const struct common_sam
 //
 llama_token common_sampler_sample(struct common_sampler * gsmpl, struct llama_context * ctx, int idx, bool grammar_first = false);
 
+// sample a token with each of the samplers from the corresponding output of the last evaluation
+// the samplers run in parallel with llama_sampler_sample_batch, so they must be distinct
+//
+// equivalent to calling common_sampler_sample(gsmpls[i], ctx, idxs[i], grammar_first) for each i
+//
+std::vector<llama_token> common_sampler_sample_batch(const std::vector<common_sampler *> & gsmpls, struct llama_context * ctx, const std::vector<int> & idxs, bool grammar_first = false);
+
 // generalized version of common_sampler_sample
 //
 // will cross-reference the sampled tokens with a batch of draft tokens and accept those that match
@@ -81,6 +88,25 @@ std::vector<llama_token> common_sampler_sample_and_accept_n(struct common_sample
 // assume idxs == [ 0, 1, 2, ..., draft.size() ]
 std::vector<llama_token> common_sampler_sample_and_accept_n(struct common_sampler * gsmpl, struct llama_context * ctx, const llama_tokens & draft, bool grammar_first = false);
 
+// tree version of common_sampler_sample_and_accept_n
+//
+// parents[i] is the index in draft of the parent of draft[i], or -1 for the children of the root (the last sampled token)
+// idxs[0] is the output of the root and idxs[i + 1] the output of draft[i]
+//
+// accepts the sampled tokens for as long as they are in the tree
+// path receives the indices in draft of the accepted draft tokens
+//
+// returns at least 1 token, up to the depth of the tree + 1
+//
+std::vector<llama_token> common_sampler_sample_and_accept_tree(
+        struct common_sampler * gsmpl,
+         struct llama_context * ctx,
+       const std::vector<int> & idxs,
+           const llama_tokens & draft,
+       const std::vector<int> & parents,
+             std::vector<int> & path,
+                         bool   grammar_first = false);
+
 uint32_t common_sampler_get_seed(const struct common_sampler * gsmpl);
 
 // helpers
@@ -22,6 +22,10 @@ struct common_speculative {
     llama_tokens prompt_dft;
     bool vocab_dft_compatible = true; // whether retokenization is needed
     std::map<std::string, std::string> tgt_dft_replacements = {};
+
+    // self-speculative decoding, the draft model is the first n_layer_self layers of ctx_tgt
+    uint32_t     n_layer_self = 0;
+    llama_seq_id seq_id_self  = 0;
 };
 
 struct common_speculative * common_speculative_init(
@@ -74,6 +78,38 @@ struct common_speculative * common_speculative_init(
     return result;
 }
 
+struct common_speculative * common_speculative_init_self(
+        struct llama_context * ctx_tgt,
+                llama_seq_id   seq_id,
+                    uint32_t   n_layer) {
+    auto * result = new common_speculative {
+        /* .ctx_tgt    = */ ctx_tgt,
+        /* .ctx_dft    = */ ctx_tgt,
+        /* .smpl       = */ nullptr,
+        /* .batch      = */ llama_batch_init(1, 0, 1),
+        /* .prompt_dft = */ {},
+        /* .vocab_dft_compatible = */ true,
+    };
+
+    {
+        common_params_sampling params;
+        params.no_perf = false;
+
+        params.top_k = 10;
+
+        params.samplers = {
+            COMMON_SAMPLER_TYPE_TOP_K,
+        };
+
+        result->smpl = common_sampler_init(llama_get_model(ctx_tgt), params);
+    }
+
+    result->n_layer_self = n_layer;
+    result->seq_id_self  = seq_id;
+
+    return result;
+}
+
 void common_speculative_free(struct common_speculative * spec) {
     if (spec == nullptr) {
         return;
@@ -182,11 +218,94 @@ static std::string replace_to_tgt(
 }
 
 
+common_speculative_tree common_speculative_tree_from_tokens(const llama_tokens & tokens) {
+    common_speculative_tree tree;
+
+    tree.tokens = tokens;
+
+    for (int i = 0; i < (int) tokens.size(); ++i) {
+        tree.parents.push_back(i - 1);
+        tree.branches.push_back({ 0 });
+    }
+
+    return tree;
+}
+
 llama_tokens common_speculative_gen_draft(
         struct common_speculative * spec,
         struct common_speculative_params params,
         const llama_tokens & prompt_tgt_main_model, // specified in target model vocab
         llama_token id_last) {
+    params.n_branch = 1;
+
+    return common_speculative_gen_draft_tree(spec, params, prompt_tgt_main_model, id_last).tokens;
+}
+
+// the draft tokens are decoded right after the prompt, which is already in the KV cache of the target
+static llama_tokens common_speculative_gen_draft_self(
+        struct common_speculative * spec,
+        struct common_speculative_params params,
+        const llama_tokens & prompt_tgt,
+        llama_token id_last) {
+    auto & batch = spec->batch;
+    auto & ctx   = spec->ctx_tgt;
+    auto & smpl  = spec->smpl;
+
+    const llama_seq_id seq_id = spec->seq_id_self;
+    const llama_pos    n_past = prompt_tgt.size();
+
+    llama_tokens result;
+    result.reserve(params.n_draft);
+
+    llama_set_n_layer_exit(ctx, spec->n_layer_self);
+
+    common_sampler_reset(smpl);
+
+    common_batch_clear(batch);
+    common_batch_add  (batch, id_last, n_past, { seq_id }, true);
+
+    while (llama_decode(ctx, batch) == 0) {
+        common_sampler_sample(smpl, ctx, 0, true);
+
+        const auto * cur_p = common_sampler_get_candidates(smpl);
+
+        for (int k = 0; k < std::min(3, (int) cur_p->size); ++k) {
+            LOG_DBG(" - draft candidate %3d, pos %3d: %6d (%8.3f) '%s'\n",
+                    k, (int) result.size(), cur_p->data[k].id, cur_p->data[k].p, common_token_to_piece(ctx, cur_p->data[k].id).c_str());
+        }
+
+        const llama_token id = cur_p->data[0].id;
+
+        common_sampler_accept(smpl, id, true);
+
+        result.push_back(id);
+
+        // only collect very high-confidence draft tokens
+        if (params.n_draft <= (int) result.size() || cur_p->data[0].p < params.p_min) {
+            break;
+        }
+
+        common_batch_clear(batch);
+        common_batch_add  (batch, id, n_past + result.size(), { seq_id }, true);
+    }
+
+    llama_set_n_layer_exit(ctx, 0);
+
+    // the cells of the draft only hold the first layers, the target decodes these tokens again
+    llama_memory_seq_rm(llama_get_memory(ctx), seq_id, n_past, -1);
+
+    return result;
+}
+
+common_speculative_tree common_speculative_gen_draft_tree(
+        struct common_speculative * spec,
+        struct common_speculative_params params,
+        const llama_tokens & prompt_tgt_main_model, // specified in target model vocab
+        llama_token id_last) {
+    if (spec->n_layer_self > 0) {
+        return common_speculative_tree_from_tokens(common_speculative_gen_draft_self(spec, params, prompt_tgt_main_model, id_last));
+    }
+
     auto & batch  = spec->batch;
     auto & ctx_tgt = spec->ctx_tgt;
     auto & ctx_dft = spec->ctx_dft;
@@ -263,7 +382,7 @@ llama_tokens common_speculative_gen_draft(
                 }
             }
 
-            return result;
+            return common_speculative_tree_from_tokens(result);
         }
 
         if (reuse_i > 0) {
@@ -311,44 +430,127 @@ llama_tokens common_speculative_gen_draft(
 
     common_sampler_reset(smpl);
 
-    // sample n_draft tokens from the draft model
-    for (int i = 0; i < params.n_draft; ++i) {
-        common_batch_clear(batch);
+    // the tokens are translated to the target vocab after drafting, which only works for a single branch
+    const int n_branch = spec->vocab_dft_compatible ? std::max(1, params.n_branch) : 1;
 
-        common_sampler_sample(smpl, ctx_dft, 0, true);
+    struct draft_branch {
+        llama_seq_id seq;     // sequence of the branch in the draft context
+        int          node;    // last token of the branch in the tree, -1 for id_last
+        int          i_batch; // output of the last token of the branch
+        bool         active;  // the branch is extended at the next step
+    };
 
-        const auto * cur_p = common_sampler_get_candidates(smpl);
+    std::vector<draft_branch> branches = { { 0, -1, 0, true } };
 
-        for (int k = 0; k < std::min(3, (int) cur_p->size); ++k) {
-            LOG_DBG(" - draft candidate %3d, pos %3d: %6d (%8.3f) '%s'\n",
-                    k, i, cur_p->data[k].id, cur_p->data[k].p, common_token_to_piece(ctx_dft, cur_p->data[k].id).c_str());
-        }
+    common_speculative_tree tree;
 
-        // add drafted token for each sequence
-        const llama_token id = cur_p->data[0].id;
+    std::vector<int> depth; // of each token of the tree, 0 for the children of id_last
 
-        common_sampler_accept(smpl, id, true);
+    auto add_node = [&](llama_token id, int parent) {
+        tree.tokens .push_back(id);
+        tree.parents.push_back(parent);
 
-        result.push_back(id);
+        depth  .push_back(parent < 0 ? 0 : depth[parent] + 1);
 
-        if (params.n_draft <= (int) result.size()) {
-            break;
+        return (int) tree.tokens.size() - 1;
+    };
+
+    // sample the tree from the draft model, one level of all the branches per decode
+    while ((int) tree.tokens.size() < params.n_draft) {
+        const int n_cur = branches.size();
+
+        for (int b = 0; b < n_cur && (int) tree.tokens.size() < params.n_draft; ++b) {
+            if (!branches[b].active) {
+                continue;
+            }
+
+            common_sampler_sample(smpl, ctx_dft, branches[b].i_batch, true);
+
+            const auto * cur_p = common_sampler_get_candidates(smpl);
+
+            for (int k = 0; k < std::min(3, (int) cur_p->size); ++k) {
+                LOG_DBG(" - draft candidate %3d, branch %d, pos %3d: %6d (%8.3f) '%s'\n",
+                        k, b, (int) tree.tokens.size(), cur_p->data[k].id, cur_p->data[k].p, common_token_to_piece(ctx_dft, cur_p->data[k].id).c_str());
+            }
+
+            // the likely alternatives to the top candidate start new branches, which share the KV cells of this one
+            for (int k = 1; k < (int) cur_p->size && (int) branches.size() < n_branch && (int) tree.tokens.size() + 1 < params.n_draft; ++k) {
+                if (cur_p->data[k].p < params.p_split) {
+                    break;
+                }
+
+                const llama_seq_id seq = branches.size();
+
+                llama_memory_seq_rm(mem_dft, seq, -1, -1);
+                llama_memory_seq_cp(mem_dft, branches[b].seq, seq, -1, -1);
+
+                const int node = add_node(cur_p->data[k].id, branches[b].node);
+
+                branches.push_back({ seq, node, -1, true });
+            }
+
+            const llama_token id = cur_p->data[0].id;
+
+            // the sampler only follows the main draft
+            if (b == 0) {
+                common_sampler_accept(smpl, id, true);
+            }
+
+            branches[b].node = add_node(id, branches[b].node);
+
+            // only collect very high-confidence draft tokens
+            if (cur_p->data[0].p < params.p_min) {
+                branches[b].active = false;
+            }
         }
 
-        // only collect very high-confidence draft tokens
-        if (cur_p->data[0].p < params.p_min) {
+        if (params.n_draft <= (int) tree.tokens.size()) {
             break;
         }
 
-        common_batch_add(batch, id, n_past + i + 1, { 0 }, true);
+        common_batch_clear(batch);
+
+        for (auto & br : branches) {
+            if (!br.active) {
+                continue;
+            }
+
+            const llama_token id = tree.tokens[br.node];
+
+            br.i_batch = batch.n_tokens;
+
+            common_batch_add(batch, id, n_past + depth[br.node] + 1, { br.seq }, true);
+
+            if (br.seq == 0) {
+                prompt_dft.push_back(id);
+            }
+        }
+
+        if (batch.n_tokens == 0) {
+            break;
+        }
 
         // evaluate the drafted tokens on the draft model
         llama_decode(ctx_dft, batch);
+    }
 
-        prompt_dft.push_back(id);
+    // the tokens of the other branches are not kept in the draft context
+    for (int b = 1; b < (int) branches.size(); ++b) {
+        llama_memory_seq_rm(mem_dft, branches[b].seq, -1, -1);
+    }
+
+    tree.n_branch = branches.size();
+    tree.branches.resize(tree.tokens.size());
+
+    for (int b = 0; b < (int) branches.size(); ++b) {
+        for (int node = branches[b].node; node >= 0; node = tree.parents[node]) {
+            tree.branches[node].push_back(b);
+        }
     }
 
     if (!spec->vocab_dft_compatible) {
+        llama_tokens result = tree.tokens;
+
         std::string detokenized = common_detokenize(ctx_dft, result, true);
         detokenized = replace_to_tgt(spec, detokenized);
         LOG_DBG("draft->main detokenized string: '%s'\n", detokenized.c_str());
@@ -356,6 +558,9 @@ llama_tokens common_speculative_gen_draft(
         if (result.size() > (size_t)params.n_draft) {
             result.resize(params.n_draft);
         }
+
+        return common_speculative_tree_from_tokens(result);
     }
-    return result;
+
+    return tree;
 }
@@ -10,13 +10,39 @@ struct common_speculative_params {
     int n_reuse = 256;
 
     float p_min = 0.75f; // min probability required to accept a token in the draft
+
+    int   n_branch = 1;    // max number of branches of the draft tree (1 = linear draft)
+    float p_split  = 0.1f; // min probability of an alternative draft token to start a new branch
 };
 
+// tree of drafted tokens, rooted at the last sampled token
+// branch 0 is the main draft, the others fork from it or from each other
+// the tokens are in breadth-first order, so the parent of a token always comes before it
+struct common_speculative_tree {
+    llama_tokens     tokens;
+    std::vector<int> parents; // index of the parent of each token, -1 for the children of the root
+
+    std::vector<std::vector<int>> branches; // branches whose path contains each token
+
+    int n_branch = 1;
+};
+
+// a tree with a single branch
+common_speculative_tree common_speculative_tree_from_tokens(const llama_tokens & tokens);
+
 struct common_speculative * common_speculative_init(
         struct llama_context * ctx_tgt,
         struct llama_context * ctx_dft
 );
 
+// self-speculative decoding: draft with the first n_layer layers of the target model
+// the draft tokens are decoded in the sequence seq_id of ctx_tgt, on top of its KV cells, and removed afterwards
+struct common_speculative * common_speculative_init_self(
+        struct llama_context * ctx_tgt,
+                llama_seq_id   seq_id,
+                    uint32_t   n_layer
+);
+
 void common_speculative_free(struct common_speculative * spec);
 
 bool common_speculative_are_compatible(
@@ -33,3 +59,13 @@ llama_tokens common_speculative_gen_draft(
         struct common_speculative_params   params,
                       const llama_tokens & prompt,
                              llama_token   id_last);
+
+// sample a tree of up to n_draft tokens using the draft model
+// at each step, the candidates of a branch with a probability of at least p_split start new branches, up to n_branch
+// the branches are decoded as sequences [0, n_branch) of the draft context, which must have a unified KV cache
+// self-speculative drafts always have a single branch
+common_speculative_tree common_speculative_gen_draft_tree(
+               struct common_speculative * spec,
+        struct common_speculative_params   params,
+                      const llama_tokens & prompt,
+                             llama_token   id_last);
@@ -4,6 +4,7 @@
 #include "llama.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <string>
 #include <vector>
@@ -81,6 +82,13 @@ int main(int argc, char ** argv) {
         return 1;
     }
 
+    // with a top-k sampler the top_k candidates are selected in the graph, so that only these are copied back
+    // instead of the logits of the whole vocab - the temperature is applied by the sampler chain
+    // it is not available if the device of the output cannot select them, the logits are then sampled as usual
+    const bool graph_sampling = params.sampling.top_k > 0 && llama_set_graph_sampling(ctx, params.sampling.top_k, 1.0f);
+
+    std::vector<llama_token_data> cur;
+
     const int n_ctx = llama_n_ctx(ctx);
 
     LOG_INF("\n%s: n_predict = %d, n_ctx = %d, n_batch = %u, n_parallel = %d, n_kv_req = %d\n", __func__, n_predict, n_ctx, ctx_params.n_batch, n_parallel, n_kv_req);
@@ -173,7 +181,31 @@ int main(int argc, char ** argv) {
                 continue;
             }
 
-            const llama_token new_token_id = llama_sampler_sample(smpl, ctx, i_batch[i]);
+            llama_token new_token_id;
+
+            if (graph_sampling) {
+                const llama_token * ids   = nullptr;
+                const float       * probs = nullptr;
+                const int32_t k = llama_get_sampled_ith(ctx, i_batch[i], &ids, &probs);
+                GGML_ASSERT(k > 0);
+
+                // the log of the probabilities are the logits up to a constant, which the samplers are invariant to
+                cur.resize(k);
+                for (int32_t j = 0; j < k; ++j) {
+                    cur[j] = llama_token_data{ ids[j], probs ? logf(probs[j]) : 0.0f, 0.0f };
+                }
+
+                llama_token_data_array cur_p = { cur.data(), cur.size(), -1, true };
+
+                llama_sampler_apply(smpl, &cur_p);
+                GGML_ASSERT(cur_p.selected >= 0 && cur_p.selected < (int64_t) cur_p.size);
+
+                new_token_id = cur_p.data[cur_p.selected].id;
+
+                llama_sampler_accept(smpl, new_token_id);
+            } else {
+                new_token_id = llama_sampler_sample(smpl, ctx, i_batch[i]);
+            }
 
             // is it an end of generation? -> mark the stream as finished
             if (llama_vocab_is_eog(vocab, new_token_id) || n_cur == n_predict) {
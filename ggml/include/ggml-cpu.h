@@ -134,6 +134,10 @@ extern "C" {
 
     GGML_BACKEND_API ggml_backend_reg_t ggml_backend_cpu_reg(void);
 
+    // CPU_REPACK buffer over memory that already holds repacked weights, e.g. a mapped file written from the data of a CPU_REPACK buffer
+    // the layout depends on the CPU features, so the data must have been repacked by the same build on the same kind of CPU
+    GGML_BACKEND_API ggml_backend_buffer_t ggml_backend_cpu_repack_buffer_from_ptr(void * ptr, size_t size);
+
     GGML_BACKEND_API void ggml_cpu_fp32_to_fp32(const float *,       float *, int64_t);
     GGML_BACKEND_API void ggml_cpu_fp32_to_fp16(const float *, ggml_fp16_t *, int64_t);
     GGML_BACKEND_API void ggml_cpu_fp16_to_fp32(const ggml_fp16_t *, float *, int64_t);
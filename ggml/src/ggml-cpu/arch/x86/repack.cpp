@@ -517,12 +517,27 @@ void ggml_quantize_mat_q8_K_4x8(const float * GGML_RESTRICT x, void * GGML_RESTR
 
 #if defined(__AVX2__) || defined(__AVX512F__)
 
+// E8M0 scales of MXFP4 blocks, halved like GGML_E8M0_TO_FP32_HALF to match the doubled kvalues_mxfp4
+static inline __m256 __avx_e8m0x8_half_load(const uint8_t * x) {
+    const __m256i e      = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) x));
+    const __m256i normal = _mm256_slli_epi32(_mm256_sub_epi32(e, _mm256_set1_epi32(1)), 23);
+    const __m256i denorm = _mm256_sllv_epi32(_mm256_set1_epi32(0x00200000), e);
+    return _mm256_castsi256_ps(_mm256_blendv_epi8(normal, denorm, _mm256_cmpgt_epi32(_mm256_set1_epi32(2), e)));
+}
+
+#define GGML_E8M0x8_HALF_LOAD(x) __avx_e8m0x8_half_load(x)
+#if defined(__AVX512F__)
+#define GGML_E8M0x8x2_HALF_LOAD(x, y) \
+    _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(__avx_e8m0x8_half_load(x))), _mm256_castps_pd(__avx_e8m0x8_half_load(y)), 1))
+#endif
+
 // GEMV for 8x blocks of 32 4-bit quants with a single scale factor per block
 template<typename block_tx8>
 static void gemv_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc, __m256i signextendlut) {
     static_assert(
             std::is_same_v<block_tx8, block_q4_0x8> ||
-            std::is_same_v<block_tx8, block_iq4_nlx8>,
+            std::is_same_v<block_tx8, block_iq4_nlx8> ||
+            std::is_same_v<block_tx8, block_mxfp4x8>,
             "Unsupported block type");
 
     const int qk = QK8_0;
@@ -580,6 +595,8 @@ static void gemv_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t
                         std::is_same_v<block_tx8, block_q4_0x8> ||
                         std::is_same_v<block_tx8, block_iq4_nlx8>) {
                     col_scale_f32 = GGML_F32Cx8_REARRANGE_LOAD(b_ptr[b].d, changemask);
+                } else if constexpr (std::is_same_v<block_tx8, block_mxfp4x8>) {
+                    col_scale_f32 = _mm256_permutevar8x32_ps(GGML_E8M0x8_HALF_LOAD(b_ptr[b].e), _mm256_set_epi32(7, 3, 6, 2, 5, 1, 4, 0));
                 }
 
                 // Load and convert to FP32 scale from block_q8_0
@@ -628,7 +645,8 @@ template<typename block_tx8>
 static void gemm_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc, __m256i signextendlut) {
     static_assert(
             std::is_same_v<block_tx8, block_q4_0x8> ||
-            std::is_same_v<block_tx8, block_iq4_nlx8>,
+            std::is_same_v<block_tx8, block_iq4_nlx8> ||
+            std::is_same_v<block_tx8, block_mxfp4x8>,
             "Unsupported block type");
 
     const int qk = QK8_0;
@@ -749,6 +767,8 @@ static void gemm_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t
                         std::is_same_v<block_tx8, block_q4_0x8> ||
                         std::is_same_v<block_tx8, block_iq4_nlx8>) {
                     col_scale_f32 = GGML_F32Cx8x2_LOAD(b_ptr_0[b].d, b_ptr_1[b].d);
+                } else if constexpr (std::is_same_v<block_tx8, block_mxfp4x8>) {
+                    col_scale_f32 = GGML_E8M0x8x2_HALF_LOAD(b_ptr_0[b].e, b_ptr_1[b].e);
                 }
 
                 // Process LHS in pairs of rows
@@ -941,6 +961,8 @@ static void gemm_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t
                         std::is_same_v<block_tx8, block_q4_0x8> ||
                         std::is_same_v<block_tx8, block_iq4_nlx8>) {
                     col_scale_f32 = GGML_F32Cx8x2_LOAD(b_ptr_0[b].d, b_ptr_1[b].d);
+                } else if constexpr (std::is_same_v<block_tx8, block_mxfp4x8>) {
+                    col_scale_f32 = GGML_E8M0x8x2_HALF_LOAD(b_ptr_0[b].e, b_ptr_1[b].e);
                 }
 
                 // Load the four blocks of quantized values interleaved with each other in chunks of eight - A0,A1,A2,A3
@@ -1123,6 +1145,8 @@ static void gemm_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t
                         std::is_same_v<block_tx8, block_q4_0x8> ||
                         std::is_same_v<block_tx8, block_iq4_nlx8>) {
                     col_scale_f32 = GGML_F32Cx8_LOAD(b_ptr[b].d);
+                } else if constexpr (std::is_same_v<block_tx8, block_mxfp4x8>) {
+                    col_scale_f32 = GGML_E8M0x8_HALF_LOAD(b_ptr[b].e);
                 }
 
                 // Process LHS in groups of four
@@ -1283,6 +1307,8 @@ static void gemm_q4_b32_8x8_q8_0_lut_avx(int n, float * GGML_RESTRICT s, size_t
                         std::is_same_v<block_tx8, block_q4_0x8> ||
                         std::is_same_v<block_tx8, block_iq4_nlx8>) {
                     col_scale_f32 = GGML_F32Cx8_LOAD(b_ptr[b].d);
+                } else if constexpr (std::is_same_v<block_tx8, block_mxfp4x8>) {
+                    col_scale_f32 = GGML_E8M0x8_HALF_LOAD(b_ptr[b].e);
                 }
 
                 // Load the four blocks of quantized values interleaved with each other in chunks of eight - A0,A1,A2,A3
@@ -1938,6 +1964,286 @@ void ggml_gemv_q2_K_8x8_q8_K(int n, float * GGML_RESTRICT s, size_t bs, const vo
 #endif
 }
 
+#if defined(__AVX2__)
+// Sum the int32 pairs of blocks B0 - B3 and B4 - B7, returning the sums in the order of the blocks
+static inline __m256i hadd_rows_int32x8(const __m256i acc_0123, const __m256i acc_4567) {
+    return _mm256_permute4x64_epi64(_mm256_hadd_epi32(acc_0123, acc_4567), 0xD8);
+}
+
+// Replicate the int32 scales of B0 - B7 as int16 over the int16 lanes of the products of B0 - B3 and B4 - B7
+static inline void scales_int16_rows(const __m256i scales, __m256i & scales_0123, __m256i & scales_4567) {
+    const __m256i scales_x2 = _mm256_or_si256(_mm256_and_si256(scales, _mm256_set1_epi32(0xFFFF)), _mm256_slli_epi32(scales, 16));
+    scales_0123 = _mm256_permutevar8x32_epi32(scales_x2, _mm256_set_epi32(3, 3, 2, 2, 1, 1, 0, 0));
+    scales_4567 = _mm256_permutevar8x32_epi32(scales_x2, _mm256_set_epi32(7, 7, 6, 6, 5, 5, 4, 4));
+}
+
+// Multiply the int16 scales of B0 - B7 for two sub-blocks with the quant sums of the two sub-blocks
+static inline __m256i mul_sum_scales_bsums_int32x8(const __m128i scales_0, const __m128i scales_1, const int16_t bsum_0, const int16_t bsum_1) {
+    const __m256i scales = _mm256_set_m128i(_mm_unpackhi_epi16(scales_0, scales_1), _mm_unpacklo_epi16(scales_0, scales_1));
+    const __m256i bsums  = _mm256_set1_epi32((int32_t) (((uint32_t) (uint16_t) bsum_1 << 16) | (uint16_t) bsum_0));
+    return _mm256_madd_epi16(scales, bsums);
+}
+
+// Broadcast 8 quants of the LHS to all the 64 bit lanes
+static inline __m256i load_lhs_8x4(const int8_t * x) {
+    return _mm256_broadcastq_epi64(_mm_loadl_epi64((const __m128i *) x));
+}
+
+// Unpack the 6 bit scales and mins of the eight sub-blocks of block_q5_Kx8 / block_q4_Kx8
+// Sub-block sb has the scales of B0 - B7 at utmp + sb * 16 and the mins at utmp + sb * 16 + 8
+static inline void unpack_scales_mins_q5_Kx8(const uint8_t * scales, uint32_t * utmp) {
+    static const uint32_t kmask1 = 0x3f3f3f3f;
+    static const uint32_t kmask2 = 0x0f0f0f0f;
+    static const uint32_t kmask3 = 0x03030303;
+
+    for (int sb = 0; sb < 8; sb++) {
+        memcpy(utmp + sb * 4, scales + sb * 12, 12);
+        utmp[sb * 4 + 3] = ((utmp[sb * 4 + 2] >> 4) & kmask2) | (((utmp[sb * 4 + 1] >> 6) & kmask3) << 4);
+        const uint32_t uaux_0 = utmp[sb * 4 + 1] & kmask1;
+        utmp[sb * 4 + 1] = (utmp[sb * 4 + 2] & kmask2) | (((utmp[sb * 4 + 0] >> 6) & kmask3) << 4);
+        utmp[sb * 4 + 2] = uaux_0;
+        utmp[sb * 4 + 0] &= kmask1;
+    }
+}
+
+// Quants 0-7 (lo) and 32-39 (hi) of a 64 quant group of B0 - B3 or B4 - B7, from 8 bytes of qs and the 5-th bits at bit shift / shift + 1 of qh
+static inline void unpack_q5_Kx8(const __m256i qs, const __m256i qh, const __m128i shift, __m256i & lo, __m256i & hi) {
+    const __m256i m4b  = _mm256_set1_epi8(0x0F);
+    const __m256i mh   = _mm256_set1_epi8(0x10);
+    const __m256i bits = _mm256_srl_epi16(qh, shift);
+    lo = _mm256_or_si256(_mm256_and_si256(qs, m4b), _mm256_and_si256(_mm256_slli_epi16(bits, 4), mh));
+    hi = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(qs, 4), m4b), _mm256_and_si256(_mm256_slli_epi16(bits, 3), mh));
+}
+
+// The four runs of 8 quants of B0 - B3 or B4 - B7 that are 32 apart in a half of the Q6_K super block, from 8 bytes of
+// ql at offsets 0 and 32 of the half and 8 bytes of qh, without the offset of 32
+static inline void unpack_q6_Kx8(const __m256i ql_0, const __m256i ql_1, const __m256i qh, __m256i * q) {
+    const __m256i m4b = _mm256_set1_epi8(0x0F);
+    const __m256i mh  = _mm256_set1_epi8(0x30);
+    q[0] = _mm256_or_si256(_mm256_and_si256(ql_0, m4b), _mm256_and_si256(_mm256_slli_epi16(qh, 4), mh));
+    q[1] = _mm256_or_si256(_mm256_and_si256(ql_1, m4b), _mm256_and_si256(_mm256_slli_epi16(qh, 2), mh));
+    q[2] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(ql_0, 4), m4b), _mm256_and_si256(qh, mh));
+    q[3] = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(ql_1, 4), m4b), _mm256_and_si256(_mm256_srli_epi16(qh, 2), mh));
+}
+#endif // defined(__AVX2__)
+
+void ggml_gemv_q5_K_8x8_q8_K(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    const int qk = QK_K;
+    const int nb = n / qk;
+
+    assert (n % qk == 0);
+    assert (nc % 8 == 0);
+
+    UNUSED(bs);
+    UNUSED(nr);
+
+    uint32_t utmp[32];
+    const uint8_t * scales_mins = (const uint8_t *) utmp;
+
+    const block_q8_K * a_ptr = (const block_q8_K *) vy;
+
+    for (int64_t x = 0; x < nc / 8; x++) {
+        const block_q5_Kx8 * b_ptr = (const block_q5_Kx8 *) vx + (x * nb);
+
+        __m256 acc_row = _mm256_setzero_ps();
+        __m256 acc_min_row = _mm256_setzero_ps();
+
+        for (int64_t b = 0; b < nb; b++) {
+            unpack_scales_mins_q5_Kx8(b_ptr[b].scales, utmp);
+
+            __m256i iacc_0123 = _mm256_setzero_si256();
+            __m256i iacc_4567 = _mm256_setzero_si256();
+
+            // Each group of 64 quants is made of the sub-blocks 2 * j (low nibbles) and 2 * j + 1 (high nibbles)
+            for (int j = 0; j < 4; j++) {
+                const __m128i shift = _mm_cvtsi32_si128(2 * j);
+
+                // Sums of products of up to four runs of 8 quants stay within int16
+                __m256i isum_lo_0123 = _mm256_setzero_si256();
+                __m256i isum_lo_4567 = _mm256_setzero_si256();
+                __m256i isum_hi_0123 = _mm256_setzero_si256();
+                __m256i isum_hi_4567 = _mm256_setzero_si256();
+
+                for (int k = 0; k < 4; k++) {
+                    const uint8_t * qs = b_ptr[b].qs + (j * 4 + k) * 64;
+                    const uint8_t * qh = b_ptr[b].qh + k * 64;
+
+                    __m256i rhs_lo_0123, rhs_hi_0123, rhs_lo_4567, rhs_hi_4567;
+                    unpack_q5_Kx8(_mm256_loadu_si256((const __m256i *) qs),        _mm256_loadu_si256((const __m256i *) qh),        shift, rhs_lo_0123, rhs_hi_0123);
+                    unpack_q5_Kx8(_mm256_loadu_si256((const __m256i *) (qs + 32)), _mm256_loadu_si256((const __m256i *) (qh + 32)), shift, rhs_lo_4567, rhs_hi_4567);
+
+                    const __m256i lhs_lo = load_lhs_8x4(a_ptr[b].qs + j * 64 + k * 8);
+                    const __m256i lhs_hi = load_lhs_8x4(a_ptr[b].qs + j * 64 + k * 8 + 32);
+
+                    isum_lo_0123 = _mm256_add_epi16(isum_lo_0123, _mm256_maddubs_epi16(rhs_lo_0123, lhs_lo));
+                    isum_lo_4567 = _mm256_add_epi16(isum_lo_4567, _mm256_maddubs_epi16(rhs_lo_4567, lhs_lo));
+                    isum_hi_0123 = _mm256_add_epi16(isum_hi_0123, _mm256_maddubs_epi16(rhs_hi_0123, lhs_hi));
+                    isum_hi_4567 = _mm256_add_epi16(isum_hi_4567, _mm256_maddubs_epi16(rhs_hi_4567, lhs_hi));
+                }
+
+                __m256i scales_lo_0123, scales_lo_4567, scales_hi_0123, scales_hi_4567;
+                scales_int16_rows(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (scales_mins + (2 * j) * 16))),     scales_lo_0123, scales_lo_4567);
+                scales_int16_rows(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (scales_mins + (2 * j + 1) * 16))), scales_hi_0123, scales_hi_4567);
+
+                iacc_0123 = _mm256_add_epi32(iacc_0123, _mm256_add_epi32(_mm256_madd_epi16(isum_lo_0123, scales_lo_0123), _mm256_madd_epi16(isum_hi_0123, scales_hi_0123)));
+                iacc_4567 = _mm256_add_epi32(iacc_4567, _mm256_add_epi32(_mm256_madd_epi16(isum_lo_4567, scales_lo_4567), _mm256_madd_epi16(isum_hi_4567, scales_hi_4567)));
+            }
+
+            // Mins multiplied with the quant sums of the sub-blocks
+            __m256i iacc_min = _mm256_setzero_si256();
+            for (int sb = 0; sb < 8; sb += 2) {
+                iacc_min = _mm256_add_epi32(iacc_min, mul_sum_scales_bsums_int32x8(
+                            _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (scales_mins + sb * 16 + 8))),
+                            _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (scales_mins + (sb + 1) * 16 + 8))),
+                            a_ptr[b].bsums[sb * 2]       + a_ptr[b].bsums[sb * 2 + 1],
+                            a_ptr[b].bsums[(sb + 1) * 2] + a_ptr[b].bsums[(sb + 1) * 2 + 1]));
+            }
+
+            const __m256 row_scale_f32 = _mm256_set1_ps(a_ptr[b].d);
+            acc_row     = _mm256_fmadd_ps(_mm256_cvtepi32_ps(hadd_rows_int32x8(iacc_0123, iacc_4567)), _mm256_mul_ps(GGML_F32Cx8_LOAD(b_ptr[b].d), row_scale_f32), acc_row);
+            acc_min_row = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc_min), _mm256_mul_ps(GGML_F32Cx8_LOAD(b_ptr[b].dmin), row_scale_f32), acc_min_row);
+        }
+
+        _mm256_storeu_ps(s + x * 8, _mm256_sub_ps(acc_row, acc_min_row));
+    }
+#else
+
+    ggml_gemv_q5_K_8x8_q8_K_generic(n, s, bs, vx, vy, nr, nc);
+
+#endif
+}
+
+void ggml_gemv_q6_K_8x8_q8_K(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    const int qk = QK_K;
+    const int nb = n / qk;
+
+    assert (n % qk == 0);
+    assert (nc % 8 == 0);
+
+    UNUSED(bs);
+    UNUSED(nr);
+
+    const block_q8_K * a_ptr = (const block_q8_K *) vy;
+
+    for (int64_t x = 0; x < nc / 8; x++) {
+        const block_q6_Kx8 * b_ptr = (const block_q6_Kx8 *) vx + (x * nb);
+
+        __m256 acc_row = _mm256_setzero_ps();
+
+        for (int64_t b = 0; b < nb; b++) {
+            __m256i iacc_0123 = _mm256_setzero_si256();
+            __m256i iacc_4567 = _mm256_setzero_si256();
+
+            for (int h = 0; h < 2; h++) {
+                // Two consecutive runs of 8 quants share the scales of a sub-block of 16
+                for (int up = 0; up < 2; up++) {
+                    __m256i isum_0123[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+                    __m256i isum_4567[4] = { _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256() };
+
+                    for (int u = 2 * up; u < 2 * up + 2; u++) {
+                        const uint8_t * ql = b_ptr[b].ql + (h * 8 + u) * 64;
+                        const uint8_t * qh = b_ptr[b].qh + (h * 4 + u) * 64;
+
+                        __m256i rhs_0123[4], rhs_4567[4];
+                        unpack_q6_Kx8(_mm256_loadu_si256((const __m256i *) ql),        _mm256_loadu_si256((const __m256i *) (ql + 256)), _mm256_loadu_si256((const __m256i *) qh),        rhs_0123);
+                        unpack_q6_Kx8(_mm256_loadu_si256((const __m256i *) (ql + 32)), _mm256_loadu_si256((const __m256i *) (ql + 288)), _mm256_loadu_si256((const __m256i *) (qh + 32)), rhs_4567);
+
+                        for (int q = 0; q < 4; q++) {
+                            const __m256i lhs = load_lhs_8x4(a_ptr[b].qs + h * 128 + q * 32 + u * 8);
+                            isum_0123[q] = _mm256_add_epi16(isum_0123[q], _mm256_maddubs_epi16(rhs_0123[q], lhs));
+                            isum_4567[q] = _mm256_add_epi16(isum_4567[q], _mm256_maddubs_epi16(rhs_4567[q], lhs));
+                        }
+                    }
+
+                    for (int q = 0; q < 4; q++) {
+                        __m256i scales_0123, scales_4567;
+                        scales_int16_rows(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) (b_ptr[b].scales + (h * 8 + q * 2 + up) * 8))), scales_0123, scales_4567);
+                        iacc_0123 = _mm256_add_epi32(iacc_0123, _mm256_madd_epi16(isum_0123[q], scales_0123));
+                        iacc_4567 = _mm256_add_epi32(iacc_4567, _mm256_madd_epi16(isum_4567[q], scales_4567));
+                    }
+                }
+            }
+
+            // The quants were used without their offset of 32, subtract 32 * scales * sums of the LHS quants
+            __m256i iacc_offset = _mm256_setzero_si256();
+            for (int g = 0; g < QK_K / 16; g += 2) {
+                iacc_offset = _mm256_add_epi32(iacc_offset, mul_sum_scales_bsums_int32x8(
+                            _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *) (b_ptr[b].scales + g * 8))),
+                            _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *) (b_ptr[b].scales + (g + 1) * 8))),
+                            a_ptr[b].bsums[g], a_ptr[b].bsums[g + 1]));
+            }
+
+            const __m256i iacc = _mm256_sub_epi32(hadd_rows_int32x8(iacc_0123, iacc_4567), _mm256_slli_epi32(iacc_offset, 5));
+            acc_row = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc), _mm256_mul_ps(GGML_F32Cx8_LOAD(b_ptr[b].d), _mm256_set1_ps(a_ptr[b].d)), acc_row);
+        }
+
+        _mm256_storeu_ps(s + x * 8, acc_row);
+    }
+#else
+
+    ggml_gemv_q6_K_8x8_q8_K_generic(n, s, bs, vx, vy, nr, nc);
+
+#endif
+}
+
+void ggml_gemv_q8_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert (nr == 1);
+    assert (n % qk == 0);
+    assert (nc % 8 == 0);
+
+    UNUSED(bs);
+    UNUSED(nr);
+
+    const block_q8_0 * a_ptr = (const block_q8_0 *) vy;
+
+    for (int64_t x = 0; x < nc / 8; x++) {
+        const block_q8_0x8 * b_ptr = (const block_q8_0x8 *) vx + (x * nb);
+
+        __m256 acc_row = _mm256_setzero_ps();
+
+        for (int64_t b = 0; b < nb; b++) {
+            __m256i iacc_0123 = _mm256_setzero_si256();
+            __m256i iacc_4567 = _mm256_setzero_si256();
+
+            // Each 64 bytes hold 8 quants of each of B0 - B7
+            for (int k = 0; k < 4; k++) {
+                const __m256i lhs = load_lhs_8x4(a_ptr[b].qs + k * 8);
+                iacc_0123 = mul_sum_i8_pairs_acc_int32x8(iacc_0123, _mm256_loadu_si256((const __m256i *) (b_ptr[b].qs + k * 64)),      lhs);
+                iacc_4567 = mul_sum_i8_pairs_acc_int32x8(iacc_4567, _mm256_loadu_si256((const __m256i *) (b_ptr[b].qs + k * 64 + 32)), lhs);
+            }
+
+            const __m256 row_scale_f32 = _mm256_set1_ps(GGML_CPU_FP16_TO_FP32(a_ptr[b].d));
+            acc_row = _mm256_fmadd_ps(_mm256_cvtepi32_ps(hadd_rows_int32x8(iacc_0123, iacc_4567)), _mm256_mul_ps(GGML_F32Cx8_LOAD(b_ptr[b].d), row_scale_f32), acc_row);
+        }
+
+        _mm256_storeu_ps(s + x * 8, acc_row);
+    }
+#else
+
+    ggml_gemv_q8_0_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+
+#endif
+}
+
+void ggml_gemv_mxfp4_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    __m256i signextendlut = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)kvalues_mxfp4));
+    signextendlut = _mm256_permute2f128_si256(signextendlut, signextendlut, 0);
+
+    gemv_q4_b32_8x8_q8_0_lut_avx<block_mxfp4x8>(n, s, bs, vx, vy, nr, nc, signextendlut);
+
+    return;
+#endif
+
+    ggml_gemv_mxfp4_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+}
+
 void ggml_gemm_q4_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
 #if defined(__AVX2__) || defined(__AVX512F__)
     {
@@ -6305,3 +6611,274 @@ void ggml_gemm_q2_K_8x8_q8_K(int n, float * GGML_RESTRICT s, size_t bs, const vo
 
 #endif
 }
+
+void ggml_gemm_q5_K_8x8_q8_K(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    const int qk = QK_K;
+    const int nb = n / qk;
+
+    assert (n % qk == 0);
+    assert (nr % 4 == 0);
+    assert (nc % 8 == 0);
+
+    uint32_t utmp[32];
+    const uint8_t * scales_mins = (const uint8_t *) utmp;
+
+    for (int64_t y = 0; y < nr / 4; y++) {
+        const block_q8_Kx4 * a_ptr = (const block_q8_Kx4 *) vy + (y * nb);
+
+        for (int64_t x = 0; x < nc / 8; x++) {
+            const block_q5_Kx8 * b_ptr = (const block_q5_Kx8 *) vx + (x * nb);
+
+            __m256 acc_rows[4];
+            __m256 acc_min_rows[4];
+            for (int m = 0; m < 4; m++) {
+                acc_rows[m] = _mm256_setzero_ps();
+                acc_min_rows[m] = _mm256_setzero_ps();
+            }
+
+            for (int64_t b = 0; b < nb; b++) {
+                unpack_scales_mins_q5_Kx8(b_ptr[b].scales, utmp);
+
+                __m256i iacc_0123[4];
+                __m256i iacc_4567[4];
+                for (int m = 0; m < 4; m++) {
+                    iacc_0123[m] = _mm256_setzero_si256();
+                    iacc_4567[m] = _mm256_setzero_si256();
+                }
+
+                // Each group of 64 quants is made of the sub-blocks 2 * j (low nibbles) and 2 * j + 1 (high nibbles)
+                for (int j = 0; j < 4; j++) {
+                    const __m128i shift = _mm_cvtsi32_si128(2 * j);
+
+                    // The quants of the group are unpacked once and used for the four rows of the LHS
+                    __m256i rhs_lo_0123[4], rhs_hi_0123[4], rhs_lo_4567[4], rhs_hi_4567[4];
+                    for (int k = 0; k < 4; k++) {
+                        const uint8_t * qs = b_ptr[b].qs + (j * 4 + k) * 64;
+                        const uint8_t * qh = b_ptr[b].qh + k * 64;
+                        unpack_q5_Kx8(_mm256_loadu_si256((const __m256i *) qs),        _mm256_loadu_si256((const __m256i *) qh),        shift, rhs_lo_0123[k], rhs_hi_0123[k]);
+                        unpack_q5_Kx8(_mm256_loadu_si256((const __m256i *) (qs + 32)), _mm256_loadu_si256((const __m256i *) (qh + 32)), shift, rhs_lo_4567[k], rhs_hi_4567[k]);
+                    }
+
+                    __m256i scales_lo_0123, scales_lo_4567, scales_hi_0123, scales_hi_4567;
+                    scales_int16_rows(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (scales_mins + (2 * j) * 16))),     scales_lo_0123, scales_lo_4567);
+                    scales_int16_rows(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (scales_mins + (2 * j + 1) * 16))), scales_hi_0123, scales_hi_4567);
+
+                    for (int m = 0; m < 4; m++) {
+                        __m256i isum_lo_0123 = _mm256_setzero_si256();
+                        __m256i isum_lo_4567 = _mm256_setzero_si256();
+                        __m256i isum_hi_0123 = _mm256_setzero_si256();
+                        __m256i isum_hi_4567 = _mm256_setzero_si256();
+
+                        for (int k = 0; k < 4; k++) {
+                            // Quants of the LHS rows are interleaved by 8, the high nibbles are 32 quants (4 runs) further
+                            const __m256i lhs_lo = load_lhs_8x4(a_ptr[b].qs + (j * 8 + k) * 32 + m * 8);
+                            const __m256i lhs_hi = load_lhs_8x4(a_ptr[b].qs + (j * 8 + k + 4) * 32 + m * 8);
+
+                            isum_lo_0123 = _mm256_add_epi16(isum_lo_0123, _mm256_maddubs_epi16(rhs_lo_0123[k], lhs_lo));
+                            isum_lo_4567 = _mm256_add_epi16(isum_lo_4567, _mm256_maddubs_epi16(rhs_lo_4567[k], lhs_lo));
+                            isum_hi_0123 = _mm256_add_epi16(isum_hi_0123, _mm256_maddubs_epi16(rhs_hi_0123[k], lhs_hi));
+                            isum_hi_4567 = _mm256_add_epi16(isum_hi_4567, _mm256_maddubs_epi16(rhs_hi_4567[k], lhs_hi));
+                        }
+
+                        iacc_0123[m] = _mm256_add_epi32(iacc_0123[m], _mm256_add_epi32(_mm256_madd_epi16(isum_lo_0123, scales_lo_0123), _mm256_madd_epi16(isum_hi_0123, scales_hi_0123)));
+                        iacc_4567[m] = _mm256_add_epi32(iacc_4567[m], _mm256_add_epi32(_mm256_madd_epi16(isum_lo_4567, scales_lo_4567), _mm256_madd_epi16(isum_hi_4567, scales_hi_4567)));
+                    }
+                }
+
+                const __m256 col_scale_f32 = GGML_F32Cx8_LOAD(b_ptr[b].d);
+                const __m256 col_dmin_f32  = GGML_F32Cx8_LOAD(b_ptr[b].dmin);
+
+                for (int m = 0; m < 4; m++) {
+                    // Mins multiplied with the quant sums of the sub-blocks of row m
+                    __m256i iacc_min = _mm256_setzero_si256();
+                    for (int sb = 0; sb < 8; sb += 2) {
+                        const int16_t * bsums = a_ptr[b].bsums + (sb * 8) + (m * 4);
+                        iacc_min = _mm256_add_epi32(iacc_min, mul_sum_scales_bsums_int32x8(
+                                    _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (scales_mins + sb * 16 + 8))),
+                                    _mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) (scales_mins + (sb + 1) * 16 + 8))),
+                                    bsums[0] + bsums[1],
+                                    bsums[2] + bsums[3]));
+                    }
+
+                    const __m256 row_scale_f32 = _mm256_set1_ps(a_ptr[b].d[m]);
+                    acc_rows[m]     = _mm256_fmadd_ps(_mm256_cvtepi32_ps(hadd_rows_int32x8(iacc_0123[m], iacc_4567[m])), _mm256_mul_ps(col_scale_f32, row_scale_f32), acc_rows[m]);
+                    acc_min_rows[m] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc_min), _mm256_mul_ps(col_dmin_f32, row_scale_f32), acc_min_rows[m]);
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                _mm256_storeu_ps(s + (y * 4 + m) * bs + x * 8, _mm256_sub_ps(acc_rows[m], acc_min_rows[m]));
+            }
+        }
+    }
+#else
+
+    ggml_gemm_q5_K_8x8_q8_K_generic(n, s, bs, vx, vy, nr, nc);
+
+#endif
+}
+
+void ggml_gemm_q6_K_8x8_q8_K(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    const int qk = QK_K;
+    const int nb = n / qk;
+
+    assert (n % qk == 0);
+    assert (nr % 4 == 0);
+    assert (nc % 8 == 0);
+
+    for (int64_t y = 0; y < nr / 4; y++) {
+        const block_q8_Kx4 * a_ptr = (const block_q8_Kx4 *) vy + (y * nb);
+
+        for (int64_t x = 0; x < nc / 8; x++) {
+            const block_q6_Kx8 * b_ptr = (const block_q6_Kx8 *) vx + (x * nb);
+
+            __m256 acc_rows[4];
+            for (int m = 0; m < 4; m++) {
+                acc_rows[m] = _mm256_setzero_ps();
+            }
+
+            for (int64_t b = 0; b < nb; b++) {
+                __m256i iacc_0123[4];
+                __m256i iacc_4567[4];
+                for (int m = 0; m < 4; m++) {
+                    iacc_0123[m] = _mm256_setzero_si256();
+                    iacc_4567[m] = _mm256_setzero_si256();
+                }
+
+                for (int h = 0; h < 2; h++) {
+                    // Two consecutive runs of 8 quants share the scales of a sub-block of 16
+                    for (int up = 0; up < 2; up++) {
+                        // The quants are unpacked once and used for the four rows of the LHS
+                        __m256i rhs_0123[2][4], rhs_4567[2][4];
+                        for (int u = 0; u < 2; u++) {
+                            const uint8_t * ql = b_ptr[b].ql + (h * 8 + up * 2 + u) * 64;
+                            const uint8_t * qh = b_ptr[b].qh + (h * 4 + up * 2 + u) * 64;
+                            unpack_q6_Kx8(_mm256_loadu_si256((const __m256i *) ql),        _mm256_loadu_si256((const __m256i *) (ql + 256)), _mm256_loadu_si256((const __m256i *) qh),        rhs_0123[u]);
+                            unpack_q6_Kx8(_mm256_loadu_si256((const __m256i *) (ql + 32)), _mm256_loadu_si256((const __m256i *) (ql + 288)), _mm256_loadu_si256((const __m256i *) (qh + 32)), rhs_4567[u]);
+                        }
+
+                        __m256i scales_0123[4], scales_4567[4];
+                        for (int q = 0; q < 4; q++) {
+                            scales_int16_rows(_mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *) (b_ptr[b].scales + (h * 8 + q * 2 + up) * 8))), scales_0123[q], scales_4567[q]);
+                        }
+
+                        for (int m = 0; m < 4; m++) {
+                            for (int q = 0; q < 4; q++) {
+                                // Quants of the LHS rows are interleaved by 8
+                                const int8_t * lhs = a_ptr[b].qs + (h * 16 + q * 4 + up * 2) * 32 + m * 8;
+                                const __m256i lhs_0 = load_lhs_8x4(lhs);
+                                const __m256i lhs_1 = load_lhs_8x4(lhs + 32);
+
+                                const __m256i isum_0123 = _mm256_add_epi16(_mm256_maddubs_epi16(rhs_0123[0][q], lhs_0), _mm256_maddubs_epi16(rhs_0123[1][q], lhs_1));
+                                const __m256i isum_4567 = _mm256_add_epi16(_mm256_maddubs_epi16(rhs_4567[0][q], lhs_0), _mm256_maddubs_epi16(rhs_4567[1][q], lhs_1));
+
+                                iacc_0123[m] = _mm256_add_epi32(iacc_0123[m], _mm256_madd_epi16(isum_0123, scales_0123[q]));
+                                iacc_4567[m] = _mm256_add_epi32(iacc_4567[m], _mm256_madd_epi16(isum_4567, scales_4567[q]));
+                            }
+                        }
+                    }
+                }
+
+                const __m256 col_scale_f32 = GGML_F32Cx8_LOAD(b_ptr[b].d);
+
+                for (int m = 0; m < 4; m++) {
+                    // The quants were used without their offset of 32, subtract 32 * scales * sums of the LHS quants
+                    __m256i iacc_offset = _mm256_setzero_si256();
+                    for (int g = 0; g < QK_K / 16; g += 2) {
+                        const int16_t * bsums = a_ptr[b].bsums + (g / 4) * 16 + m * 4 + g % 4;
+                        iacc_offset = _mm256_add_epi32(iacc_offset, mul_sum_scales_bsums_int32x8(
+                                    _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *) (b_ptr[b].scales + g * 8))),
+                                    _mm_cvtepi8_epi16(_mm_loadl_epi64((const __m128i *) (b_ptr[b].scales + (g + 1) * 8))),
+                                    bsums[0], bsums[1]));
+                    }
+
+                    const __m256i iacc = _mm256_sub_epi32(hadd_rows_int32x8(iacc_0123[m], iacc_4567[m]), _mm256_slli_epi32(iacc_offset, 5));
+                    acc_rows[m] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(iacc), _mm256_mul_ps(col_scale_f32, _mm256_set1_ps(a_ptr[b].d[m])), acc_rows[m]);
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                _mm256_storeu_ps(s + (y * 4 + m) * bs + x * 8, acc_rows[m]);
+            }
+        }
+    }
+#else
+
+    ggml_gemm_q6_K_8x8_q8_K_generic(n, s, bs, vx, vy, nr, nc);
+
+#endif
+}
+
+void ggml_gemm_q8_0_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__)
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert (n % qk == 0);
+    assert (nr % 4 == 0);
+    assert (nc % 8 == 0);
+
+    for (int64_t y = 0; y < nr / 4; y++) {
+        const block_q8_0x4 * a_ptr = (const block_q8_0x4 *) vy + (y * nb);
+
+        for (int64_t x = 0; x < nc / 8; x++) {
+            const block_q8_0x8 * b_ptr = (const block_q8_0x8 *) vx + (x * nb);
+
+            __m256 acc_rows[4];
+            for (int m = 0; m < 4; m++) {
+                acc_rows[m] = _mm256_setzero_ps();
+            }
+
+            for (int64_t b = 0; b < nb; b++) {
+                // Each 64 bytes hold 8 quants of each of B0 - B7
+                __m256i rhs_0123[4], rhs_4567[4];
+                for (int k = 0; k < 4; k++) {
+                    rhs_0123[k] = _mm256_loadu_si256((const __m256i *) (b_ptr[b].qs + k * 64));
+                    rhs_4567[k] = _mm256_loadu_si256((const __m256i *) (b_ptr[b].qs + k * 64 + 32));
+                }
+
+                const __m256 col_scale_f32 = GGML_F32Cx8_LOAD(b_ptr[b].d);
+
+                for (int m = 0; m < 4; m++) {
+                    __m256i iacc_0123 = _mm256_setzero_si256();
+                    __m256i iacc_4567 = _mm256_setzero_si256();
+
+                    for (int k = 0; k < 4; k++) {
+                        const __m256i lhs = load_lhs_8x4(a_ptr[b].qs + k * 32 + m * 8);
+                        iacc_0123 = mul_sum_i8_pairs_acc_int32x8(iacc_0123, rhs_0123[k], lhs);
+                        iacc_4567 = mul_sum_i8_pairs_acc_int32x8(iacc_4567, rhs_4567[k], lhs);
+                    }
+
+                    const __m256 row_scale_f32 = _mm256_set1_ps(GGML_CPU_FP16_TO_FP32(a_ptr[b].d[m]));
+                    acc_rows[m] = _mm256_fmadd_ps(_mm256_cvtepi32_ps(hadd_rows_int32x8(iacc_0123, iacc_4567)), _mm256_mul_ps(col_scale_f32, row_scale_f32), acc_rows[m]);
+                }
+            }
+
+            for (int m = 0; m < 4; m++) {
+                _mm256_storeu_ps(s + (y * 4 + m) * bs + x * 8, acc_rows[m]);
+            }
+        }
+    }
+#else
+
+    ggml_gemm_q8_0_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+
+#endif
+}
+
+void ggml_gemm_mxfp4_8x8_q8_0(int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT vx, const void * GGML_RESTRICT vy, int nr, int nc) {
+#if defined(__AVX2__) || defined(__AVX512F__)
+    {
+        __m256i signextendlut = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)kvalues_mxfp4));
+        signextendlut = _mm256_permute2f128_si256(signextendlut, signextendlut, 0);
+
+        gemm_q4_b32_8x8_q8_0_lut_avx<block_mxfp4x8>(n, s, bs, vx, vy, nr, nc, signextendlut);
+
+        return;
+    }
+#endif // defined(__AVX2__) || defined(__AVX512F__)
+
+    ggml_gemm_mxfp4_8x8_q8_0_generic(n, s, bs, vx, vy, nr, nc);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "ggml.h"
+
+#include <stdbool.h>
+
+// GGML CPU internal header
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// barrier elision
+//
+// by default all threads synchronize after each node of the graph. this is not needed when the next node does not
+// depend on the results of the nodes computed since the last barrier - in that case the threads that finish early
+// can start working on the next node, while the slower threads are still computing the previous ones
+// the decision is deterministic, so all threads take the same barriers
+// set the GGML_CPU_NO_BARRIER_ELISION environment variable to synchronize after each node
+//
+
+#define GGML_CPU_MAX_OVERLAP 8
+
+struct ggml_overlap_group {
+    const struct ggml_tensor * nodes[GGML_CPU_MAX_OVERLAP];
+    int  n_nodes;
+    bool use_wdata;
+};
+
+// nodes that do not compute anything
+static inline bool ggml_node_is_noop(const struct ggml_tensor * node) {
+    switch (node->op) {
+        case GGML_OP_NONE:
+        case GGML_OP_RESHAPE:
+        case GGML_OP_VIEW:
+        case GGML_OP_PERMUTE:
+        case GGML_OP_TRANSPOSE:
+            return true;
+        default:
+            return ggml_is_empty(node);
+    }
+}
+
+// ops that can run while other threads are still computing previous nodes:
+//   they do not use ggml_barrier() and the shared chunk counter, and they are not handled by the extra buffer types
+// use_wdata is set if the op uses per-thread slices of the work buffer
+static inline bool ggml_node_can_overlap(const struct ggml_tensor * node, bool * use_wdata) {
+    const struct ggml_tensor * src0 = node->src[0];
+
+    *use_wdata = false;
+
+    switch (node->op) {
+        case GGML_OP_ADD:
+        case GGML_OP_ADD1:
+            {
+                *use_wdata = ggml_is_quantized(src0->type);
+            } return true;
+        case GGML_OP_DUP:
+        case GGML_OP_CPY:
+        case GGML_OP_CONT:
+            {
+                *use_wdata = src0->type != node->type;
+            } return true;
+        case GGML_OP_ROPE:
+        case GGML_OP_SOFT_MAX:
+            {
+                *use_wdata = true;
+            } return true;
+        case GGML_OP_SUB:
+        case GGML_OP_MUL:
+        case GGML_OP_DIV:
+        case GGML_OP_SCALE:
+        case GGML_OP_SQR:
+        case GGML_OP_SQRT:
+        case GGML_OP_NORM:
+        case GGML_OP_RMS_NORM:
+        case GGML_OP_CONCAT:
+        case GGML_OP_SET_ROWS:
+        case GGML_OP_UNARY:
+        case GGML_OP_GLU:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline bool ggml_tensors_overlap(const struct ggml_tensor * a, const struct ggml_tensor * b) {
+    if (a->data == NULL || b->data == NULL) {
+        return false;
+    }
+
+    const char * a0 = (const char *) a->data;
+    const char * b0 = (const char *) b->data;
+
+    return a0 < b0 + ggml_nbytes(b) && b0 < a0 + ggml_nbytes(a);
+}
+
+// check if node reads the results of a, or writes to memory that a reads or writes
+static inline bool ggml_node_depends_on(const struct ggml_tensor * node, const struct ggml_tensor * a) {
+    if (ggml_tensors_overlap(node, a)) {
+        return true;
+    }
+
+    for (int i = 0; i < GGML_MAX_SRC; i++) {
+        if (node->src[i] && ggml_tensors_overlap(node->src[i], a)) {
+            return true;
+        }
+        if (a->src[i] && ggml_tensors_overlap(node, a->src[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// returns true if a barrier is needed before computing node, otherwise adds the node to the group
+static inline bool ggml_overlap_group_add(struct ggml_overlap_group * group, const struct ggml_tensor * node) {
+    if (ggml_node_is_noop(node)) {
+        return false;
+    }
+
+    bool use_wdata = false;
+
+    bool sync = group->n_nodes == GGML_CPU_MAX_OVERLAP;
+
+    if (!sync && group->n_nodes > 0) {
+        sync = !ggml_node_can_overlap(node, &use_wdata) || (use_wdata && group->use_wdata);
+
+        for (int i = 0; i < group->n_nodes && !sync; i++) {
+            sync = ggml_node_depends_on(node, group->nodes[i]);
+        }
+    }
+
+    if (sync) {
+        group->n_nodes   = 0;
+        group->use_wdata = false;
+    }
+
+    if (group->n_nodes == 0) {
+        // the first node of a group can be any op - the ones that cannot overlap are assumed to use the work buffer
+        const bool can_overlap = ggml_node_can_overlap(node, &use_wdata);
+
+        use_wdata = use_wdata || !can_overlap;
+    }
+
+    group->nodes[group->n_nodes++] = node;
+    group->use_wdata = group->use_wdata || use_wdata;
+
+    return sync;
+}
+
+#ifdef __cplusplus
+}
+#endif
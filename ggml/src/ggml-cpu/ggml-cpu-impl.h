@@ -520,6 +520,12 @@ void ggml_barrier(struct ggml_threadpool * tp);
 void ggml_threadpool_chunk_set(struct ggml_threadpool * tp, int value);
 int  ggml_threadpool_chunk_add(struct ggml_threadpool * tp, int value);
 
+// number of NUMA nodes that the weights are mirrored to, 0 if mirroring is disabled
+int ggml_cpu_numa_mirror_n_nodes(void);
+
+// NUMA node that the compute thread ith is bound to
+int ggml_cpu_numa_node(int ith);
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,7 @@
 #include "binary-ops.h"
 #include "vec.h"
 #include "ops.h"
+#include "barrier-elision.h"
 #include "ggml.h"
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -464,6 +465,8 @@ struct ggml_threadpool {
     uint32_t     poll;        // Polling level (0 - no polling)
 
     enum ggml_status ec;
+
+    bool elide_barriers;      // skip the barriers between independent nodes, see barrier-elision.h
 };
 
 // Per-thread state
@@ -679,6 +682,30 @@ bool ggml_is_numa(void) {
     return g_state.numa.n_nodes > 1;
 }
 
+int ggml_cpu_numa_mirror_n_nodes(void) {
+    if (!ggml_is_numa() || g_state.numa.numa_strategy != GGML_NUMA_STRATEGY_MIRROR) {
+        return 0;
+    }
+
+    return g_state.numa.n_nodes;
+}
+
+int ggml_cpu_numa_node(int ith) {
+    if (!ggml_is_numa()) {
+        return 0;
+    }
+
+    switch (g_state.numa.numa_strategy) {
+        case GGML_NUMA_STRATEGY_DISTRIBUTE:
+        case GGML_NUMA_STRATEGY_MIRROR:
+            return ith % g_state.numa.n_nodes;
+        case GGML_NUMA_STRATEGY_ISOLATE:
+            return g_state.numa.current_node;
+        default:
+            return 0;
+    }
+}
+
 #if defined(__ARM_ARCH)
 
 #if defined(__linux__) && defined(__aarch64__)
@@ -1473,7 +1500,7 @@ static void * incr_ptr_aligned(void ** p, size_t size, size_t align) {
     return ptr;
 }
 
-static void ggml_compute_forward_mul_mat_id(
+void ggml_compute_forward_mul_mat_id(
         const struct ggml_compute_params * params,
               struct ggml_tensor * dst) {
 
@@ -2055,7 +2082,9 @@ static void set_numa_thread_affinity(int thread_n) {
 
     switch(g_state.numa.numa_strategy) {
         case GGML_NUMA_STRATEGY_DISTRIBUTE:
+        case GGML_NUMA_STRATEGY_MIRROR:
             // run thread on node_num thread_n / (threads per node)
+            // note: ggml_cpu_numa_node() must follow the same mapping
             node_num = thread_n % g_state.numa.n_nodes;
             break;
         case GGML_NUMA_STRATEGY_ISOLATE:
@@ -2801,7 +2830,16 @@ struct ggml_cplan ggml_graph_plan(
                         const int64_t ne10 = node->src[1]->ne[0]; // DK
                         const int64_t ne20 = node->src[2]->ne[0]; // DV
 
-                        cur = sizeof(float)*(1*ne10 + 2*ne20)*n_tasks; // 1x head size K + 2x head size V (per thread)
+                        if (node->src[0]->ne[1] >= GGML_FA_TILE_MIN_Q) {
+                            cur = sizeof(float)*(GGML_FA_TILE_WSIZE(ne10, ne20) + CACHE_LINE_SIZE_F32)*n_tasks; // tiles of Q, KQ, K, V and VKQ (per thread)
+                        } else {
+                            cur = sizeof(float)*(1*ne10 + 2*ne20)*n_tasks; // 1x head size K + 2x head size V (per thread)
+
+                            const int64_t nr = node->src[0]->ne[1]*node->src[0]->ne[2]*node->src[0]->ne[3];
+                            if (ggml_fa_n_kv_chunks(node->src[0]->ne[1], nr, node->src[1]->ne[1], n_tasks) > 1) {
+                                cur += sizeof(float)*(ne20 + 2)*nr*n_tasks; // partial VKQ, max and sum of each KV chunk of each row
+                            }
+                        }
                     } break;
                 case GGML_OP_FLASH_ATTN_BACK:
                     {
@@ -2865,9 +2903,22 @@ static thread_ret_t ggml_graph_compute_thread(void * data) {
         /*.threadpool=*/ tp,
     };
 
-    for (int node_n = 0; node_n < cgraph->n_nodes && atomic_load_explicit(&tp->abort, memory_order_relaxed) != node_n; node_n++) {
+    struct ggml_overlap_group group = { { NULL }, 0, false };
+
+    for (int node_n = 0; node_n < cgraph->n_nodes; node_n++) {
         struct ggml_tensor * node = cgraph->nodes[node_n];
 
+        const bool sync = tp->elide_barriers ? ggml_overlap_group_add(&group, node) : node_n > 0;
+
+        if (sync) {
+            ggml_barrier(state->threadpool);
+
+            // the abort flag is set by thread 0 before entering the barrier, so all threads see the same value here
+            if (atomic_load_explicit(&tp->abort, memory_order_relaxed) != -1) {
+                break;
+            }
+        }
+
         ggml_compute_forward(&params, node);
 
         if (state->ith == 0 && cplan->abort_callback &&
@@ -2875,10 +2926,6 @@ static thread_ret_t ggml_graph_compute_thread(void * data) {
             atomic_store_explicit(&tp->abort, node_n + 1, memory_order_relaxed);
             tp->ec    = GGML_STATUS_ABORTED;
         }
-
-        if (node_n + 1 < cgraph->n_nodes) {
-            ggml_barrier(state->threadpool);
-        }
     }
 
     ggml_barrier(state->threadpool);
@@ -3132,6 +3179,8 @@ enum ggml_status ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cpl
         threadpool->ec               = GGML_STATUS_SUCCESS;
     }
 
+    threadpool->elide_barriers = getenv("GGML_CPU_NO_BARRIER_ELISION") == NULL;
+
 #ifdef GGML_USE_OPENMP
     if (n_threads > 1) {
         #pragma omp parallel num_threads(n_threads)
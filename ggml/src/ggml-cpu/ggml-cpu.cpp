@@ -2,6 +2,7 @@
 #include "ggml-backend-impl.h"
 #include "ggml-cpu.h"
 #include "repack.h"
+#include "numa.h"
 #include "traits.h"
 #include "ggml-impl.h"
 #include "amx/amx.h"
@@ -39,6 +40,11 @@ std::vector<ggml_backend_buffer_type_t> & ggml_backend_cpu_get_extra_buffer_type
     static std::vector<ggml_backend_buffer_type_t> bufts = []() {
         std::vector<ggml_backend_buffer_type_t> bufts;
 
+        // note: the NUMA mirror buffer type is only used with --numa mirror, it takes precedence over the others
+        if (ggml_backend_cpu_numa_buffer_type()) {
+            bufts.push_back(ggml_backend_cpu_numa_buffer_type());
+        }
+
 #if defined(__AMX_INT8__) && defined(__AVX512VNNI__)
         if (ggml_backend_amx_buffer_type()) {
             bufts.push_back(ggml_backend_amx_buffer_type());
@@ -632,6 +638,11 @@ static void * ggml_backend_cpu_get_proc_address(ggml_backend_reg_t reg, const ch
     if (strcmp(name, "ggml_backend_cpu_is_numa") == 0) {
         return (void *)ggml_is_numa;
     }
+#ifdef GGML_USE_CPU_REPACK
+    if (strcmp(name, "ggml_backend_cpu_repack_buffer_from_ptr") == 0) {
+        return (void *)ggml_backend_cpu_repack_buffer_from_ptr;
+    }
+#endif
 
     // threadpool - TODO:  move to ggml-base
     if (strcmp(name, "ggml_threadpool_new") == 0) {
@@ -0,0 +1,250 @@
+#include "ops.h"
+
+#include "ggml-backend.h"
+#include "ggml-backend-impl.h"
+#include "ggml-cpu.h"
+#include "ggml-impl.h"
+#include "traits.h"
+
+#include "numa.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#if defined(__gnu_linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// from <numaif.h>, to avoid the dependency on libnuma
+#define GGML_MPOL_PREFERRED 1
+
+// buffer type NUMA mirror
+//
+// the buffer holds one replica of its data per NUMA node, each allocated on its own node
+// the replica of node 0 is the one exposed through the tensor data pointers
+// matrix multiplications (including MUL_MAT_ID of the MoE experts) read the weights from the replica of the node that the compute thread is running on
+
+struct ggml_backend_cpu_numa_buffer_context {
+    std::vector<void *> replicas; // [n_nodes]
+    size_t size;
+
+    ~ggml_backend_cpu_numa_buffer_context() {
+        for (void * ptr : replicas) {
+            munmap(ptr, size);
+        }
+    }
+};
+
+static void * ggml_numa_alloc_on_node(size_t size, int node) {
+    GGML_ASSERT(node >= 0);
+
+    void * ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // the pages are allocated on first touch, according to this policy
+    const size_t bits = 8*sizeof(unsigned long);
+    std::vector<unsigned long> nodemask(node/bits + 1, 0);
+    nodemask[node/bits] |= 1ul << (node % bits);
+    if (syscall(SYS_mbind, ptr, size, GGML_MPOL_PREFERRED, nodemask.data(), nodemask.size()*bits, 0) != 0) {
+        GGML_LOG_WARN("%s: mbind to node %d failed: %s\n", __func__, node, strerror(errno));
+    }
+
+    return ptr;
+}
+
+namespace ggml::cpu::numa {
+class tensor_traits : public ggml::cpu::tensor_traits {
+    bool work_size(int /* n_threads */, const struct ggml_tensor * /* op */, size_t & /* size */) override {
+        // same as the regular matrix multiplication
+        return false;
+    }
+
+    bool compute_forward(struct ggml_compute_params * params, struct ggml_tensor * op) override {
+        if (op->op != GGML_OP_MUL_MAT && op->op != GGML_OP_MUL_MAT_ID) {
+            return false;
+        }
+
+        const auto * ctx = (const ggml_backend_cpu_numa_buffer_context *) op->src[0]->buffer->context;
+
+        const int    node = ggml_cpu_numa_node(params->ith) % (int) ctx->replicas.size();
+        const size_t offs = (const char *) op->src[0]->data - (const char *) ctx->replicas[0];
+
+        // shallow copies of the op that point to the local replica of the weights
+        ggml_tensor src0 = *op->src[0];
+        src0.data = (char *) ctx->replicas[node] + offs;
+
+        ggml_tensor dst = *op;
+        dst.src[0] = &src0;
+
+        if (op->op == GGML_OP_MUL_MAT) {
+            ggml_compute_forward_mul_mat(params, &dst);
+        } else {
+            ggml_compute_forward_mul_mat_id(params, &dst);
+        }
+
+        return true;
+    }
+};
+
+static ggml::cpu::tensor_traits * get_tensor_traits(ggml_backend_buffer_t, struct ggml_tensor *) {
+    static tensor_traits traits;
+    return &traits;
+}
+}  // namespace ggml::cpu::numa
+
+static void ggml_backend_cpu_numa_buffer_free_buffer(ggml_backend_buffer_t buffer) {
+    delete (ggml_backend_cpu_numa_buffer_context *) buffer->context;
+}
+
+static void * ggml_backend_cpu_numa_buffer_get_base(ggml_backend_buffer_t buffer) {
+    return ((ggml_backend_cpu_numa_buffer_context *) buffer->context)->replicas[0];
+}
+
+static enum ggml_status ggml_backend_cpu_numa_buffer_init_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor) {
+    tensor->extra = (void *) ggml::cpu::numa::get_tensor_traits(buffer, tensor);
+
+    return GGML_STATUS_SUCCESS;
+}
+
+static void ggml_backend_cpu_numa_buffer_memset_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor,
+                                                       uint8_t value, size_t offset, size_t size) {
+    const auto * ctx = (const ggml_backend_cpu_numa_buffer_context *) buffer->context;
+
+    const size_t offs = (const char *) tensor->data - (const char *) ctx->replicas[0] + offset;
+
+    for (void * ptr : ctx->replicas) {
+        memset((char *) ptr + offs, value, size);
+    }
+}
+
+static void ggml_backend_cpu_numa_buffer_set_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor,
+                                                    const void * data, size_t offset, size_t size) {
+    const auto * ctx = (const ggml_backend_cpu_numa_buffer_context *) buffer->context;
+
+    const size_t offs = (const char *) tensor->data - (const char *) ctx->replicas[0] + offset;
+
+    for (void * ptr : ctx->replicas) {
+        memcpy((char *) ptr + offs, data, size);
+    }
+}
+
+static void ggml_backend_cpu_numa_buffer_get_tensor(ggml_backend_buffer_t buffer, const struct ggml_tensor * tensor,
+                                                    void * data, size_t offset, size_t size) {
+    memcpy(data, (const char *) tensor->data + offset, size);
+
+    GGML_UNUSED(buffer);
+}
+
+static void ggml_backend_cpu_numa_buffer_clear(ggml_backend_buffer_t buffer, uint8_t value) {
+    const auto * ctx = (const ggml_backend_cpu_numa_buffer_context *) buffer->context;
+
+    for (void * ptr : ctx->replicas) {
+        memset(ptr, value, ctx->size);
+    }
+}
+
+static ggml_backend_buffer_i ggml_backend_cpu_numa_buffer_interface = {
+    /* .free_buffer     = */ ggml_backend_cpu_numa_buffer_free_buffer,
+    /* .get_base        = */ ggml_backend_cpu_numa_buffer_get_base,
+    /* .init_tensor     = */ ggml_backend_cpu_numa_buffer_init_tensor,
+    /* .memset_tensor   = */ ggml_backend_cpu_numa_buffer_memset_tensor,
+    /* .set_tensor      = */ ggml_backend_cpu_numa_buffer_set_tensor,
+    /* .get_tensor      = */ ggml_backend_cpu_numa_buffer_get_tensor,
+    /* .cpy_tensor      = */ nullptr,
+    /* .clear           = */ ggml_backend_cpu_numa_buffer_clear,
+    /* .reset           = */ nullptr,
+};
+
+static const char * ggml_backend_cpu_numa_buffer_type_get_name(ggml_backend_buffer_type_t buft) {
+    return "CPU_NUMA";
+
+    GGML_UNUSED(buft);
+}
+
+static ggml_backend_buffer_t ggml_backend_cpu_numa_buffer_type_alloc_buffer(ggml_backend_buffer_type_t buft, size_t size) {
+    const int n_nodes = std::max(1, ggml_cpu_numa_mirror_n_nodes());
+
+    auto * ctx = new ggml_backend_cpu_numa_buffer_context;
+    ctx->size = size;
+
+    for (int node = 0; node < n_nodes; ++node) {
+        void * ptr = ggml_numa_alloc_on_node(size, node);
+        if (ptr == nullptr) {
+            GGML_LOG_ERROR("%s: failed to allocate buffer of size %zu on NUMA node %d\n", __func__, size, node);
+            delete ctx;
+            return nullptr;
+        }
+        ctx->replicas.push_back(ptr);
+    }
+
+    GGML_LOG_DEBUG("%s: allocated %d replicas of %.2f MiB\n", __func__, n_nodes, size/1024.0/1024.0);
+
+    return ggml_backend_buffer_init(buft, ggml_backend_cpu_numa_buffer_interface, ctx, size);
+}
+
+static size_t ggml_backend_cpu_numa_buffer_type_get_alignment(ggml_backend_buffer_type_t buft) {
+    return TENSOR_ALIGNMENT;
+
+    GGML_UNUSED(buft);
+}
+
+namespace ggml::cpu::numa {
+class extra_buffer_type : ggml::cpu::extra_buffer_type {
+    bool supports_op(ggml_backend_dev_t, const struct ggml_tensor * op) override {
+        // only active with --numa mirror on a system with multiple nodes
+        if (ggml_cpu_numa_mirror_n_nodes() < 2) {
+            return false;
+        }
+
+        if ((op->op == GGML_OP_MUL_MAT || op->op == GGML_OP_MUL_MAT_ID) &&
+                op->src[0]->buffer &&
+                op->src[0]->buffer->buft == ggml_backend_cpu_numa_buffer_type()) {
+            if (op->src[1]->buffer && !ggml_backend_buft_is_host(op->src[1]->buffer->buft)) {
+                return false;
+            }
+            const auto * traits = ggml_get_type_traits_cpu(op->src[0]->type);
+            return op->src[1]->type == GGML_TYPE_F32 || op->src[1]->type == traits->vec_dot_type;
+        }
+        return false;
+    }
+
+    ggml::cpu::tensor_traits * get_tensor_traits(const struct ggml_tensor * op) override {
+        if ((op->op == GGML_OP_MUL_MAT || op->op == GGML_OP_MUL_MAT_ID) && op->src[0]->buffer &&
+            op->src[0]->buffer->buft == ggml_backend_cpu_numa_buffer_type()) {
+            return (ggml::cpu::tensor_traits *) op->src[0]->extra;
+        }
+
+        return nullptr;
+    }
+};
+}  // namespace ggml::cpu::numa
+
+ggml_backend_buffer_type_t ggml_backend_cpu_numa_buffer_type(void) {
+    static struct ggml_backend_buffer_type ggml_backend_cpu_buffer_type_numa = {
+        /* .iface    = */ {
+                           /* .get_name         = */ ggml_backend_cpu_numa_buffer_type_get_name,
+                           /* .alloc_buffer     = */ ggml_backend_cpu_numa_buffer_type_alloc_buffer,
+                           /* .get_alignment    = */ ggml_backend_cpu_numa_buffer_type_get_alignment,
+                           /* .get_max_size     = */ nullptr,  // defaults to SIZE_MAX
+                           /* .get_alloc_size   = */ nullptr,  // defaults to ggml_nbytes
+                           /* .is_host          = */ nullptr,
+                           },
+        /* .device  = */ ggml_backend_reg_dev_get(ggml_backend_cpu_reg(), 0),
+        /* .context = */ new ggml::cpu::numa::extra_buffer_type(),
+    };
+
+    return &ggml_backend_cpu_buffer_type_numa;
+}
+
+#else
+
+ggml_backend_buffer_type_t ggml_backend_cpu_numa_buffer_type(void) {
+    return nullptr;
+}
+
+#endif // defined(__gnu_linux__)
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ggml-backend.h"
+#include "ggml.h"
+
+// GGML CPU internal header
+
+// buffer type that keeps a copy of the weights on each NUMA node (--numa mirror)
+ggml_backend_buffer_type_t ggml_backend_cpu_numa_buffer_type(void);
@@ -8308,6 +8308,51 @@ void ggml_compute_forward_argsort(
 
 // ggml_compute_forward_flash_attn_ext
 
+// applies the sinks, normalizes and writes one row of the result from its online softmax state
+static void ggml_flash_attn_ext_f16_write_row(
+        ggml_tensor * dst,
+        const ggml_tensor * sinks,
+        int iq1, int iq2, int iq3,
+        float M, float S, float * VKQ32) {
+
+    const int64_t DV = dst->ne[0];
+
+    GGML_TENSOR_LOCALS(int64_t, ne, dst, ne)
+    GGML_TENSOR_LOCALS(size_t,  nb, dst, nb)
+
+    // sinks
+    if (sinks) {
+        const float s = ((float *)((char *) sinks->data))[iq2];
+
+        float ms = 1.0f;
+        float vs = 1.0f;
+
+        if (s > M) {
+            ms = expf(M - s);
+            ggml_vec_scale_f32(DV, VKQ32, ms);
+        } else {
+            vs = expf(s - M);
+        }
+
+        S = S*ms + vs;
+    }
+
+    // V /= S
+    const float S_inv = 1.0f/S;
+    ggml_vec_scale_f32(DV, VKQ32, S_inv);
+
+    // dst indices
+    const int i1 = iq1;
+    const int i2 = iq2;
+    const int i3 = iq3;
+
+    // original
+    //memcpy((char *) dst->data + (i1*nb1 + i2*nb2 + i3*nb3), V, nev0*sizeof(float));
+
+    // permute(0, 2, 1, 3)
+    memcpy((char *) dst->data + (i3*ne2*ne1 + i2 + i1*ne1)*nb1, VKQ32, nb1);
+}
+
 static void ggml_compute_forward_flash_attn_ext_f16(
         const ggml_compute_params * params,
         ggml_tensor * dst) {
@@ -8362,16 +8407,25 @@ static void ggml_compute_forward_flash_attn_ext_f16(
     const int64_t rv3 = neq3/nev3;
 
     // parallelize by q rows using ggml_vec_dot_f32
+    // for decode, the KV length can also be split in chunks, the partial results of the chunks are reduced at the end
 
     // total rows in q
     const int nr = neq1*neq2*neq3;
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
+    // KV chunks per row
+    const int64_t n_chunks = ggml_fa_n_kv_chunks(neq1, nr, nek1, nth);
+    const int64_t dc       = (nek1 + n_chunks - 1)/n_chunks;
 
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    // (row, chunk) pairs per thread
+    const int64_t nw = nr*n_chunks;
+    const int64_t dw = (nw + nth - 1)/nth;
+
+    // pair range for this thread
+    const int64_t iw0 = dw*ith;
+    const int64_t iw1 = MIN(iw0 + dw, nw);
+
+    // partial results of the chunks: [nr][n_chunks][M, S, VKQ]
+    float * partials = (float *) params->wdata + nth*(1*DK + 2*DV + CACHE_LINE_SIZE_F32);
 
     float scale         = 1.0f;
     float max_bias      = 0.0f;
@@ -8399,8 +8453,14 @@ static void ggml_compute_forward_flash_attn_ext_f16(
     GGML_ASSERT((                            q_to_vec_dot) && "fattn: unsupported K-type");
     GGML_ASSERT((v->type == GGML_TYPE_F32 || v_to_float  ) && "fattn: unsupported V-type");
 
-    // loop over n_batch and n_head
-    for (int ir = ir0; ir < ir1; ++ir) {
+    // loop over n_batch, n_head and the KV chunks
+    for (int64_t iw = iw0; iw < iw1; ++iw) {
+        const int     ir = iw/n_chunks;
+        const int64_t ik = iw%n_chunks;
+
+        const int64_t ic0 = ik*dc;
+        const int64_t ic1 = MIN(ic0 + dc, nek1);
+
         // q indices
         const int iq3 = ir/(neq2*neq1);
         const int iq2 = (ir - iq3*neq2*neq1)/neq1;
@@ -8439,7 +8499,7 @@ static void ggml_compute_forward_flash_attn_ext_f16(
         // online softmax / attention
         // loop over n_kv and n_head_kv
         // ref: https://arxiv.org/pdf/2112.05682.pdf
-        for (int64_t ic = 0; ic < nek1; ++ic) {
+        for (int64_t ic = ic0; ic < ic1; ++ic) {
             const float mv = mp ? slope*GGML_CPU_FP16_TO_FP32(mp[ic]) : 0.0f;
             if (mv == -INFINITY) {
                 continue;
@@ -8512,37 +8572,407 @@ static void ggml_compute_forward_flash_attn_ext_f16(
             }
         }
 
-        // sinks
-        if (sinks) {
-            const float s = ((float *)((char *) sinks->data))[h];
+        if (n_chunks > 1) {
+            // store the partial result of the chunk, reduced below
+            float * part = partials + iw*(DV + 2);
+
+            part[0] = M;
+            part[1] = S;
+            memcpy(part + 2, VKQ32, DV*sizeof(float));
+
+            continue;
+        }
+
+        ggml_flash_attn_ext_f16_write_row(dst, sinks, iq1, iq2, iq3, M, S, VKQ32);
+    }
+
+    if (n_chunks == 1) {
+        return;
+    }
+
+    ggml_barrier(params->threadpool);
+
+    // reduce the partial results of the chunks of each row
+    const int dr = (nr + nth - 1)/nth;
+
+    const int ir0 = dr*ith;
+    const int ir1 = MIN(ir0 + dr, nr);
+
+    float * VKQ32 = (float *) params->wdata + ith*(1*DK + 2*DV + CACHE_LINE_SIZE_F32);
+
+    for (int ir = ir0; ir < ir1; ++ir) {
+        const int iq3 = ir/(neq2*neq1);
+        const int iq2 = (ir - iq3*neq2*neq1)/neq1;
+        const int iq1 = (ir - iq3*neq2*neq1 - iq2*neq1);
+
+        const float * part = partials + ir*n_chunks*(DV + 2);
+
+        float M = -INFINITY;
+        for (int64_t ik = 0; ik < n_chunks; ++ik) {
+            M = MAX(M, part[ik*(DV + 2)]);
+        }
+
+        float S = 0.0f;
+        memset(VKQ32, 0, DV*sizeof(float));
+
+        for (int64_t ik = 0; ik < n_chunks; ++ik) {
+            const float * p = part + ik*(DV + 2);
+
+            // fully masked chunk
+            if (p[0] == -INFINITY) {
+                continue;
+            }
+
+            const float ms = expf(p[0] - M);
+
+            S += p[1]*ms;
+            ggml_vec_mad_f32(DV, VKQ32, p + 2, ms);
+        }
+
+        ggml_flash_attn_ext_f16_write_row(dst, sinks, iq1, iq2, iq3, M, S, VKQ32);
+    }
+}
+
+// y[i] += sum_ic p[ic]*x[ic*ldx + i], for a tile of nc rows of x
+// the accumulators are kept in registers for the whole tile instead of being reloaded for every row
+static void ggml_fa_tile_mad_f32(const int64_t n, const int64_t nc, float * y, const float * p, const float * x, const int64_t ldx) {
+#if defined(GGML_SIMD) && !defined(__ARM_FEATURE_SVE)
+    const int64_t np = (n & ~(GGML_F32_STEP - 1));
+
+    GGML_F32_VEC acc[GGML_F32_ARR];
+
+    for (int64_t i = 0; i < np; i += GGML_F32_STEP) {
+        for (int j = 0; j < GGML_F32_ARR; j++) {
+            acc[j] = GGML_F32_VEC_LOAD(y + i + j*GGML_F32_EPR);
+        }
+
+        for (int64_t ic = 0; ic < nc; ++ic) {
+            if (p[ic] == 0.0f) {
+                continue;
+            }
+
+            const GGML_F32_VEC pv = GGML_F32_VEC_SET1(p[ic]);
+
+            for (int j = 0; j < GGML_F32_ARR; j++) {
+                acc[j] = GGML_F32_VEC_FMA(acc[j], GGML_F32_VEC_LOAD(x + ic*ldx + i + j*GGML_F32_EPR), pv);
+            }
+        }
+
+        for (int j = 0; j < GGML_F32_ARR; j++) {
+            GGML_F32_VEC_STORE(y + i + j*GGML_F32_EPR, acc[j]);
+        }
+    }
+#else
+    const int64_t np = 0;
+#endif
+    // leftovers
+    for (int64_t i = np; i < n; ++i) {
+        float sum = y[i];
+        for (int64_t ic = 0; ic < nc; ++ic) {
+            sum += p[ic]*x[ic*ldx + i];
+        }
+        y[i] = sum;
+    }
+}
+
+// blocked version for prompt processing: each thread takes tiles of GGML_FA_TILE_Q query rows of a head and walks
+// the K/V rows in tiles of GGML_FA_TILE_KV, so that the K/V rows are loaded once per tile of queries instead of once per row
+// the tiles of K/V that are masked for all the queries of the tile are skipped
+static void ggml_compute_forward_flash_attn_ext_f16_tiled(
+        const ggml_compute_params * params,
+        ggml_tensor * dst) {
+
+    const ggml_tensor * q     = dst->src[0];
+    const ggml_tensor * k     = dst->src[1];
+    const ggml_tensor * v     = dst->src[2];
+    const ggml_tensor * mask  = dst->src[3];
+    const ggml_tensor * sinks = dst->src[4];
+
+    GGML_TENSOR_LOCALS(int64_t, neq, q,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbq, q,   nb)
+    GGML_TENSOR_LOCALS(int64_t, nek, k,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbk, k,   nb)
+    GGML_TENSOR_LOCALS(int64_t, nev, v,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbv, v,   nb)
+    GGML_TENSOR_LOCALS(int64_t, ne,  dst, ne)
+    GGML_TENSOR_LOCALS(size_t,  nb,  dst, nb)
+
+    const int ith = params->ith;
+    const int nth = params->nth;
+
+    const int64_t DK = nek0;
+    const int64_t DV = nev0;
+    const int64_t N  = neq1;
+
+    GGML_ASSERT(ne0 == DV);
+    GGML_ASSERT(ne2 == N);
+
+    // input tensor rows must be contiguous
+    GGML_ASSERT(nbq0 == ggml_type_size(q->type));
+    GGML_ASSERT(nbk0 == ggml_type_size(k->type));
+    GGML_ASSERT(nbv0 == ggml_type_size(v->type));
+
+    GGML_ASSERT(neq0 == DK);
+    GGML_ASSERT(nek0 == DK);
+    GGML_ASSERT(nev0 == DV);
+
+    GGML_ASSERT(neq1 == N);
+
+    // dst cannot be transposed or permuted
+    GGML_ASSERT(nb0 == sizeof(float));
+    GGML_ASSERT(nb0 <= nb1);
+    GGML_ASSERT(nb1 <= nb2);
+    GGML_ASSERT(nb2 <= nb3);
+
+    // broadcast factors
+    const int64_t rk2 = neq2/nek2;
+    const int64_t rk3 = neq3/nek3;
+
+    const int64_t rv2 = neq2/nev2;
+    const int64_t rv3 = neq3/nev3;
+
+    // parallelize by tiles of q rows of the same head
+    const int64_t n_tiles_q = (N + GGML_FA_TILE_Q - 1)/GGML_FA_TILE_Q;
+
+    // total tiles in q
+    const int64_t nt = n_tiles_q*neq2*neq3;
+
+    // tiles per thread
+    const int64_t dt = (nt + nth - 1)/nth;
+
+    // tile range for this thread
+    const int64_t it0 = dt*ith;
+    const int64_t it1 = MIN(it0 + dt, nt);
+
+    float scale         = 1.0f;
+    float max_bias      = 0.0f;
+    float logit_softcap = 0.0f;
+
+    memcpy(&scale,         (float *) dst->op_params + 0, sizeof(float));
+    memcpy(&max_bias,      (float *) dst->op_params + 1, sizeof(float));
+    memcpy(&logit_softcap, (float *) dst->op_params + 2, sizeof(float));
+
+    if (logit_softcap != 0) {
+        scale /= logit_softcap;
+    }
 
-            float ms = 1.0f;
-            float vs = 1.0f;
+    const uint32_t n_head      = neq2;
+    const uint32_t n_head_log2 = 1u << (uint32_t) floor(log2(n_head));
+
+    const float m0 = powf(2.0f, -(max_bias       ) / n_head_log2);
+    const float m1 = powf(2.0f, -(max_bias / 2.0f) / n_head_log2);
+
+    ggml_type         const k_vec_dot_type = ggml_get_type_traits_cpu(k->type)->vec_dot_type;
+    ggml_from_float_t const q_to_vec_dot   = ggml_get_type_traits_cpu(k_vec_dot_type)->from_float;
+    ggml_vec_dot_t    const kq_vec_dot     = ggml_get_type_traits_cpu(k->type)->vec_dot;
+    ggml_to_float_t   const v_to_float     = ggml_get_type_traits(v->type)->to_float;
+
+    // the float K types are transposed to F32 once per tile, so that Q*K^T is computed with the same kernel as softmax(KQ)*V
+    // the quantized K types use the vec_dot of the type, with Q converted to its vec_dot_type
+    const bool k_f32 = k->type == GGML_TYPE_F32 || k->type == GGML_TYPE_F16 || k->type == GGML_TYPE_BF16;
+
+    GGML_ASSERT((                            q_to_vec_dot) && "fattn: unsupported K-type");
+    GGML_ASSERT((v->type == GGML_TYPE_F32 || v_to_float  ) && "fattn: unsupported V-type");
+
+    // per-thread buffers, see ggml_graph_plan()
+    float * Q_q   = (float *) params->wdata + ith*(GGML_FA_TILE_WSIZE(DK, DV) + CACHE_LINE_SIZE_F32); // Q rows, one row of DK floats per query
+    float * KQ    = Q_q   + GGML_FA_TILE_Q*DK;               // [GGML_FA_TILE_Q][GGML_FA_TILE_KV] KQ values, then softmax numerators
+    float * K32   = KQ    + GGML_FA_TILE_Q*GGML_FA_TILE_KV;  // [DK][GGML_FA_TILE_KV] K rows converted to F32, transposed
+    float * V32   = K32   + GGML_FA_TILE_KV*DK;              // [GGML_FA_TILE_KV][DV] V rows converted to F32
+    float * VKQ32 = V32   + GGML_FA_TILE_KV*DV;              // [GGML_FA_TILE_Q][DV] FP32 VKQ accumulators
+    float * M     = VKQ32 + GGML_FA_TILE_Q*DV;               // [GGML_FA_TILE_Q] maximum KQ values
+    float * S     = M     + GGML_FA_TILE_Q;                  // [GGML_FA_TILE_Q] sums
 
-            if (s > M) {
-                ms = expf(M - s);
-                ggml_vec_scale_f32(DV, VKQ32, ms);
+    const ggml_fp16_t * mp[GGML_FA_TILE_Q];
+
+    float kqs[GGML_FA_TILE_KV];
+
+    for (int64_t it = it0; it < it1; ++it) {
+        // q indices
+        const int64_t iq3 = it/(neq2*n_tiles_q);
+        const int64_t iq2 = (it - iq3*neq2*n_tiles_q)/n_tiles_q;
+        const int64_t iq1 = (it - iq3*neq2*n_tiles_q - iq2*n_tiles_q)*GGML_FA_TILE_Q;
+
+        const int64_t nq = MIN(GGML_FA_TILE_Q, N - iq1);
+
+        const uint32_t h = iq2; // head index
+        const float slope = (max_bias > 0.0f) ? h < n_head_log2 ? powf(m0, h + 1) : powf(m1, 2*(h - n_head_log2) + 1) : 1.0f;
+
+        // k indices
+        const int64_t ik3 = iq3 / rk3;
+        const int64_t ik2 = iq2 / rk2;
+
+        // v indices
+        const int64_t iv3 = iq3 / rv3;
+        const int64_t iv2 = iq2 / rv2;
+
+        for (int64_t i = 0; i < nq; ++i) {
+            const float * pq = (const float *) ((char *) q->data + ((iq1 + i)*nbq1 + iq2*nbq2 + iq3*nbq3));
+            if (k_f32) {
+                memcpy(Q_q + i*DK, pq, DK*sizeof(float));
             } else {
-                vs = expf(s - M);
+                q_to_vec_dot(pq, Q_q + i*DK, DK);
             }
 
-            S = S*ms + vs;
+            mp[i] = mask ? (ggml_fp16_t *)((char *) mask->data + (iq1 + i)*mask->nb[1] + (iq2%mask->ne[2])*mask->nb[2] + (iq3%mask->ne[3])*mask->nb[3]) : NULL;
+
+            M[i] = -INFINITY;
+            S[i] = 0.0f;
         }
 
-        // V /= S
-        const float S_inv = 1.0f/S;
-        ggml_vec_scale_f32(DV, VKQ32, S_inv);
+        memset(VKQ32, 0, nq*DV*sizeof(float));
 
-        // dst indices
-        const int i1 = iq1;
-        const int i2 = iq2;
-        const int i3 = iq3;
+        // online softmax / attention, one tile of K/V at a time
+        // ref: https://arxiv.org/pdf/2112.05682.pdf
+        for (int64_t ic0 = 0; ic0 < nek1; ic0 += GGML_FA_TILE_KV) {
+            const int64_t nc = MIN(GGML_FA_TILE_KV, nek1 - ic0);
 
-        // original
-        //memcpy((char *) dst->data + (i1*nb1 + i2*nb2 + i3*nb3), V, nev0*sizeof(float));
+            // mask values, skip the tile if it is masked for all the queries
+            bool any = false;
+            for (int64_t i = 0; i < nq; ++i) {
+                float * kq = KQ + i*GGML_FA_TILE_KV;
 
-        // permute(0, 2, 1, 3)
-        memcpy((char *) dst->data + (i3*ne2*ne1 + i2 + i1*ne1)*nb1, VKQ32, nb1);
+                for (int64_t ic = 0; ic < nc; ++ic) {
+                    kq[ic] = mp[i] ? slope*GGML_CPU_FP16_TO_FP32(mp[i][ic0 + ic]) : 0.0f;
+                    any = any || kq[ic] != -INFINITY;
+                }
+            }
+
+            if (!any) {
+                continue;
+            }
+
+            // K and V rows of the tile, as F32
+            for (int64_t ic = 0; ic < nc; ++ic) {
+                const char * k_data = (const char *) k->data + ((ic0 + ic)*nbk1 + ik2*nbk2 + ik3*nbk3);
+
+                switch (k->type) {
+                    case GGML_TYPE_F32:
+                        for (int64_t d = 0; d < DK; ++d) {
+                            K32[d*GGML_FA_TILE_KV + ic] = ((const float *) k_data)[d];
+                        } break;
+                    case GGML_TYPE_F16:
+                        for (int64_t d = 0; d < DK; ++d) {
+                            K32[d*GGML_FA_TILE_KV + ic] = GGML_CPU_FP16_TO_FP32(((const ggml_fp16_t *) k_data)[d]);
+                        } break;
+                    case GGML_TYPE_BF16:
+                        for (int64_t d = 0; d < DK; ++d) {
+                            K32[d*GGML_FA_TILE_KV + ic] = GGML_BF16_TO_FP32(((const ggml_bf16_t *) k_data)[d]);
+                        } break;
+                    default:
+                        break;
+                }
+            }
+
+            const float * v32 = (const float *) ((const char *) v->data + (ic0*nbv1 + iv2*nbv2 + iv3*nbv3));
+            int64_t       ldv = nbv1/sizeof(float);
+
+            if (v->type != GGML_TYPE_F32) {
+                for (int64_t ic = 0; ic < nc; ++ic) {
+                    v_to_float((const char *) v->data + ((ic0 + ic)*nbv1 + iv2*nbv2 + iv3*nbv3), V32 + ic*DV, DV);
+                }
+
+                v32 = V32;
+                ldv = DV;
+            }
+
+            // KQ = Q*K^T + mask, with -INFINITY for the masked positions
+            for (int64_t i = 0; i < nq; ++i) {
+                float * kq = KQ + i*GGML_FA_TILE_KV;
+
+                if (k_f32) {
+                    memset(kqs, 0, nc*sizeof(float));
+                    ggml_fa_tile_mad_f32(nc, DK, kqs, Q_q + i*DK, K32, GGML_FA_TILE_KV);
+                }
+
+                for (int64_t ic = 0; ic < nc; ++ic) {
+                    const float mv = kq[ic];
+                    if (mv == -INFINITY) {
+                        continue;
+                    }
+
+                    float s; // KQ value
+
+                    if (k_f32) {
+                        s = kqs[ic];
+                    } else {
+                        const char * k_data = (const char *) k->data + ((ic0 + ic)*nbk1 + ik2*nbk2 + ik3*nbk3);
+                        kq_vec_dot(DK, &s, 0, k_data, 0, Q_q + i*DK, 0, 1);
+                    }
+
+                    s = s*scale; // scale KQ value
+
+                    if (logit_softcap != 0.0f) {
+                        s = logit_softcap*tanhf(s);
+                    }
+
+                    kq[ic] = s + mv; // apply mask
+                }
+            }
+
+            // VKQ += softmax(KQ)*V, rescaling the previous tiles to the new maximum
+            for (int64_t i = 0; i < nq; ++i) {
+                float * kq  = KQ    + i*GGML_FA_TILE_KV;
+                float * vkq = VKQ32 + i*DV;
+
+                float max = -INFINITY;
+                ggml_vec_max_f32(nc, &max, kq);
+
+                if (max == -INFINITY) {
+                    continue;
+                }
+
+                const float Mold = M[i];
+
+                if (max > Mold) {
+                    M[i] = max;
+
+                    if (Mold != -INFINITY) {
+                        const float ms = expf(Mold - max);
+
+                        ggml_vec_scale_f32(DV, vkq, ms);
+                        S[i] *= ms;
+                    }
+                }
+
+                S[i] += (float) ggml_vec_soft_max_f32(nc, kq, kq, M[i]);
+
+                ggml_fa_tile_mad_f32(DV, nc, vkq, kq, v32, ldv);
+            }
+        }
+
+        for (int64_t i = 0; i < nq; ++i) {
+            float * vkq = VKQ32 + i*DV;
+
+            // sinks
+            if (sinks) {
+                const float s = ((float *)((char *) sinks->data))[h];
+
+                float ms = 1.0f;
+                float vs = 1.0f;
+
+                if (s > M[i]) {
+                    ms = expf(M[i] - s);
+                    ggml_vec_scale_f32(DV, vkq, ms);
+                } else {
+                    vs = expf(s - M[i]);
+                }
+
+                S[i] = S[i]*ms + vs;
+            }
+
+            // V /= S
+            const float S_inv = S[i] == 0.0f ? 0.0f : 1.0f/S[i];
+            ggml_vec_scale_f32(DV, vkq, S_inv);
+
+            // dst indices
+            const int64_t i1 = iq1 + i;
+            const int64_t i2 = iq2;
+            const int64_t i3 = iq3;
+
+            // permute(0, 2, 1, 3)
+            memcpy((char *) dst->data + (i3*ne2*ne1 + i2 + i1*ne1)*nb1, vkq, nb1);
+        }
     }
 }
 
@@ -8554,7 +8984,11 @@ void ggml_compute_forward_flash_attn_ext(
         case GGML_PREC_F32:
             {
                 // uses F32 accumulators
-                ggml_compute_forward_flash_attn_ext_f16(params, dst);
+                if (dst->src[0]->ne[1] >= GGML_FA_TILE_MIN_Q) {
+                    ggml_compute_forward_flash_attn_ext_f16_tiled(params, dst);
+                } else {
+                    ggml_compute_forward_flash_attn_ext_f16(params, dst);
+                }
             } break;
         default:
             {
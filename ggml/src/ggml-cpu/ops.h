@@ -23,6 +23,30 @@ static const size_t CACHE_LINE_SIZE_F32 = CACHE_LINE_SIZE/sizeof(float);
 // Work buffer size for im2col operations in CONV2D
 #define GGML_IM2COL_WORK_SIZE (16 * 1024 * 1024)
 
+// Tiles of the blocked FLASH_ATTN_EXT kernel, used from GGML_FA_TILE_MIN_Q query rows
+#define GGML_FA_TILE_Q     32
+#define GGML_FA_TILE_KV    64
+#define GGML_FA_TILE_MIN_Q 8
+
+// Work buffer size per thread of the blocked FLASH_ATTN_EXT kernel, in floats
+#define GGML_FA_TILE_WSIZE(DK, DV) \
+    (GGML_FA_TILE_Q*(DK) + GGML_FA_TILE_Q*GGML_FA_TILE_KV + GGML_FA_TILE_KV*((DK) + (DV)) + GGML_FA_TILE_Q*(DV) + 2*GGML_FA_TILE_Q)
+
+// Minimum number of KV rows per chunk when FLASH_ATTN_EXT splits the KV length across threads (flash-decoding)
+#define GGML_FA_SPLIT_KV_MIN 256
+
+// Number of chunks the KV length is split into, 1 if the threads only split the query rows
+// Only for decode (one query row per head), when the rows cannot be evenly distributed across the threads
+static inline int64_t ggml_fa_n_kv_chunks(int64_t nq, int64_t nr, int64_t nkv, int nth) {
+    if (nq != 1 || nth == 1 || nr % nth == 0) {
+        return 1;
+    }
+
+    const int64_t n_chunks = nkv/GGML_FA_SPLIT_KV_MIN;
+
+    return n_chunks < 1 ? 1 : n_chunks > nth ? nth : n_chunks;
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -108,6 +132,7 @@ void ggml_compute_forward_cross_entropy_loss(const struct ggml_compute_params *
 void ggml_compute_forward_cross_entropy_loss_back(const struct ggml_compute_params * params, struct ggml_tensor * dst);
 void ggml_compute_forward_opt_step_adamw(const struct ggml_compute_params * params, struct ggml_tensor * dst);
 void ggml_compute_forward_mul_mat(const struct ggml_compute_params * params, struct ggml_tensor * dst);
+void ggml_compute_forward_mul_mat_id(const struct ggml_compute_params * params, struct ggml_tensor * dst);
 void ggml_compute_forward_opt_step_sgd(const struct ggml_compute_params * params, struct ggml_tensor * dst);
 #ifdef __cplusplus
 }
@@ -4,6 +4,8 @@
 #include "ggml-cpp.h"
 
 #include <cinttypes>
+#include <cstdlib>
+#include <deque>
 #include <string>
 #include <vector>
 #include <memory>
@@ -35,6 +37,15 @@ namespace fs = std::filesystem;
 
 static constexpr size_t MAX_CHUNK_SIZE = 1024ull * 1024ull * 1024ull; // 1 GiB
 
+// max total size of the responses of pipelined commands that have not been received yet, including their size headers
+// kept below the socket buffer size so that the server never blocks on sending while the client is still sending
+static constexpr size_t MAX_PENDING_SIZE = 32ull * 1024ull; // 32 KiB
+
+// size of a response on the wire: | response_size (8 bytes) | response_data (output_size bytes) |
+static constexpr size_t rpc_rsp_wire_size(size_t output_size) {
+    return sizeof(uint64_t) + output_size;
+}
+
 #ifdef _WIN32
 typedef SOCKET sockfd_t;
 using ssize_t = __int64;
@@ -42,9 +53,26 @@ using ssize_t = __int64;
 typedef int sockfd_t;
 #endif
 
+// response of a pipelined command
+struct rpc_pending_rsp {
+    uint8_t cmd;
+    void *  output;      // destination of the response data, nullptr for commands that return a status
+    size_t  output_size;
+};
+
 // cross-platform socket
 struct socket_t {
     sockfd_t fd;
+
+    // client side: responses of the pipelined commands, in the order in which the server sends them
+    std::deque<rpc_pending_rsp> pending;
+    size_t   pending_size = 0;
+    uint64_t n_pending_sent = 0;
+    uint64_t n_pending_recv = 0;
+
+    // status of a pipelined graph compute that failed, returned by the next graph compute
+    enum ggml_status graph_compute_status = GGML_STATUS_SUCCESS;
+
     socket_t(sockfd_t fd) : fd(fd) {}
     ~socket_t() {
         GGML_PRINT_DEBUG("[%s] closing socket %d\n", __func__, this->fd);
@@ -209,6 +237,7 @@ struct ggml_backend_rpc_buffer_type_context {
 struct ggml_backend_rpc_context {
     std::string endpoint;
     std::string name;
+    std::shared_ptr<socket_t> sock;
 };
 
 struct ggml_backend_rpc_buffer_context {
@@ -415,12 +444,8 @@ static bool send_rpc_cmd(const std::shared_ptr<socket_t> & sock, enum rpc_cmd cm
     return true;
 }
 
-// RPC request : | rpc_cmd (1 byte) | request_size (8 bytes) | request_data (request_size bytes) |
 // RPC response: | response_size (8 bytes) | response_data (response_size bytes) |
-static bool send_rpc_cmd(const std::shared_ptr<socket_t> & sock, enum rpc_cmd cmd, const void * input, size_t input_size, void * output, size_t output_size) {
-    if (!send_rpc_cmd(sock, cmd, input, input_size)) {
-        return false;
-    }
+static bool recv_rpc_rsp(const std::shared_ptr<socket_t> & sock, void * output, size_t output_size) {
     // TODO: currently the output_size is always known, do we need support for commands with variable output size?
     // even if we do, we can skip sending output_size from the server for commands with known output size
     uint64_t out_size;
@@ -436,6 +461,94 @@ static bool send_rpc_cmd(const std::shared_ptr<socket_t> & sock, enum rpc_cmd cm
     return true;
 }
 
+// the data read from the server after a failed pipelined graph compute is not valid, and the caller that reads it
+// cannot see the status that the next graph compute would return
+static void check_graph_compute_status(const std::shared_ptr<socket_t> & sock) {
+    if (sock->graph_compute_status != GGML_STATUS_SUCCESS) {
+        GGML_ABORT("reading a tensor after a graph compute that failed on the server: %s", ggml_status_to_string(sock->graph_compute_status));
+    }
+}
+
+// receive the responses of the pipelined commands until n_pending_recv reaches n_until
+// the server processes the commands of a connection one by one, so the responses arrive in the order of the commands
+static bool recv_pending_rsps(const std::shared_ptr<socket_t> & sock, uint64_t n_until) {
+    while (sock->n_pending_recv < n_until) {
+        GGML_ASSERT(!sock->pending.empty());
+        rpc_pending_rsp rsp = sock->pending.front();
+        sock->pending.pop_front();
+        sock->pending_size -= rpc_rsp_wire_size(rsp.output_size);
+        sock->n_pending_recv++;
+
+        if (rsp.output != nullptr) {
+            if (!recv_rpc_rsp(sock, rsp.output, rsp.output_size)) {
+                return false;
+            }
+            if (rsp.cmd == RPC_CMD_GET_TENSOR) {
+                check_graph_compute_status(sock);
+            }
+            continue;
+        }
+        // commands without output return a status byte
+        uint8_t result;
+        if (!recv_rpc_rsp(sock, &result, sizeof(result))) {
+            return false;
+        }
+        // the status is sent as a byte, the failures are negative
+        const enum ggml_status compute_status = (enum ggml_status) (int8_t) result;
+        if (rsp.cmd == RPC_CMD_GRAPH_COMPUTE && compute_status != GGML_STATUS_SUCCESS) {
+            // the connection is still in sync, the failure is reported by the next graph compute instead of
+            // failing the unrelated command that happens to receive the response
+            GGML_LOG_ERROR("%s: graph compute failed on the server: %s\n", __func__, ggml_status_to_string(compute_status));
+            if (sock->graph_compute_status == GGML_STATUS_SUCCESS) {
+                sock->graph_compute_status = compute_status;
+            }
+        }
+    }
+    return true;
+}
+
+static bool recv_pending_rsps(const std::shared_ptr<socket_t> & sock) {
+    return recv_pending_rsps(sock, sock->n_pending_sent);
+}
+
+// RPC request : | rpc_cmd (1 byte) | request_size (8 bytes) | request_data (request_size bytes) |
+// RPC response: | response_size (8 bytes) | response_data (response_size bytes) |
+static bool send_rpc_cmd(const std::shared_ptr<socket_t> & sock, enum rpc_cmd cmd, const void * input, size_t input_size, void * output, size_t output_size) {
+    if (!send_rpc_cmd(sock, cmd, input, input_size)) {
+        return false;
+    }
+    // the responses of the commands sent before come first
+    if (!recv_pending_rsps(sock)) {
+        return false;
+    }
+    return recv_rpc_rsp(sock, output, output_size);
+}
+
+// RPC request sent without waiting for the response
+// the response is received into output (or checked as a status byte if output is nullptr) by a later recv_pending_rsps
+static bool send_rpc_cmd_async(const std::shared_ptr<socket_t> & sock, enum rpc_cmd cmd, const void * input, size_t input_size, void * output, size_t output_size) {
+    const size_t rsp_size = rpc_rsp_wire_size(output_size);
+    GGML_ASSERT(rsp_size <= MAX_PENDING_SIZE);
+    if (sock->pending_size + rsp_size > MAX_PENDING_SIZE) {
+        if (!recv_pending_rsps(sock)) {
+            return false;
+        }
+    }
+    if (!send_rpc_cmd(sock, cmd, input, input_size)) {
+        return false;
+    }
+    sock->pending.push_back({ (uint8_t) cmd, output, output_size });
+    sock->pending_size += rsp_size;
+    sock->n_pending_sent++;
+    return true;
+}
+
+// commands are pipelined unless GGML_RPC_DISABLE_ASYNC is set
+static bool rpc_async_enabled() {
+    static const bool enabled = getenv("GGML_RPC_DISABLE_ASYNC") == nullptr;
+    return enabled;
+}
+
 // RPC client-side implementation
 
 static bool check_server_version(const std::shared_ptr<socket_t> & sock) {
@@ -600,6 +713,7 @@ static void ggml_backend_rpc_buffer_get_tensor(ggml_backend_buffer_t buffer, con
     request.size = size;
     bool status = send_rpc_cmd(ctx->sock, RPC_CMD_GET_TENSOR, &request, sizeof(request), data, size);
     RPC_STATUS_ASSERT(status);
+    check_graph_compute_status(ctx->sock);
 }
 
 static bool ggml_backend_rpc_buffer_cpy_tensor(ggml_backend_buffer_t buffer, const ggml_tensor * src, ggml_tensor * dst) {
@@ -722,15 +836,80 @@ static const char * ggml_backend_rpc_name(ggml_backend_t backend) {
     return rpc_ctx->name.c_str();
 }
 
+static void ggml_backend_rpc_synchronize(ggml_backend_t backend) {
+    ggml_backend_rpc_context * rpc_ctx = (ggml_backend_rpc_context *)backend->context;
+    // receives the status of every pipelined graph compute, the failures are logged here and returned by the next
+    // graph compute, the pending reads of tensors that follow a failure abort
+    bool status = recv_pending_rsps(rpc_ctx->sock);
+    RPC_STATUS_ASSERT(status);
+}
+
 static void ggml_backend_rpc_free(ggml_backend_t backend) {
+    ggml_backend_rpc_synchronize(backend);
     ggml_backend_rpc_context * rpc_ctx = (ggml_backend_rpc_context *)backend->context;
     delete rpc_ctx;
     delete backend;
 }
 
-static void ggml_backend_rpc_synchronize(ggml_backend_t backend) {
+static void ggml_backend_rpc_set_tensor_async(ggml_backend_t backend, ggml_tensor * tensor, const void * data, size_t offset, size_t size) {
+    ggml_backend_buffer_t buf = tensor->view_src ? tensor->view_src->buffer : tensor->buffer;
+    GGML_ASSERT(buf->buft->iface.get_name == ggml_backend_rpc_buffer_type_name && "unsupported buffer type");
+    // SET_TENSOR has no response, so this only blocks until the data is handed to the socket
+    ggml_backend_rpc_buffer_set_tensor(buf, tensor, data, offset, size);
+
     GGML_UNUSED(backend);
-    // this is no-op because we don't have any async operations
+}
+
+static void ggml_backend_rpc_get_tensor_async(ggml_backend_t backend, const ggml_tensor * tensor, void * data, size_t offset, size_t size) {
+    ggml_backend_buffer_t buf = tensor->view_src ? tensor->view_src->buffer : tensor->buffer;
+    GGML_ASSERT(buf->buft->iface.get_name == ggml_backend_rpc_buffer_type_name && "unsupported buffer type");
+    if (!rpc_async_enabled() || rpc_rsp_wire_size(size) > MAX_PENDING_SIZE) {
+        ggml_backend_rpc_buffer_get_tensor(buf, tensor, data, offset, size);
+        return;
+    }
+    ggml_backend_rpc_buffer_context * ctx = (ggml_backend_rpc_buffer_context *)buf->context;
+    rpc_msg_get_tensor_req request;
+    request.tensor = serialize_tensor(tensor);
+    request.offset = offset;
+    request.size = size;
+    bool status = send_rpc_cmd_async(ctx->sock, RPC_CMD_GET_TENSOR, &request, sizeof(request), data, size);
+    RPC_STATUS_ASSERT(status);
+
+    GGML_UNUSED(backend);
+}
+
+static bool ggml_backend_rpc_cpy_tensor_async(ggml_backend_t backend_src, ggml_backend_t backend_dst, const ggml_tensor * src, ggml_tensor * dst) {
+    ggml_backend_buffer_t src_buf = src->view_src ? src->view_src->buffer : src->buffer;
+    ggml_backend_buffer_t dst_buf = dst->view_src ? dst->view_src->buffer : dst->buffer;
+
+    if (dst_buf->buft->iface.get_name != ggml_backend_rpc_buffer_type_name) {
+        return false;
+    }
+    ggml_backend_rpc_buffer_context * dst_ctx = (ggml_backend_rpc_buffer_context *)dst_buf->context;
+
+    if (src_buf->buft->iface.get_name == ggml_backend_rpc_buffer_type_name) {
+        ggml_backend_rpc_buffer_context * src_ctx = (ggml_backend_rpc_buffer_context *)src_buf->context;
+        if (src_ctx->sock == dst_ctx->sock) {
+            // the server runs the commands in order, so the copy is done after the queued work on the server
+            return ggml_backend_rpc_buffer_cpy_tensor(dst_buf, src, dst);
+        }
+        // the blocking read waits for the queued work on the source server only,
+        // the write to the destination server is queued after its own work without waiting for it
+        std::vector<uint8_t> data(ggml_nbytes(src));
+        ggml_backend_rpc_buffer_get_tensor(src_buf, src, data.data(), 0, data.size());
+        ggml_backend_rpc_buffer_set_tensor(dst_buf, dst, data.data(), 0, data.size());
+        return true;
+    }
+
+    if (ggml_backend_buffer_is_host(src_buf)) {
+        ggml_backend_synchronize(backend_src);
+        ggml_backend_rpc_buffer_set_tensor(dst_buf, dst, src->data, 0, ggml_nbytes(src));
+        return true;
+    }
+
+    return false;
+
+    GGML_UNUSED(backend_dst);
 }
 
 static void add_tensor(ggml_tensor * tensor, std::vector<rpc_tensor> & tensors, std::unordered_set<ggml_tensor*> & visited) {
@@ -774,27 +953,71 @@ static enum ggml_status ggml_backend_rpc_graph_compute(ggml_backend_t backend, g
     ggml_backend_rpc_context * rpc_ctx = (ggml_backend_rpc_context *)backend->context;
     std::vector<uint8_t> input;
     serialize_graph(cgraph, input);
+    auto & sock = rpc_ctx->sock;
+    if (rpc_async_enabled()) {
+        // the status of the compute is checked when the response is received, a failure is returned by the
+        // next graph compute on this connection
+        bool status = send_rpc_cmd_async(sock, RPC_CMD_GRAPH_COMPUTE, input.data(), input.size(), nullptr, sizeof(rpc_msg_graph_compute_rsp));
+        RPC_STATUS_ASSERT(status);
+        const enum ggml_status result = sock->graph_compute_status;
+        sock->graph_compute_status = GGML_STATUS_SUCCESS;
+        return result;
+    }
     rpc_msg_graph_compute_rsp response;
-    auto sock = get_socket(rpc_ctx->endpoint);
     bool status = send_rpc_cmd(sock, RPC_CMD_GRAPH_COMPUTE, input.data(), input.size(), &response, sizeof(response));
     RPC_STATUS_ASSERT(status);
-    return (enum ggml_status)response.result;
+    return (enum ggml_status)(int8_t)response.result;
+}
+
+// events mark a point in the stream of commands of a connection
+
+struct ggml_backend_rpc_event_context {
+    std::shared_ptr<socket_t> sock;
+    uint64_t n_pending_sent = 0;
+};
+
+static void ggml_backend_rpc_event_record(ggml_backend_t backend, ggml_backend_event_t event) {
+    ggml_backend_rpc_context * rpc_ctx = (ggml_backend_rpc_context *)backend->context;
+    ggml_backend_rpc_event_context * event_ctx = (ggml_backend_rpc_event_context *)event->context;
+    event_ctx->sock = rpc_ctx->sock;
+    event_ctx->n_pending_sent = event_ctx->sock->n_pending_sent;
+}
+
+static void ggml_backend_rpc_event_synchronize(ggml_backend_dev_t dev, ggml_backend_event_t event) {
+    ggml_backend_rpc_event_context * event_ctx = (ggml_backend_rpc_event_context *)event->context;
+    if (event_ctx->sock == nullptr) {
+        return;
+    }
+    bool status = recv_pending_rsps(event_ctx->sock, event_ctx->n_pending_sent);
+    RPC_STATUS_ASSERT(status);
+
+    GGML_UNUSED(dev);
+}
+
+static void ggml_backend_rpc_event_wait(ggml_backend_t backend, ggml_backend_event_t event) {
+    ggml_backend_rpc_context * rpc_ctx = (ggml_backend_rpc_context *)backend->context;
+    ggml_backend_rpc_event_context * event_ctx = (ggml_backend_rpc_event_context *)event->context;
+    if (event_ctx->sock == rpc_ctx->sock) {
+        // the commands of a connection are already run in order
+        return;
+    }
+    ggml_backend_rpc_event_synchronize(event->device, event);
 }
 
 static ggml_backend_i ggml_backend_rpc_interface = {
     /* .get_name                = */ ggml_backend_rpc_name,
     /* .free                    = */ ggml_backend_rpc_free,
-    /* .set_tensor_async        = */ NULL,
-    /* .get_tensor_async        = */ NULL,
-    /* .cpy_tensor_async        = */ NULL,
+    /* .set_tensor_async        = */ ggml_backend_rpc_set_tensor_async,
+    /* .get_tensor_async        = */ ggml_backend_rpc_get_tensor_async,
+    /* .cpy_tensor_async        = */ ggml_backend_rpc_cpy_tensor_async,
     /* .synchronize             = */ ggml_backend_rpc_synchronize,
     /* .graph_plan_create       = */ NULL,
     /* .graph_plan_free         = */ NULL,
     /* .graph_plan_update       = */ NULL,
     /* .graph_plan_compute      = */ NULL,
     /* .graph_compute           = */ ggml_backend_rpc_graph_compute,
-    /* .event_record            = */ NULL,
-    /* .event_wait              = */ NULL,
+    /* .event_record            = */ ggml_backend_rpc_event_record,
+    /* .event_wait              = */ ggml_backend_rpc_event_wait,
 };
 
 ggml_backend_buffer_type_t ggml_backend_rpc_buffer_type(const char * endpoint) {
@@ -830,9 +1053,15 @@ ggml_backend_buffer_type_t ggml_backend_rpc_buffer_type(const char * endpoint) {
 }
 
 ggml_backend_t ggml_backend_rpc_init(const char * endpoint) {
+    auto sock = get_socket(endpoint);
+    if (sock == nullptr) {
+        fprintf(stderr, "Failed to connect to %s\n", endpoint);
+        return nullptr;
+    }
     ggml_backend_rpc_context * ctx = new ggml_backend_rpc_context {
         /* .endpoint  = */ endpoint,
         /* .name      = */ "RPC[" + std::string(endpoint) + "]",
+        /* .sock      = */ sock,
     };
 
     ggml_backend_t backend = new ggml_backend {
@@ -1693,10 +1922,10 @@ static void ggml_backend_rpc_device_get_props(ggml_backend_dev_t dev, struct ggm
     props->type        = ggml_backend_rpc_device_get_type(dev);
     ggml_backend_rpc_device_get_memory(dev, &props->memory_free, &props->memory_total);
     props->caps = {
-        /* .async                 = */ false,
+        /* .async                 = */ rpc_async_enabled(),
         /* .host_buffer           = */ false,
         /* .buffer_from_host_ptr  = */ false,
-        /* .events                = */ false,
+        /* .events                = */ rpc_async_enabled(),
     };
 }
 
@@ -1732,6 +1961,20 @@ static bool ggml_backend_rpc_device_supports_buft(ggml_backend_dev_t dev, ggml_b
     return buft_ctx->endpoint == dev_ctx->endpoint;
 }
 
+static ggml_backend_event_t ggml_backend_rpc_device_event_new(ggml_backend_dev_t dev) {
+    return new ggml_backend_event {
+        /* .device  = */ dev,
+        /* .context = */ new ggml_backend_rpc_event_context,
+    };
+}
+
+static void ggml_backend_rpc_device_event_free(ggml_backend_dev_t dev, ggml_backend_event_t event) {
+    delete (ggml_backend_rpc_event_context *)event->context;
+    delete event;
+
+    GGML_UNUSED(dev);
+}
+
 static const struct ggml_backend_device_i ggml_backend_rpc_device_i = {
     /* .get_name             = */ ggml_backend_rpc_device_get_name,
     /* .get_description      = */ ggml_backend_rpc_device_get_description,
@@ -1745,9 +1988,9 @@ static const struct ggml_backend_device_i ggml_backend_rpc_device_i = {
     /* .supports_op          = */ ggml_backend_rpc_device_supports_op,
     /* .supports_buft        = */ ggml_backend_rpc_device_supports_buft,
     /* .offload_op           = */ NULL,
-    /* .event_new            = */ NULL,
-    /* .event_free           = */ NULL,
-    /* .event_synchronize    = */ NULL,
+    /* .event_new            = */ ggml_backend_rpc_device_event_new,
+    /* .event_free           = */ ggml_backend_rpc_device_event_free,
+    /* .event_synchronize    = */ ggml_backend_rpc_event_synchronize,
 };
 
 // backend reg interface
@@ -283,11 +283,12 @@ extern "C" {
         const struct llama_model_kv_override * kv_overrides;
 
         // Keep the booleans together to avoid misalignment during copy-by-value.
-        bool vocab_only;      // only load the vocabulary, no weights
-        bool use_mmap;        // use mmap if possible
-        bool use_mlock;       // force system to keep model in RAM
-        bool check_tensors;   // validate model tensor data
-        bool use_extra_bufts; // use extra buffer types (used for weight repacking)
+        bool vocab_only;       // only load the vocabulary, no weights
+        bool use_mmap;         // use mmap if possible
+        bool use_mlock;        // force system to keep model in RAM
+        bool check_tensors;    // validate model tensor data
+        bool use_extra_bufts;  // use extra buffer types (used for weight repacking)
+        bool use_repack_cache; // store the repacked weights in a file next to the model and map it on later loads (requires mmap)
     };
 
     // NOTE: changing the default values of parameters marked as [EXPERIMENTAL] may cause crashes or incorrect results in certain configurations
@@ -535,6 +536,9 @@ extern "C" {
     // Returns true if the model is recurrent (like Mamba, RWKV, etc.)
     LLAMA_API bool llama_model_is_recurrent(const struct llama_model * model);
 
+    // Returns true if the model is hybrid, mixing attention and recurrent layers (like Jamba, Falcon-H1, etc.)
+    LLAMA_API bool llama_model_is_hybrid(const struct llama_model * model);
+
     // Returns true if the model is diffusion-based (like LLaDA, Dream, etc.)
     LLAMA_API bool llama_model_is_diffusion(const struct llama_model * model);
 
@@ -575,6 +579,21 @@ extern "C" {
     // Remove all LoRA adapters from given context
     LLAMA_API void llama_clear_adapter_lora(struct llama_context * ctx);
 
+    // Apply a loaded LoRA adapter only to the tokens of the given sequence, on top of the adapters of the context
+    // Sequences with different adapters can be processed in the same llama_decode() call
+    // A scale of 0.0f removes the adapter from the sequence
+    // Return -1 if the sequence id is invalid
+    LLAMA_API int32_t llama_set_adapter_lora_seq(
+            struct llama_context * ctx,
+            struct llama_adapter_lora * adapter,
+            llama_seq_id seq_id,
+            float scale);
+
+    // Remove the LoRA adapters of the given sequence (seq_id < 0 : all sequences)
+    LLAMA_API void llama_clear_adapter_lora_seq(
+            struct llama_context * ctx,
+            llama_seq_id seq_id);
+
     // Apply a loaded control vector to a llama_context, or if data is NULL, clear
     // the currently loaded vector.
     // n_embd should be the size of a single layer's control, and data should point
@@ -858,6 +877,20 @@ extern "C" {
     // If set to true, the model will only attend to the past tokens
     LLAMA_API void llama_set_causal_attn(struct llama_context * ctx, bool causal_attn);
 
+    // Evaluate only the first n_layer layers of the model, followed by the output norm and head (0 = all layers)
+    // The KV cells of the skipped layers are left unset, so the tokens decoded this way must be removed from the
+    // memory before they are decoded again with all the layers - used for self-speculative decoding
+    LLAMA_API void llama_set_n_layer_exit(struct llama_context * ctx, uint32_t n_layer);
+
+    // Sample the outputs in the graph of llama_decode(), so that only the sampled tokens are copied back
+    // instead of the n_vocab logits of each output - use llama_get_sampled_ith() to obtain them
+    // top_k = 1 or temp <= 0 is greedy sampling, otherwise the top_k candidates are returned with their
+    // probabilities at the given temperature, for the final draw to be made by the caller
+    // top_k = 0 disables it, the logits are not available while it is enabled
+    // With top_k > 1 and an offloaded output layer, the candidates are selected by sorting the logits on the device of the
+    // output - if it cannot, the graph sampling is disabled and false is returned, the caller then samples from the logits
+    LLAMA_API bool llama_set_graph_sampling(struct llama_context * ctx, int32_t top_k, float temp);
+
     // Set whether the model is in warmup mode or not
     // If true, all model tensors are activated during llama_decode() to load and cache their weights.
     LLAMA_API void llama_set_warmup(struct llama_context * ctx, bool warmup);
@@ -884,6 +917,11 @@ extern "C" {
     // returns NULL for invalid ids.
     LLAMA_API float * llama_get_logits_ith(struct llama_context * ctx, int32_t i);
 
+    // The candidates sampled in the graph for the ith token, see llama_set_graph_sampling()
+    // ids receives the candidates by decreasing probability, probs their probabilities or NULL for greedy sampling
+    // returns the number of candidates, or -1 for invalid ids
+    LLAMA_API int32_t llama_get_sampled_ith(struct llama_context * ctx, int32_t i, const llama_token ** ids, const float ** probs);
+
     // Get all output token embeddings.
     // when pooling_type == LLAMA_POOLING_TYPE_NONE or when using a generative model,
     // the embeddings for which llama_batch.logits[i] != 0 are stored contiguously
@@ -1265,6 +1303,16 @@ extern "C" {
     // Returns the seed used by the sampler if applicable, LLAMA_DEFAULT_SEED otherwise
     LLAMA_API uint32_t llama_sampler_get_seed(const struct llama_sampler * smpl);
 
+    /// @details Initialize the candidates of smpl from the raw logits of the n_vocab tokens, data must have room for n_vocab entries
+    // If the first sampler to modify the candidates is a top-k sampler, only the k tokens with the highest logits are copied,
+    // sorted in descending order, instead of the whole vocab
+    LLAMA_API void llama_sampler_fill_candidates(
+            const struct llama_sampler * smpl,
+                           const float * logits,
+                               int32_t   n_vocab,
+                      llama_token_data * data,
+                llama_token_data_array * cur_p);
+
     /// @details Sample and accept a token from the idx-th output of the last evaluation
     //
     // Shorthand for:
@@ -1277,6 +1325,17 @@ extern "C" {
     // Returns the sampled token
     LLAMA_API llama_token llama_sampler_sample(struct llama_sampler * smpl, struct llama_context * ctx, int32_t idx);
 
+    /// @details Sample and accept a token for each of the n outputs of the last evaluation
+    // Equivalent to tokens[i] = llama_sampler_sample(smpls[i], ctx, idxs[i]) for i in [0, n), with the samplers run
+    // in parallel on the CPU threads of the context (llama_n_threads(ctx), and the threadpool attached to it if any)
+    // The samplers must be distinct
+    LLAMA_API void llama_sampler_sample_batch(
+            struct llama_sampler ** smpls,
+            struct llama_context  * ctx,
+                   const int32_t  * idxs,
+                     llama_token  * tokens,
+                         int32_t    n);
+
     // TODO: extend in the future
     //LLAMA_API void llama_decode_with_sampler(struct llama_context * ctx, struct llama_sampler * smpl, struct llama_batch batch, ...);
 
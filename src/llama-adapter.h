@@ -74,3 +74,6 @@ struct llama_adapter_lora {
 };
 
 using llama_adapter_loras = std::unordered_map<llama_adapter_lora *, float>;
+
+// adapters applied to a subset of the sequences: the scale of the adapter for each seq_id, 0.0f if not applied
+using llama_adapter_loras_seq = std::unordered_map<llama_adapter_lora *, std::vector<float>>;
@@ -7,9 +7,12 @@
 #include "llama-mmap.h"
 #include "llama-model.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cinttypes>
 #include <cstring>
 #include <limits>
+#include <mutex>
 #include <stdexcept>
 
 //
@@ -33,6 +36,10 @@ llama_context::llama_context(
         throw std::runtime_error("n_seq_max must be <= " + std::to_string(LLAMA_MAX_SEQ));
     }
 
+    cparams.n_layer_exit     = 0;
+    cparams.sampling_top_k   = 0;
+    cparams.sampling_temp    = 1.0f;
+    cparams.sampling_sort    = false;
     cparams.n_threads        = params.n_threads;
     cparams.n_threads_batch  = params.n_threads_batch;
     cparams.yarn_ext_factor  = params.yarn_ext_factor;
@@ -542,6 +549,53 @@ float * llama_context::get_logits_ith(int32_t i) {
     }
 }
 
+int32_t llama_context::get_sampled_ith(int32_t i, const llama_token ** ids, const float ** probs) {
+    int64_t j = -1;
+
+    output_reorder();
+
+    try {
+        if (sampled_k == 0) {
+            throw std::runtime_error("no sampled tokens");
+        }
+
+        if (i < 0) {
+            j = n_outputs + i;
+            if (j < 0) {
+                throw std::runtime_error(format("negative index out of range [0, %d)", n_outputs));
+            }
+        } else if ((size_t) i >= output_ids.size()) {
+            throw std::runtime_error(format("out of range [0, %zu)", output_ids.size()));
+        } else {
+            j = output_ids[i];
+        }
+
+        if (j < 0) {
+            throw std::runtime_error(format("batch.logits[%d] != true", i));
+        }
+        if (j >= n_outputs) {
+            // This should not happen
+            throw std::runtime_error(format("corrupt output buffer (j=%" PRId64 ", n_outputs=%d)", j, n_outputs));
+        }
+
+        if (ids) {
+            *ids = sampled_ids.data() + j*sampled_k;
+        }
+        if (probs) {
+            *probs = sampled_probs.empty() ? nullptr : sampled_probs.data() + j*sampled_k;
+        }
+
+        return sampled_k;
+    } catch (const std::exception & err) {
+        LLAMA_LOG_ERROR("%s: invalid sampled id %d, reason: %s\n", __func__, i, err.what());
+#ifndef NDEBUG
+        GGML_ABORT("fatal error");
+#else
+        return -1;
+#endif
+    }
+}
+
 float * llama_context::get_embeddings() {
     output_reorder();
 
@@ -620,6 +674,85 @@ void llama_context::set_n_threads(int32_t n_threads, int32_t n_threads_batch) {
     cparams.n_threads_batch = n_threads_batch;
 }
 
+namespace {
+struct llama_cpu_parallel_for_job {
+    const std::function<void(int32_t)> * f;
+    int32_t n;
+
+    std::atomic<int32_t> next { 0 };
+
+    std::mutex         mutex;
+    std::exception_ptr error;
+};
+}
+
+static void llama_cpu_parallel_for_custom(ggml_tensor * /*dst*/, int /*ith*/, int /*nth*/, void * userdata) {
+    auto & job = *(llama_cpu_parallel_for_job *) userdata;
+
+    for (int32_t i = job.next++; i < job.n; i = job.next++) {
+        try {
+            (*job.f)(i);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            if (!job.error) {
+                job.error = std::current_exception();
+            }
+            job.next = job.n;
+        }
+    }
+}
+
+void llama_context::cpu_parallel_for(int32_t n, const std::function<void(int32_t)> & f) {
+    if (n <= 1 || cparams.n_threads <= 1) {
+        for (int32_t i = 0; i < n; ++i) {
+            f(i);
+        }
+        return;
+    }
+
+    llama_cpu_parallel_for_job job;
+    job.f = &f;
+    job.n = n;
+
+    // a graph with a single custom op, so that the work runs on the threads of the CPU backend instead of new ones
+    ggml_init_params params = {
+        /*.mem_size   =*/ ggml_tensor_overhead() + ggml_graph_overhead_custom(1, false),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+
+    ggml_context_ptr ctx0 { ggml_init(params) };
+
+    ggml_tensor * cur = ggml_custom_4d(ctx0.get(), GGML_TYPE_I32, 1, 1, 1, 1, nullptr, 0, llama_cpu_parallel_for_custom, GGML_N_TASKS_MAX, &job);
+
+    ggml_cgraph * gf = ggml_new_graph_custom(ctx0.get(), 1, false);
+    ggml_build_forward_expand(gf, cur);
+
+    ggml_backend_buffer_ptr buf { ggml_backend_alloc_ctx_tensors(ctx0.get(), backend_cpu) };
+    if (!buf) {
+        throw std::runtime_error("failed to allocate the CPU parallel_for buffer");
+    }
+
+    auto * reg = ggml_backend_dev_backend_reg(ggml_backend_get_device(backend_cpu));
+    auto * set_threadpool_fn = (decltype(ggml_backend_cpu_set_threadpool) *) ggml_backend_reg_get_proc_address(reg, "ggml_backend_cpu_set_threadpool");
+    set_threadpool_fn(backend_cpu, threadpool);
+
+    for (const auto & set_n_threads_fn : set_n_threads_fns) {
+        if (set_n_threads_fn.first == backend_cpu) {
+            set_n_threads_fn.second(backend_cpu, std::min<int32_t>(cparams.n_threads, n));
+        }
+    }
+
+    const auto status = ggml_backend_graph_compute(backend_cpu, gf);
+    if (status != GGML_STATUS_SUCCESS) {
+        throw std::runtime_error(format("failed to run the CPU parallel_for graph: %s", ggml_status_to_string(status)));
+    }
+
+    if (job.error) {
+        std::rethrow_exception(job.error);
+    }
+}
+
 void llama_context::set_abort_callback(bool (*abort_callback)(void * data), void * abort_callback_data) {
     LLAMA_LOG_DEBUG("%s: call\n", __func__);
 
@@ -647,6 +780,52 @@ void llama_context::set_causal_attn(bool value) {
     cparams.causal_attn = value;
 }
 
+void llama_context::set_n_layer_exit(uint32_t value) {
+    LLAMA_LOG_DEBUG("%s: value = %u\n", __func__, value);
+
+    cparams.n_layer_exit = value;
+}
+
+bool llama_context::set_graph_sampling(int32_t top_k, float temp) {
+    LLAMA_LOG_DEBUG("%s: top_k = %d, temp = %f\n", __func__, top_k, temp);
+
+    cparams.sampling_top_k = top_k;
+    cparams.sampling_temp  = temp;
+    cparams.sampling_sort  = false;
+
+    ggml_backend_dev_t dev = model.dev_output();
+
+    if (top_k <= 1 || temp <= 0.0f || dev == nullptr || ggml_backend_dev_type(dev) == GGML_BACKEND_DEVICE_TYPE_CPU) {
+        return true;
+    }
+
+    // the partial top-k is a CPU op, with an offloaded output it would make the scheduler copy the logits of the
+    // whole vocab to the host, so the candidates are sorted on the device of the output if it supports it
+    ggml_init_params params = {
+        /*.mem_size   =*/ 2*ggml_tensor_overhead(),
+        /*.mem_buffer =*/ nullptr,
+        /*.no_alloc   =*/ true,
+    };
+
+    ggml_context_ptr ctx0 { ggml_init(params) };
+
+    ggml_tensor * logits = ggml_new_tensor_2d(ctx0.get(), GGML_TYPE_F32, model.vocab.n_tokens(), cparams.n_batch);
+    ggml_tensor * ids    = ggml_argsort(ctx0.get(), logits, GGML_SORT_ORDER_DESC);
+
+    if (!ggml_backend_dev_supports_op(dev, ids)) {
+        LLAMA_LOG_WARN("%s: %s cannot sort the logits of the output, the graph sampling of top_k = %d is disabled\n",
+                __func__, ggml_backend_dev_name(dev), top_k);
+
+        cparams.sampling_top_k = 0;
+
+        return false;
+    }
+
+    cparams.sampling_sort = true;
+
+    return true;
+}
+
 void llama_context::set_warmup(bool value) {
     LLAMA_LOG_DEBUG("%s: value = %d\n", __func__, value);
 
@@ -658,6 +837,11 @@ void llama_context::set_adapter_lora(
             float scale) {
     LLAMA_LOG_DEBUG("%s: adapter = %p, scale = %f\n", __func__, (void *) adapter, scale);
 
+    auto it = loras.find(adapter);
+    if (it == loras.end() || it->second != scale) {
+        loras_gen++;
+    }
+
     loras[adapter] = scale;
 }
 
@@ -668,6 +852,7 @@ bool llama_context::rm_adapter_lora(
     auto pos = loras.find(adapter);
     if (pos != loras.end()) {
         loras.erase(pos);
+        loras_gen++;
         return true;
     }
 
@@ -677,9 +862,64 @@ bool llama_context::rm_adapter_lora(
 void llama_context::clear_adapter_lora() {
     LLAMA_LOG_DEBUG("%s: call\n", __func__);
 
+    if (!loras.empty()) {
+        loras_gen++;
+    }
+
     loras.clear();
 }
 
+bool llama_context::set_adapter_lora_seq(
+            llama_adapter_lora * adapter,
+            llama_seq_id seq_id,
+            float scale) {
+    LLAMA_LOG_DEBUG("%s: adapter = %p, seq_id = %d, scale = %f\n", __func__, (void *) adapter, seq_id, scale);
+
+    if (seq_id < 0 || (uint32_t) seq_id >= cparams.n_seq_max) {
+        LLAMA_LOG_ERROR("%s: invalid seq_id = %d >= %u\n", __func__, seq_id, cparams.n_seq_max);
+        return false;
+    }
+
+    auto it = loras_seq.find(adapter);
+    if (it == loras_seq.end()) {
+        if (scale == 0.0f) {
+            return true;
+        }
+
+        // the scales are graph inputs, so only adding or removing an adapter changes the graph
+        it = loras_seq.emplace(adapter, std::vector<float>(cparams.n_seq_max, 0.0f)).first;
+        loras_gen++;
+    }
+
+    it->second[seq_id] = scale;
+
+    if (std::all_of(it->second.begin(), it->second.end(), [](float s) { return s == 0.0f; })) {
+        loras_seq.erase(it);
+        loras_gen++;
+    }
+
+    return true;
+}
+
+void llama_context::clear_adapter_lora_seq(llama_seq_id seq_id) {
+    LLAMA_LOG_DEBUG("%s: seq_id = %d\n", __func__, seq_id);
+
+    for (auto it = loras_seq.begin(); it != loras_seq.end(); ) {
+        if (seq_id >= 0 && (uint32_t) seq_id < cparams.n_seq_max) {
+            it->second[seq_id] = 0.0f;
+        } else {
+            std::fill(it->second.begin(), it->second.end(), 0.0f);
+        }
+
+        if (std::all_of(it->second.begin(), it->second.end(), [](float s) { return s == 0.0f; })) {
+            it = loras_seq.erase(it);
+            loras_gen++;
+        } else {
+            ++it;
+        }
+    }
+}
+
 bool llama_context::apply_adapter_cvec(
             const float * data,
                  size_t   len,
@@ -1098,6 +1338,27 @@ int llama_context::decode(const llama_batch & batch_inp) {
             t_embd = res->get_embd_pooled();
         }
 
+        auto * t_sampled_ids   = res->get_sampled_ids();
+        auto * t_sampled_probs = res->get_sampled_probs();
+
+        // extract the sampled tokens instead of the logits
+        if (t_sampled_ids && n_outputs > 0) {
+            ggml_backend_t backend_res = ggml_backend_sched_get_tensor_backend(sched.get(), t_sampled_ids);
+            GGML_ASSERT(backend_res != nullptr);
+            GGML_ASSERT(t_sampled_ids->ne[0]*t_sampled_ids->ne[1] == n_outputs*sampled_k);
+            GGML_ASSERT((n_outputs_prev + n_outputs)*sampled_k <= (int64_t) sampled_ids.size());
+
+            ggml_backend_tensor_get_async(backend_res, t_sampled_ids, sampled_ids.data() + n_outputs_prev*sampled_k, 0, n_outputs*sampled_k*sizeof(llama_token));
+
+            if (t_sampled_probs) {
+                GGML_ASSERT((n_outputs_prev + n_outputs)*sampled_k <= (int64_t) sampled_probs.size());
+
+                ggml_backend_tensor_get_async(backend_res, t_sampled_probs, sampled_probs.data() + n_outputs_prev*sampled_k, 0, n_outputs*sampled_k*sizeof(float));
+            }
+
+            t_logits = nullptr;
+        }
+
         // extract logits
         if (t_logits && n_outputs > 0) {
             ggml_backend_t backend_res = ggml_backend_sched_get_tensor_backend(sched.get(), t_logits);
@@ -1247,7 +1508,10 @@ uint32_t llama_context::output_reserve(int32_t n_outputs) {
     const auto n_vocab = vocab.n_tokens();
     const auto n_embd  = hparams.n_embd;
 
-    bool has_logits = true;
+    // with in-graph sampling, only the sampled tokens are returned
+    const bool has_sampled = cparams.sampling_top_k > 0 && !cparams.embeddings;
+
+    bool has_logits = !has_sampled;
     bool has_embd   = cparams.embeddings;
 
     // TODO: hacky enc-dec support
@@ -1259,6 +1523,15 @@ uint32_t llama_context::output_reserve(int32_t n_outputs) {
     logits_size = has_logits ? n_vocab*n_outputs_max : 0;
     embd_size   = has_embd   ?  n_embd*n_outputs_max : 0;
 
+    // must match llm_graph_context::build_sampling()
+    sampled_k = 0;
+    if (has_sampled) {
+        sampled_k = cparams.sampling_temp > 0.0f ? std::min<int64_t>(cparams.sampling_top_k, n_vocab) : 1;
+    }
+
+    sampled_ids.resize(sampled_k*n_outputs_max);
+    sampled_probs.resize(sampled_k > 1 ? sampled_k*n_outputs_max : 0);
+
     if (output_ids.empty()) {
         // init, never resized afterwards
         output_ids.resize(n_batch);
@@ -1326,6 +1599,13 @@ void llama_context::output_reorder() {
                 std::swap(embd[i0*n_embd + k], embd[i1*n_embd + k]);
             }
         }
+
+        if (sampled_k > 0) {
+            std::swap_ranges(sampled_ids.begin() + i0*sampled_k, sampled_ids.begin() + (i0 + 1)*sampled_k, sampled_ids.begin() + i1*sampled_k);
+            if (!sampled_probs.empty()) {
+                std::swap_ranges(sampled_probs.begin() + i0*sampled_k, sampled_probs.begin() + (i0 + 1)*sampled_k, sampled_probs.begin() + i1*sampled_k);
+            }
+        }
     }
 
     output_swaps.clear();
@@ -1401,6 +1681,8 @@ llm_graph_params llama_context::graph_params(
         /*.backend_cpu =*/ backend_cpu,
         /*.cvec        =*/ &cvec,
         /*.loras       =*/ &loras,
+        /*.loras_seq   =*/ &loras_seq,
+        /*.loras_gen   =*/ loras_gen,
         /*.mctx        =*/ mctx,
         /*.cross       =*/ &cross,
         /*.n_outputs   =*/ n_outputs,
@@ -2362,6 +2644,14 @@ void llama_set_causal_attn(llama_context * ctx, bool causal_attn) {
     ctx->set_causal_attn(causal_attn);
 }
 
+void llama_set_n_layer_exit(llama_context * ctx, uint32_t n_layer) {
+    ctx->set_n_layer_exit(n_layer);
+}
+
+bool llama_set_graph_sampling(llama_context * ctx, int32_t top_k, float temp) {
+    return ctx->set_graph_sampling(top_k, temp);
+}
+
 void llama_set_warmup(llama_context * ctx, bool warmup) {
     ctx->set_warmup(warmup);
 }
@@ -2382,6 +2672,12 @@ float * llama_get_logits_ith(llama_context * ctx, int32_t i) {
     return ctx->get_logits_ith(i);
 }
 
+int32_t llama_get_sampled_ith(llama_context * ctx, int32_t i, const llama_token ** ids, const float ** probs) {
+    ctx->synchronize();
+
+    return ctx->get_sampled_ith(i, ids, probs);
+}
+
 float * llama_get_embeddings(llama_context * ctx) {
     ctx->synchronize();
 
@@ -2423,6 +2719,20 @@ void llama_clear_adapter_lora(llama_context * ctx) {
     ctx->clear_adapter_lora();
 }
 
+int32_t llama_set_adapter_lora_seq(
+            llama_context * ctx,
+            llama_adapter_lora * adapter,
+            llama_seq_id seq_id,
+            float scale) {
+    bool res = ctx->set_adapter_lora_seq(adapter, seq_id, scale);
+
+    return res ? 0 : -1;
+}
+
+void llama_clear_adapter_lora_seq(llama_context * ctx, llama_seq_id seq_id) {
+    ctx->clear_adapter_lora_seq(seq_id);
+}
+
 int32_t llama_apply_adapter_cvec(
         llama_context * ctx,
                  const float * data,
@@ -8,6 +8,7 @@
 #include "ggml-cpp.h"
 #include "ggml-opt.h"
 
+#include <functional>
 #include <map>
 #include <vector>
 
@@ -54,6 +55,8 @@ struct llama_context {
     float * get_logits();
     float * get_logits_ith(int32_t i);
 
+    int32_t get_sampled_ith(int32_t i, const llama_token ** ids, const float ** probs);
+
     float * get_embeddings();
     float * get_embeddings_ith(int32_t i);
     float * get_embeddings_seq(llama_seq_id seq_id);
@@ -66,10 +69,16 @@ struct llama_context {
 
     void set_n_threads(int32_t n_threads, int32_t n_threads_batch);
 
+    // run f(i) for i in [0, n) on the threads of the CPU backend, with the threadpool attached to the context if any
+    // the first exception thrown by f is rethrown
+    void cpu_parallel_for(int32_t n, const std::function<void(int32_t)> & f);
+
     void set_abort_callback(bool (*abort_callback)(void * data), void * abort_callback_data);
 
     void set_embeddings (bool value);
     void set_causal_attn(bool value);
+    void set_n_layer_exit(uint32_t value);
+    bool set_graph_sampling(int32_t top_k, float temp);
     void set_warmup(bool value);
 
     void set_adapter_lora(
@@ -81,6 +90,13 @@ struct llama_context {
 
     void clear_adapter_lora();
 
+    bool set_adapter_lora_seq(
+            llama_adapter_lora * adapter,
+            llama_seq_id seq_id,
+            float scale);
+
+    void clear_adapter_lora_seq(llama_seq_id seq_id);
+
     bool apply_adapter_cvec(
             const float * data,
                  size_t   len,
@@ -223,6 +239,10 @@ private:
     llama_cparams       cparams;
     llama_adapter_cvec  cvec;
     llama_adapter_loras loras;
+    llama_adapter_loras_seq loras_seq;
+
+    // incremented when the set of adapters or the scales of the context adapters change, since these are part of the graph
+    uint32_t loras_gen = 0;
 
     llama_cross cross; // TODO: tmp for handling cross-attention - need something better probably
 
@@ -232,6 +252,12 @@ private:
     size_t  logits_size = 0; // capacity (of floats) for logits
     float * logits      = nullptr;
 
+    // in-graph sampling output (2-dimensional arrays: [n_outputs][sampled_k])
+    // populated instead of the logits when cparams.sampling_top_k > 0
+    int32_t                  sampled_k = 0;
+    std::vector<llama_token> sampled_ids;
+    std::vector<float>       sampled_probs; // empty for greedy sampling
+
     // embeddings output (2-dimensional array: [n_outputs][n_embd])
     // populated only when pooling_type == LLAMA_POOLING_TYPE_NONE
     size_t  embd_size = 0; // capacity (of floats) for embeddings
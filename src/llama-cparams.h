@@ -11,6 +11,10 @@ struct llama_cparams {
     uint32_t n_batch;
     uint32_t n_ubatch;
     uint32_t n_seq_max;
+    uint32_t n_layer_exit;    // number of layers evaluated by the graph, 0 for all of them
+    int32_t  sampling_top_k;  // number of candidates sampled by the graph for each output, 0 to return the logits
+    float    sampling_temp;   // temperature of the in-graph sampling
+    bool     sampling_sort;   // select the candidates with ggml_top_k on the device of the output instead of on the CPU
     int32_t  n_threads;       // number of threads to use for generation
     int32_t  n_threads_batch; // number of threads to use for batch processing
 
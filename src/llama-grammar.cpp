@@ -6,6 +6,8 @@
 
 #include <cmath>
 #include <algorithm>
+#include <functional>
+#include <mutex>
 #include <stdexcept>
 
 //
@@ -823,11 +825,12 @@ llama_grammar_stacks & llama_grammar_get_stacks(struct llama_grammar * grammar)
     return grammar->stacks;
 }
 
-void llama_grammar_accept(struct llama_grammar * grammar, uint32_t chr) {
-    llama_grammar_stacks stacks_new;
-    stacks_new.reserve(grammar->stacks.size());
-
-    for (const auto & stack : grammar->stacks) {
+static void llama_grammar_accept_chr(
+        const llama_grammar_rules  & rules,
+        const llama_grammar_stacks & stacks,
+                          uint32_t   chr,
+              llama_grammar_stacks & stacks_new) {
+    for (const auto & stack : stacks) {
         if (stack.empty()) {
             continue;
         }
@@ -841,9 +844,16 @@ void llama_grammar_accept(struct llama_grammar * grammar, uint32_t chr) {
             if (!llama_grammar_is_end_of_sequence(pos)) {
                 new_stack.push_back(pos);
             }
-            llama_grammar_advance_stack(grammar->rules, new_stack, stacks_new);
+            llama_grammar_advance_stack(rules, new_stack, stacks_new);
         }
     }
+}
+
+void llama_grammar_accept(struct llama_grammar * grammar, uint32_t chr) {
+    llama_grammar_stacks stacks_new;
+    stacks_new.reserve(grammar->stacks.size());
+
+    llama_grammar_accept_chr(grammar->rules, grammar->stacks, chr, stacks_new);
 
     grammar->stacks = std::move(stacks_new);
 }
@@ -903,6 +913,256 @@ llama_grammar_candidates llama_grammar_reject_candidates_for_stack(
     return rejects;
 }
 
+//
+// token masks
+//
+
+// the pieces of the vocab decoded to code points and arranged in a trie, so that the grammar stacks are
+// advanced once per common prefix instead of once per token when computing the allowed tokens of a state
+struct llama_grammar_token_trie {
+    struct node {
+        uint32_t child_begin; // edges in child_cps / child_nodes
+        uint32_t child_end;
+        uint32_t token_begin; // tokens whose code points end at this node
+        uint32_t token_end;
+    };
+
+    std::vector<node>     nodes; // nodes[0] is the root
+    std::vector<uint32_t> child_cps;
+    std::vector<uint32_t> child_nodes;
+
+    std::vector<llama_token>        tokens;
+    std::vector<llama_partial_utf8> tokens_partial; // incomplete UTF-8 sequence at the end of the piece
+
+    uint32_t n_vocab = 0;
+};
+
+// allowed tokens for a grammar state: the stacks, with the elements as (rule, offset) pairs
+using llama_grammar_mask_key = std::vector<uint32_t>;
+using llama_grammar_mask     = std::vector<uint64_t>; // bit i set iff token i is allowed
+
+struct llama_grammar_masks {
+    std::mutex mutex;
+
+    std::shared_ptr<const llama_grammar_token_trie> trie;
+
+    std::map<llama_grammar_mask_key, std::shared_ptr<const llama_grammar_mask>> cache;
+};
+
+// the masks are dropped once there are more states than this (~19 KiB each for a 150k vocab)
+static constexpr size_t LLAMA_GRAMMAR_MAX_MASKS = 256;
+
+static std::shared_ptr<const llama_grammar_token_trie> llama_grammar_build_token_trie(const llama_vocab & vocab) {
+    struct entry {
+        std::vector<uint32_t> cps;
+        llama_partial_utf8    partial;
+        llama_token           id;
+    };
+
+    const uint32_t n_vocab = vocab.n_tokens();
+
+    std::vector<entry> entries;
+    entries.reserve(n_vocab);
+
+    for (uint32_t id = 0; id < n_vocab; ++id) {
+        // same as llama_grammar_apply_impl, these tokens are not matched against the grammar
+        const std::string & piece = vocab.token_to_piece(id);
+        if (vocab.is_eog(id) || piece.empty() || piece[0] == 0) {
+            continue;
+        }
+
+        auto decoded = decode_utf8(piece, {});
+        decoded.first.pop_back(); // terminating 0
+
+        entries.push_back({ std::move(decoded.first), decoded.second, (llama_token) id });
+    }
+
+    // a prefix sorts before its extensions, so the entries of a node come first in the range of its subtree
+    std::sort(entries.begin(), entries.end(), [](const entry & a, const entry & b) { return a.cps < b.cps; });
+
+    auto trie = std::make_shared<llama_grammar_token_trie>();
+    trie->n_vocab = n_vocab;
+
+    std::function<uint32_t(size_t, size_t, size_t)> build = [&](size_t lo, size_t hi, size_t depth) -> uint32_t {
+        const uint32_t idx = trie->nodes.size();
+        trie->nodes.push_back({});
+
+        size_t i = lo;
+
+        trie->nodes[idx].token_begin = trie->tokens.size();
+        for (; i < hi && entries[i].cps.size() == depth; ++i) {
+            trie->tokens.push_back(entries[i].id);
+            trie->tokens_partial.push_back(entries[i].partial);
+        }
+        trie->nodes[idx].token_end = trie->tokens.size();
+
+        // the edges of a node are contiguous, the subtrees are filled afterwards
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t j = i; i < hi; i = j) {
+            while (j < hi && entries[j].cps[depth] == entries[i].cps[depth]) {
+                ++j;
+            }
+            ranges.emplace_back(i, j);
+        }
+
+        const uint32_t child_begin = trie->child_cps.size();
+        for (const auto & [r_lo, r_hi] : ranges) {
+            trie->child_cps.push_back(entries[r_lo].cps[depth]);
+            trie->child_nodes.push_back(0);
+        }
+        trie->nodes[idx].child_begin = child_begin;
+        trie->nodes[idx].child_end   = child_begin + ranges.size();
+
+        for (size_t k = 0; k < ranges.size(); ++k) {
+            trie->child_nodes[child_begin + k] = build(ranges[k].first, ranges[k].second, depth + 1);
+        }
+
+        return idx;
+    };
+
+    build(0, entries.size(), 0);
+
+    return trie;
+}
+
+// the trie only depends on the vocab, so it is shared by all the grammars of a model
+static std::shared_ptr<const llama_grammar_token_trie> llama_grammar_get_token_trie(const llama_vocab & vocab) {
+    static std::mutex mutex;
+    static std::map<const llama_vocab *, std::weak_ptr<const llama_grammar_token_trie>> tries;
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto trie = tries[&vocab].lock();
+    if (!trie) {
+        const int64_t t_start_us = ggml_time_us();
+
+        trie = llama_grammar_build_token_trie(vocab);
+        tries[&vocab] = trie;
+
+        LLAMA_LOG_DEBUG("%s: built token trie with %zu nodes in %.2f ms\n", __func__, trie->nodes.size(), (ggml_time_us() - t_start_us) / 1000.0);
+    }
+
+    return trie;
+}
+
+static std::vector<std::pair<const llama_grammar_element *, uint32_t>> llama_grammar_index_rules(const llama_grammar_rules & rules) {
+    std::vector<std::pair<const llama_grammar_element *, uint32_t>> res;
+    res.reserve(rules.size());
+
+    for (size_t ir = 0; ir < rules.size(); ++ir) {
+        if (!rules[ir].empty()) {
+            res.emplace_back(rules[ir].data(), ir);
+        }
+    }
+
+    std::sort(res.begin(), res.end());
+
+    return res;
+}
+
+static llama_grammar_mask_key llama_grammar_get_mask_key(const llama_grammar & grammar) {
+    const auto & index = grammar.rules_index;
+
+    llama_grammar_mask_key key;
+
+    for (const auto & stack : grammar.stacks) {
+        for (const llama_grammar_element * pos : stack) {
+            // the last rule that starts at or before pos
+            auto it = std::upper_bound(index.begin(), index.end(), pos,
+                    [](const llama_grammar_element * p, const std::pair<const llama_grammar_element *, uint32_t> & e) { return std::less<>()(p, e.first); });
+            GGML_ASSERT(it != index.begin());
+            --it;
+
+            const auto & rule = grammar.rules[it->second];
+            GGML_ASSERT(std::less<>()(pos, rule.data() + rule.size()));
+
+            key.push_back(it->second);
+            key.push_back(pos - rule.data());
+        }
+        key.push_back(UINT32_MAX);
+    }
+
+    return key;
+}
+
+// sets the bits of the tokens in the subtree of node that can be accepted from one of the stacks
+static void llama_grammar_fill_mask(
+        const llama_grammar_rules      & rules,
+        const llama_grammar_token_trie & trie,
+                              uint32_t   node,
+        const llama_grammar_stacks     & stacks,
+                   llama_grammar_mask  & mask) {
+    const auto & n = trie.nodes[node];
+
+    for (uint32_t i = n.token_begin; i < n.token_end; ++i) {
+        const llama_partial_utf8 partial = trie.tokens_partial[i];
+
+        // a token ending in a partial sequence is allowed iff a continuation of it can satisfy a stack
+        bool allowed = partial.n_remain == 0;
+        for (size_t is = 0; is < stacks.size() && !allowed; ++is) {
+            allowed = !stacks[is].empty() && llama_grammar_match_partial_char(stacks[is].back(), partial);
+        }
+
+        if (allowed) {
+            const llama_token id = trie.tokens[i];
+            mask[id / 64] |= uint64_t(1) << (id % 64);
+        }
+    }
+
+    llama_grammar_stacks stacks_next;
+
+    for (uint32_t c = n.child_begin; c < n.child_end; ++c) {
+        stacks_next.clear();
+        llama_grammar_accept_chr(rules, stacks, trie.child_cps[c], stacks_next);
+
+        if (!stacks_next.empty()) {
+            llama_grammar_fill_mask(rules, trie, trie.child_nodes[c], stacks_next, mask);
+        }
+    }
+}
+
+// returns the allowed tokens of the current state of the grammar, or nullptr if it is cheaper to check the candidates
+static std::shared_ptr<const llama_grammar_mask> llama_grammar_get_mask(
+        const llama_grammar & grammar,
+                     size_t   n_candidates) {
+    // the masks are computed for pieces decoded from the start of a code point
+    if (!grammar.masks || grammar.partial_utf8.n_remain != 0) {
+        return nullptr;
+    }
+
+    auto & masks = *grammar.masks;
+
+    auto key = llama_grammar_get_mask_key(grammar);
+
+    std::lock_guard<std::mutex> lock(masks.mutex);
+
+    auto it = masks.cache.find(key);
+    if (it != masks.cache.end()) {
+        return it->second;
+    }
+
+    // e.g. checking only the sampled token is cheaper than walking the trie
+    if (n_candidates < grammar.vocab->n_tokens() / 8) {
+        return nullptr;
+    }
+
+    if (!masks.trie) {
+        masks.trie = llama_grammar_get_token_trie(*grammar.vocab);
+    }
+
+    auto mask = std::make_shared<llama_grammar_mask>((masks.trie->n_vocab + 63) / 64, 0);
+
+    llama_grammar_fill_mask(grammar.rules, *masks.trie, 0, grammar.stacks, *mask);
+
+    if (masks.cache.size() >= LLAMA_GRAMMAR_MAX_MASKS) {
+        masks.cache.clear();
+    }
+
+    masks.cache.emplace(std::move(key), mask);
+
+    return mask;
+}
+
 ////////////////////
 
 struct llama_grammar * llama_grammar_init_impl(
@@ -960,7 +1220,7 @@ struct llama_grammar * llama_grammar_init_impl(
     // Important: vec_rules has to be moved here, not copied, because stacks contains
     // pointers to elements of vec_rules. If vec_rules were copied into llama_grammar
     // then the pointers would be invalidated when the local vec_rules goes out of scope.
-    return new llama_grammar {
+    auto * result = new llama_grammar {
         vocab,
         std::move(vec_rules),
         std::move(stacks),
@@ -970,7 +1230,13 @@ struct llama_grammar * llama_grammar_init_impl(
         /* .trigger_buffer = */   "",
         /* .trigger_tokens   = */ {},
         /* .trigger_patterns    = */ {},
+        /* .masks = */            vocab ? std::make_shared<llama_grammar_masks>() : nullptr,
+        /* .rules_index = */      {},
     };
+
+    result->rules_index = llama_grammar_index_rules(result->rules);
+
+    return result;
 }
 
 struct llama_grammar * llama_grammar_init_impl(
@@ -1065,7 +1331,7 @@ struct llama_grammar * llama_grammar_init_impl(
     // Important: vec_rules has to be moved here, not copied, because stacks contains
     // pointers to elements of vec_rules. If vec_rules were copied into llama_grammar
     // then the pointers would be invalidated when the local vec_rules goes out of scope.
-    return new llama_grammar {
+    auto * result = new llama_grammar {
         vocab,
         std::move(vec_rules),
         std::move(stacks),
@@ -1075,7 +1341,13 @@ struct llama_grammar * llama_grammar_init_impl(
         /* .trigger_buffer = */   "",
         std::move(vec_trigger_tokens),
         std::move(vec_trigger_patterns),
+        /* .masks = */            vocab ? std::make_shared<llama_grammar_masks>() : nullptr,
+        /* .rules_index = */      {},
     };
+
+    result->rules_index = llama_grammar_index_rules(result->rules);
+
+    return result;
 }
 
 void llama_grammar_free_impl(struct llama_grammar * grammar) {
@@ -1097,8 +1369,12 @@ struct llama_grammar * llama_grammar_clone_impl(const struct llama_grammar & gra
         grammar.trigger_buffer,
         grammar.trigger_tokens,
         grammar.trigger_patterns,
+        grammar.masks,
+        /* .rules_index = */ {},
     };
 
+    result->rules_index = llama_grammar_index_rules(result->rules);
+
     // redirect elements in stacks to point to new rules
     for (size_t is = 0; is < result->stacks.size(); is++) {
         for (size_t ie = 0; ie < result->stacks[is].size(); ie++) {
@@ -1130,11 +1406,15 @@ void llama_grammar_apply_impl(const struct llama_grammar & grammar, llama_token_
         }
     }
 
-    std::vector<std::pair<std::vector<uint32_t>, llama_partial_utf8>> candidates_decoded;
-    candidates_decoded.reserve(cur_p->size);
+    const auto mask = llama_grammar_get_mask(grammar, cur_p->size);
 
+    std::vector<std::pair<std::vector<uint32_t>, llama_partial_utf8>> candidates_decoded;
     llama_grammar_candidates candidates_grammar;
-    candidates_grammar.reserve(cur_p->size);
+
+    if (!mask) {
+        candidates_decoded.reserve(cur_p->size);
+        candidates_grammar.reserve(cur_p->size);
+    }
 
     for (size_t i = 0; i < cur_p->size; ++i) {
         const llama_token id      = cur_p->data[i].id;
@@ -1146,12 +1426,20 @@ void llama_grammar_apply_impl(const struct llama_grammar & grammar, llama_token_
             }
         } else if (piece.empty() || piece[0] == 0) {
             cur_p->data[i].logit = -INFINITY;
+        } else if (mask) {
+            if (!((*mask)[id / 64] & (uint64_t(1) << (id % 64)))) {
+                cur_p->data[i].logit = -INFINITY;
+            }
         } else {
             candidates_decoded.push_back(decode_utf8(piece, grammar.partial_utf8));
             candidates_grammar.push_back({ i, candidates_decoded.back().first.data(), candidates_decoded.back().second });
         }
     }
 
+    if (mask) {
+        return;
+    }
+
     const auto rejects = llama_grammar_reject_candidates(grammar.rules, grammar.stacks, candidates_grammar);
     for (const auto & reject : rejects) {
         cur_p->data[reject.index].logit = -INFINITY;
@@ -3,11 +3,13 @@
 #include "llama.h"
 
 #include <map>
+#include <memory>
 #include <regex>
 #include <string>
 #include <vector>
 
 struct llama_vocab;
+struct llama_grammar_masks;
 
 // grammar element type
 enum llama_gretype {
@@ -132,6 +134,13 @@ struct llama_grammar {
                              trigger_patterns;         // Regular expressions that trigger a lazy grammar. Must be a full match of the entire generated
                                                        // string, and the grammar will be given the string from the first match group onwards.
 
+    // allowed tokens of the vocab for the grammar states seen so far, shared by the clones of the grammar
+    // null when the grammar has no vocab, in which case the candidates are always checked one by one
+    std::shared_ptr<llama_grammar_masks> masks;
+
+    // first element of each rule with the index of the rule, sorted by address
+    // used to map the elements of the stacks back to (rule, offset) for the keys of the masks
+    std::vector<std::pair<const llama_grammar_element *, uint32_t>> rules_index;
 };
 
 //
@@ -9,9 +9,12 @@
 #include "llama-memory-hybrid.h"
 #include "llama-memory-recurrent.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <numeric>
+#include <vector>
 
 void llm_graph_input_embd::set_input(const llama_ubatch * ubatch) {
     if (ubatch->token) {
@@ -108,6 +111,46 @@ void llm_graph_input_pos_bucket_kv::set_input(const llama_ubatch * ubatch) {
     }
 }
 
+void llm_graph_input_lora_seq::set_input(const llama_ubatch * ubatch) {
+    const int64_t n_tokens = ubatch->n_tokens;
+
+    for (const auto & scale : scales) {
+        const auto it = loras_seq->find(scale.adapter);
+
+        if (scale.all) {
+            GGML_ASSERT(ggml_backend_buffer_is_host(scale.all->buffer));
+            float * data = (float *) scale.all->data;
+
+            for (int i = 0; i < n_tokens; ++i) {
+                // tokens shared by several sequences use the adapters of the first one
+                data[i] = it == loras_seq->end() ? 0.0f : it->second[ubatch->seq_id[i][0]];
+            }
+        }
+
+        if (scale.out) {
+            GGML_ASSERT(ggml_backend_buffer_is_host(scale.out->buffer));
+            float * data = (float *) scale.out->data;
+
+            GGML_ASSERT(ubatch->output);
+
+            // only created when n_outputs < n_tokens, same order as llm_graph_input_out_ids
+            int n_outputs = 0;
+            for (int i = 0; i < n_tokens; ++i) {
+                if (ubatch->output[i]) {
+                    data[n_outputs++] = it == loras_seq->end() ? 0.0f : it->second[ubatch->seq_id[i][0]];
+                }
+            }
+        }
+    }
+}
+
+bool llm_graph_input_lora_seq::can_reuse(const llm_graph_params & params) {
+    // the set of adapters is covered by loras_gen, only the scales change and these are inputs
+    GGML_UNUSED(params);
+
+    return true;
+}
+
 void llm_graph_input_out_ids::set_input(const llama_ubatch * ubatch) {
     GGML_ASSERT(out_ids);
 
@@ -417,6 +460,9 @@ void llm_graph_result::reset() {
     t_embd        = nullptr;
     t_embd_pooled = nullptr;
 
+    t_sampled_ids   = nullptr;
+    t_sampled_probs = nullptr;
+
     params = {};
 
     inputs.clear();
@@ -492,6 +538,7 @@ llm_graph_context::llm_graph_context(const llm_graph_params & params) :
     ubatch           (params.ubatch),
     n_embd           (hparams.n_embd),
     n_layer          (hparams.n_layer),
+    n_layer_eval     (cparams.n_layer_exit > 0 ? std::min(cparams.n_layer_exit, hparams.n_layer) : hparams.n_layer),
     n_rot            (hparams.n_rot),
     n_ctx            (cparams.n_ctx),
     n_head           (hparams.n_head()),
@@ -519,6 +566,7 @@ llm_graph_context::llm_graph_context(const llm_graph_params & params) :
     backend_cpu      (params.backend_cpu),
     cvec             (params.cvec),
     loras            (params.loras),
+    loras_seq        (params.loras_seq),
     mctx             (params.mctx),
     cross            (params.cross),
     cb_func          (params.cb),
@@ -540,6 +588,49 @@ ggml_tensor * llm_graph_context::build_cvec(
     return cvec->apply_to(ctx0, cur, il);
 }
 
+ggml_tensor * llm_graph_context::build_lora_seq_scale(
+        llama_adapter_lora * adapter,
+         const ggml_tensor * cur,
+                       int   dim) const {
+    if (!inp_lora_seq) {
+        inp_lora_seq = static_cast<llm_graph_input_lora_seq *>(res->add_input(std::make_unique<llm_graph_input_lora_seq>(loras_seq)));
+    }
+
+    GGML_ASSERT(dim > 0 && dim < GGML_MAX_DIMS);
+
+    // the tokens span the dims [dim, GGML_MAX_DIMS) of cur, e.g. {n_seq_tokens, n_seqs} for the recurrent models
+    // they are either all the tokens of the ubatch or only the outputs (after the out_ids selection)
+    int64_t ne[GGML_MAX_DIMS] = { 1, 1, 1, 1 };
+    int64_t n_rows = 1;
+    for (int d = dim; d < GGML_MAX_DIMS; ++d) {
+        ne[d]   = cur->ne[d];
+        n_rows *= cur->ne[d];
+    }
+
+    GGML_ASSERT(n_rows == n_tokens || n_rows == n_outputs);
+
+    llm_graph_input_lora_seq::scale * entry = nullptr;
+    for (auto & scale : inp_lora_seq->scales) {
+        if (scale.adapter == adapter) {
+            entry = &scale;
+            break;
+        }
+    }
+
+    if (!entry) {
+        entry = &inp_lora_seq->scales.emplace_back();
+        entry->adapter = adapter;
+    }
+
+    ggml_tensor *& t = n_rows == n_tokens ? entry->all : entry->out;
+    if (!t) {
+        t = ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, 1, n_rows);
+        ggml_set_input(t);
+    }
+
+    return ggml_reshape_4d(ctx0, t, ne[0], ne[1], ne[2], ne[3]);
+}
+
 ggml_tensor * llm_graph_context::build_lora_mm(
           ggml_tensor * w,
           ggml_tensor * cur) const {
@@ -563,6 +654,23 @@ ggml_tensor * llm_graph_context::build_lora_mm(
         res = ggml_add(ctx0, res, ab_cur);
     }
 
+    // adapters of a subset of the sequences are computed for all tokens and masked by the per-token scale
+    for (const auto & lora : *loras_seq) {
+        llama_adapter_lora_weight * lw = lora.first->get_weight(w);
+        if (lw == nullptr) {
+            continue;
+        }
+
+        ggml_tensor * ab_cur = ggml_mul_mat(
+                ctx0, lw->b,
+                ggml_mul_mat(ctx0, lw->a, cur)
+                );
+
+        ab_cur = ggml_scale(ctx0, ab_cur, lw->get_scale(lora.first->alpha, 1.0f));
+        ab_cur = ggml_mul  (ctx0, ab_cur, build_lora_seq_scale(lora.first, ab_cur, 1));
+        res = ggml_add(ctx0, res, ab_cur);
+    }
+
     return res;
 }
 
@@ -591,6 +699,23 @@ ggml_tensor * llm_graph_context::build_lora_mm_id(
         res = ggml_add(ctx0, res, ab_cur);
     }
 
+    for (const auto & lora : *loras_seq) {
+        llama_adapter_lora_weight * lw = lora.first->get_weight(w);
+        if (lw == nullptr) {
+            continue;
+        }
+
+        ggml_tensor * ab_cur = ggml_mul_mat_id(
+                ctx0, lw->b,
+                ggml_mul_mat_id(ctx0, lw->a, cur, ids),
+                ids
+                );
+
+        ab_cur = ggml_scale(ctx0, ab_cur, lw->get_scale(lora.first->alpha, 1.0f));
+        ab_cur = ggml_mul  (ctx0, ab_cur, build_lora_seq_scale(lora.first, ab_cur, 2));
+        res = ggml_add(ctx0, res, ab_cur);
+    }
+
     return res;
 }
 
@@ -1055,6 +1180,20 @@ ggml_tensor * llm_graph_context::build_inp_embd(ggml_tensor * tok_embd) const {
 
             cur = ggml_add(ctx0, cur, inpL_delta);
         }
+
+        for (const auto & lora : *loras_seq) {
+            llama_adapter_lora_weight * lw = lora.first->get_weight(tok_embd);
+            if (lw == nullptr) {
+                continue;
+            }
+
+            ggml_tensor * inpL_delta = ggml_scale(ctx0, ggml_mul_mat(
+                        ctx0, lw->b, // non-transposed lora_b
+                        ggml_get_rows(ctx0, lw->a, inp->tokens)
+                        ), lw->get_scale(lora.first->alpha, 1.0f));
+
+            cur = ggml_add(ctx0, cur, ggml_mul(ctx0, inpL_delta, build_lora_seq_scale(lora.first, inpL_delta, 1)));
+        }
     } else {
         inp->embd = ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, n_embd, ubatch.n_tokens);
         ggml_set_input(inp->embd);
@@ -1863,6 +2002,96 @@ void llm_graph_context::build_pooling(
     ggml_build_forward_expand(gf, cur);
 }
 
+// partial top-k of the rows of src[0], ids in decreasing order of the logits
+// ggml_top_k is a full argsort of the vocab, which is O(n_vocab log n_vocab) per row
+// this is a CPU op, it is only used when the logits are computed on the CPU (see llama_context::set_graph_sampling)
+static void llama_top_k_custom(ggml_tensor * dst, int ith, int nth, void * /*userdata*/) {
+    const ggml_tensor * src = dst->src[0];
+
+    GGML_ASSERT(src->type == GGML_TYPE_F32);
+    GGML_ASSERT(dst->type == GGML_TYPE_I32);
+
+    const int64_t n_vocab = src->ne[0];
+    const int64_t top_k   = dst->ne[0];
+    const int64_t n_rows  = dst->ne[1];
+
+    const int64_t dr  = (n_rows + nth - 1)/nth;
+    const int64_t ir0 = dr*ith;
+    const int64_t ir1 = std::min(ir0 + dr, n_rows);
+
+    if (ir0 >= ir1) {
+        return;
+    }
+
+    // custom ops have no work buffer, the indices are kept per thread across the graph computes
+    static thread_local std::vector<int32_t> idx;
+    idx.resize(n_vocab);
+
+    for (int64_t ir = ir0; ir < ir1; ++ir) {
+        const float * x = (const float *) ((const char *) src->data + ir*src->nb[1]);
+        int32_t     * y = (int32_t     *) ((char       *) dst->data + ir*dst->nb[1]);
+
+        // ties are broken by the token id, so that the result does not depend on the partitioning
+        const auto cmp = [x](int32_t a, int32_t b) {
+            return x[a] > x[b] || (x[a] == x[b] && a < b);
+        };
+
+        std::iota(idx.begin(), idx.end(), 0);
+        std::partial_sort(idx.begin(), idx.begin() + top_k, idx.end(), cmp);
+        std::copy(idx.begin(), idx.begin() + top_k, y);
+    }
+}
+
+void llm_graph_context::build_sampling() const {
+    if (cparams.sampling_top_k <= 0 || cparams.embeddings || res->t_logits == nullptr || n_outputs == 0) {
+        return;
+    }
+
+    ggml_tensor * logits = res->t_logits;
+
+    const int64_t n_vocab = logits->ne[0];
+    const int64_t top_k   = std::min<int64_t>(cparams.sampling_top_k, n_vocab);
+
+    if (top_k == 1 || cparams.sampling_temp <= 0.0f) {
+        // greedy
+        ggml_tensor * ids = ggml_argmax(ctx0, logits);
+        cb(ids, "result_sampled_ids", -1);
+
+        res->t_sampled_ids = ids;
+
+        ggml_build_forward_expand(gf, ids);
+
+        return;
+    }
+
+    // [top_k, n_outputs]
+    ggml_tensor * ids = nullptr;
+    if (cparams.sampling_sort) {
+        // the output is offloaded, the candidates are selected on its device instead of copying the logits to the CPU
+        ids = ggml_cont(ctx0, ggml_top_k(ctx0, logits, top_k));
+    } else {
+        ids = ggml_custom_4d(ctx0, GGML_TYPE_I32, top_k, logits->ne[1], 1, 1, &logits, 1, llama_top_k_custom, GGML_N_TASKS_MAX, nullptr);
+    }
+
+    // [1, top_k, n_outputs]
+    ggml_tensor * vals = ggml_get_rows(ctx0, ggml_reshape_3d(ctx0, logits, 1, n_vocab, logits->ne[1]), ids);
+    vals = ggml_reshape_2d(ctx0, vals, top_k, logits->ne[1]);
+
+    ggml_tensor * probs = ggml_soft_max_ext(ctx0, vals, nullptr, 1.0f/cparams.sampling_temp, 0.0f);
+    cb(probs, "result_sampled_probs", -1);
+
+    cb(ids, "result_sampled_ids", -1);
+
+    // the ids are also an input of get_rows, without this their memory is reused once it is done
+    ggml_set_output(ids);
+
+    res->t_sampled_ids   = ids;
+    res->t_sampled_probs = probs;
+
+    ggml_build_forward_expand(gf, ids);
+    ggml_build_forward_expand(gf, probs);
+}
+
 int32_t llama_relative_position_bucket(llama_pos x, llama_pos y, uint64_t n_buckets, bool bidirectional) {
     // TODO move to hparams if a T5 variant appears that uses a different value
     const int64_t max_distance = 128;
@@ -164,6 +164,27 @@ public:
     const llama_kv_cache_context * mctx;
 };
 
+class llm_graph_input_lora_seq : public llm_graph_input_i {
+public:
+    llm_graph_input_lora_seq(const llama_adapter_loras_seq * loras_seq) : loras_seq(loras_seq) {}
+    virtual ~llm_graph_input_lora_seq() = default;
+
+    void set_input(const llama_ubatch * ubatch) override;
+
+    bool can_reuse(const llm_graph_params & params) override;
+
+    struct scale {
+        llama_adapter_lora * adapter = nullptr;
+
+        ggml_tensor * all = nullptr; // F32 [1, n_batch]
+        ggml_tensor * out = nullptr; // F32 [1, n_outputs]
+    };
+
+    std::vector<scale> scales;
+
+    const llama_adapter_loras_seq * loras_seq;
+};
+
 class llm_graph_input_out_ids : public llm_graph_input_i {
 public:
     llm_graph_input_out_ids(
@@ -398,10 +419,12 @@ struct llm_graph_params {
     ggml_backend_sched_t sched;
     ggml_backend_t backend_cpu;
 
-    const llama_adapter_cvec     * cvec;
-    const llama_adapter_loras    * loras;
-    const llama_memory_context_i * mctx;
-    const llama_cross            * cross;
+    const llama_adapter_cvec      * cvec;
+    const llama_adapter_loras     * loras;
+    const llama_adapter_loras_seq * loras_seq;
+    uint32_t                        loras_gen;
+    const llama_memory_context_i  * mctx;
+    const llama_cross             * cross;
 
     uint32_t n_outputs;
 
@@ -445,10 +468,14 @@ struct llm_graph_params {
         return
             cparams.embeddings  == other.cparams.embeddings  &&
             cparams.causal_attn == other.cparams.causal_attn &&
+            cparams.n_layer_exit == other.cparams.n_layer_exit &&
+            cparams.sampling_top_k == other.cparams.sampling_top_k &&
+            cparams.sampling_temp  == other.cparams.sampling_temp  &&
             arch      == other.arch  &&
             gtype     == other.gtype &&
             cvec      == other.cvec  &&
             loras     == other.loras &&
+            loras_gen == other.loras_gen &&
             cross     == other.cross &&
             n_outputs == other.n_outputs;
     }
@@ -464,6 +491,8 @@ public:
     ggml_tensor * get_logits()      const { return t_logits; }
     ggml_tensor * get_embd()        const { return t_embd; }
     ggml_tensor * get_embd_pooled() const { return t_embd_pooled; }
+    ggml_tensor * get_sampled_ids()   const { return t_sampled_ids; }
+    ggml_tensor * get_sampled_probs() const { return t_sampled_probs; }
 
     ggml_cgraph  * get_gf()  const { return gf; }
     ggml_context * get_ctx() const { return ctx_compute.get(); }
@@ -491,6 +520,9 @@ public:
     ggml_tensor * t_embd        = nullptr;
     ggml_tensor * t_embd_pooled = nullptr;
 
+    ggml_tensor * t_sampled_ids   = nullptr; // I32 [top_k, n_outputs]
+    ggml_tensor * t_sampled_probs = nullptr; // F32 [top_k, n_outputs], null for greedy sampling
+
     std::vector<llm_graph_input_ptr> inputs;
 
     ggml_context_ptr ctx_compute;
@@ -530,6 +562,7 @@ struct llm_graph_context {
 
     const int64_t n_embd;
     const int64_t n_layer;
+    const int64_t n_layer_eval; // layers evaluated by the layer loops, fewer than n_layer with llama_set_n_layer_exit()
     const int64_t n_rot;
     const int64_t n_ctx;       // user-specified context size (can be different from n_ctx_train)
     const int64_t n_head;
@@ -561,13 +594,17 @@ struct llm_graph_context {
 
     ggml_backend_t backend_cpu; // TODO: needed by build_attn_mha, figure out a way to remove?
 
-    const llama_adapter_cvec     * cvec;
-    const llama_adapter_loras    * loras;
-    const llama_memory_context_i * mctx;
-    const llama_cross            * cross;
+    const llama_adapter_cvec      * cvec;
+    const llama_adapter_loras     * loras;
+    const llama_adapter_loras_seq * loras_seq;
+    const llama_memory_context_i  * mctx;
+    const llama_cross             * cross;
 
     const llm_graph_cb & cb_func;
 
+    // created on first use by build_lora_seq_scale()
+    mutable llm_graph_input_lora_seq * inp_lora_seq = nullptr;
+
     llm_graph_result * res;
 
     ggml_context * ctx0 = nullptr;
@@ -586,6 +623,13 @@ struct llm_graph_context {
              ggml_tensor * cur,
                      int   il) const;
 
+    // per-token scale of an adapter that is applied to a subset of the sequences, shaped to broadcast over cur
+    // dim is the first dimension of cur that holds the tokens
+    ggml_tensor * build_lora_seq_scale(
+            llama_adapter_lora * adapter,
+             const ggml_tensor * cur,
+                           int   dim) const;
+
     // do mat_mul, while optionally apply lora
     ggml_tensor * build_lora_mm(
               ggml_tensor * w,
@@ -804,6 +848,13 @@ struct llm_graph_context {
             ggml_tensor * cls_b,
             ggml_tensor * cls_out,
             ggml_tensor * cls_out_b) const;
+
+    //
+    // sampling
+    //
+
+    // reduce the logits of each output to the top_k candidates and their probabilities
+    void build_sampling() const;
 };
 
 // TODO: better name
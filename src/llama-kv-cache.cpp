@@ -790,6 +790,16 @@ llama_kv_cache::slot_info llama_kv_cache::find_slot(const llama_ubatch & ubatch,
             return { };
         }
 
+        // with multiple sequences in the same stream, try to keep the cells of each sequence in their own blocks
+        // if this fails (e.g. because the cells have to be reused through the SWA mask), fallback to the search below
+        if (!cont && n_stream == 1 && n_seq_max > 1) {
+            if (cells.find_slot_blocks(n_tokens, ubatch.seq_id, res.idxs[s])) {
+                continue;
+            }
+
+            res.idxs[s].clear();
+        }
+
         uint32_t n_tested = 0;
 
         // for continuous slots, we test that all tokens in the ubatch fit, starting from the current head
@@ -1240,7 +1250,7 @@ void llama_kv_cache::set_input_kq_mask(ggml_tensor * dst, const llama_ubatch * u
     //      xxxxx-----
     //      xxxxx-----
     // To visualize the mask, see https://github.com/ggml-org/llama.cpp/pull/12615
-    // TODO: optimize this section
+    // The blocks of cells that do not contain the sequence of the token are skipped entirely.
     for (uint32_t h = 0; h < 1; ++h) {
         for (uint32_t s = 0; s < n_stream; ++s) {
             for (uint32_t ii = 0; ii < n_tps; ++ii) {
@@ -1254,29 +1264,38 @@ void llama_kv_cache::set_input_kq_mask(ggml_tensor * dst, const llama_ubatch * u
 
                 const uint64_t idst = n_kv*(h*n_stream*n_tps_pad + s*n_tps_pad + ii);
 
-                for (uint32_t j = 0; j < n_kv; ++j) {
-                    if (cells.is_empty(j)) {
+                for (uint32_t j0 = 0, b = 0; j0 < n_kv; j0 += llama_kv_cells::BLOCK_SIZE, ++b) {
+                    // mask the whole block if there are no cells from the same sequence in it
+                    if (!cells.blk_has_seq(b, seq_id)) {
                         continue;
                     }
 
-                    // mask the token if not the same sequence
-                    if (!cells.seq_has(j, seq_id)) {
-                        continue;
-                    }
+                    const uint32_t j1 = std::min<uint32_t>(n_kv, j0 + llama_kv_cells::BLOCK_SIZE);
 
-                    const llama_pos p0 = cells.pos_get(j);
+                    for (uint32_t j = j0; j < j1; ++j) {
+                        if (cells.is_empty(j)) {
+                            continue;
+                        }
 
-                    // mask future tokens
-                    if (causal_attn && p0 > p1) {
-                        continue;
-                    }
+                        // mask the token if not the same sequence
+                        if (!cells.seq_has(j, seq_id)) {
+                            continue;
+                        }
 
-                    // apply SWA if any
-                    if (is_masked_swa(p0, p1)) {
-                        continue;
-                    }
+                        const llama_pos p0 = cells.pos_get(j);
 
-                    data[idst + j] = hparams.use_alibi ? -std::abs(p0 - p1) : 0.0f;
+                        // mask future tokens
+                        if (causal_attn && p0 > p1) {
+                            continue;
+                        }
+
+                        // apply SWA if any
+                        if (is_masked_swa(p0, p1)) {
+                            continue;
+                        }
+
+                        data[idst + j] = hparams.use_alibi ? -std::abs(p0 - p1) : 0.0f;
+                    }
                 }
             }
         }
@@ -3,6 +3,7 @@
 #include "llama.h"
 #include "llama-cparams.h"
 
+#include <algorithm>
 #include <bitset>
 #include <cassert>
 #include <vector>
@@ -10,9 +11,13 @@
 #include <map>
 
 // meta information about KV cells that can be part of multiple sequences at the same time
-// TODO: add unit tests
 class llama_kv_cells {
 public:
+    // the cells are grouped in fixed-size blocks
+    // for each sequence we keep track of how many of its cells are in each block, i.e. a block table
+    // this allows to visit only the parts of the cache that are relevant for a given sequence
+    static constexpr uint32_t BLOCK_SIZE = 64;
+
     void reset() {
         for (uint32_t i = 0; i < pos.size(); ++i) {
             pos[i]   = -1;
@@ -24,8 +29,12 @@ public:
 
         used.clear();
 
+        std::fill(blk_used.begin(), blk_used.end(), 0);
+
         for (uint32_t s = 0; s < LLAMA_MAX_SEQ; ++s) {
             seq_pos[s].clear();
+
+            std::fill(seq_blk[s].begin(), seq_blk[s].end(), 0);
         }
     }
 
@@ -46,9 +55,137 @@ public:
         shift.resize(n);
         seq.resize(n);
 
+        const uint32_t n_blk = (n + BLOCK_SIZE - 1)/BLOCK_SIZE;
+
+        blk_used.resize(n_blk);
+        for (uint32_t s = 0; s < LLAMA_MAX_SEQ; ++s) {
+            seq_blk[s].resize(n_blk);
+        }
+
+        fsb_taken.assign(n, false);
+        fsb_blk_taken.assign(n_blk, 0);
+        fsb_blk_owner.assign(n_blk, -1);
+
         reset();
     }
 
+    uint32_t n_blocks() const {
+        return blk_used.size();
+    }
+
+    // number of used cells in block b
+    uint32_t blk_get_used(uint32_t b) const {
+        assert(b < blk_used.size());
+
+        return blk_used[b];
+    }
+
+    // check if block b contains any cell of seq_id
+    bool blk_has_seq(uint32_t b, llama_seq_id seq_id) const {
+        assert(b < blk_used.size());
+        assert(seq_id >= 0);
+
+        return seq_blk[seq_id][b] > 0;
+    }
+
+    // place n_tokens new cells for the sequences seq_id[i][0], keeping the cells of each sequence grouped in blocks
+    // a new block for a sequence is picked in order of preference:
+    //   - a block that already contains cells of the sequence (or that was claimed by it during this call)
+    //   - an empty block
+    //   - any block with free cells
+    // the cells are not modified, idxs receives the selected cells
+    // return false if not all tokens could be placed
+    bool find_slot_blocks(uint32_t n_tokens, llama_seq_id * const * seq_id, std::vector<uint32_t> & idxs) const {
+        const uint32_t n_size = pos.size();
+        const uint32_t n_blk  = blk_used.size();
+
+        const auto blk_n_free = [&](uint32_t b) {
+            return std::min(BLOCK_SIZE, n_size - b*BLOCK_SIZE) - blk_used[b] - fsb_blk_taken[b];
+        };
+
+        // the scratch state is reset by visiting only the cells selected during this call
+        // the blocks claimed by a sequence always have at least one of these cells
+        const auto fsb_reset = [&]() {
+            for (const uint32_t idx : idxs) {
+                fsb_taken[idx] = false;
+                fsb_blk_taken[idx/BLOCK_SIZE] = 0;
+                fsb_blk_owner[idx/BLOCK_SIZE] = -1;
+            }
+            for (uint32_t i = 0; i < n_tokens; ++i) {
+                fsb_cur[seq_id[i][0]] = 0;
+                fsb_end[seq_id[i][0]] = 0;
+            }
+        };
+
+        idxs.clear();
+        idxs.reserve(n_tokens);
+
+        for (uint32_t i = 0; i < n_tokens; ++i) {
+            const llama_seq_id s = seq_id[i][0];
+
+            uint32_t & cur = fsb_cur[s];
+            uint32_t & end = fsb_end[s];
+
+            while (true) {
+                // continue with the block that is currently being filled by the sequence
+                while (cur < end && (fsb_taken[cur] || pos[cur] != -1)) {
+                    cur++;
+                }
+
+                if (cur < end) {
+                    break;
+                }
+
+                int32_t blk_seq   = -1;
+                int32_t blk_empty = -1;
+                int32_t blk_any   = -1;
+
+                for (uint32_t b = 0; b < n_blk; ++b) {
+                    if (blk_n_free(b) == 0) {
+                        continue;
+                    }
+
+                    if (seq_blk[s][b] > 0 || fsb_blk_owner[b] == s) {
+                        blk_seq = b;
+                        break;
+                    }
+
+                    if (blk_empty < 0 && blk_used[b] == 0 && fsb_blk_taken[b] == 0) {
+                        blk_empty = b;
+                    }
+
+                    if (blk_any < 0) {
+                        blk_any = b;
+                    }
+                }
+
+                const int32_t b = blk_seq >= 0 ? blk_seq : blk_empty >= 0 ? blk_empty : blk_any;
+                if (b < 0) {
+                    fsb_reset();
+                    return false;
+                }
+
+                if (b == blk_empty) {
+                    fsb_blk_owner[b] = s;
+                }
+
+                cur = b*BLOCK_SIZE;
+                end = std::min(n_size, cur + BLOCK_SIZE);
+            }
+
+            const uint32_t idx = cur++;
+
+            fsb_taken[idx] = true;
+            fsb_blk_taken[idx/BLOCK_SIZE]++;
+
+            idxs.push_back(idx);
+        }
+
+        fsb_reset();
+
+        return true;
+    }
+
     bool is_empty(uint32_t i) const {
         assert(i < pos.size());
         assert((pos[i] < 0 && pos[i] == -1) || pos[i] >= 0);
@@ -142,11 +279,11 @@ public:
             const auto idx = i + j;
 
             if (pos[idx] == -1 && other.pos[j] != -1) {
-                used.insert(i + j);
+                used_insert(i + j);
             }
 
             if (pos[idx] != -1 && other.pos[j] == -1) {
-                used.erase(i + j);
+                used_erase(i + j);
             }
 
             if (pos[idx] != -1) {
@@ -172,11 +309,11 @@ public:
             const auto idx = idxs[j];
 
             if (pos[idx] == -1 && other.pos[j] != -1) {
-                used.insert(idx);
+                used_insert(idx);
             }
 
             if (pos[idx] != -1 && other.pos[j] == -1) {
-                used.erase(idx);
+                used_erase(idx);
             }
 
             if (pos[idx] != -1) {
@@ -205,7 +342,7 @@ public:
         pos[i] = -1;
         shift[i] = 0;
 
-        used.erase(i);
+        used_erase(i);
     }
 
     // note: call only if the cell has seq_id
@@ -217,13 +354,13 @@ public:
         assert(seq_id >= 0);
 
         seq[i].reset(seq_id);
-        seq_pos_dec(seq_id, pos[i]);
+        seq_pos_dec(seq_id, i);
 
         if (seq[i].none()) {
             pos[i] = -1;
             shift[i] = 0;
 
-            used.erase(i);
+            used_erase(i);
 
             return true;
         }
@@ -240,7 +377,7 @@ public:
             seq[i].reset();
 
             seq[i].set(seq_id);
-            seq_pos_inc(seq_id, pos[i]);
+            seq_pos_inc(seq_id, i);
 
             return false;
         }
@@ -252,7 +389,7 @@ public:
             pos[i] = -1;
             shift[i] = 0;
 
-            used.erase(i);
+            used_erase(i);
 
             return true;
         }
@@ -285,7 +422,7 @@ public:
         assert(!seq[i].test(seq_id));
 
         seq[i].set(seq_id);
-        seq_pos_inc(seq_id, pos[i]);
+        seq_pos_inc(seq_id, i);
     }
 
     // return the sequence id of this cell
@@ -365,7 +502,7 @@ public:
 
         pos[i] = p;
 
-        used.insert(i);
+        used_insert(i);
     }
 
     // pos[i] = pos[i] + d
@@ -387,7 +524,7 @@ public:
             pos[i] = -1;
             shift[i] = 0;
 
-            used.erase(i);
+            used_erase(i);
 
             return true;
         }
@@ -456,26 +593,55 @@ private:
     //
     std::map<llama_pos, int> seq_pos[LLAMA_MAX_SEQ];
 
-    // helper functions for updating `seq_pos`, once cell at a time:
+    // the number of used cells in each block
+    std::vector<uint32_t> blk_used;
+
+    // seq_blk[s][b] is the number of cells in block b that belong to sequence s
+    std::vector<uint16_t> seq_blk[LLAMA_MAX_SEQ];
+
+    // scratch state of find_slot_blocks(), kept between the calls so that they do not allocate and clear O(size) buffers
+    mutable std::vector<bool>         fsb_taken;     // cells selected during the call
+    mutable std::vector<uint32_t>     fsb_blk_taken; // number of cells selected in each block
+    mutable std::vector<llama_seq_id> fsb_blk_owner; // empty blocks claimed by a sequence
 
-    void seq_pos_dec(llama_seq_id s, llama_pos p) {
-        auto it = seq_pos[s].find(p);
+    // for each sequence, the range of cells [cur, end) of the block that is currently being filled
+    mutable uint32_t fsb_cur[LLAMA_MAX_SEQ] = {};
+    mutable uint32_t fsb_end[LLAMA_MAX_SEQ] = {};
+
+    void used_insert(uint32_t i) {
+        used.insert(i);
+        blk_used[i/BLOCK_SIZE]++;
+    }
+
+    void used_erase(uint32_t i) {
+        used.erase(i);
+        blk_used[i/BLOCK_SIZE]--;
+    }
+
+    // helper functions for updating `seq_pos` and `seq_blk`, once cell at a time:
+
+    void seq_pos_dec(llama_seq_id s, uint32_t i) {
+        auto it = seq_pos[s].find(pos[i]);
         assert(it != seq_pos[s].end());
 
         if (--it->second == 0) {
             seq_pos[s].erase(it);
         }
+
+        assert(seq_blk[s][i/BLOCK_SIZE] > 0);
+        seq_blk[s][i/BLOCK_SIZE]--;
     }
 
-    void seq_pos_inc(llama_seq_id s, llama_pos p) {
-        seq_pos[s][p]++;
+    void seq_pos_inc(llama_seq_id s, uint32_t i) {
+        seq_pos[s][pos[i]]++;
+        seq_blk[s][i/BLOCK_SIZE]++;
     }
 
     // remove cell i
     void seq_pos_rm(uint32_t i) {
         for (int s = 0; s < LLAMA_MAX_SEQ; ++s) {
             if (seq[i].test(s)) {
-                seq_pos_dec(s, pos[i]);
+                seq_pos_dec(s, i);
             }
         }
     }
@@ -484,7 +650,7 @@ private:
     void seq_pos_add(uint32_t i) {
         for (int s = 0; s < LLAMA_MAX_SEQ; ++s) {
             if (seq[i].test(s)) {
-                seq_pos_inc(s, pos[i]);
+                seq_pos_inc(s, i);
             }
         }
     }
@@ -24,6 +24,7 @@ struct llama_file {
     void seek(size_t offset, int whence) const;
 
     void read_raw(void * ptr, size_t len) const;
+    void read_raw_at(void * ptr, size_t len, size_t offset) const; // positioned read, can be used from multiple threads
     uint32_t read_u32() const;
 
     void write_raw(const void * ptr, size_t len) const;
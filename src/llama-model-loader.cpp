@@ -3,9 +3,12 @@
 #include "ggml.h"
 
 #include <array>
+#include <atomic>
 #include <cinttypes>
 #include <cstring>
 #include <future>
+#include <mutex>
+#include <thread>
 
 static const size_t kiB = 1024;
 static const size_t MiB = 1024*kiB;
@@ -501,6 +504,8 @@ llama_model_loader::llama_model_loader(
     get_key(llm_kv(LLM_KV_GENERAL_ARCHITECTURE), arch_name, false);
     llm_kv = LLM_KV(llm_arch_from_string(arch_name));
 
+    this->fname = fname;
+
     files.emplace_back(new llama_file(fname.c_str(), "rb"));
     contexts.emplace_back(ctx);
 
@@ -916,6 +921,119 @@ void llama_model_loader::load_data_for(struct ggml_tensor * cur) const {
     }
 }
 
+// read the data of tensors in host buffers with several positioned reads in flight
+// the tensors are split in chunks that are handed out to the readers in file order, and the data of a tensor is
+// validated by the reader of its last chunk, so that the validation overlaps with the remaining reads
+// returns false if the load was cancelled by the progress callback
+static bool llama_load_tensors_parallel(
+        const std::vector<std::pair<ggml_tensor *, const llama_model_loader::llama_tensor_weight *>> & tensors,
+        const llama_files & files,
+        bool check_tensors,
+        size_t size_done,
+        size_t size_data,
+        llama_progress_callback progress_callback,
+        void * progress_callback_user_data) {
+    // 4 readers with 8MB requests are enough to saturate a single NVMe drive
+    constexpr size_t n_readers  = 4;
+    constexpr size_t chunk_size = 8*MiB;
+
+    struct chunk {
+        size_t i_tensor;
+        size_t offs; // offset in the tensor data
+        size_t size;
+    };
+
+    std::vector<chunk> chunks;
+    std::vector<std::atomic<size_t>> n_pending(tensors.size());
+
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        const size_t n_size = ggml_nbytes(tensors[i].first);
+        size_t n_chunks = 0;
+        for (size_t offs = 0; offs < n_size; offs += chunk_size) {
+            chunks.push_back({ i, offs, std::min(chunk_size, n_size - offs) });
+            n_chunks++;
+        }
+        n_pending[i].store(n_chunks);
+    }
+
+    std::vector<uint8_t> valid(tensors.size(), 1);
+
+    std::atomic<size_t> i_next    = 0;
+    std::atomic<size_t> n_read    = 0;
+    std::atomic<bool>   stop      = false;
+    std::atomic<bool>   cancelled = false;
+
+    std::mutex         error_mutex;
+    std::exception_ptr error;
+
+    auto worker = [&](bool report_progress) {
+        try {
+            while (!stop) {
+                const size_t i = i_next++;
+                if (i >= chunks.size()) {
+                    break;
+                }
+
+                const auto & c = chunks[i];
+
+                ggml_tensor * cur = tensors[c.i_tensor].first;
+                const auto  * w   = tensors[c.i_tensor].second;
+
+                files.at(w->idx)->read_raw_at((uint8_t *) cur->data + c.offs, c.size, w->offs + c.offs);
+
+                if (--n_pending[c.i_tensor] == 0 && check_tensors) {
+                    valid[c.i_tensor] = ggml_validate_row_data(cur->type, cur->data, ggml_nbytes(cur));
+                }
+
+                n_read += c.size;
+
+                if (report_progress && progress_callback) {
+                    if (!progress_callback((float) (size_done + n_read) / size_data, progress_callback_user_data)) {
+                        cancelled = true;
+                        stop      = true;
+                    }
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            stop = true;
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (size_t i = 1; i < std::min(n_readers, chunks.size()); ++i) {
+        readers.emplace_back(worker, false);
+    }
+    worker(true);
+    for (auto & reader : readers) {
+        reader.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    if (cancelled) {
+        return false;
+    }
+
+    bool validation_failed = false;
+    for (size_t i = 0; i < tensors.size(); ++i) {
+        if (!valid[i]) {
+            LLAMA_LOG_ERROR("%s: tensor '%s' has invalid data\n", __func__, ggml_get_name(tensors[i].first));
+            validation_failed = true;
+        }
+    }
+    if (validation_failed) {
+        throw std::runtime_error("found tensors with invalid data");
+    }
+
+    return true;
+}
+
 bool llama_model_loader::load_all_data(
         struct ggml_context * ctx,
         llama_buf_map & bufs,
@@ -927,6 +1045,10 @@ bool llama_model_loader::load_all_data(
     std::vector<no_init<uint8_t>> read_buf;
     std::vector<std::future<std::pair<ggml_tensor *, bool>>> validation_result;
 
+    // tensors in host buffers that are read in parallel after the other tensors
+    std::vector<std::pair<ggml_tensor *, const llama_tensor_weight *>> host_reads;
+    size_t host_reads_size = 0;
+
     // 4 staging buffers for async uploads, each sized 1MB seems to be a good default for single NVMe drives.
     // NVMe raid configurations might require more / larger buffers.
     constexpr size_t n_buffers = 4;
@@ -1062,13 +1184,9 @@ bool llama_model_loader::load_all_data(
         } else {
             const auto & file = files.at(weight->idx);
             if (ggml_backend_buffer_is_host(cur->buffer)) {
-                file->seek(weight->offs, SEEK_SET);
-                file->read_raw(cur->data, n_size);
-                if (check_tensors) {
-                    validation_result.emplace_back(std::async(std::launch::async, [cur, n_size] {
-                        return std::make_pair(cur, ggml_validate_row_data(cur->type, cur->data, n_size));
-                    }));
-                }
+                host_reads.emplace_back(cur, weight);
+                host_reads_size += n_size;
+                continue;
             } else {
                 // If upload_backend is valid load the tensor in chunks to pinned memory and upload the buffers asynchronously to the GPU.
                 if (upload_backend) {
@@ -1113,6 +1231,13 @@ bool llama_model_loader::load_all_data(
     }
     ggml_backend_free(upload_backend);
 
+    if (!host_reads.empty()) {
+        if (!llama_load_tensors_parallel(host_reads, files, check_tensors, size_done, size_data, progress_callback, progress_callback_user_data)) {
+            return false;
+        }
+        size_done += host_reads_size;
+    }
+
     // check validation results
     bool validation_failed = false;
     for (auto & future : validation_result) {
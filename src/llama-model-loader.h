@@ -72,6 +72,8 @@ struct llama_model_loader {
     bool use_mmap = false;
     bool check_tensors;
 
+    std::string fname; // path of the main model file
+
     llama_files files;
     llama_ftype ftype;
     llama_fver  fver;
@@ -12,15 +12,19 @@
 #include "llama-memory-recurrent.h"
 
 #include "ggml-cpp.h"
+#include "ggml-cpu.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cfloat>
+#include <cinttypes>
+#include <cstdio>
 #include <cstring>
 #include <cmath>
 #include <functional>
 #include <map>
+#include <random>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
@@ -396,6 +400,201 @@ static buft_list_t make_gpu_buft_list(ggml_backend_dev_t dev, llama_split_mode s
     return buft_list;
 }
 
+// cache of the weights in the CPU_REPACK buffer, stored in a GGUF file next to the model
+// the repacked layout depends on the build and on the CPU features, the file name is derived from both so that
+// different machines can share the model directory, and the source fingerprint invalidates the cache when the model changes
+
+static constexpr uint32_t LLAMA_REPACK_CACHE_VERSION = 1; // bump when the data written by the repack buffer changes
+
+static const char * LLAMA_REPACK_CACHE_KEY_CPU    = "repack.cpu";
+static const char * LLAMA_REPACK_CACHE_KEY_SOURCE = "repack.source";
+
+static constexpr uint64_t LLAMA_REPACK_CACHE_HASH_INIT = 0xcbf29ce484222325ULL;
+
+// FNV-1a
+static uint64_t llama_repack_cache_hash(uint64_t hash, const void * data, size_t size) {
+    const uint8_t * bytes = (const uint8_t *) data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool llama_repack_cache_is_buft(ggml_backend_buffer_type_t buft) {
+    return strcmp(ggml_backend_buft_name(buft), "CPU_REPACK") == 0;
+}
+
+static std::string llama_repack_cache_cpu_key() {
+    std::string key = format("v%u;ggml %s (%s)", LLAMA_REPACK_CACHE_VERSION, ggml_version(), ggml_commit());
+
+    auto * dev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    auto * reg = ggml_backend_dev_backend_reg(dev);
+    auto * get_features_fn = (ggml_backend_get_features_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_get_features");
+    if (get_features_fn) {
+        for (auto * feature = get_features_fn(reg); feature && feature->name; ++feature) {
+            key += format(";%s=%s", feature->name, feature->value);
+        }
+    }
+
+    return key;
+}
+
+// fingerprint of the source tensors: their metadata, the size of the files and samples of the data
+// hashing all of the data would take about as long as repacking it
+static std::string llama_repack_cache_source_key(const llama_model_loader & ml, ggml_context * ctx) {
+    constexpr size_t n_sample = 4096;
+
+    uint64_t hash = LLAMA_REPACK_CACHE_HASH_INIT;
+    for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+        const auto & w = ml.require_weight(ggml_get_name(t));
+
+        const size_t n_size    = ggml_nbytes(t);
+        const size_t file_size = ml.files.at(w.idx)->size();
+
+        hash = llama_repack_cache_hash(hash, t->name, strlen(t->name));
+        hash = llama_repack_cache_hash(hash, &t->type, sizeof(t->type));
+        hash = llama_repack_cache_hash(hash, t->ne, sizeof(t->ne));
+        hash = llama_repack_cache_hash(hash, &w.offs, sizeof(w.offs));
+        hash = llama_repack_cache_hash(hash, &file_size, sizeof(file_size));
+
+        const uint8_t * data = (const uint8_t *) ml.mappings.at(w.idx)->addr() + w.offs;
+        hash = llama_repack_cache_hash(hash, data, std::min(n_size, n_sample));
+        hash = llama_repack_cache_hash(hash, data + n_size - std::min(n_size, n_sample), std::min(n_size, n_sample));
+    }
+
+    return format("%016" PRIx64, hash);
+}
+
+// map the cache file and place the tensors of ctx in it, returns nullptr if the file is missing or stale
+static ggml_backend_buffer_t llama_repack_cache_load(
+        const std::string & path, const std::string & cpu_key, const std::string & source_key,
+        ggml_context * ctx, std::unique_ptr<llama_mmap> & mapping) {
+    auto * dev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    auto * reg = ggml_backend_dev_backend_reg(dev);
+    auto * buffer_from_ptr_fn = (decltype(ggml_backend_cpu_repack_buffer_from_ptr) *)
+        ggml_backend_reg_get_proc_address(reg, "ggml_backend_cpu_repack_buffer_from_ptr");
+    if (!buffer_from_ptr_fn) {
+        return nullptr;
+    }
+
+    std::unique_ptr<llama_file> file;
+    try {
+        file = std::make_unique<llama_file>(path.c_str(), "rb");
+    } catch (const std::exception &) {
+        return nullptr;
+    }
+
+    gguf_init_params params = {
+        /*.no_alloc = */ true,
+        /*.ctx      = */ nullptr,
+    };
+    gguf_context_ptr meta(gguf_init_from_file(path.c_str(), params));
+    if (!meta) {
+        return nullptr;
+    }
+
+    auto get_str = [&](const char * key) -> std::string {
+        const int64_t kid = gguf_find_key(meta.get(), key);
+        if (kid < 0 || gguf_get_kv_type(meta.get(), kid) != GGUF_TYPE_STRING) {
+            return "";
+        }
+        return gguf_get_val_str(meta.get(), kid);
+    };
+
+    if (get_str(LLAMA_REPACK_CACHE_KEY_CPU) != cpu_key || get_str(LLAMA_REPACK_CACHE_KEY_SOURCE) != source_key) {
+        LLAMA_LOG_INFO("%s: repack cache '%s' is stale, it will be rewritten\n", __func__, path.c_str());
+        return nullptr;
+    }
+
+    const size_t data_offset = gguf_get_data_offset(meta.get());
+
+    std::vector<size_t> offsets;
+    for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+        const int64_t tid = gguf_find_tensor(meta.get(), ggml_get_name(t));
+        if (tid < 0 || gguf_get_tensor_type(meta.get(), tid) != t->type || gguf_get_tensor_size(meta.get(), tid) != ggml_nbytes(t) ||
+                data_offset + gguf_get_tensor_offset(meta.get(), tid) + ggml_nbytes(t) > file->size()) {
+            LLAMA_LOG_INFO("%s: repack cache '%s' does not match the tensors of the model, it will be rewritten\n", __func__, path.c_str());
+            return nullptr;
+        }
+        offsets.push_back(gguf_get_tensor_offset(meta.get(), tid));
+    }
+
+    mapping = std::make_unique<llama_mmap>(file.get());
+
+    uint8_t * base = (uint8_t *) mapping->addr() + data_offset;
+    ggml_backend_buffer_t buf = buffer_from_ptr_fn(base, mapping->size() - data_offset);
+    if (buf == nullptr) {
+        mapping.reset();
+        return nullptr;
+    }
+
+    size_t i = 0;
+    for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+        if (ggml_backend_tensor_alloc(buf, t, base + offsets[i++]) != GGML_STATUS_SUCCESS) {
+            throw std::runtime_error(format("%s: failed to map tensor '%s' from '%s'", __func__, ggml_get_name(t), path.c_str()));
+        }
+    }
+
+    return buf;
+}
+
+// write the repacked data of the tensors in ctx, the file is renamed into place once complete
+// so that other processes never map a partial file
+// the temporary file has a random name and is created exclusively, so that concurrent loads of the same model
+// never write to or remove the temporary file of each other
+static void llama_repack_cache_save(
+        const std::string & path, const std::string & cpu_key, const std::string & source_key, ggml_context * ctx) {
+    std::random_device rd;
+    const std::string path_tmp = format("%s.tmp-%08x%08x", path.c_str(), rd(), rd());
+
+    bool created = false;
+
+    try {
+        gguf_context_ptr out(gguf_init_empty());
+        gguf_set_val_str(out.get(), LLAMA_REPACK_CACHE_KEY_CPU,    cpu_key.c_str());
+        gguf_set_val_str(out.get(), LLAMA_REPACK_CACHE_KEY_SOURCE, source_key.c_str());
+        for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+            gguf_add_tensor(out.get(), t);
+        }
+
+        std::vector<uint8_t> meta(gguf_get_meta_size(out.get()));
+        gguf_get_meta_data(out.get(), meta.data());
+
+        const size_t alignment = gguf_get_alignment(out.get());
+        const std::vector<uint8_t> zeros(alignment, 0);
+
+        llama_file file(path_tmp.c_str(), "wbx");
+        created = true;
+
+        file.write_raw(meta.data(), meta.size());
+        for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+            // the CPU_REPACK buffer is in host memory, the data is written in the repacked layout
+            const size_t n_size = ggml_nbytes(t);
+            file.write_raw(t->data, n_size);
+            file.write_raw(zeros.data(), GGML_PAD(n_size, alignment) - n_size);
+        }
+    } catch (const std::exception & err) {
+        LLAMA_LOG_WARN("%s: failed to write repack cache '%s': %s\n", __func__, path.c_str(), err.what());
+        if (created) {
+            std::remove(path_tmp.c_str());
+        }
+        return;
+    }
+
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    std::remove(path.c_str());
+#endif
+    if (std::rename(path_tmp.c_str(), path.c_str()) != 0) {
+        LLAMA_LOG_WARN("%s: failed to write repack cache '%s'\n", __func__, path.c_str());
+        std::remove(path_tmp.c_str());
+        return;
+    }
+
+    LLAMA_LOG_INFO("%s: wrote repack cache '%s'\n", __func__, path.c_str());
+}
+
 struct llama_model::impl {
     impl() {}
     ~impl() {}
@@ -5616,6 +5815,15 @@ bool llama_model::load_tensors(llama_model_loader & ml) {
     const size_t n_max_backend_buffer = ctx_map.size() * ml.files.size();
     pimpl->bufs.reserve(n_max_backend_buffer);
 
+    // repacked weights that are not in the cache yet, written after loading
+    struct repack_cache {
+        ggml_context * ctx;
+        std::string    path;
+        std::string    cpu_key;
+        std::string    source_key;
+    };
+    std::vector<repack_cache> repack_caches;
+
     for (auto & it : ctx_map) {
         ggml_backend_buffer_type_t buft = it.first;
         ggml_context * ctx              = it.second;
@@ -5642,6 +5850,39 @@ bool llama_model::load_tensors(llama_model_loader & ml) {
         bool buffer_from_host_ptr_supported = props.caps.buffer_from_host_ptr;
         bool is_default_buft = buft == ggml_backend_dev_buffer_type(dev);
 
+        // repacked weights can be mapped from the cache file written by an earlier load
+        if (params.use_repack_cache && ml.use_mmap && llama_repack_cache_is_buft(buft)) {
+            const std::string cpu_key = llama_repack_cache_cpu_key();
+            const std::string path    = format("%s.repack-%016" PRIx64 ".gguf", ml.fname.c_str(),
+                    llama_repack_cache_hash(LLAMA_REPACK_CACHE_HASH_INIT, cpu_key.data(), cpu_key.size()));
+
+            repack_cache cache = { ctx, path, cpu_key, llama_repack_cache_source_key(ml, ctx) };
+
+            std::unique_ptr<llama_mmap> mapping;
+            ggml_backend_buffer_t buf = llama_repack_cache_load(cache.path, cache.cpu_key, cache.source_key, ctx, mapping);
+            if (buf != nullptr) {
+                LLAMA_LOG_INFO("%s: mapped repacked tensors from '%s'\n", __func__, cache.path.c_str());
+
+                ggml_backend_buffer_set_usage(buf, GGML_BACKEND_BUFFER_USAGE_WEIGHTS);
+                pimpl->bufs.emplace_back(buf);
+                if (use_mlock) {
+                    pimpl->mlock_bufs.emplace_back(new llama_mlock);
+                    auto & mlock_buf = pimpl->mlock_bufs.back();
+                    mlock_buf->init   (mapping->addr());
+                    mlock_buf->grow_to(mapping->size());
+                }
+                pimpl->mappings.emplace_back(std::move(mapping));
+
+                // the tensors are not read from the model files
+                for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != nullptr; t = ggml_get_next_tensor(ctx, t)) {
+                    ml.size_done += ggml_nbytes(t);
+                }
+                continue;
+            }
+
+            repack_caches.push_back(std::move(cache));
+        }
+
         if (ml.use_mmap && use_mmap_buffer && buffer_from_host_ptr_supported && is_default_buft) {
             for (uint32_t idx = 0; idx < ml.files.size(); idx++) {
                 // only the mmap region containing the tensors in the model is mapped to the backend buffer
@@ -5719,6 +5960,8 @@ bool llama_model::load_tensors(llama_model_loader & ml) {
     }
 
     // load tensor data
+    const int64_t t_load_start_us = ggml_time_us();
+
     for (auto & it : ctx_bufs) {
         ggml_context * ctx = it.first;
         auto & bufs = it.second;
@@ -5727,6 +5970,17 @@ bool llama_model::load_tensors(llama_model_loader & ml) {
         }
     }
 
+    {
+        const double t_load = (ggml_time_us() - t_load_start_us) / 1e6;
+        LLAMA_LOG_INFO("%s: loaded %.2f MiB of tensor data in %.2f s (%.2f MiB/s, %s)\n", __func__,
+                ml.size_data / 1024.0 / 1024.0, t_load, t_load > 0.0 ? ml.size_data / 1024.0 / 1024.0 / t_load : 0.0,
+                ml.use_mmap ? "mmap" : "read");
+    }
+
+    for (const auto & cache : repack_caches) {
+        llama_repack_cache_save(cache.path, cache.cpu_key, cache.source_key, cache.ctx);
+    }
+
     if (use_mmap_buffer) {
         for (auto & mapping : ml.mappings) {
             pimpl->mappings.emplace_back(std::move(mapping));
@@ -6043,7 +6297,7 @@ struct llm_build_llama : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -6105,7 +6359,7 @@ struct llm_build_llama : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -6203,7 +6457,7 @@ struct llm_build_llama_iswa : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             const bool use_rope = (il + 1) % hparams.n_no_rope_layer_step != 0;
@@ -6279,7 +6533,7 @@ struct llm_build_llama_iswa : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -6382,7 +6636,7 @@ struct llm_build_deci : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
             const int64_t n_head_kv = hparams.n_head_kv(il);
             const int64_t n_head    = hparams.n_head(il);
@@ -6455,7 +6709,7 @@ struct llm_build_deci : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, kq_scale, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -6536,7 +6790,7 @@ struct llm_build_baichuan : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -6587,7 +6841,7 @@ struct llm_build_baichuan : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -6658,7 +6912,7 @@ struct llm_build_xverse : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -6702,7 +6956,7 @@ struct llm_build_xverse : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -6772,7 +7026,7 @@ struct llm_build_falcon : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * attn_norm;
 
             attn_norm = build_norm(inpL,
@@ -6825,7 +7079,7 @@ struct llm_build_falcon : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur       = ggml_get_rows(ctx0,       cur, inp_out_ids);
                 inpL      = ggml_get_rows(ctx0,      inpL, inp_out_ids);
                 attn_norm = ggml_get_rows(ctx0, attn_norm, inp_out_ids);
@@ -6896,7 +7150,7 @@ struct llm_build_grok : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -6955,7 +7209,7 @@ struct llm_build_grok : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -7056,7 +7310,7 @@ struct llm_build_dbrx : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -7104,7 +7358,7 @@ struct llm_build_dbrx : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -7186,7 +7440,7 @@ struct llm_build_starcoder : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -7218,7 +7472,7 @@ struct llm_build_starcoder : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -7285,7 +7539,7 @@ struct llm_build_refact : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -7317,7 +7571,7 @@ struct llm_build_refact : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -7405,7 +7659,7 @@ struct llm_build_bert : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * cur = inpL;
 
             {
@@ -7481,7 +7735,7 @@ struct llm_build_bert : public llm_graph_context {
                 cb(cur, "kqv_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -7580,7 +7834,7 @@ struct llm_build_neo_bert : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * cur = inpL;
 
             // pre-norm
@@ -7626,7 +7880,7 @@ struct llm_build_neo_bert : public llm_graph_context {
                 cb(cur, "kqv_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -7693,7 +7947,7 @@ struct llm_build_bloom : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -7725,7 +7979,7 @@ struct llm_build_bloom : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -7804,7 +8058,7 @@ struct llm_build_mpt : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * attn_norm;
 
             attn_norm = build_norm(inpL,
@@ -7873,7 +8127,7 @@ struct llm_build_mpt : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -7944,7 +8198,7 @@ struct llm_build_stablelm : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // norm
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
@@ -8019,7 +8273,7 @@ struct llm_build_stablelm : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpL  = ggml_get_rows(ctx0,  inpL, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
@@ -8096,7 +8350,7 @@ struct llm_build_qwen : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -8140,7 +8394,7 @@ struct llm_build_qwen : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8211,7 +8465,7 @@ struct llm_build_qwen2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8260,7 +8514,7 @@ struct llm_build_qwen2 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8335,7 +8589,7 @@ struct llm_build_dream : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8376,7 +8630,7 @@ struct llm_build_dream : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f / sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0, cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8440,7 +8694,7 @@ struct llm_build_llada : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8477,7 +8731,7 @@ struct llm_build_llada : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f / sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0, cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8541,7 +8795,7 @@ struct llm_build_qwen2vl : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8590,7 +8844,7 @@ struct llm_build_qwen2vl : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8659,7 +8913,7 @@ struct llm_build_qwen2moe : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8717,7 +8971,7 @@ struct llm_build_qwen2moe : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8818,7 +9072,7 @@ struct llm_build_qwen3 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8870,7 +9124,7 @@ struct llm_build_qwen3 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -8939,7 +9193,7 @@ struct llm_build_qwen3moe : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -8991,7 +9245,7 @@ struct llm_build_qwen3moe : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -9069,7 +9323,7 @@ struct llm_build_phi2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             attn_norm_output = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -9131,7 +9385,7 @@ struct llm_build_phi2 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur              = ggml_get_rows(ctx0,              cur, inp_out_ids);
                 inpL             = ggml_get_rows(ctx0,             inpL, inp_out_ids);
                 attn_norm_output = ggml_get_rows(ctx0, attn_norm_output, inp_out_ids);
@@ -9205,7 +9459,7 @@ struct llm_build_phi3 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             auto * residual = inpL;
 
             // self-attention
@@ -9268,7 +9522,7 @@ struct llm_build_phi3 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur      = ggml_get_rows(ctx0, cur,      inp_out_ids);
                 residual = ggml_get_rows(ctx0, residual, inp_out_ids);
             }
@@ -9356,7 +9610,7 @@ struct llm_build_plamo : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // norm
             cur = build_norm(inpL,
                     model.layers[il].attn_norm, NULL,
@@ -9402,7 +9656,7 @@ struct llm_build_plamo : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur    = ggml_get_rows(ctx0,    cur, inp_out_ids);
                 sa_inp = ggml_get_rows(ctx0, sa_inp, inp_out_ids);
                 inpL   = ggml_get_rows(ctx0,   inpL, inp_out_ids);
@@ -9478,7 +9732,7 @@ struct llm_build_gpt2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -9510,7 +9764,7 @@ struct llm_build_gpt2 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -9582,7 +9836,7 @@ struct llm_build_codeshell : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -9624,7 +9878,7 @@ struct llm_build_codeshell : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -9695,7 +9949,7 @@ struct llm_build_orion : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -9753,7 +10007,7 @@ struct llm_build_orion : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -9822,7 +10076,7 @@ struct llm_build_internlm2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -9880,7 +10134,7 @@ struct llm_build_internlm2 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -9958,7 +10212,7 @@ struct llm_build_minicpm3 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             ggml_tensor * rope_factors = model.get_rope_factors(cparams, il);
@@ -10068,7 +10322,7 @@ struct llm_build_minicpm3 : public llm_graph_context {
                         q_states, k_states, v_states, nullptr, nullptr, nullptr, kq_scale, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -10153,7 +10407,7 @@ struct llm_build_gemma : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // norm
             cur = build_norm(inpL,
                     model.layers[il].attn_norm, NULL,
@@ -10198,7 +10452,7 @@ struct llm_build_gemma : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -10269,7 +10523,7 @@ struct llm_build_gemma2_iswa : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // norm
             cur = build_norm(inpL,
                     model.layers[il].attn_norm, NULL,
@@ -10313,7 +10567,7 @@ struct llm_build_gemma2_iswa : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -10403,7 +10657,7 @@ struct llm_build_gemma3_iswa : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const float freq_base_l  = model.get_rope_freq_base (cparams, il);
             const float freq_scale_l = model.get_rope_freq_scale(cparams, il);
 
@@ -10455,7 +10709,7 @@ struct llm_build_gemma3_iswa : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -10572,7 +10826,7 @@ struct llm_build_gemma3n_iswa : public llm_graph_context {
         // inpL now has shape:          [n_embd,       n_tokens, n_altup]
         // inp_per_layer now has shape: [n_embd_altup, n_tokens, n_layer]
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // this block is made to be closely resemble Gemma3p5DecoderLayer on python code
             const bool has_kv = (il < n_layer_kv);
 
@@ -10961,7 +11215,7 @@ struct llm_build_starcoder2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -11019,7 +11273,7 @@ struct llm_build_starcoder2 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -11356,7 +11610,7 @@ struct llm_build_mamba : public llm_graph_context_mamba {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // norm
             cur = build_norm(inpL,
                     model.layers[il].attn_norm, NULL,
@@ -11369,7 +11623,7 @@ struct llm_build_mamba : public llm_graph_context_mamba {
                 cur = build_mamba_layer(rs_inp, cur, model, ubatch, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -11415,7 +11669,7 @@ struct llm_build_jamba : public llm_graph_context_mamba {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const int64_t n_head_kv = hparams.n_head_kv(il);
 
             cur = build_norm(inpL, model.layers[il].attn_norm, NULL, LLM_NORM_RMS, il);
@@ -11448,7 +11702,7 @@ struct llm_build_jamba : public llm_graph_context_mamba {
                         Qcur, Kcur, Vcur, NULL, NULL, NULL, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -11532,7 +11786,7 @@ struct llm_build_command_r : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             // norm
             cur = build_norm(inpL,
                     model.layers[il].attn_norm, NULL,
@@ -11606,7 +11860,7 @@ struct llm_build_command_r : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur     = ggml_get_rows(ctx0,     cur, inp_out_ids);
                 inpL    = ggml_get_rows(ctx0,    inpL, inp_out_ids);
                 ffn_inp = ggml_get_rows(ctx0, ffn_inp, inp_out_ids);
@@ -11679,7 +11933,7 @@ struct llm_build_cohere2_iswa : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const bool is_swa = hparams.is_swa(il);
 
             // norm
@@ -11741,7 +11995,7 @@ struct llm_build_cohere2_iswa : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur     = ggml_get_rows(ctx0, cur, inp_out_ids);
                 inpL    = ggml_get_rows(ctx0, inpL, inp_out_ids);
                 ffn_inp = ggml_get_rows(ctx0, ffn_inp, inp_out_ids);
@@ -11814,7 +12068,7 @@ struct llm_build_olmo : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -11872,7 +12126,7 @@ struct llm_build_olmo : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -11942,7 +12196,7 @@ struct llm_build_olmo2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = inpL;
@@ -11992,7 +12246,7 @@ struct llm_build_olmo2 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -12071,7 +12325,7 @@ struct llm_build_olmoe : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -12125,7 +12379,7 @@ struct llm_build_olmoe : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -12197,7 +12451,7 @@ struct llm_build_openelm : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const int64_t n_head    = hparams.n_head(il);
             const int64_t n_head_kv = hparams.n_head_kv(il);
             const int64_t n_head_qkv = 2*n_head_kv + n_head;
@@ -12258,7 +12512,7 @@ struct llm_build_openelm : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 residual = ggml_get_rows(ctx0, residual, inp_out_ids);
                 cur      = ggml_get_rows(ctx0, cur,      inp_out_ids);
             }
@@ -12328,7 +12582,7 @@ struct llm_build_gptneox : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -12370,7 +12624,7 @@ struct llm_build_gptneox : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -12474,7 +12728,7 @@ struct llm_build_arctic : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -12520,7 +12774,7 @@ struct llm_build_arctic : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -12614,7 +12868,7 @@ struct llm_build_deepseek : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -12675,7 +12929,7 @@ struct llm_build_deepseek : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, kq_scale, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -12789,7 +13043,7 @@ struct llm_build_deepseek2 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -12938,7 +13192,7 @@ struct llm_build_deepseek2 : public llm_graph_context {
                 }
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -13036,7 +13290,7 @@ struct llm_build_bitnet : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -13118,7 +13372,7 @@ struct llm_build_bitnet : public llm_graph_context {
                 cb(cur, "attn_o_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -13195,7 +13449,7 @@ struct llm_build_t5_enc : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -13228,7 +13482,7 @@ struct llm_build_t5_enc : public llm_graph_context {
                 cb(cur, "kqv_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -13301,7 +13555,7 @@ struct llm_build_t5_dec : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -13392,7 +13646,7 @@ struct llm_build_t5_dec : public llm_graph_context {
                 //cb(cur, "kqv_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpCA = ggml_get_rows(ctx0, inpCA, inp_out_ids);
             }
@@ -13465,7 +13719,7 @@ struct llm_build_jais : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             cur = build_norm(inpL,
                     model.layers[il].attn_norm,
                     model.layers[il].attn_norm_b,
@@ -13497,7 +13751,7 @@ struct llm_build_jais : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/float(n_embd_head), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 inpL = ggml_get_rows(ctx0, inpL, inp_out_ids);
             }
@@ -13563,7 +13817,7 @@ struct llm_build_chatglm : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -13629,7 +13883,7 @@ struct llm_build_chatglm : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -13696,7 +13950,7 @@ struct llm_build_glm4 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // Pre-attention norm
@@ -13762,7 +14016,7 @@ struct llm_build_glm4 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -13848,7 +14102,7 @@ struct llm_build_glm4_moe : public llm_graph_context {
 
         // Only process up to last layer (skip final NextN layer)
         // Final layer tensors are loaded but not processed in forward pass
-        const int n_transformer_layers = n_layer - hparams.nextn_predict_layers;
+        const int n_transformer_layers = std::min<int64_t>(n_layer_eval, n_layer - hparams.nextn_predict_layers);
         for (int il = 0; il < n_transformer_layers; ++il) {
             ggml_tensor * inpSA = inpL;
 
@@ -14006,7 +14260,7 @@ struct llm_build_nemotron : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -14065,7 +14319,7 @@ struct llm_build_nemotron : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -14135,7 +14389,7 @@ struct llm_build_exaone : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -14196,7 +14450,7 @@ struct llm_build_exaone : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -14274,7 +14528,7 @@ struct llm_build_exaone4 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // use RoPE for SWA layers or non-SWA models
@@ -14328,7 +14582,7 @@ struct llm_build_exaone4 : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -14609,7 +14863,7 @@ struct llm_build_rwkv6 : public llm_build_rwkv6_base {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const llama_layer * layer = &model.layers[il];
             inpL = ggml_reshape_3d(ctx0, inpL, n_embd, n_seq_tokens, n_seqs);
 
@@ -14655,7 +14909,7 @@ struct llm_build_rwkv6 : public llm_build_rwkv6_base {
             x_prev   = ggml_reshape_2d(ctx0, x_prev,   n_embd, n_tokens);
             cur      = ggml_reshape_2d(ctx0, cur,      n_embd, n_tokens);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 ffn_inp  = ggml_get_rows(ctx0, ffn_inp,  inp_out_ids);
                 ffn_norm = ggml_get_rows(ctx0, ffn_norm, inp_out_ids);
                 x_prev   = ggml_get_rows(ctx0, x_prev,   inp_out_ids);
@@ -14709,7 +14963,7 @@ struct llm_build_rwkv6qwen2 : public llm_build_rwkv6_base {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const llama_layer * layer = &model.layers[il];
             inpL = ggml_reshape_3d(ctx0, inpL, n_embd, n_seq_tokens, n_seqs);
 
@@ -14736,7 +14990,7 @@ struct llm_build_rwkv6qwen2 : public llm_build_rwkv6_base {
             cur     = ggml_reshape_2d(ctx0, cur,     n_embd, n_tokens);
             ffn_inp = ggml_reshape_2d(ctx0, ffn_inp, n_embd, n_tokens);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur     = ggml_get_rows(ctx0, cur,     inp_out_ids);
                 ffn_inp = ggml_get_rows(ctx0, ffn_inp, inp_out_ids);
             }
@@ -14965,7 +15219,7 @@ struct llm_build_rwkv7 : public llm_build_rwkv7_base {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const llama_layer * layer = &model.layers[il];
             inpL = ggml_reshape_3d(ctx0, inpL, n_embd, n_seq_tokens, n_seqs);
 
@@ -15010,7 +15264,7 @@ struct llm_build_rwkv7 : public llm_build_rwkv7_base {
             ffn_norm = ggml_reshape_2d(ctx0, ffn_norm, n_embd, n_tokens);
             x_prev   = ggml_reshape_2d(ctx0, x_prev,   n_embd, n_tokens);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 ffn_inp  = ggml_get_rows(ctx0, ffn_inp,  inp_out_ids);
                 ffn_norm = ggml_get_rows(ctx0, ffn_norm, inp_out_ids);
                 x_prev   = ggml_get_rows(ctx0, x_prev,   inp_out_ids);
@@ -15060,7 +15314,7 @@ struct llm_build_arwkv7 : public llm_build_rwkv7_base {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             const llama_layer * layer = &model.layers[il];
             inpL = ggml_reshape_3d(ctx0, inpL, n_embd, n_seq_tokens, n_seqs);
 
@@ -15087,7 +15341,7 @@ struct llm_build_arwkv7 : public llm_build_rwkv7_base {
             cur     = ggml_reshape_2d(ctx0, cur,     n_embd, n_tokens);
             ffn_inp = ggml_reshape_2d(ctx0, ffn_inp, n_embd, n_tokens);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur     = ggml_get_rows(ctx0, cur,     inp_out_ids);
                 ffn_inp = ggml_get_rows(ctx0, ffn_inp, inp_out_ids);
             }
@@ -15156,7 +15410,7 @@ struct llm_build_granite : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -15170,7 +15424,7 @@ struct llm_build_granite : public llm_graph_context {
                 cur, inp_pos, inp_attn,
                 model, n_embd_head, il);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -15368,7 +15622,7 @@ struct llm_build_granite_hybrid : public llm_graph_context_mamba {
             inp_pos = build_inp_pos();
         }
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             struct ggml_tensor * inpSA = inpL;
 
             // norm
@@ -15387,7 +15641,7 @@ struct llm_build_granite_hybrid : public llm_graph_context_mamba {
                     n_embd_head, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -15588,7 +15842,7 @@ struct llm_build_chameleon : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -15666,7 +15920,7 @@ struct llm_build_chameleon : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -15919,7 +16173,7 @@ struct llm_build_plm : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -16022,7 +16276,7 @@ struct llm_build_plm : public llm_graph_context {
                         q_states, k_states, v_states, nullptr, nullptr, nullptr, kq_scale, il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -16084,7 +16338,7 @@ struct llm_build_bailingmoe : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -16145,7 +16399,7 @@ struct llm_build_bailingmoe : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_rot)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -16233,7 +16487,7 @@ struct llm_build_dots1 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -16285,7 +16539,7 @@ struct llm_build_dots1 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -16381,7 +16635,7 @@ struct llm_build_ernie4_5 : public llm_graph_context {
 
         auto * inp_attn = build_attn_inp_kv();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -16440,7 +16694,7 @@ struct llm_build_ernie4_5 : public llm_graph_context {
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f/sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1) {
+            if (il == n_layer_eval - 1) {
                 // skip computing output for unused tokens
                 ggml_tensor * inp_out_ids = build_inp_out_ids();
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
@@ -16514,7 +16768,7 @@ struct llm_build_ernie4_5_moe : public llm_graph_context {
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
         GGML_ASSERT(hparams.n_moe_layer_step > 0 && "Ernie 4.5 MoE requires n_moe_layer_step > 0");
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
             // norm
             {
@@ -16574,7 +16828,7 @@ struct llm_build_ernie4_5_moe : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -16683,7 +16937,7 @@ struct llm_build_falcon_h1 : public llm_graph_context_mamba {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             cur = build_norm(inpL,
@@ -16740,7 +16994,7 @@ struct llm_build_falcon_h1 : public llm_graph_context_mamba {
             inpSA = ggml_add(ctx0, cur, inpSA);
             cb(cur, "layer_out", il);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -16805,7 +17059,7 @@ struct llm_build_plamo2 : public llm_graph_context_mamba {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * residual = inpL;
 
             // ggml_graph_add_node(gf, model.layers[il].attn_norm);
@@ -16851,7 +17105,7 @@ struct llm_build_plamo2 : public llm_graph_context_mamba {
             cur = build_norm(cur, model.layers[il].ffn_post_norm, NULL, LLM_NORM_RMS, il);
             cb(cur, "ffn_post_norm", il);
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur  = ggml_get_rows(ctx0,  cur, inp_out_ids);
                 residual = ggml_get_rows(ctx0, residual, inp_out_ids);
             }
@@ -17124,7 +17378,7 @@ struct llm_build_arcee : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -17186,7 +17440,7 @@ struct llm_build_arcee : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -17259,7 +17513,7 @@ struct llm_build_hunyuan_moe : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -17331,7 +17585,7 @@ struct llm_build_hunyuan_moe : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -17420,7 +17674,7 @@ struct llm_build_hunyuan_dense : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -17491,7 +17745,7 @@ struct llm_build_hunyuan_dense : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -17558,7 +17812,7 @@ struct llm_build_smollm3 : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             const bool use_rope = (il + 1) % hparams.n_no_rope_layer_step != 0;
@@ -17621,7 +17875,7 @@ struct llm_build_smollm3 : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -17686,7 +17940,7 @@ struct llm_build_openai_moe_iswa : public llm_graph_context {
 
         auto * inp_attn = build_attn_inp_kv_iswa();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -17746,7 +18000,7 @@ struct llm_build_openai_moe_iswa : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1) {
+            if (il == n_layer_eval - 1) {
                 // skip computing output for unused tokens
                 ggml_tensor * inp_out_ids = build_inp_out_ids();
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
@@ -17816,7 +18070,7 @@ struct llm_build_lfm2 : public llm_graph_context {
         auto        * inp_hybrid  = build_inp_mem_hybrid();
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             auto * prev_cur = cur;
             cur = build_norm(cur, model.layers[il].attn_norm, NULL, LLM_NORM_RMS, il);
             cb(cur, "model.layers.{}.operator_norm", il);
@@ -17825,7 +18079,7 @@ struct llm_build_lfm2 : public llm_graph_context {
                 build_shortconv_block(cur, inp_hybrid->get_recr(), il) :
                 build_attn_block(cur, inp_pos, inp_hybrid->get_attn(), il) ;
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur      = ggml_get_rows(ctx0,      cur, inp_out_ids);
                 prev_cur = ggml_get_rows(ctx0, prev_cur, inp_out_ids);
             }
@@ -18001,7 +18255,7 @@ struct llm_build_seed_oss : public llm_graph_context {
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA = inpL;
 
             // norm
@@ -18060,7 +18314,7 @@ struct llm_build_seed_oss : public llm_graph_context {
                 cb(cur, "attn_out", il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur   = ggml_get_rows(ctx0,   cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
             }
@@ -18138,7 +18392,7 @@ struct llm_build_smallthinker : public llm_graph_context{
 
         ggml_tensor * inp_out_ids = build_inp_out_ids();
 
-        for (int il = 0; il < n_layer; ++il) {
+        for (int il = 0; il < n_layer_eval; ++il) {
             ggml_tensor * inpSA  = inpL;
             ggml_tensor * probs  = nullptr;
 
@@ -18181,7 +18435,7 @@ struct llm_build_smallthinker : public llm_graph_context{
                         Qcur, Kcur, Vcur, nullptr, nullptr, nullptr, 1.0f / sqrtf(float(n_embd_head)), il);
             }
 
-            if (il == n_layer - 1 && inp_out_ids) {
+            if (il == n_layer_eval - 1 && inp_out_ids) {
                 cur = ggml_get_rows(ctx0, cur, inp_out_ids);
                 inpSA = ggml_get_rows(ctx0, inpSA, inp_out_ids);
                 probs = ggml_get_rows(ctx0, probs, inp_out_ids);
@@ -18708,6 +18962,9 @@ ggml_cgraph * llama_model::build_graph(const llm_graph_params & params) const {
     // add on pooling layer
     llm->build_pooling(cls, cls_b, cls_out, cls_out_b);
 
+    // add on in-graph sampling
+    llm->build_sampling();
+
     return llm->res->get_gf();
 }
 
@@ -18732,6 +18989,7 @@ llama_model_params llama_model_default_params() {
         /*.use_mlock                   =*/ false,
         /*.check_tensors               =*/ false,
         /*.use_extra_bufts             =*/ true,
+        /*.use_repack_cache            =*/ false,
     };
 
 #ifdef GGML_USE_METAL
@@ -19017,6 +19275,10 @@ bool llama_model_is_recurrent(const llama_model * model) {
     return llm_arch_is_recurrent(model->arch);
 }
 
+bool llama_model_is_hybrid(const llama_model * model) {
+    return llm_arch_is_hybrid(model->arch);
+}
+
 bool llama_model_is_diffusion(const llama_model * model) {
     return llm_arch_is_diffusion(model->arch);
 }
@@ -1,6 +1,7 @@
 #include "llama-sampling.h"
 
 #include "llama-impl.h"
+#include "llama-context.h"
 #include "llama-vocab.h"
 #include "llama-grammar.h"
 
@@ -12,6 +13,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <memory>
 #include <numeric>
 #include <random>
 #include <unordered_map>
@@ -302,6 +304,111 @@ static void llama_sampler_top_k_impl(llama_token_data_array * cur_p, int32_t k)
     cur_p->size = k;
 }
 
+// writes the k tokens with the highest logits to dst in descending order, reading the raw logits instead of a candidate array
+// dst must have room for n entries
+static void llama_sampler_top_k_logits(const float * logits, int32_t n, int32_t k, llama_token_data * dst) {
+    GGML_ASSERT(0 < k && k <= n);
+
+    auto comp = [](const llama_token_data & a, const llama_token_data & b) {
+        return a.logit > b.logit;
+    };
+
+    if (k <= 128) {
+        // min-heap of the best k tokens so far, the logits are compared to the smallest of them a block at a time
+        // so that the test is vectorized and most of the blocks are skipped without touching the heap
+        constexpr int32_t nblock = 16;
+
+        for (int32_t i = 0; i < k; ++i) {
+            dst[i] = llama_token_data{i, logits[i], 0.0f};
+        }
+        std::make_heap(dst, dst + k, comp);
+
+        auto push = [&](int32_t i) {
+            if (logits[i] > dst[0].logit) {
+                std::pop_heap(dst, dst + k, comp);
+                dst[k - 1] = llama_token_data{i, logits[i], 0.0f};
+                std::push_heap(dst, dst + k, comp);
+            }
+        };
+
+        int32_t i = k;
+        for (; i + nblock <= n; i += nblock) {
+            const float thold = dst[0].logit;
+
+            int any = 0;
+            for (int32_t j = 0; j < nblock; ++j) {
+                any |= logits[i + j] > thold;
+            }
+
+            if (any) {
+                for (int32_t j = 0; j < nblock; ++j) {
+                    push(i + j);
+                }
+            }
+        }
+        for (; i < n; ++i) {
+            push(i);
+        }
+
+        std::sort_heap(dst, dst + k, comp);
+        return;
+    }
+
+    // bucket sort over the range of the logits, the buckets above the k-th logit are copied and sorted
+    float max_l = logits[0];
+    float min_l = logits[0];
+    for (int32_t i = 1; i < n; ++i) {
+        max_l = std::max(max_l, logits[i]);
+        min_l = std::min(min_l, logits[i]);
+    }
+
+    // the logits further below the max than this all go to the lowest bucket
+    constexpr float bucket_range = 32.0f;
+    constexpr int   nbuckets     = 256;
+
+    const float bucket_low = std::max(min_l, max_l - bucket_range);
+
+    if (!(max_l > bucket_low)) {
+        // all the logits are equal or not finite
+        for (int32_t i = 0; i < n; ++i) {
+            dst[i] = llama_token_data{i, logits[i], 0.0f};
+        }
+        std::partial_sort(dst, dst + k, dst + n, comp);
+        return;
+    }
+
+    const float bucket_scale = nbuckets/(max_l - bucket_low);
+
+    // clamped as a float, converting -INFINITY (e.g. masked by a grammar) or NaN to int is undefined
+    auto bucket = [&](float val) {
+        const float b = bucket_scale*(val - bucket_low);
+        return b > 0.0f ? int(std::min(float(nbuckets - 1), b)) : 0;
+    };
+
+    int histo[nbuckets] = {};
+    for (int32_t i = 0; i < n; ++i) {
+        ++histo[bucket(logits[i])];
+    }
+
+    int nhave = 0;
+    int ib = nbuckets - 1;
+    for ( ; ib > 0; --ib) {
+        nhave += histo[ib];
+        if (nhave >= k) {
+            break;
+        }
+    }
+
+    nhave = 0;
+    for (int32_t i = 0; i < n; ++i) {
+        if (bucket(logits[i]) >= ib) {
+            dst[nhave++] = llama_token_data{i, logits[i], 0.0f};
+        }
+    }
+
+    std::partial_sort(dst, dst + k, dst + nhave, comp);
+}
+
 static uint32_t get_rng_seed(uint32_t seed) {
     if (seed == LLAMA_DEFAULT_SEED) {
         // use system clock if std::random_device is not a true RNG
@@ -385,18 +492,10 @@ llama_token llama_sampler_sample(struct llama_sampler * smpl, struct llama_conte
     const int n_vocab = llama_vocab_n_tokens(vocab);
 
     // TODO: do not allocate each time
-    std::vector<llama_token_data> cur;
-    cur.reserve(n_vocab);
-    for (llama_token token_id = 0; token_id < n_vocab; token_id++) {
-        cur.emplace_back(llama_token_data{token_id, logits[token_id], 0.0f});
-    }
+    std::unique_ptr<llama_token_data[]> cur(new llama_token_data[n_vocab]);
 
-    llama_token_data_array cur_p = {
-        /* .data       = */ cur.data(),
-        /* .size       = */ cur.size(),
-        /* .selected   = */ -1,
-        /* .sorted     = */ false,
-    };
+    llama_token_data_array cur_p;
+    llama_sampler_fill_candidates(smpl, logits, n_vocab, cur.get(), &cur_p);
 
     llama_sampler_apply(smpl, &cur_p);
 
@@ -409,6 +508,41 @@ llama_token llama_sampler_sample(struct llama_sampler * smpl, struct llama_conte
     return token;
 }
 
+void llama_sampler_sample_batch(
+        struct llama_sampler ** smpls,
+        struct llama_context  * ctx,
+               const int32_t  * idxs,
+                 llama_token  * tokens,
+                     int32_t    n) {
+    const llama_model * model = llama_get_model(ctx);
+    const llama_vocab * vocab = llama_model_get_vocab(model);
+
+    const int n_vocab = llama_vocab_n_tokens(vocab);
+
+    // the logits are fetched on this thread, as it synchronizes the context
+    std::vector<const float *> logits(n);
+    for (int32_t i = 0; i < n; ++i) {
+        logits[i] = llama_get_logits_ith(ctx, idxs[i]);
+    }
+
+    ctx->cpu_parallel_for(n, [&](int32_t i) {
+        // the candidates buffer of each thread is kept across the calls
+        static thread_local std::vector<llama_token_data> cur;
+        cur.resize(n_vocab);
+
+        llama_token_data_array cur_p;
+        llama_sampler_fill_candidates(smpls[i], logits[i], n_vocab, cur.data(), &cur_p);
+
+        llama_sampler_apply(smpls[i], &cur_p);
+
+        GGML_ASSERT(cur_p.selected >= 0 && cur_p.selected < (int32_t) cur_p.size);
+
+        tokens[i] = cur_p.data[cur_p.selected].id;
+
+        llama_sampler_accept(smpls[i], tokens[i]);
+    });
+}
+
 // sampler chain
 
 static const char * llama_sampler_chain_name(const struct llama_sampler * /*smpl*/) {
@@ -1470,6 +1604,11 @@ static void llama_sampler_grammar_reset(struct llama_sampler * smpl) {
                                                  ctx->grammar->lazy, trigger_patterns_c.data(), trigger_patterns_c.size(),
                                                  ctx->grammar->trigger_tokens.data(), ctx->grammar->trigger_tokens.size());
 
+    // same rules, so the masks computed so far still apply
+    if (grammar_new) {
+        grammar_new->masks = ctx->grammar->masks;
+    }
+
     llama_grammar_free_impl(ctx->grammar);
     ctx->grammar = grammar_new;
 }
@@ -2540,6 +2679,83 @@ uint32_t llama_sampler_get_seed(const struct llama_sampler * smpl) {
     return LLAMA_DEFAULT_SEED;
 }
 
+// true if the sampler does not modify the candidates with its current parameters
+static bool llama_sampler_is_noop(const struct llama_sampler * smpl) {
+    if (smpl->iface == &llama_sampler_top_k_i) {
+        return ((const llama_sampler_top_k *) smpl->ctx)->k <= 0;
+    }
+
+    if (smpl->iface == &llama_sampler_penalties_i) {
+        const auto * ctx = (const llama_sampler_penalties *) smpl->ctx;
+        return ctx->penalty_last_n == 0 ||
+              (ctx->penalty_repeat == 1.0f && ctx->penalty_freq == 0.0f && ctx->penalty_present == 0.0f);
+    }
+
+    if (smpl->iface == &llama_sampler_dry_i) {
+        const auto * ctx = (const llama_sampler_dry *) smpl->ctx;
+        return ctx->dry_multiplier == 0.0f || ctx->dry_base < 1.0f || ctx->dry_penalty_last_n == 0;
+    }
+
+    if (smpl->iface == &llama_sampler_top_n_sigma_i) {
+        return ((const llama_sampler_top_n_sigma *) smpl->ctx)->n <= 0.0f;
+    }
+
+    if (smpl->iface == &llama_sampler_logit_bias_i) {
+        return ((const llama_sampler_logit_bias *) smpl->ctx)->logit_bias.empty();
+    }
+
+    if (smpl->iface == &llama_sampler_chain_i) {
+        const auto * ctx = (const llama_sampler_chain *) smpl->ctx;
+        return std::all_of(ctx->samplers.begin(), ctx->samplers.end(), llama_sampler_is_noop);
+    }
+
+    return false;
+}
+
+// the k of the top-k sampler that is applied first to the candidates, or 0 if there is none
+static int32_t llama_sampler_get_first_top_k(const struct llama_sampler * smpl) {
+    if (smpl->iface == &llama_sampler_top_k_i) {
+        return std::max(0, ((const llama_sampler_top_k *) smpl->ctx)->k);
+    }
+
+    if (smpl->iface == &llama_sampler_chain_i) {
+        const auto * ctx = (const llama_sampler_chain *) smpl->ctx;
+        for (const auto * s : ctx->samplers) {
+            const int32_t k = llama_sampler_get_first_top_k(s);
+            if (k > 0) {
+                return k;
+            }
+            if (!llama_sampler_is_noop(s)) {
+                break;
+            }
+        }
+    }
+
+    return 0;
+}
+
+void llama_sampler_fill_candidates(
+        const struct llama_sampler * smpl,
+                       const float * logits,
+                           int32_t   n_vocab,
+                  llama_token_data * data,
+            llama_token_data_array * cur_p) {
+    const int32_t k = smpl ? llama_sampler_get_first_top_k(smpl) : 0;
+
+    if (k > 0 && k < n_vocab) {
+        llama_sampler_top_k_logits(logits, n_vocab, k, data);
+
+        *cur_p = { data, (size_t) k, -1, true };
+        return;
+    }
+
+    for (llama_token token_id = 0; token_id < n_vocab; token_id++) {
+        data[token_id] = llama_token_data{token_id, logits[token_id], 0.0f};
+    }
+
+    *cur_p = { data, (size_t) n_vocab, -1, false };
+}
+
 // perf
 
 struct llama_perf_sampler_data llama_perf_sampler(const struct llama_sampler * chain) {
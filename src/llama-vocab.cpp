@@ -8,6 +8,7 @@
 #include "unicode.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <cfloat>
@@ -19,6 +20,7 @@
 #include <map>
 #include <queue>
 #include <set>
+#include <thread>
 #include <unordered_map>
 
 //
@@ -257,6 +259,11 @@ public:
         return item;
     }
 
+    // keeps the capacity of the container
+    void clear() {
+        this->c.clear();
+    }
+
     void pop() =  delete;
 };
 
@@ -271,14 +278,38 @@ struct llm_bigram_bpe {
     using queue = llama_priority_queue<llm_bigram_bpe, queue_storage, comparator>;
     llm_symbol::index left;
     llm_symbol::index right;
-    std::string text;
+    llama_token id_left;  // ids of the symbols when the bigram was created, the bigram is outdated if they changed
+    llama_token id_right;
+    llama_token id;       // id of the merged symbol
     int rank;
-    size_t size;
 };
 
+// merge of the symbols with ids (key >> 32, key & 0xFFFFFFFF)
+struct llm_merge_bpe {
+    uint64_t    key;
+    int32_t     rank;
+    llama_token id;
+};
+
+#define LLAMA_BPE_MERGE_KEY_EMPTY UINT64_MAX
+
+// words of at most this size are memoized per thread
+#define LLAMA_BPE_MEMO_MAX_WORD_SIZE 32
+#define LLAMA_BPE_MEMO_MAX_WORDS     65536
+
+// number of words per thread when merging the words of large inputs in parallel
+#define LLAMA_BPE_PARALLEL_WORDS 8192
+// the threads are spawned per call, concurrent callers (e.g. the server slots) would otherwise oversubscribe the CPU
+#define LLAMA_BPE_PARALLEL_MAX_THREADS 4
+
+static std::atomic<uint64_t> llm_tokenizer_bpe_uid { 0 };
+
 struct llm_tokenizer_bpe : llm_tokenizer {
-    llm_tokenizer_bpe(const llama_vocab & vocab) {
+    llm_tokenizer_bpe(const llama_vocab & vocab) : n_tokens(vocab.n_tokens()), uid(++llm_tokenizer_bpe_uid) {
         GGML_ASSERT(vocab.get_type() == LLAMA_VOCAB_TYPE_BPE);
+
+        init_merges(vocab);
+
         switch (vocab.get_pre_type()) {
             case LLAMA_VOCAB_PRE_TYPE_LLAMA3:
                 regex_exprs = {
@@ -446,9 +477,132 @@ struct llm_tokenizer_bpe : llm_tokenizer {
         }
     }
 
+    // the merges are looked up by the ids of their parts, so the symbols never have to be converted back to text
+    // the parts and the results of the merges that are not in the vocab get ids starting at n_tokens
+    void init_merges(const llama_vocab & vocab) {
+        std::unordered_map<std::string, llama_token> extra;
+
+        auto get_id = [&](const std::string & text) {
+            const llama_token id = vocab.text_to_token(text);
+            if (id != LLAMA_TOKEN_NULL) {
+                return id;
+            }
+
+            return extra.emplace(text, (llama_token) (n_tokens + extra.size())).first->second;
+        };
+
+        const auto bpe_merges = vocab.get_bpe_merges();
+
+        size_t n_merges = 1;
+        while (n_merges < 2*bpe_merges.size()) {
+            n_merges *= 2;
+        }
+
+        merges.assign(n_merges, { LLAMA_BPE_MERGE_KEY_EMPTY, -1, LLAMA_TOKEN_NULL });
+
+        for (int rank = 0; rank < (int) bpe_merges.size(); ++rank) {
+            const std::string & word = bpe_merges[rank];
+
+            // same split as when the merges are loaded
+            std::string first;
+            std::string second;
+
+            const size_t pos = word.find(' ', 1);
+
+            if (pos != std::string::npos) {
+                first  = word.substr(0, pos);
+                second = word.substr(pos + 1);
+            }
+
+            const uint64_t key = merge_key(get_id(first), get_id(second));
+
+            size_t i = merge_hash(key);
+            while (merges[i].key != LLAMA_BPE_MERGE_KEY_EMPTY && merges[i].key != key) {
+                i = (i + 1) & (merges.size() - 1);
+            }
+
+            if (merges[i].key == LLAMA_BPE_MERGE_KEY_EMPTY) {
+                merges[i] = { key, rank, get_id(first + second) };
+            }
+        }
+
+        // the initial symbols of a word are single UTF-8 characters
+        auto add_char = [&](const std::string & text, llama_token id) {
+            if (!text.empty() && text.size() <= 4 && text.size() == std::min(text.size(), unicode_len_utf8(text[0]))) {
+                char_ids[char_key(text.data(), text.size())] = id;
+            }
+        };
+
+        for (uint32_t id = 0; id < n_tokens; ++id) {
+            add_char(vocab.token_get_text(id), id);
+        }
+
+        for (const auto & [text, id] : extra) {
+            add_char(text, id);
+        }
+    }
+
+    static uint64_t merge_key(llama_token left, llama_token right) {
+        return ((uint64_t) (uint32_t) left << 32) | (uint32_t) right;
+    }
+
+    size_t merge_hash(uint64_t key) const {
+        return (size_t) ((key * 0x9E3779B97F4A7C15ull) >> 17) & (merges.size() - 1);
+    }
+
+    static uint64_t char_key(const char * text, size_t n) {
+        uint64_t key = n;
+        for (size_t i = 0; i < n; ++i) {
+            key = (key << 8) | (uint8_t) text[i];
+        }
+        return key;
+    }
+
+    const llm_merge_bpe * find_merge(llama_token left, llama_token right) const {
+        if (left == LLAMA_TOKEN_NULL || right == LLAMA_TOKEN_NULL) {
+            return nullptr;
+        }
+
+        const uint64_t key = merge_key(left, right);
+
+        for (size_t i = merge_hash(key); merges[i].key != LLAMA_BPE_MERGE_KEY_EMPTY; i = (i + 1) & (merges.size() - 1)) {
+            if (merges[i].key == key) {
+                return &merges[i];
+            }
+        }
+
+        return nullptr;
+    }
+
+    llama_token find_char(const char * text, size_t n) const {
+        const auto it = char_ids.find(char_key(text, n));
+        return it == char_ids.end() ? LLAMA_TOKEN_NULL : it->second;
+    }
+
     std::vector<std::string> regex_exprs;
+
+    std::vector<llm_merge_bpe> merges; // open addressing, the size is a power of 2
+
+    std::unordered_map<uint64_t, llama_token> char_ids;
+
+    const uint32_t n_tokens;
+    const uint64_t uid; // owner of the thread-local memoized words
+};
+
+// per-thread buffers of the BPE tokenizer, reused between the calls
+struct llm_tokenizer_bpe_state {
+    std::vector<llm_symbol>  symbols;
+    std::vector<llama_token> ids;
+    llm_bigram_bpe::queue    work_queue;
+
+    // tokens of the recently seen short words
+    uint64_t owner = 0;
+    std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> memo; // word -> range in memo_tokens
+    std::vector<llama_token> memo_tokens;
 };
 
+static thread_local llm_tokenizer_bpe_state llm_tokenizer_bpe_tls;
+
 struct llm_tokenizer_bpe_session {
     llm_tokenizer_bpe_session(const llama_vocab & vocab, const llm_tokenizer_bpe & tokenizer) : vocab(vocab), tokenizer(tokenizer) {}
 
@@ -490,143 +644,195 @@ struct llm_tokenizer_bpe_session {
     }
 
     void tokenize(const std::string & text, std::vector<llama_token> & output) {
-        int final_prev_index = -1;
         const auto word_collection = unicode_regex_split(text, tokenizer.regex_exprs);
 
-        symbols_final.clear();
-
-        for (const auto & word : word_collection) {
-            work_queue = llm_bigram_bpe::queue();
-            symbols.clear();
+        const int n_words = word_collection.size();
 
-            int index = 0;
-            size_t offset = 0;
+        // the words are independent, so large inputs are merged in parallel chunks of words
+        const int n_threads = std::max(1, std::min<int>({ (int) std::thread::hardware_concurrency(), LLAMA_BPE_PARALLEL_MAX_THREADS, n_words/LLAMA_BPE_PARALLEL_WORDS }));
 
-            //if (vocab.tokenizer_ignore_merges && vocab.token_to_id.find(word) != vocab.token_to_id.end()) {
-            if (vocab.get_ignore_merges() && vocab.text_to_token(word) != LLAMA_TOKEN_NULL) {
-                symbols.emplace_back(llm_symbol{-1, -1, word.c_str(), word.size()});
-                offset = word.size();
+        if (n_threads == 1) {
+            for (const auto & word : word_collection) {
+                tokenize_word(word, output);
             }
+            return;
+        }
 
-            while (offset < word.size()) {
-                llm_symbol sym;
-                size_t char_len = std::min(word.size() - offset, (size_t) unicode_len_utf8(word[offset]));
-                sym.text = word.c_str() + offset;
-                sym.n = char_len;
-                offset += sym.n;
-                sym.prev = index - 1;
-                sym.next = offset == word.size() ? -1 : index + 1;
-                index++;
-                symbols.emplace_back(sym);
-            }
-            for (int i = 1; i < (int) symbols.size(); ++i) {
-                add_new_bigram(i - 1, i);
+        std::vector<std::vector<llama_token>> outputs(n_threads);
+        std::vector<std::thread> workers;
+
+        auto worker = [&](int ith) {
+            const int i0 = (int64_t) n_words*ith/n_threads;
+            const int i1 = (int64_t) n_words*(ith + 1)/n_threads;
+
+            for (int i = i0; i < i1; ++i) {
+                tokenize_word(word_collection[i], outputs[ith]);
             }
+        };
 
-            // build token(s)
-            while (!work_queue.empty()) {
-                auto bigram = work_queue.pop_move();
+        for (int ith = 1; ith < n_threads; ++ith) {
+            workers.emplace_back(worker, ith);
+        }
 
-                auto & left_symbol = symbols[bigram.left];
-                auto & right_symbol = symbols[bigram.right];
+        worker(0);
 
-                if (left_symbol.n == 0 || right_symbol.n == 0) {
-                    continue;
-                }
-                std::string left_token = std::string(left_symbol.text, left_symbol.n);
-                std::string right_token = std::string(right_symbol.text, right_symbol.n);
-                if (left_token + right_token != bigram.text) {
-                    continue;  // Skip this bigram if it's outdated
-                }
+        for (auto & w : workers) {
+            w.join();
+        }
 
-                // merge the right sym into the left one
-                left_symbol.n += right_symbol.n;
-                right_symbol.n = 0;
+        for (const auto & out : outputs) {
+            output.insert(output.end(), out.begin(), out.end());
+        }
+    }
 
-                // remove the right sym from the chain
-                left_symbol.next = right_symbol.next;
-                if (right_symbol.next >= 0) {
-                    symbols[right_symbol.next].prev = bigram.left;
-                }
+private:
+    void tokenize_word(const std::string & word, std::vector<llama_token> & output) const {
+        auto & state = llm_tokenizer_bpe_tls;
 
-                add_new_bigram(left_symbol.prev, bigram.left);  // left side of current symbol
-                add_new_bigram(bigram.left, left_symbol.next);  // right side of current symbol
+        if (state.owner != tokenizer.uid) {
+            state.owner = tokenizer.uid;
+            state.memo.clear();
+            state.memo_tokens.clear();
+        }
+
+        const bool memoize = word.size() <= LLAMA_BPE_MEMO_MAX_WORD_SIZE;
+
+        if (memoize) {
+            const auto it = state.memo.find(word);
+            if (it != state.memo.end()) {
+                output.insert(output.end(), state.memo_tokens.begin() + it->second.first, state.memo_tokens.begin() + it->second.second);
+                return;
             }
+        }
 
-            // add the finished tokens to the final list keeping correct order for next and prev
-            for (auto & sym : symbols) {
-                if (sym.n > 0) {
-                    sym.prev = final_prev_index;
-                    sym.next = -1;
-                    if (final_prev_index != -1) {
-                        symbols_final[final_prev_index].next = symbols_final.size();
-                    }
-                    symbols_final.emplace_back(sym);
-                    final_prev_index = symbols_final.size() - 1;
-                }
+        const size_t n_output = output.size();
+
+        merge_word(state, word, output);
+
+        if (memoize) {
+            if (state.memo.size() >= LLAMA_BPE_MEMO_MAX_WORDS) {
+                state.memo.clear();
+                state.memo_tokens.clear();
             }
+
+            const uint32_t i0 = state.memo_tokens.size();
+            state.memo_tokens.insert(state.memo_tokens.end(), output.begin() + n_output, output.end());
+            state.memo.emplace(word, std::make_pair(i0, (uint32_t) state.memo_tokens.size()));
         }
+    }
 
-        symbols = symbols_final;
+    void merge_word(llm_tokenizer_bpe_state & state, const std::string & word, std::vector<llama_token> & output) const {
+        auto & symbols    = state.symbols;
+        auto & ids        = state.ids;
+        auto & work_queue = state.work_queue;
 
-        if (!symbols.empty()) {
-            for (int i = 0; i != -1; i = symbols[i].next) {
-                auto & symbol = symbols[i];
-                if (symbol.n == 0) {
-                    continue;
-                }
+        if (word.empty()) {
+            return;
+        }
+
+        //if (vocab.tokenizer_ignore_merges && vocab.token_to_id.find(word) != vocab.token_to_id.end()) {
+        if (vocab.get_ignore_merges()) {
+            const llama_token id = vocab.text_to_token(word);
+            if (id != LLAMA_TOKEN_NULL) {
+                output.push_back(id);
+                return;
+            }
+        }
 
-                const std::string str = std::string(symbol.text, symbol.n);
-                const auto token = vocab.text_to_token(str);
+        work_queue.clear();
+        symbols.clear();
+        ids.clear();
 
-                if (token == LLAMA_TOKEN_NULL) {
-                    for (auto j = str.begin(); j != str.end(); ++j) {
-                        std::string byte_str(1, *j);
-                        auto token_multibyte = vocab.text_to_token(byte_str);
-                        if (token_multibyte != LLAMA_TOKEN_NULL) {
-                            output.push_back(token_multibyte);
-                        }
+        int index = 0;
+        size_t offset = 0;
+
+        while (offset < word.size()) {
+            llm_symbol sym;
+            size_t char_len = std::min(word.size() - offset, (size_t) unicode_len_utf8(word[offset]));
+            sym.text = word.c_str() + offset;
+            sym.n = char_len;
+            offset += sym.n;
+            sym.prev = index - 1;
+            sym.next = offset == word.size() ? -1 : index + 1;
+            index++;
+            symbols.emplace_back(sym);
+            ids.push_back(tokenizer.find_char(sym.text, sym.n));
+        }
+        for (int i = 1; i < (int) symbols.size(); ++i) {
+            add_new_bigram(state, i - 1, i);
+        }
+
+        // build token(s)
+        while (!work_queue.empty()) {
+            auto bigram = work_queue.pop_move();
+
+            auto & left_symbol = symbols[bigram.left];
+            auto & right_symbol = symbols[bigram.right];
+
+            if (left_symbol.n == 0 || right_symbol.n == 0) {
+                continue;
+            }
+            if (ids[bigram.left] != bigram.id_left || ids[bigram.right] != bigram.id_right) {
+                continue;  // Skip this bigram if it's outdated
+            }
+
+            // merge the right sym into the left one
+            left_symbol.n += right_symbol.n;
+            right_symbol.n = 0;
+            ids[bigram.left] = bigram.id;
+
+            // remove the right sym from the chain
+            left_symbol.next = right_symbol.next;
+            if (right_symbol.next >= 0) {
+                symbols[right_symbol.next].prev = bigram.left;
+            }
+
+            add_new_bigram(state, left_symbol.prev, bigram.left);  // left side of current symbol
+            add_new_bigram(state, bigram.left, left_symbol.next);  // right side of current symbol
+        }
+
+        for (int i = 0; i != -1; i = symbols[i].next) {
+            const auto & symbol = symbols[i];
+            const llama_token token = ids[i];
+
+            if (token == LLAMA_TOKEN_NULL || (uint32_t) token >= tokenizer.n_tokens) {
+                for (size_t j = 0; j < symbol.n; ++j) {
+                    std::string byte_str(1, symbol.text[j]);
+                    auto token_multibyte = vocab.text_to_token(byte_str);
+                    if (token_multibyte != LLAMA_TOKEN_NULL) {
+                        output.push_back(token_multibyte);
                     }
-                } else {
-                    output.push_back(token);
                 }
+            } else {
+                output.push_back(token);
             }
         }
     }
 
-private:
-    void add_new_bigram(int left, int right) {
+    void add_new_bigram(llm_tokenizer_bpe_state & state, int left, int right) const {
         if (left == -1 || right == -1) {
             return;
         }
-        std::string left_token  = std::string(symbols[left].text,  symbols[left].n);
-        std::string right_token = std::string(symbols[right].text, symbols[right].n);
-
-        int rank_found = -1;
 
-        rank_found = vocab.find_bpe_rank(left_token, right_token);
-
-        if (rank_found < 0) {
+        const llm_merge_bpe * merge = tokenizer.find_merge(state.ids[left], state.ids[right]);
+        if (merge == nullptr) {
             return;
         }
 
         llm_bigram_bpe bigram;
 
-        bigram.left  = left;
-        bigram.right = right;
-        bigram.text  = left_token + right_token;
-        bigram.size  = left_token.size() + right_token.size();
-        bigram.rank  = rank_found;
+        bigram.left     = left;
+        bigram.right    = right;
+        bigram.id_left  = state.ids[left];
+        bigram.id_right = state.ids[right];
+        bigram.id       = merge->id;
+        bigram.rank     = merge->rank;
 
-        work_queue.push(bigram);
+        state.work_queue.push(bigram);
     }
 
     const llama_vocab & vocab;
     const llm_tokenizer_bpe & tokenizer;
-
-    std::vector<llm_symbol> symbols;
-    std::vector<llm_symbol> symbols_final;
-    llm_bigram_bpe::queue work_queue;
 };
 
 //
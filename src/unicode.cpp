@@ -239,12 +239,10 @@ static std::vector<std::string> unicode_byte_encoding_process(const std::vector<
 }
 
 // GPT2 system regex:  's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
-static std::vector<size_t> unicode_regex_split_custom_gpt2(const std::string & text, const std::vector<size_t> & offsets) {
+static std::vector<size_t> unicode_regex_split_custom_gpt2(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
     std::vector<size_t> bpe_offsets; // store the offset of each word
     bpe_offsets.reserve(offsets.size()); // Reserve memory for the approximate size
 
-    const auto cpts = unicode_cpts_from_utf8(text);
-
     size_t start = 0;
     for (auto offset : offsets) {
         const size_t offset_ini = start;
@@ -357,12 +355,11 @@ static std::vector<size_t> unicode_regex_split_custom_gpt2(const std::string & t
 }
 
 // LLAMA3 system regex: "(?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+"
-static std::vector<size_t> unicode_regex_split_custom_llama3(const std::string & text, const std::vector<size_t> & offsets) {
+// also used for the variants with \p{N}{1,n_digits} and without the [\r\n]* after the punctuation
+static std::vector<size_t> unicode_regex_split_custom_llama3(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets, size_t n_digits = 3, bool punct_newlines = true) {
     std::vector<size_t> bpe_offsets; // store the offset of each word
     bpe_offsets.reserve(offsets.size()); // Reserve memory for the approximate size
 
-    const auto cpts = unicode_cpts_from_utf8(text);
-
     size_t start = 0;
     for (auto offset : offsets) {
         const size_t offset_ini = start;
@@ -434,7 +431,7 @@ static std::vector<size_t> unicode_regex_split_custom_llama3(const std::string &
             if (flags.is_number) {
                 size_t ini = pos;
                 while (_get_flags(pos).is_number) {
-                    if (++pos - ini >= 3 ) {
+                    if (++pos - ini >= n_digits) {
                         _add_token(pos);
                         ini = pos;
                     }
@@ -451,7 +448,7 @@ static std::vector<size_t> unicode_regex_split_custom_llama3(const std::string &
                     flags2 = _get_flags(++pos);
                 }
                 uint32_t cpt2 = _get_cpt(pos);
-                while (cpt2 == '\r' || cpt2 == '\n') {
+                while (punct_newlines && (cpt2 == '\r' || cpt2 == '\n')) {
                     cpt2 = _get_cpt(++pos);
                 }
                 _add_token(pos);
@@ -559,12 +556,10 @@ static std::vector<size_t> unicode_regex_split_stl(const std::string & text, con
 
 // K2 system regex patterns (from tokenization_kimi.py):
 // [\p{Han}]+|[^\r\n\p{L}\p{N}]?[\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}&&[^\p{Han}]]*[\p{Ll}\p{Lm}\p{Lo}\p{M}&&[^\p{Han}]]+(?i:'s|'t|'re|'ve|'m|'ll|'d)?|[^\r\n\p{L}\p{N}]?[\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}&&[^\p{Han}]]+[\p{Ll}\p{Lm}\p{Lo}\p{M}&&[^\p{Han}]]*(?i:'s|'t|'re|'ve|'m|'ll|'d)?|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
-static std::vector<size_t> unicode_regex_split_custom_kimi_k2(const std::string & text, const std::vector<size_t> & offsets) {
+static std::vector<size_t> unicode_regex_split_custom_kimi_k2(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
     std::vector<size_t> bpe_offsets;
     bpe_offsets.reserve(offsets.size());
 
-    const auto cpts = unicode_cpts_from_utf8(text);
-
     size_t start = 0;
     for (auto offset : offsets) {
         const size_t offset_ini = start;
@@ -729,24 +724,574 @@ static std::vector<size_t> unicode_regex_split_custom_kimi_k2(const std::string
     return bpe_offsets;
 }
 
-static std::vector<size_t> unicode_regex_split_custom(const std::string & text, const std::string & regex_expr, const std::vector<size_t> & offsets) {
+//
+// hand-written splits of the other pre-tokenizer regexes
+// the text between the matches is kept as separate words, as with std::regex
+//
+
+static const uint32_t UNICODE_OUT_OF_RANGE = 0xFFFFFFFF;
+
+// split each chunk at the matches of a regex, match(pos, end) returns the end of the match at pos or pos if there is none
+template <typename F>
+static std::vector<size_t> unicode_regex_split_matches(const std::vector<size_t> & offsets, const F & match) {
     std::vector<size_t> bpe_offsets;
+    bpe_offsets.reserve(offsets.size());
 
-    if (regex_expr == "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)") {
-        bpe_offsets = unicode_regex_split_custom_gpt2(text, offsets);
-    } else if (
-            regex_expr == "(?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+" ||
-            regex_expr == "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+") {
+    size_t start = 0;
+    for (auto offset : offsets) {
+        const size_t offset_ini = start;
+        const size_t offset_end = start + offset;
+        start = offset_end;
 
-        bpe_offsets = unicode_regex_split_custom_llama3(text, offsets);
-    } else if (regex_expr == "\\p{Han}+") {
-        // K2's first pattern - handle all K2 patterns together
-        bpe_offsets = unicode_regex_split_custom_kimi_k2(text, offsets);
+        size_t prev_end = offset_ini;
+        for (size_t pos = offset_ini; pos < offset_end; ) {
+            const size_t end = match(pos, offset_end);
+            if (end == pos) {
+                pos++;
+                continue;
+            }
+            if (pos > prev_end) {
+                bpe_offsets.push_back(pos - prev_end);
+            }
+            bpe_offsets.push_back(end - pos);
+            prev_end = pos = end;
+        }
+
+        if (offset_end > prev_end) {
+            bpe_offsets.push_back(offset_end - prev_end);
+        }
     }
 
     return bpe_offsets;
 }
 
+static inline uint32_t unicode_get_cpt(const std::vector<uint32_t> & cpts, size_t pos, size_t end) {
+    return pos < end ? cpts[pos] : UNICODE_OUT_OF_RANGE;
+}
+
+static inline unicode_cpt_flags unicode_get_flags(const std::vector<uint32_t> & cpts, size_t pos, size_t end) {
+    return pos < end ? unicode_cpt_flags_from_cpt(cpts[pos]) : unicode_cpt_flags{};
+}
+
+static inline bool unicode_cpt_is_ascii_alpha(uint32_t cpt) {
+    return (cpt >= 'a' && cpt <= 'z') || (cpt >= 'A' && cpt <= 'Z');
+}
+
+// regex: (?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])
+static size_t unicode_match_contraction(const std::vector<uint32_t> & cpts, size_t pos, size_t end) {
+    if (unicode_get_cpt(cpts, pos, end) != '\'' || pos + 1 >= end) {
+        return pos;
+    }
+    auto tolower = [](uint32_t cpt) { return cpt >= 'A' && cpt <= 'Z' ? cpt + ('a' - 'A') : cpt; };
+    const uint32_t cpt_next = tolower(cpts[pos + 1]);
+    if (cpt_next == 's' || cpt_next == 't' || cpt_next == 'm' || cpt_next == 'd') {
+        return pos + 2;
+    }
+    if (pos + 2 < end) {
+        const uint32_t cpt_next_next = tolower(cpts[pos + 2]);
+        if ((cpt_next == 'r' && cpt_next_next == 'e') ||
+            (cpt_next == 'v' && cpt_next_next == 'e') ||
+            (cpt_next == 'l' && cpt_next_next == 'l')) {
+            return pos + 3;
+        }
+    }
+    return pos;
+}
+
+// regex: \s*[\r\n]+|\s+(?!\S)|\s+
+static size_t unicode_match_whitespaces(const std::vector<uint32_t> & cpts, size_t pos, size_t end) {
+    size_t num_whitespaces = 0;
+    size_t last_end_r_or_n = 0;
+    while (unicode_get_flags(cpts, pos + num_whitespaces, end).is_whitespace) {
+        const uint32_t cpt = cpts[pos + num_whitespaces];
+        if (cpt == '\r' || cpt == '\n') {
+            last_end_r_or_n = pos + num_whitespaces + 1;
+        }
+        num_whitespaces++;
+    }
+
+    if (last_end_r_or_n > 0) {
+        return last_end_r_or_n;
+    }
+
+    if (num_whitespaces > 1 && pos + num_whitespaces < end) {
+        return pos + num_whitespaces - 1;
+    }
+
+    return pos + num_whitespaces;
+}
+
+// TEKKEN system regex: "[^\r\n\p{L}\p{N}]?((?=[\p{L}])([^a-z]))*((?=[\p{L}])([^A-Z]))+|[^\r\n\p{L}\p{N}]?((?=[\p{L}])([^a-z]))+((?=[\p{L}])([^A-Z]))*|\p{N}| ?[^\s\p{L}\p{N}]+[\r\n/]*|\s*[\r\n]+|\s+(?!\S)|\s+"
+// GPT4O adds the contractions after the letters and uses \p{N}{1,3}
+// as in the regex, only the ASCII letters have a case, the other letters are both upper and lower case
+static std::vector<size_t> unicode_regex_split_custom_tekken(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets, size_t n_digits, bool contractions) {
+    auto is_upper = [](uint32_t cpt, unicode_cpt_flags flags) { return flags.is_letter && !(cpt >= 'a' && cpt <= 'z'); };
+    auto is_lower = [](uint32_t cpt, unicode_cpt_flags flags) { return flags.is_letter && !(cpt >= 'A' && cpt <= 'Z'); };
+
+    return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+        const uint32_t cpt = cpts[pos];
+        const auto flags = unicode_cpt_flags_from_cpt(cpt);
+
+        // regex: [^\r\n\p{L}\p{N}]?[upper]*[lower]+|[^\r\n\p{L}\p{N}]?[upper]+[lower]*
+        size_t ini = pos;
+        if (!(cpt == '\r' || cpt == '\n' || flags.is_letter || flags.is_number) && unicode_get_flags(cpts, pos + 1, end).is_letter) {
+            ini++;
+        }
+
+        size_t n_upper = 0;
+        while (is_upper(unicode_get_cpt(cpts, ini + n_upper, end), unicode_get_flags(cpts, ini + n_upper, end))) {
+            n_upper++;
+        }
+
+        size_t res = ini;
+        if (is_lower(unicode_get_cpt(cpts, ini + n_upper, end), unicode_get_flags(cpts, ini + n_upper, end))) {
+            res = ini + n_upper;
+            while (is_lower(unicode_get_cpt(cpts, res, end), unicode_get_flags(cpts, res, end))) {
+                res++;
+            }
+        } else if (n_upper > 0) {
+            // backtrack to the last letter that is also lower case, if any
+            res = ini + n_upper;
+            for (size_t i = ini + n_upper; i > ini; --i) {
+                if (is_lower(cpts[i - 1], unicode_cpt_flags_from_cpt(cpts[i - 1]))) {
+                    res = i;
+                    break;
+                }
+            }
+        }
+
+        if (res > ini) {
+            return contractions ? unicode_match_contraction(cpts, res, end) : res;
+        }
+
+        // regex: \p{N}{1,n_digits}
+        if (flags.is_number) {
+            size_t res = pos;
+            while (res - pos < n_digits && unicode_get_flags(cpts, res, end).is_number) {
+                res++;
+            }
+            return res;
+        }
+
+        // regex: <space>?[^\s\p{L}\p{N}]+[\r\n/]*
+        auto flags2 = (cpt == ' ' ? unicode_get_flags(cpts, pos + 1, end) : flags);
+        if (!(flags2.is_whitespace | flags2.is_letter | flags2.is_number) && flags2.as_uint()) {
+            size_t res = pos + (cpt == ' ');
+            while (!(flags2.is_whitespace | flags2.is_letter | flags2.is_number) && flags2.as_uint()) {
+                flags2 = unicode_get_flags(cpts, ++res, end);
+            }
+            uint32_t cpt2 = unicode_get_cpt(cpts, res, end);
+            while (cpt2 == '\r' || cpt2 == '\n' || cpt2 == '/') {
+                cpt2 = unicode_get_cpt(cpts, ++res, end);
+            }
+            return res;
+        }
+
+        return unicode_match_whitespaces(cpts, pos, end);
+    });
+}
+
+// DEEPSEEK3 system regex: "[!\"#$%&'()*+,\-./:;<=>?@\[\\\]^_`{|}~][A-Za-z]+|[^\r\n\p{L}\p{P}\p{S}]?[\p{L}\p{M}]+| ?[\p{P}\p{S}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+"
+static std::vector<size_t> unicode_regex_split_custom_deepseek3(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    auto is_letter_or_mark = [](unicode_cpt_flags flags) { return flags.is_letter || flags.is_accent_mark; };
+
+    return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+        const uint32_t cpt = cpts[pos];
+        const auto flags = unicode_cpt_flags_from_cpt(cpt);
+
+        // regex: [!"#$%&'()*+,\-./:;<=>?@\[\\\]^_`{|}~][A-Za-z]+
+        if (cpt < 0x80 && (flags.is_punctuation || flags.is_symbol) && unicode_cpt_is_ascii_alpha(unicode_get_cpt(cpts, pos + 1, end))) {
+            size_t res = pos + 1;
+            while (unicode_cpt_is_ascii_alpha(unicode_get_cpt(cpts, res, end))) {
+                res++;
+            }
+            return res;
+        }
+
+        // regex: [^\r\n\p{L}\p{P}\p{S}]?[\p{L}\p{M}]+
+        size_t res = pos;
+        if (!(cpt == '\r' || cpt == '\n' || flags.is_letter || flags.is_punctuation || flags.is_symbol) && is_letter_or_mark(unicode_get_flags(cpts, pos + 1, end))) {
+            res++;
+        }
+        while (is_letter_or_mark(unicode_get_flags(cpts, res, end))) {
+            res++;
+        }
+        if (res > pos && is_letter_or_mark(unicode_get_flags(cpts, res - 1, end))) {
+            return res;
+        }
+
+        // regex: <space>?[\p{P}\p{S}]+[\r\n]*
+        auto flags2 = (cpt == ' ' ? unicode_get_flags(cpts, pos + 1, end) : flags);
+        if (flags2.is_punctuation || flags2.is_symbol) {
+            size_t res = pos + (cpt == ' ');
+            while (flags2.is_punctuation || flags2.is_symbol) {
+                flags2 = unicode_get_flags(cpts, ++res, end);
+            }
+            uint32_t cpt2 = unicode_get_cpt(cpts, res, end);
+            while (cpt2 == '\r' || cpt2 == '\n') {
+                cpt2 = unicode_get_cpt(cpts, ++res, end);
+            }
+            return res;
+        }
+
+        return unicode_match_whitespaces(cpts, pos, end);
+    });
+}
+
+// regex: [0-9][0-9][0-9]
+static std::vector<size_t> unicode_regex_split_custom_digits3(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    auto is_digit = [](uint32_t cpt) { return cpt >= '0' && cpt <= '9'; };
+
+    return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+        if (pos + 3 <= end && is_digit(cpts[pos]) && is_digit(cpts[pos + 1]) && is_digit(cpts[pos + 2])) {
+            return pos + 3;
+        }
+        return pos;
+    });
+}
+
+// regex: (?=(\d{3})+(?!\d))
+// the empty matches split the runs of digits into groups of 3 from the right
+static std::vector<size_t> unicode_regex_split_custom_digits3_rtl(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    auto is_digit = [&](size_t pos) { return cpts[pos] >= '0' && cpts[pos] <= '9'; };
+
+    std::vector<size_t> bpe_offsets;
+    bpe_offsets.reserve(offsets.size());
+
+    size_t start = 0;
+    for (auto offset : offsets) {
+        const size_t offset_ini = start;
+        const size_t offset_end = start + offset;
+        assert(offset_end <= cpts.size());
+        start = offset_end;
+
+        size_t prev_end = offset_ini;
+        for (size_t pos = offset_ini; pos < offset_end; ) {
+            if (!is_digit(pos)) {
+                pos++;
+                continue;
+            }
+
+            size_t run_end = pos;
+            while (run_end < offset_end && is_digit(run_end)) {
+                run_end++;
+            }
+
+            for (size_t split = pos; split < run_end; ++split) {
+                if ((run_end - split) % 3 == 0 && split > prev_end) {
+                    bpe_offsets.push_back(split - prev_end);
+                    prev_end = split;
+                }
+            }
+
+            pos = run_end;
+        }
+
+        if (offset_end > prev_end) {
+            bpe_offsets.push_back(offset_end - prev_end);
+        }
+    }
+
+    return bpe_offsets;
+}
+
+// regex: \s+$
+static std::vector<size_t> unicode_regex_split_custom_trailing_whitespaces(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    std::vector<size_t> bpe_offsets;
+    bpe_offsets.reserve(offsets.size());
+
+    size_t start = 0;
+    for (auto offset : offsets) {
+        size_t n_ws = 0;
+        while (n_ws < offset && unicode_cpt_flags_from_cpt(cpts[start + offset - n_ws - 1]).is_whitespace) {
+            n_ws++;
+        }
+
+        if (offset > n_ws) {
+            bpe_offsets.push_back(offset - n_ws);
+        }
+        if (n_ws > 0) {
+            bpe_offsets.push_back(n_ws);
+        }
+        start += offset;
+    }
+
+    return bpe_offsets;
+}
+
+// CHAMELEON regexes: "<sentinel:[0-9]+>", "(IMGIMG)((A|B|C|D|E|F|G|H|I){1,4})Z", "([\t\n]|    |  )"
+static std::vector<size_t> unicode_regex_split_custom_chameleon_sentinel(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    static const char prefix[] = "<sentinel:";
+
+    return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+        size_t res = pos;
+        for (const char * c = prefix; *c; ++c, ++res) {
+            if (unicode_get_cpt(cpts, res, end) != (uint32_t) *c) {
+                return pos;
+            }
+        }
+        const size_t ini = res;
+        while (unicode_get_cpt(cpts, res, end) >= '0' && unicode_get_cpt(cpts, res, end) <= '9') {
+            res++;
+        }
+        return res > ini && unicode_get_cpt(cpts, res, end) == '>' ? res + 1 : pos;
+    });
+}
+
+static std::vector<size_t> unicode_regex_split_custom_chameleon_image(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    static const char prefix[] = "IMGIMG";
+
+    return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+        size_t res = pos;
+        for (const char * c = prefix; *c; ++c, ++res) {
+            if (unicode_get_cpt(cpts, res, end) != (uint32_t) *c) {
+                return pos;
+            }
+        }
+        const size_t ini = res;
+        while (res - ini < 4 && unicode_get_cpt(cpts, res, end) >= 'A' && unicode_get_cpt(cpts, res, end) <= 'I') {
+            res++;
+        }
+        return res > ini && unicode_get_cpt(cpts, res, end) == 'Z' ? res + 1 : pos;
+    });
+}
+
+static std::vector<size_t> unicode_regex_split_custom_chameleon_spaces(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) {
+    return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+        if (cpts[pos] == '\t' || cpts[pos] == '\n') {
+            return pos + 1;
+        }
+        size_t n_spaces = 0;
+        while (n_spaces < 4 && unicode_get_cpt(cpts, pos + n_spaces, end) == ' ') {
+            n_spaces++;
+        }
+        return n_spaces == 4 ? pos + 4 : n_spaces >= 2 ? pos + 2 : pos;
+    });
+}
+
+// a regex made of a single character class, optionally preceded by \s? or <space>? and followed by +, {n} or {1,n}
+// for example: \p{N}{1,3}, \s?\p{L}+, [\r\n] or \s?[A-Za-zµÀ-ÖØ-öø-ƺ]+
+struct unicode_regex_class {
+    bool negated = false;
+    bool whitespace = false;  // \s
+    uint16_t categories = 0;  // \p{X}
+    std::vector<std::pair<uint32_t, uint32_t>> ranges; // sorted
+
+    uint32_t prefix = 0;      // ' ', '\s' as 0x0B or 0 for none
+    size_t   n_min  = 1;
+    size_t   n_max  = 1;
+
+    bool contains(uint32_t cpt) const {
+        const auto flags = unicode_cpt_flags_from_cpt(cpt);
+
+        // the std::regex fallback sees the non-ASCII whitespaces as \v
+        if (cpt > 0x7F && flags.is_whitespace) {
+            cpt = 0x0B;
+        }
+
+        bool res = (whitespace && flags.is_whitespace) || (flags.category_flag() & categories);
+        if (!res && !ranges.empty()) {
+            auto it = std::upper_bound(ranges.begin(), ranges.end(), std::make_pair(cpt, UNICODE_OUT_OF_RANGE));
+            res = it != ranges.begin() && cpt <= std::prev(it)->second;
+        }
+        return res != negated;
+    }
+
+    // parse the supported regexes, return false for the others
+    bool parse(const std::string & regex_expr) {
+        static const std::map<uint32_t, uint16_t> k_ucat = {
+            { 'N', unicode_cpt_flags::NUMBER },
+            { 'L', unicode_cpt_flags::LETTER },
+            { 'P', unicode_cpt_flags::PUNCTUATION },
+            { 'M', unicode_cpt_flags::ACCENT_MARK },
+            { 'S', unicode_cpt_flags::SYMBOL },
+        };
+
+        const auto cpts = unicode_cpts_from_utf8(regex_expr);
+        size_t i = 0;
+
+        auto at = [&](size_t j) { return j < cpts.size() ? cpts[j] : 0; };
+
+        // \p{X} at j, returns its category or 0
+        auto ucat = [&](size_t j) -> uint16_t {
+            if (at(j) != '\\' || at(j + 1) != 'p' || at(j + 2) != '{' || at(j + 4) != '}') {
+                return 0;
+            }
+            const auto it = k_ucat.find(at(j + 3));
+            return it == k_ucat.end() ? 0 : it->second;
+        };
+
+        // literal at j, possibly escaped
+        auto literal = [&](size_t & j, uint32_t & cpt) -> bool {
+            if (at(j) != '\\') {
+                cpt = at(j++);
+                return cpt != 0;
+            }
+            switch (at(j + 1)) {
+                case 'r': cpt = '\r'; break;
+                case 'n': cpt = '\n'; break;
+                case 't': cpt = '\t'; break;
+                case 'p': case 's': case 'S': case 'd': case 'D': case 'w': case 'W': return false;
+                default:  cpt = at(j + 1); if (unicode_cpt_is_ascii_alpha(cpt) || cpt == 0) { return false; }
+            }
+            j += 2;
+            return true;
+        };
+
+        if (at(0) == ' ' && at(1) == '?') {
+            prefix = ' ';
+            i = 2;
+        } else if (at(0) == '\\' && at(1) == 's' && at(2) == '?') {
+            prefix = 0x0B;
+            i = 3;
+        }
+
+        if (uint16_t cat = ucat(i)) {
+            categories = cat;
+            i += 5;
+        } else if (at(i) == '[') {
+            i++;
+            if (at(i) == '^') {
+                negated = true;
+                i++;
+            }
+            while (at(i) != ']') {
+                if (uint16_t cat = ucat(i)) {
+                    categories |= cat;
+                    i += 5;
+                    continue;
+                }
+                if (at(i) == '\\' && at(i + 1) == 's') {
+                    whitespace = true;
+                    i += 2;
+                    continue;
+                }
+                uint32_t first;
+                uint32_t last;
+                if (!literal(i, first)) {
+                    return false;
+                }
+                last = first;
+                if (at(i) == '-' && at(i + 1) != ']') {
+                    i++;
+                    if (!literal(i, last) || last < first) {
+                        return false;
+                    }
+                }
+                ranges.emplace_back(first, last);
+            }
+            i++;
+        } else {
+            return false;
+        }
+
+        if (at(i) == '+') {
+            n_max = SIZE_MAX;
+            i++;
+        } else if (at(i) == '{') {
+            size_t j = i + 1;
+            size_t n0 = 0;
+            while (at(j) >= '0' && at(j) <= '9') {
+                n0 = 10*n0 + (at(j++) - '0');
+            }
+            size_t n1 = n0;
+            if (at(j) == ',') {
+                j++;
+                n1 = 0;
+                while (at(j) >= '0' && at(j) <= '9') {
+                    n1 = 10*n1 + (at(j++) - '0');
+                }
+            }
+            if (at(j) != '}' || n0 < 1 || n1 < n0) {
+                return false;
+            }
+            n_min = n0;
+            n_max = n1;
+            i = j + 1;
+        }
+
+        if (i != cpts.size()) {
+            return false;
+        }
+
+        std::sort(ranges.begin(), ranges.end());
+
+        return true;
+    }
+
+    std::vector<size_t> split(const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) const {
+        auto run = [&](size_t pos, size_t end) -> size_t {
+            size_t n = 0;
+            while (n < n_max && pos + n < end && contains(cpts[pos + n])) {
+                n++;
+            }
+            return n >= n_min ? pos + n : pos;
+        };
+
+        return unicode_regex_split_matches(offsets, [&](size_t pos, size_t end) -> size_t {
+            if (prefix != 0) {
+                const bool has_prefix = prefix == ' ' ? cpts[pos] == ' ' : unicode_cpt_flags_from_cpt(cpts[pos]).is_whitespace;
+                if (has_prefix) {
+                    const size_t res = run(pos + 1, end);
+                    if (res > pos + 1) {
+                        return res;
+                    }
+                }
+            }
+            return run(pos, end);
+        });
+    }
+};
+
+static std::vector<size_t> unicode_regex_split_custom(const std::vector<uint32_t> & cpts, const std::string & regex_expr, const std::vector<size_t> & offsets) {
+    using split_fn = std::vector<size_t> (*)(const std::vector<uint32_t> &, const std::vector<size_t> &);
+
+    static const std::unordered_map<std::string, split_fn> k_custom = {
+        { "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)",
+            unicode_regex_split_custom_gpt2 },
+        { "(?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_llama3(cpts, offsets); } },
+        { "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_llama3(cpts, offsets); } },
+        // QWEN2
+        { "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_llama3(cpts, offsets, 1); } },
+        // BAILINGMOE, \s*[\r\n] ends at the last newline like \s*[\r\n]+
+        { "'(?:[sSdDmMtT]|[lL][lL]|[vV][eE]|[rR][eE])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_llama3(cpts, offsets, 1); } },
+        // SEED_CODER
+        { "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1}| ?[^\\s\\p{L}\\p{N}\\r\\n]+|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_llama3(cpts, offsets, 1, false); } },
+        { "[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))*((?=[\\p{L}])([^A-Z]))+|[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))+((?=[\\p{L}])([^A-Z]))*|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n/]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_tekken(cpts, offsets, 1, false); } },
+        // GPT4O
+        { "[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))*((?=[\\p{L}])([^A-Z]))+(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])?|[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))+((?=[\\p{L}])([^A-Z]))*(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])?|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n/]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+            [](const std::vector<uint32_t> & cpts, const std::vector<size_t> & offsets) { return unicode_regex_split_custom_tekken(cpts, offsets, 3, true); } },
+        { "[!\"#$%&'()*+,\\-./:;<=>?@\\[\\\\\\]^_`{|}~][A-Za-z]+|[^\r\n\\p{L}\\p{P}\\p{S}]?[\\p{L}\\p{M}]+| ?[\\p{P}\\p{S}]+[\r\n]*|\\s*[\r\n]+|\\s+(?!\\S)|\\s+",
+            unicode_regex_split_custom_deepseek3 },
+        // K2's first pattern - handle all K2 patterns together
+        { "\\p{Han}+",                              unicode_regex_split_custom_kimi_k2 },
+        { "[0-9][0-9][0-9]",                        unicode_regex_split_custom_digits3 },
+        { "(?=(\\d{3})+(?!\\d))",                   unicode_regex_split_custom_digits3_rtl },
+        { "\\s+$",                                  unicode_regex_split_custom_trailing_whitespaces },
+        { "<sentinel:[0-9]+>",                      unicode_regex_split_custom_chameleon_sentinel },
+        { "(IMGIMG)((A|B|C|D|E|F|G|H|I){1,4})Z",    unicode_regex_split_custom_chameleon_image },
+        { "([\\t\\n]|    |  )",                     unicode_regex_split_custom_chameleon_spaces },
+    };
+
+    const auto it = k_custom.find(regex_expr);
+    if (it != k_custom.end()) {
+        return it->second(cpts, offsets);
+    }
+
+    unicode_regex_class rclass;
+    if (rclass.parse(regex_expr)) {
+        return rclass.split(cpts, offsets);
+    }
+
+    return {};
+}
+
 //
 // interface
 //
@@ -879,7 +1424,7 @@ bool unicode_cpt_is_han(uint32_t cpt) {
     return false;
 }
 
-std::vector<std::string> unicode_regex_split(const std::string & text, const std::vector<std::string> & regex_exprs) {
+std::vector<std::string> unicode_regex_split(const std::string & text, const std::vector<std::string> & regex_exprs, bool use_custom) {
     // unicode categories
     static const std::map<std::string, int> k_ucat_enum = {
         { "\\p{N}", unicode_cpt_flags::NUMBER },
@@ -902,27 +1447,23 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
         { unicode_cpt_flags::LETTER,      "\x41-\x5A\x61-\x7A" }, // A-Za-z
         { unicode_cpt_flags::PUNCTUATION, "\x21-\x23\x25-\x2A\x2C-\x2F\x3A-\x3B\x3F-\x40\\\x5B-\\\x5D\x5F\\\x7B\\\x7D" }, // !-#%-*,-/:-;?-@\[-\]_\{\}
         { unicode_cpt_flags::ACCENT_MARK, "" }, // no sub-128 codepoints
-        { unicode_cpt_flags::SYMBOL,      "\\\x24\\\x2B\x3C-\x3E\x5E\x60\\\x7C" }, // $+<=>^`|
+        { unicode_cpt_flags::SYMBOL,      "\\\x24\\\x2B\x3C-\x3E\x5E\x60\\\x7C\x7E" }, // $+<=>^`|~
     };
 
-    // compute collapsed codepoints only if needed by at least one regex
-    bool need_collapse = false;
-    for (const auto & regex_expr : regex_exprs) {
-        // search for unicode categories
-        for (const auto & ucat : k_ucat_enum) {
-            if (std::string::npos != regex_expr.find(ucat.first)) {
-                need_collapse = true;
-                break;
-            }
-        }
-    }
-
     const auto cpts = unicode_cpts_from_utf8(text);
 
     // generate a "collapsed" representation of the text, where all codepoints are replaced by a single byte
+    // computed only if needed by the std::regex fallback of at least one regex
     // ref: https://github.com/ggml-org/llama.cpp/pull/6920#issuecomment-2081479935
     std::string text_collapsed;
-    if (need_collapse) {
+    bool collapsed = false;
+
+    auto collapse = [&]() {
+        if (collapsed) {
+            return;
+        }
+        collapsed = true;
+
         // collapse all unicode categories
         text_collapsed.resize(cpts.size());
 
@@ -945,17 +1486,19 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
                 text_collapsed[i] = (char) 0xD0; // fallback
             }
         }
-    }
+    };
 
     std::vector<size_t> bpe_offsets = { cpts.size() };
 
     for (const auto & regex_expr : regex_exprs) {
         // first, see if we have an efficient custom regex implementation
-        auto tmp = unicode_regex_split_custom(text, regex_expr, bpe_offsets);
+        if (use_custom) {
+            auto tmp = unicode_regex_split_custom(cpts, regex_expr, bpe_offsets);
 
-        if (!tmp.empty()) {
-            bpe_offsets = std::move(tmp);
-            continue;
+            if (!tmp.empty()) {
+                bpe_offsets = std::move(tmp);
+                continue;
+            }
         }
 
         // fallback to general-purpose std::regex / std::wregex
@@ -1021,6 +1564,7 @@ std::vector<std::string> unicode_regex_split(const std::string & text, const std
 
                 //printf("text_collapsed: %s\n", text_collapsed.c_str());
                 //printf("regex_expr_collapsed: %s\n", regex_expr_collapsed.c_str());
+                collapse();
                 bpe_offsets = unicode_regex_split_stl(text_collapsed, regex_expr_collapsed, bpe_offsets);
             } else {
                 // no unicode category used, we can use std::wregex directly
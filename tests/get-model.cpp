@@ -1,8 +1,11 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <random>
+#include <vector>
 
 #include "get-model.h"
+#include "gguf.h"
 
 char * get_model_or_exit(int argc, char *argv[]) {
     char * model_path;
@@ -19,3 +22,96 @@ char * get_model_or_exit(int argc, char *argv[]) {
 
     return model_path;
 }
+
+bool make_random_model(const char * fname_vocab, const std::string & fname_model, const random_model_params & params) {
+    gguf_init_params gparams = { /*.no_alloc =*/ true, /*.ctx =*/ nullptr };
+    gguf_context * vocab = gguf_init_from_file(fname_vocab, gparams);
+    if (!vocab) {
+        return false;
+    }
+
+    const int64_t key_tokens = gguf_find_key(vocab, "tokenizer.ggml.tokens");
+    if (key_tokens < 0) {
+        gguf_free(vocab);
+        return false;
+    }
+    const int64_t n_vocab = gguf_get_arr_n(vocab, key_tokens);
+
+    ggml_init_params ggml_params = { /*.mem_size =*/ 128ull*1024*1024, /*.mem_buffer =*/ nullptr, /*.no_alloc =*/ false };
+    ggml_context * ctx = ggml_init(ggml_params);
+
+    std::mt19937 rng(42);
+
+    gguf_context * model = gguf_init_empty();
+    gguf_set_kv(model, vocab);
+    gguf_set_val_str(model, "general.architecture", "llama");
+    gguf_set_val_u32(model, "llama.context_length", 256);
+    gguf_set_val_u32(model, "llama.embedding_length", params.n_embd);
+    gguf_set_val_u32(model, "llama.feed_forward_length", params.n_ff);
+    gguf_set_val_u32(model, "llama.block_count", params.n_layer);
+    gguf_set_val_u32(model, "llama.attention.head_count", params.n_head);
+    gguf_set_val_u32(model, "llama.attention.head_count_kv", params.n_head);
+    gguf_set_val_f32(model, "llama.attention.layer_norm_rms_epsilon", 1e-5f);
+    gguf_set_val_u32(model, "llama.rope.dimension_count", params.n_embd/params.n_head);
+    if (params.n_expert > 0) {
+        gguf_set_val_u32(model, "llama.expert_count", params.n_expert);
+        gguf_set_val_u32(model, "llama.expert_used_count", 2);
+    }
+
+    // stddev 0 for the norms, which are set to 1
+    auto add = [&](const std::string & name, std::vector<int64_t> ne, float stddev, enum ggml_type type) {
+        ggml_tensor * t = ggml_new_tensor(ctx, GGML_TYPE_F32, ne.size(), ne.data());
+
+        std::normal_distribution<float> dist(0.0f, stddev);
+        float * data = (float *) t->data;
+        for (int64_t i = 0; i < ggml_nelements(t); ++i) {
+            data[i] = stddev > 0.0f ? dist(rng) : 1.0f;
+        }
+
+        if (type != GGML_TYPE_F32) {
+            ggml_tensor * q = ggml_new_tensor(ctx, type, ne.size(), ne.data());
+            ggml_quantize_chunk(type, data, q->data, 0, ggml_nrows(t), t->ne[0], nullptr);
+            t = q;
+        }
+
+        ggml_set_name(t, name.c_str());
+        gguf_add_tensor(model, t);
+    };
+
+    const int64_t n_embd   = params.n_embd;
+    const int64_t n_ff     = params.n_ff;
+    const int64_t n_expert = params.n_expert;
+
+    add("token_embd.weight",  { n_embd, n_vocab }, 0.5f, GGML_TYPE_F32);
+    add("output_norm.weight", { n_embd },          0.0f, GGML_TYPE_F32);
+    add("output.weight",      { n_embd, n_vocab }, 0.1f, GGML_TYPE_F32);
+
+    for (int il = 0; il < params.n_layer; ++il) {
+        const std::string blk = "blk." + std::to_string(il) + ".";
+
+        add(blk + "attn_norm.weight", { n_embd }, 0.0f, GGML_TYPE_F32);
+        add(blk + "ffn_norm.weight",  { n_embd }, 0.0f, GGML_TYPE_F32);
+        for (const char * name : { "attn_q", "attn_k", "attn_v", "attn_output" }) {
+            add(blk + name + ".weight", { n_embd, n_embd }, 0.1f, params.type);
+        }
+
+        if (n_expert > 0) {
+            add(blk + "ffn_gate_inp.weight",  { n_embd, n_expert },       0.5f, GGML_TYPE_F32);
+            add(blk + "ffn_gate_exps.weight", { n_embd, n_ff, n_expert }, 0.1f, params.type);
+            add(blk + "ffn_up_exps.weight",   { n_embd, n_ff, n_expert }, 0.1f, params.type);
+            add(blk + "ffn_down_exps.weight", { n_ff, n_embd, n_expert }, 0.1f, params.type);
+        } else {
+            add(blk + "ffn_gate.weight", { n_embd, n_ff }, 0.1f, params.type);
+            add(blk + "ffn_up.weight",   { n_embd, n_ff }, 0.1f, params.type);
+            add(blk + "ffn_down.weight", { n_ff, n_embd }, 0.1f, params.type);
+        }
+    }
+
+    const bool ok = gguf_write_to_file(model, fname_model.c_str(), false);
+
+    gguf_free(model);
+    gguf_free(vocab);
+    ggml_free(ctx);
+
+    return ok;
+}
@@ -1,2 +1,21 @@
 #pragma once
+
+#include "ggml.h"
+
+#include <string>
+
 char * get_model_or_exit(int, char*[]);
+
+// shape of the model written by make_random_model()
+struct random_model_params {
+    int n_embd   = 64;
+    int n_ff     = 128;
+    int n_layer  = 2;
+    int n_head   = 4;
+    int n_expert = 0; // 0 for a dense model
+
+    enum ggml_type type = GGML_TYPE_F32; // type of the weight matrices of the layers
+};
+
+// write a llama model with random weights on top of the vocab of fname_vocab, for the tests that need to evaluate a model
+bool make_random_model(const char * fname_vocab, const std::string & fname_model, const random_model_params & params = {});
@@ -6390,7 +6390,7 @@ static std::vector<std::unique_ptr<test_case>> make_test_cases_perf() {
         }
     }
 
-    for (int kv : { 4096, 8192, 16384, }) {
+    for (int kv : { 4096, 8192, 16384, 32768, }) {
         for (int hs : { 64, 128, }) {
             for (int nr : { 1, 4, }) {
                 test_cases.emplace_back(new test_flash_attn_ext(hs, hs, 8, {nr, 1}, kv, 1, true, false, 0, 0, GGML_PREC_F32, GGML_TYPE_F16));
@@ -6398,6 +6398,15 @@ static std::vector<std::unique_ptr<test_case>> make_test_cases_perf() {
         }
     }
 
+    // prompt processing
+    for (int kv : { 512, 4096, }) {
+        for (int hs : { 64, 128, }) {
+            for (ggml_type type_KV : { GGML_TYPE_F16, GGML_TYPE_Q8_0, }) {
+                test_cases.emplace_back(new test_flash_attn_ext(hs, hs, 8, {4, 1}, kv, 512, true, false, 0, 0, GGML_PREC_F32, type_KV));
+            }
+        }
+    }
+
     test_cases.emplace_back(new test_conv_2d_dw({512, 512, 256, 1}, {3, 3, 1, 256}, 1, 1, 1, false));
     test_cases.emplace_back(new test_conv_2d_dw({512, 512, 256, 1}, {3, 3, 1, 256}, 1, 1, 1, true));
 
@@ -0,0 +1,261 @@
+// check the barrier elision of the CPU backend:
+//   - the nodes computed without a barrier between them never depend on each other
+//   - the results are the same as with a barrier after each node (GGML_CPU_NO_BARRIER_ELISION)
+#include "ggml.h"
+#include "ggml-cpu.h"
+#include "../ggml/src/ggml-cpu/barrier-elision.h"
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+static void set_no_elision(bool value) {
+#ifdef _WIN32
+    _putenv_s("GGML_CPU_NO_BARRIER_ELISION", value ? "1" : "");
+#else
+    if (value) {
+        setenv("GGML_CPU_NO_BARRIER_ELISION", "1", 1);
+    } else {
+        unsetenv("GGML_CPU_NO_BARRIER_ELISION");
+    }
+#endif
+}
+
+static bool ranges_overlap(const ggml_tensor * a, const ggml_tensor * b) {
+    const char * a0 = (const char *) a->data;
+    const char * b0 = (const char *) b->data;
+    return a0 < b0 + ggml_nbytes(b) && b0 < a0 + ggml_nbytes(a);
+}
+
+// b is reachable from a through the sources and the view sources
+static bool is_ancestor(const ggml_tensor * a, const ggml_tensor * b, std::set<const ggml_tensor *> & visited) {
+    if (a == nullptr || !visited.insert(a).second) {
+        return false;
+    }
+    if (a == b) {
+        return true;
+    }
+    for (int i = 0; i < GGML_MAX_SRC; ++i) {
+        if (is_ancestor(a->src[i], b, visited)) {
+            return true;
+        }
+    }
+    return is_ancestor(a->view_src, b, visited);
+}
+
+// a writes memory that b reads or writes, or the reverse
+static bool conflicts(const ggml_tensor * a, const ggml_tensor * b) {
+    if (ranges_overlap(a, b)) {
+        return true;
+    }
+    for (int i = 0; i < GGML_MAX_SRC; ++i) {
+        if ((a->src[i] && ranges_overlap(a->src[i], b)) || (b->src[i] && ranges_overlap(a, b->src[i]))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// nodes that use the work buffer, or synchronize internally
+static bool uses_wdata(const ggml_tensor * t) {
+    switch (t->op) {
+        case GGML_OP_SOFT_MAX:
+        case GGML_OP_ROPE:
+        case GGML_OP_MUL_MAT:
+            return true;
+        case GGML_OP_ADD:
+            return ggml_is_quantized(t->src[0]->type);
+        case GGML_OP_CPY:
+        case GGML_OP_DUP:
+        case GGML_OP_CONT:
+            return t->src[0]->type != t->type;
+        default:
+            return false;
+    }
+}
+
+static ggml_tensor * new_rand(ggml_context * ctx, ggml_type type, int64_t ne0, int64_t ne1, std::mt19937 & rng) {
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    std::vector<float> data(ne0*ne1);
+    for (auto & v : data) {
+        v = dist(rng);
+    }
+
+    ggml_tensor * t = ggml_new_tensor_2d(ctx, type, ne0, ne1);
+    if (type == GGML_TYPE_F32) {
+        memcpy(t->data, data.data(), ggml_nbytes(t));
+    } else {
+        ggml_quantize_chunk(type, data.data(), t->data, 0, ne1, ne0, nullptr);
+    }
+    return t;
+}
+
+int main(int argc, char ** argv) {
+    const int n_threads = argc > 1 ? std::atoi(argv[1]) : 4;
+    const int n_rounds  = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    ggml_init_params params = { /*.mem_size =*/ 64*1024*1024, /*.mem_buffer =*/ nullptr, /*.no_alloc =*/ false };
+    ggml_context * ctx = ggml_init(params);
+
+    std::mt19937 rng(1234);
+
+    const int64_t ne0 = 64;
+    const int64_t ne1 = 32;
+
+    constexpr int n_x = 6;
+
+    std::vector<ggml_tensor *> inputs;
+
+    ggml_tensor * x[n_x];
+    for (auto & t : x) {
+        t = new_rand(ctx, GGML_TYPE_F32, ne0, ne1, rng);
+        inputs.push_back(t);
+    }
+    ggml_tensor * w = new_rand(ctx, GGML_TYPE_F32,  ne0, ne1, rng);
+    ggml_tensor * q = new_rand(ctx, GGML_TYPE_Q8_0, ne0, ne1, rng);
+    ggml_tensor * m = new_rand(ctx, GGML_TYPE_F32,  ne0, ne0, rng);
+    inputs.push_back(w);
+    inputs.push_back(q);
+    inputs.push_back(m);
+
+    ggml_tensor * pos = ggml_new_tensor_1d(ctx, GGML_TYPE_I32, ne1);
+    for (int i = 0; i < ne1; ++i) {
+        ((int32_t *) pos->data)[i] = i;
+    }
+
+    // destination of the copies through overlapping views
+    ggml_tensor * buf = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 4*ne0*ne1);
+    inputs.push_back(buf);
+
+    ggml_cgraph * gf = ggml_new_graph(ctx);
+
+    // independent nodes, followed by nodes that read their results
+    ggml_tensor * y[n_x];
+    for (int i = 0; i < n_x; ++i) {
+        y[i] = ggml_scale(ctx, x[i], 0.5f + i);
+        ggml_build_forward_expand(gf, y[i]);
+    }
+    for (int i = 0; i < n_x; ++i) {
+        ggml_build_forward_expand(gf, ggml_mul(ctx, y[i], w));
+    }
+
+    // nodes that use the work buffer
+    ggml_build_forward_expand(gf, ggml_soft_max(ctx, x[0]));
+    ggml_build_forward_expand(gf, ggml_soft_max(ctx, x[1]));
+    ggml_build_forward_expand(gf, ggml_add(ctx, q, x[2]));
+    ggml_build_forward_expand(gf, ggml_rope(ctx, ggml_reshape_3d(ctx, x[3], 16, 4, ne1), pos, 16, 0));
+    ggml_build_forward_expand(gf, ggml_sqr(ctx, x[4]));
+
+    // writes through overlapping and disjoint views of the same buffer
+    const size_t n = ne0*ne1;
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, x[0], ggml_view_1d(ctx, buf, n, 0)));
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, x[1], ggml_view_1d(ctx, buf, n, n/2*sizeof(float))));
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, x[2], ggml_view_1d(ctx, buf, n, 2*n*sizeof(float))));
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, x[3], ggml_view_1d(ctx, buf, n, 3*n*sizeof(float))));
+
+    // a read of the buffer and a conversion that uses the work buffer
+    ggml_build_forward_expand(gf, ggml_scale(ctx, ggml_view_2d(ctx, buf, ne0, ne1, ne0*sizeof(float), n/4*sizeof(float)), 2.0f));
+    ggml_build_forward_expand(gf, ggml_cpy(ctx, x[5], ggml_new_tensor_2d(ctx, GGML_TYPE_F16, ne0, ne1)));
+
+    // a node that cannot overlap, then in-place writes to memory that earlier nodes read
+    ggml_build_forward_expand(gf, ggml_mul_mat(ctx, m, x[4]));
+    ggml_build_forward_expand(gf, ggml_scale_inplace(ctx, x[4], 3.0f));
+    ggml_build_forward_expand(gf, ggml_scale_inplace(ctx, x[5], 3.0f));
+    ggml_build_forward_expand(gf, ggml_add_inplace(ctx, x[4], x[5]));
+
+    const int n_nodes = ggml_graph_n_nodes(gf);
+
+    // replay the grouping decisions of the threads
+    {
+        ggml_overlap_group group = { { nullptr }, 0, false };
+
+        std::vector<ggml_tensor *> cur;
+        int n_elided = 0;
+
+        for (int i = 0; i < n_nodes; ++i) {
+            ggml_tensor * node = ggml_graph_node(gf, i);
+
+            const bool sync = ggml_overlap_group_add(&group, node);
+            if (ggml_node_is_noop(node)) {
+                assert(!sync);
+                continue;
+            }
+            if (sync) {
+                cur.clear();
+            }
+
+            for (ggml_tensor * other : cur) {
+                std::set<const ggml_tensor *> visited;
+                if (is_ancestor(node, other, visited) || conflicts(node, other) || (uses_wdata(node) && uses_wdata(other))) {
+                    fprintf(stderr, "%s: node %d (%s) is grouped with %s\n", __func__, i, ggml_op_desc(node), ggml_op_desc(other));
+                    return 1;
+                }
+            }
+            assert(cur.empty() || node->op != GGML_OP_MUL_MAT);
+
+            n_elided += !cur.empty();
+            cur.push_back(node);
+        }
+
+        printf("%d of %d nodes run without a barrier\n", n_elided, n_nodes);
+
+        // at least the independent scales are grouped
+        assert(n_elided >= n_x - 1);
+    }
+
+    ggml_threadpool_params tpp = ggml_threadpool_params_default(n_threads);
+    ggml_threadpool * threadpool = ggml_threadpool_new(&tpp);
+    assert(threadpool);
+
+    ggml_cplan cplan = ggml_graph_plan(gf, n_threads, threadpool);
+    std::vector<uint8_t> work_data(cplan.work_size);
+    cplan.work_data = work_data.data();
+
+    std::vector<std::vector<uint8_t>> saved;
+    for (ggml_tensor * t : inputs) {
+        const uint8_t * data = (const uint8_t *) t->data;
+        saved.emplace_back(data, data + ggml_nbytes(t));
+    }
+
+    // the in-place ops modify the inputs, so they are restored before each run
+    const auto run = [&]() {
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            memcpy(inputs[i]->data, saved[i].data(), saved[i].size());
+        }
+        assert(ggml_graph_compute(gf, &cplan) == GGML_STATUS_SUCCESS);
+
+        std::vector<std::vector<uint8_t>> res;
+        for (int i = 0; i < n_nodes; ++i) {
+            const uint8_t * data = (const uint8_t *) ggml_graph_node(gf, i)->data;
+            res.emplace_back(data, data + ggml_nbytes(ggml_graph_node(gf, i)));
+        }
+        return res;
+    };
+
+    set_no_elision(true);
+    const auto ref = run();
+    set_no_elision(false);
+
+    for (int r = 0; r < n_rounds; ++r) {
+        const auto res = run();
+        for (int i = 0; i < n_nodes; ++i) {
+            if (res[i] != ref[i]) {
+                fprintf(stderr, "%s: round %d: node %d (%s) differs from the result without elision\n", __func__, r, i, ggml_op_desc(ggml_graph_node(gf, i)));
+                return 1;
+            }
+        }
+    }
+
+    printf("%d rounds with %d threads: OK\n", n_rounds, n_threads);
+
+    ggml_threadpool_free(threadpool);
+    ggml_free(ctx);
+
+    return 0;
+}
@@ -0,0 +1,282 @@
+// compare the blocked flash_attn_ext kernel of the CPU backend, used from GGML_FA_TILE_MIN_Q query rows,
+// with the per-row kernel on splits of the same problem in fewer rows
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+#include "ggml-cpu.h"
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// the per-row kernel rounds Q to the vec_dot_type of K, F16 and BF16, while the blocked kernel converts K to F32,
+// and it accumulates F16 V in F16, so the KV chunks of the split also change the rounding
+constexpr double MAX_NMSE      = 1e-10;
+constexpr double MAX_NMSE_HALF = 1e-4;
+
+static double nmse(const std::vector<float> & a, const std::vector<float> & b) {
+    double mse = 0.0;
+    double ref = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        mse += (a[i] - b[i]) * (a[i] - b[i]);
+        ref += b[i] * b[i];
+    }
+    return mse / ref;
+}
+
+struct test_case {
+    ggml_type type_k;
+    int64_t   dk;
+    int64_t   dv;
+    int64_t   n_head;
+    int64_t   n_head_kv;
+    int64_t   n_kv;
+    int64_t   n_q;
+    bool      mask;
+    float     max_bias;
+    float     softcap;
+    bool      sinks;
+};
+
+static void fill(ggml_tensor * t, std::mt19937 & rng, float lo, float hi) {
+    std::uniform_real_distribution<float> dist(lo, hi);
+
+    std::vector<float> data(ggml_nelements(t));
+    for (auto & v : data) {
+        v = dist(rng);
+    }
+    ggml_backend_tensor_set(t, data.data(), 0, ggml_nbytes(t));
+}
+
+// masks the KV rows [j0, j1) for all the queries and a causal end that masks the last KV rows for the first queries,
+// with small biases in between, scaled by the ALiBi slopes when max_bias > 0
+static void set_mask(ggml_tensor * mask, int64_t n_q, int64_t n_kv, int64_t j0, int64_t j1, std::mt19937 & rng) {
+    std::uniform_real_distribution<float> dist(-1.0f, 0.0f);
+
+    std::vector<ggml_fp16_t> data(ggml_nelements(mask), ggml_fp32_to_fp16(0.0f));
+    for (int64_t i = 0; i < n_q; ++i) {
+        for (int64_t j = 0; j < n_kv; ++j) {
+            const bool masked = (j >= j0 && j < j1) || j > n_kv - n_q + i;
+            data[i*n_kv + j] = ggml_fp32_to_fp16(masked ? -INFINITY : dist(rng));
+        }
+    }
+    ggml_backend_tensor_set(mask, data.data(), 0, ggml_nbytes(mask));
+}
+
+// returns the NMSE of the n_q rows computed at once against the same rows computed n_sub at a time
+static double run_test(const test_case & tc, ggml_backend_t backend, int64_t n_sub, std::mt19937 & rng) {
+    const int64_t n_q_pad = tc.n_q + GGML_KQ_MASK_PAD; // room for the padded views of the last rows
+
+    ggml_init_params params = {
+        /* .mem_size   = */ 256*ggml_tensor_overhead() + ggml_graph_overhead(),
+        /* .mem_buffer = */ nullptr,
+        /* .no_alloc   = */ true,
+    };
+
+    ggml_context * ctx = ggml_init(params);
+
+    ggml_tensor * q     = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.dk, tc.n_q, tc.n_head);
+    ggml_tensor * k32   = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.dk, tc.n_kv, tc.n_head_kv);
+    ggml_tensor * v32   = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.dv, tc.n_kv, tc.n_head_kv);
+    ggml_tensor * mask  = tc.mask  ? ggml_new_tensor_2d(ctx, GGML_TYPE_F16, tc.n_kv, n_q_pad) : nullptr;
+    ggml_tensor * sinks = tc.sinks ? ggml_new_tensor_1d(ctx, GGML_TYPE_F32, tc.n_head)        : nullptr;
+
+    // K and V are converted in the graph, so that both kernels read the same data
+    ggml_tensor * k = ggml_cpy(ctx, k32, ggml_new_tensor_3d(ctx, tc.type_k, tc.dk, tc.n_kv, tc.n_head_kv));
+    ggml_tensor * v = ggml_cpy(ctx, v32, ggml_new_tensor_3d(ctx, tc.type_k, tc.dv, tc.n_kv, tc.n_head_kv));
+
+    const float scale = 1.0f/sqrtf(tc.dk);
+
+    auto build_fa = [&](ggml_tensor * q, ggml_tensor * mask) {
+        ggml_tensor * fa = ggml_flash_attn_ext(ctx, q, k, v, mask, scale, tc.max_bias, tc.softcap);
+        ggml_flash_attn_ext_add_sinks(fa, sinks);
+        ggml_flash_attn_ext_set_prec(fa, GGML_PREC_F32);
+        return fa;
+    };
+
+    ggml_cgraph * gf = ggml_new_graph(ctx);
+
+    ggml_tensor * out = build_fa(q, mask);
+    ggml_build_forward_expand(gf, out);
+
+    std::vector<ggml_tensor *> outs_sub;
+    for (int64_t i0 = 0; i0 < tc.n_q; i0 += n_sub) {
+        const int64_t n = std::min(n_sub, tc.n_q - i0);
+
+        ggml_tensor * q_sub    = ggml_view_3d(ctx, q, tc.dk, n, tc.n_head, q->nb[1], q->nb[2], i0*q->nb[1]);
+        ggml_tensor * mask_sub = mask ? ggml_view_2d(ctx, mask, tc.n_kv, GGML_PAD(n, GGML_KQ_MASK_PAD), mask->nb[1], i0*mask->nb[1]) : nullptr;
+
+        outs_sub.push_back(build_fa(q_sub, mask_sub));
+        ggml_build_forward_expand(gf, outs_sub.back());
+    }
+
+    ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors(ctx, backend);
+
+    fill(q,   rng, -1.0f, 1.0f);
+    fill(k32, rng, -1.0f, 1.0f);
+    fill(v32, rng, -1.0f, 1.0f);
+
+    if (sinks) {
+        fill(sinks, rng, -2.0f, 2.0f);
+    }
+
+    if (mask) {
+        // a KV tile masked for all the queries
+        set_mask(mask, tc.n_q, tc.n_kv, 64, 128, rng);
+    }
+
+    ggml_backend_graph_compute(backend, gf);
+
+    // the rows of the output are the query rows, the split outputs follow each other
+    std::vector<float> res(ggml_nelements(out));
+    std::vector<float> res_sub;
+    ggml_backend_tensor_get(out, res.data(), 0, ggml_nbytes(out));
+    for (ggml_tensor * t : outs_sub) {
+        const size_t n = res_sub.size();
+        res_sub.resize(n + ggml_nelements(t));
+        ggml_backend_tensor_get(t, res_sub.data() + n, 0, ggml_nbytes(t));
+    }
+    assert(res.size() == res_sub.size());
+
+    ggml_backend_buffer_free(buf);
+    ggml_free(ctx);
+
+    return nmse(res, res_sub);
+}
+
+// decode with n_threads threads that do not divide the number of heads splits the KV length in chunks of at least
+// GGML_FA_SPLIT_KV_MIN rows, reduced at the end - returns the NMSE against the same graph computed with one thread
+static double run_test_split_kv(const test_case & tc, ggml_backend_t backend, int n_threads, int64_t j0, int64_t j1, std::mt19937 & rng) {
+    assert(tc.n_q == 1 && tc.n_head % n_threads != 0);
+
+    ggml_init_params params = {
+        /* .mem_size   = */ 16*ggml_tensor_overhead() + ggml_graph_overhead(),
+        /* .mem_buffer = */ nullptr,
+        /* .no_alloc   = */ true,
+    };
+
+    ggml_context * ctx = ggml_init(params);
+
+    ggml_tensor * q     = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.dk, tc.n_q, tc.n_head);
+    ggml_tensor * k32   = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.dk, tc.n_kv, tc.n_head_kv);
+    ggml_tensor * v32   = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.dv, tc.n_kv, tc.n_head_kv);
+    ggml_tensor * mask  = tc.mask  ? ggml_new_tensor_2d(ctx, GGML_TYPE_F16, tc.n_kv, GGML_KQ_MASK_PAD) : nullptr;
+    ggml_tensor * sinks = tc.sinks ? ggml_new_tensor_1d(ctx, GGML_TYPE_F32, tc.n_head)                : nullptr;
+
+    ggml_tensor * k = ggml_cpy(ctx, k32, ggml_new_tensor_3d(ctx, tc.type_k, tc.dk, tc.n_kv, tc.n_head_kv));
+    ggml_tensor * v = ggml_cpy(ctx, v32, ggml_new_tensor_3d(ctx, tc.type_k, tc.dv, tc.n_kv, tc.n_head_kv));
+
+    ggml_tensor * out = ggml_flash_attn_ext(ctx, q, k, v, mask, 1.0f/sqrtf(tc.dk), tc.max_bias, tc.softcap);
+    ggml_flash_attn_ext_add_sinks(out, sinks);
+    ggml_flash_attn_ext_set_prec(out, GGML_PREC_F32);
+
+    ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, out);
+
+    ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors(ctx, backend);
+
+    fill(q,   rng, -1.0f, 1.0f);
+    fill(k32, rng, -1.0f, 1.0f);
+    fill(v32, rng, -1.0f, 1.0f);
+
+    if (sinks) {
+        fill(sinks, rng, -2.0f, 2.0f);
+    }
+
+    if (mask) {
+        set_mask(mask, tc.n_q, tc.n_kv, j0, j1, rng);
+    }
+
+    std::vector<float> res(ggml_nelements(out));
+    std::vector<float> res_ref(ggml_nelements(out));
+
+    ggml_backend_cpu_set_n_threads(backend, n_threads);
+    ggml_backend_graph_compute(backend, gf);
+    ggml_backend_tensor_get(out, res.data(), 0, ggml_nbytes(out));
+
+    ggml_backend_cpu_set_n_threads(backend, 1);
+    ggml_backend_graph_compute(backend, gf);
+    ggml_backend_tensor_get(out, res_ref.data(), 0, ggml_nbytes(out));
+
+    ggml_backend_buffer_free(buf);
+    ggml_free(ctx);
+
+    return nmse(res, res_ref);
+}
+
+int main() {
+    ggml_backend_t backend = ggml_backend_cpu_init();
+
+    const ggml_type types[] = { GGML_TYPE_F32, GGML_TYPE_F16, GGML_TYPE_BF16, GGML_TYPE_Q8_0 };
+
+    std::mt19937 rng(1234);
+
+    int n_fail = 0;
+
+    for (int n_threads : { 1, 3 }) {
+        ggml_backend_cpu_set_n_threads(backend, n_threads);
+
+        for (ggml_type type : types) {
+            // n_kv is not a multiple of the KV tile, n_q covers a full query tile and a partial one
+            const test_case cases[] = {
+                { type, 64, 64, 4, 2, 200, 40, false, 0.0f,  0.0f, false },
+                { type, 64, 64, 4, 2, 200, 40, true,  0.0f,  0.0f, false },
+                { type, 64, 64, 4, 2, 200, 40, true,  0.0f, 30.0f, false },
+                { type, 64, 64, 4, 2, 200, 40, true,  8.0f,  0.0f, false },
+                { type, 64, 64, 4, 2, 200, 40, true,  0.0f,  0.0f, true  },
+                { type, 96, 64, 4, 4, 200,  8, true,  8.0f, 30.0f, true  },
+            };
+
+            for (const auto & tc : cases) {
+                // the per-row kernel is used below GGML_FA_TILE_MIN_Q rows
+                for (int64_t n_sub : { 1, 5 }) {
+                    const double err = run_test(tc, backend, n_sub, rng);
+
+                    const bool half = type == GGML_TYPE_F16 || type == GGML_TYPE_BF16;
+                    const bool ok   = err <= (half ? MAX_NMSE_HALF : MAX_NMSE);
+                    n_fail += !ok;
+
+                    printf("%s : n_threads = %d, %-5s dk = %3lld, n_q = %2lld, n_sub = %lld, mask = %d, max_bias = %.0f, softcap = %.0f, sinks = %d: nmse = %.2e %s\n", __func__,
+                            n_threads, ggml_type_name(type), (long long) tc.dk, (long long) tc.n_q, (long long) n_sub,
+                            tc.mask, tc.max_bias, tc.softcap, tc.sinks, err, ok ? "ok" : "FAILED");
+                }
+            }
+        }
+    }
+
+    for (ggml_type type : types) {
+        // 5 heads on 3 threads: 1000 KV rows in 3 chunks of 334 rows, the second one fully masked
+        // 3 heads on 2 threads: 512 KV rows in 2 chunks of 256 rows, the last one fully masked
+        struct split_kv_case {
+            test_case tc;
+            int       n_threads;
+            int64_t   j0;
+            int64_t   j1;
+        };
+        const split_kv_case cases[] = {
+            { { type, 64, 64, 5, 5, 1000, 1, false, 0.0f,  0.0f, false }, 3,   0,    0 },
+            { { type, 64, 64, 5, 5, 1000, 1, true,  0.0f,  0.0f, false }, 3, 334,  668 },
+            { { type, 64, 64, 5, 5, 1000, 1, true,  8.0f, 30.0f, true  }, 3, 334,  668 },
+            { { type, 64, 64, 3, 1,  512, 1, true,  0.0f,  0.0f, true  }, 2, 256,  512 },
+        };
+
+        for (const auto & c : cases) {
+            const double err = run_test_split_kv(c.tc, backend, c.n_threads, c.j0, c.j1, rng);
+
+            const bool ok = err <= (type == GGML_TYPE_F16 ? MAX_NMSE_HALF : MAX_NMSE);
+            n_fail += !ok;
+
+            printf("%s : split kv, n_threads = %d, %-5s n_head = %lld, n_kv = %4lld, masked = [%lld, %lld), max_bias = %.0f, softcap = %.0f, sinks = %d: nmse = %.2e %s\n", __func__,
+                    c.n_threads, ggml_type_name(type), (long long) c.tc.n_head, (long long) c.tc.n_kv, (long long) c.j0, (long long) c.j1,
+                    c.tc.max_bias, c.tc.softcap, c.tc.sinks, err, ok ? "ok" : "FAILED");
+        }
+    }
+
+    ggml_backend_free(backend);
+
+    return n_fail == 0 ? 0 : 1;
+}
@@ -10,6 +10,7 @@
 #include <nlohmann/json.hpp>
 
 #include <cassert>
+#include <cmath>
 #include <string>
 #include <vector>
 
@@ -1295,7 +1296,98 @@ static void test_json_schema() {
     );
 }
 
-int main() {
+// allowed tokens after applying the grammar to candidates [begin, end) of the vocab
+static std::vector<bool> apply_grammar(const llama_grammar & grammar, llama_token begin, llama_token end, std::vector<bool> res) {
+    std::vector<llama_token_data> cur;
+    for (llama_token id = begin; id < end; ++id) {
+        cur.push_back({ id, 0.0f, 0.0f });
+    }
+
+    llama_token_data_array cur_p = { cur.data(), cur.size(), -1, false };
+    llama_grammar_apply_impl(grammar, &cur_p);
+
+    for (const auto & td : cur) {
+        res[td.id] = std::isfinite(td.logit);
+    }
+
+    return res;
+}
+
+static void test_token_mask(const llama_vocab * vocab, const std::string & grammar_str, const std::vector<std::string> & prefixes) {
+    fprintf(stderr, "⚫ Testing token masks for grammar: %s\n", grammar_str.c_str());
+
+    const llama_token n_vocab = llama_vocab_n_tokens(vocab);
+
+    for (const auto & prefix : prefixes) {
+        fprintf(stderr, "    \"%s\" ", prefix.c_str());
+
+        // the whole vocab goes through the cached bitmask of the grammar state
+        auto * grammar = llama_grammar_init_impl(vocab, grammar_str.c_str(), "root", false, nullptr, 0, nullptr, 0);
+        llama_grammar_accept_str(*grammar, prefix);
+
+        // twice, so that the second time the mask comes from the cache
+        const auto mask = apply_grammar(*grammar, 0, n_vocab, std::vector<bool>(n_vocab));
+        assert(apply_grammar(*grammar, 0, n_vocab, std::vector<bool>(n_vocab)) == mask);
+
+        // small candidate sets are checked one by one with llama_grammar_reject_candidates
+        // a separate grammar, so that no mask is cached for its states
+        auto * grammar_ref = llama_grammar_init_impl(vocab, grammar_str.c_str(), "root", false, nullptr, 0, nullptr, 0);
+        llama_grammar_accept_str(*grammar_ref, prefix);
+
+        std::vector<bool> ref(n_vocab);
+        const llama_token n_chunk = 64;
+        for (llama_token begin = 0; begin < n_vocab; begin += n_chunk) {
+            ref = apply_grammar(*grammar_ref, begin, std::min(begin + n_chunk, n_vocab), std::move(ref));
+        }
+
+        size_t n_allowed = 0;
+        for (llama_token id = 0; id < n_vocab; ++id) {
+            if (mask[id] != ref[id]) {
+                fprintf(stderr, "❌ (token %d '%s': mask %d, reject_candidates %d)\n", id, llama_vocab_get_text(vocab, id), (int) mask[id], (int) ref[id]);
+            }
+            assert(mask[id] == ref[id]);
+            n_allowed += mask[id];
+        }
+
+        fprintf(stdout, "✅︎ (%zu allowed)\n", n_allowed);
+
+        llama_grammar_free_impl(grammar_ref);
+        llama_grammar_free_impl(grammar);
+    }
+}
+
+static void test_token_masks(const char * fname_vocab) {
+    llama_backend_init();
+
+    auto mparams = llama_model_default_params();
+    mparams.vocab_only = true;
+
+    llama_model * model = llama_model_load_from_file(fname_vocab, mparams);
+    assert(model != nullptr);
+
+    const llama_vocab * vocab = llama_model_get_vocab(model);
+
+    test_token_mask(vocab, R"""(root ::= "abc" | "abd" [0-9]+)""", { "", "a", "ab", "abd", "abd12" });
+    test_token_mask(vocab, R"""(root ::= [a-z]+ (" " [a-z]+)* ".")""", { "", "the", "the ", "the quick brown" });
+    test_token_mask(vocab, R"""(root ::= [^\x00-\x7F]+ | "é" "x"?)""", { "", "é", "日本", "\xe6" });
+    test_token_mask(vocab, R"""(
+        root  ::= "{" ws "\"" key "\":" ws value ws "}"
+        key   ::= [a-z]+
+        value ::= [0-9]+ | "true" | "false" | "[" ws (value ("," ws value)*)? ws "]"
+        ws    ::= [ \t\n]*)""", { "", "{", "{\"", "{\"ab", "{\"ab\": ", "{\"ab\": [1, tr" });
+    test_token_mask(vocab, json_schema_to_grammar(json::parse(R"""({
+            "type": "object",
+            "properties": {
+                "name": { "type": "string" },
+                "tags": { "type": "array", "items": { "type": "string", "enum": ["a", "bc"] } }
+            }
+        })""")), { "", "{", "{\"name\": \"x", "{\"name\": \"x\", \"tags\": [\"b" });
+
+    llama_model_free(model);
+    llama_backend_free();
+}
+
+int main(int argc, char ** argv) {
     fprintf(stdout, "Running grammar integration tests...\n");
     test_simple_grammar();
     test_complex_grammar();
@@ -1305,6 +1397,9 @@ int main() {
     test_failure_missing_reference();
     test_failure_left_recursion();
     test_json_schema();
+    if (argc > 1) {
+        test_token_masks(argv[1]);
+    }
     fprintf(stdout, "All tests passed.\n");
     return 0;
 }
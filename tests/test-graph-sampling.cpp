@@ -0,0 +1,143 @@
+// check the candidates sampled in the graph (llama_set_graph_sampling) against the same sampling on the host logits
+// the model is a tiny random llama built on top of the vocab passed as the first argument
+#include "llama.h"
+#include "get-model.h"
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+static llama_context * make_context(llama_model * model, int32_t top_k, float temp) {
+    llama_context_params cparams = llama_context_default_params();
+    cparams.n_ctx     = 256;
+    cparams.n_batch   = 64;
+    cparams.n_threads = 2;
+    cparams.n_threads_batch = 2;
+
+    llama_context * ctx = llama_init_from_model(model, cparams);
+    assert(ctx);
+
+    if (top_k > 0) {
+        llama_set_graph_sampling(ctx, top_k, temp);
+    }
+
+    return ctx;
+}
+
+// a prompt of 8 tokens with n_outputs outputs at the end, followed by single token steps
+static void decode(llama_context * ctx, int step, int n_outputs) {
+    const int n_tokens = step == 0 ? 8 : 1;
+    const int pos0     = step == 0 ? 0 : 8 + step - 1;
+
+    llama_batch batch = llama_batch_init(n_tokens, 0, 1);
+    for (int i = 0; i < n_tokens; ++i) {
+        batch.token   [i]    = 100 + 13*(pos0 + i);
+        batch.pos     [i]    = pos0 + i;
+        batch.n_seq_id[i]    = 1;
+        batch.seq_id  [i][0] = 0;
+        batch.logits  [i]    = i >= n_tokens - n_outputs;
+    }
+    batch.n_tokens = n_tokens;
+
+    assert(llama_decode(ctx, batch) == 0);
+
+    llama_batch_free(batch);
+}
+
+static void test(llama_model * model, int32_t top_k, float temp) {
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(model));
+
+    llama_context * ctx_ref = make_context(model, 0, 0.0f);
+    llama_context * ctx     = make_context(model, top_k, temp);
+
+    const bool greedy = top_k == 1 || temp <= 0.0f;
+    const int  k      = greedy ? 1 : std::min(top_k, n_vocab);
+
+    for (int step = 0; step < 3; ++step) {
+        const int n_tokens  = step == 0 ? 8 : 1;
+        const int n_outputs = step == 0 ? 4 : 1;
+
+        decode(ctx_ref, step, n_outputs);
+        decode(ctx,     step, n_outputs);
+
+        for (int i = n_tokens - n_outputs; i < n_tokens; ++i) {
+            const float * logits = llama_get_logits_ith(ctx_ref, i);
+            assert(logits);
+
+            // host top-k, ties broken by the token id like in the graph
+            std::vector<llama_token> ids_ref(n_vocab);
+            std::iota(ids_ref.begin(), ids_ref.end(), 0);
+            std::partial_sort(ids_ref.begin(), ids_ref.begin() + k, ids_ref.end(), [logits](llama_token a, llama_token b) {
+                return logits[a] > logits[b] || (logits[a] == logits[b] && a < b);
+            });
+
+            const llama_token * ids   = nullptr;
+            const float       * probs = nullptr;
+            assert(llama_get_sampled_ith(ctx, i, &ids, &probs) == k);
+
+            if (greedy) {
+                assert(probs == nullptr);
+                assert(ids[0] == ids_ref[0]);
+                continue;
+            }
+
+            std::vector<float> probs_ref(k);
+            float sum = 0.0f;
+            for (int j = 0; j < k; ++j) {
+                probs_ref[j] = std::exp((logits[ids_ref[j]] - logits[ids_ref[0]])/temp);
+                sum += probs_ref[j];
+            }
+
+            for (int j = 0; j < k; ++j) {
+                assert(ids[j] == ids_ref[j]);
+                assert(std::fabs(probs[j] - probs_ref[j]/sum) < 1e-4f);
+            }
+        }
+    }
+
+    printf("top_k = %d, temp = %.2f: OK\n", top_k, temp);
+
+    llama_free(ctx);
+    llama_free(ctx_ref);
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <vocab-file>\n", argv[0]);
+        return 1;
+    }
+
+    const std::string fname_model = "test-graph-sampling-" + std::to_string(getpid()) + ".gguf";
+
+    if (!make_random_model(argv[1], fname_model)) {
+        fprintf(stderr, "%s: failed to create the test model from %s\n", __func__, argv[1]);
+        return 1;
+    }
+
+    llama_backend_init();
+
+    llama_model_params mparams = llama_model_default_params();
+    mparams.n_gpu_layers = 0;
+
+    llama_model * model = llama_model_load_from_file(fname_model.c_str(), mparams);
+    assert(model);
+
+    test(model, 1,  0.7f);
+    test(model, 40, 0.0f);
+    test(model, 40, 0.7f);
+    test(model, 5,  1.5f);
+
+    llama_model_free(model);
+    llama_backend_free();
+
+    remove(fname_model.c_str());
+
+    return 0;
+}
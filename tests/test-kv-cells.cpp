@@ -0,0 +1,162 @@
+// unit tests of the per-sequence block occupancy of llama_kv_cells and of the placement of new cells in blocks
+#include "../src/llama-kv-cells.h"
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <vector>
+
+constexpr uint32_t BS = llama_kv_cells::BLOCK_SIZE;
+
+static void add(llama_kv_cells & cells, uint32_t i, llama_pos p, llama_seq_id s) {
+    cells.pos_set(i, p);
+    cells.seq_add(i, s);
+}
+
+// place the tokens of the sequences seq_ids
+static bool place(const llama_kv_cells & cells, const std::vector<llama_seq_id> & seq_ids, std::vector<uint32_t> & idxs) {
+    std::vector<llama_seq_id>   ids = seq_ids;
+    std::vector<llama_seq_id *> ptrs;
+    for (auto & id : ids) {
+        ptrs.push_back(&id);
+    }
+    return cells.find_slot_blocks(ids.size(), ptrs.data(), idxs);
+}
+
+static void test_blocks() {
+    llama_kv_cells cells;
+    cells.resize(3*BS + 8); // the last block is partial
+
+    assert(cells.n_blocks() == 4);
+    for (uint32_t b = 0; b < cells.n_blocks(); ++b) {
+        assert(cells.blk_get_used(b) == 0);
+    }
+
+    add(cells, 0,      0, 0);
+    add(cells, 1,      1, 0);
+    add(cells, BS + 3, 2, 0);
+    add(cells, BS + 4, 0, 1);
+    cells.seq_add(BS + 4, 2); // shared by seq 1 and 2
+    add(cells, 3*BS,   0, 3);
+
+    assert(cells.blk_get_used(0) == 2);
+    assert(cells.blk_get_used(1) == 2);
+    assert(cells.blk_get_used(2) == 0);
+    assert(cells.blk_get_used(3) == 1);
+
+    assert( cells.blk_has_seq(0, 0) && !cells.blk_has_seq(0, 1));
+    assert( cells.blk_has_seq(1, 0) &&  cells.blk_has_seq(1, 1) && cells.blk_has_seq(1, 2));
+    assert(!cells.blk_has_seq(2, 0));
+    assert( cells.blk_has_seq(3, 3));
+
+    // removing one of the sequences of a shared cell keeps the cell used
+    assert(!cells.seq_rm(BS + 4, 1));
+    assert(!cells.blk_has_seq(1, 1) && cells.blk_has_seq(1, 2));
+    assert(cells.blk_get_used(1) == 2);
+
+    // removing the last one frees it
+    assert(cells.seq_rm(BS + 4, 2));
+    assert(!cells.blk_has_seq(1, 2));
+    assert(cells.blk_get_used(1) == 1);
+
+    // seq_keep drops the cells of the other sequences
+    assert(cells.seq_keep(3*BS, 0));
+    assert(cells.blk_get_used(3) == 0 && !cells.blk_has_seq(3, 3));
+
+    // a shift below 0 removes the cell
+    assert(cells.pos_add(0, -1));
+    assert(cells.blk_get_used(0) == 1 && cells.blk_has_seq(0, 0));
+    assert(cells.pos_add(1, -2));
+    assert(cells.blk_get_used(0) == 0 && !cells.blk_has_seq(0, 0));
+
+    cells.rm(BS + 3);
+    assert(cells.blk_get_used(1) == 0 && !cells.blk_has_seq(1, 0));
+    assert(cells.get_used() == 0);
+
+    // save/restore of the state through cp/set
+    add(cells, 2,      5, 1);
+    add(cells, BS + 1, 6, 1);
+
+    const auto saved = cells.cp(0, 2*BS);
+    cells.reset();
+    assert(cells.blk_get_used(0) == 0 && !cells.blk_has_seq(1, 1));
+
+    cells.set(0, saved);
+    assert(cells.blk_get_used(0) == 1 && cells.blk_get_used(1) == 1);
+    assert(cells.blk_has_seq(0, 1) && cells.blk_has_seq(1, 1));
+
+    printf("%s: OK\n", __func__);
+}
+
+static void test_placement() {
+    llama_kv_cells cells;
+    cells.resize(4*BS);
+
+    // block 0: seq 0, block 1: seq 1, blocks 2 and 3 are empty
+    for (uint32_t i = 0; i < 10; ++i) {
+        add(cells, i,      i, 0);
+        add(cells, BS + i, i, 1);
+    }
+
+    std::vector<uint32_t> idxs;
+
+    // the sequences continue in their own block
+    assert(place(cells, { 1, 0, 1 }, idxs));
+    assert((idxs == std::vector<uint32_t>{ BS + 10, 10, BS + 11 }));
+
+    // a new sequence takes an empty block rather than the free cells of the used blocks
+    // and a second new sequence in the same call takes another empty block
+    assert(place(cells, { 2, 3, 2 }, idxs));
+    assert((idxs == std::vector<uint32_t>{ 2*BS, 3*BS, 2*BS + 1 }));
+
+    // the same call gives the same result, the scratch state of the previous call is reset
+    assert(place(cells, { 2, 3, 2 }, idxs));
+    assert((idxs == std::vector<uint32_t>{ 2*BS, 3*BS, 2*BS + 1 }));
+
+    // a sequence that fills its block continues in an empty block
+    {
+        std::vector<llama_seq_id> seq_ids(BS - 10 + 2, 0);
+        assert(place(cells, seq_ids, idxs));
+        assert(idxs[BS - 10 - 1] == BS - 1);
+        assert(idxs[BS - 10]     == 2*BS);
+        assert(idxs[BS - 10 + 1] == 2*BS + 1);
+    }
+
+    // without an empty block, a new sequence takes any block with free cells
+    for (uint32_t i = 0; i < 5; ++i) {
+        add(cells, 2*BS + i, i, 2);
+        add(cells, 3*BS + i, i, 3);
+    }
+    assert(place(cells, { 4, 4 }, idxs));
+    assert((idxs == std::vector<uint32_t>{ 10, 11 }));
+
+    // once the sequence has a cell in a block, that block is preferred
+    add(cells, 2*BS + 5, 5, 4);
+    assert(place(cells, { 4 }, idxs));
+    assert((idxs == std::vector<uint32_t>{ 2*BS + 6 }));
+
+    // not enough free cells for the whole ubatch
+    {
+        std::vector<llama_seq_id> seq_ids(4*BS - cells.get_used() + 1, 5);
+        assert(!place(cells, seq_ids, idxs));
+
+        seq_ids.pop_back();
+        assert(place(cells, seq_ids, idxs));
+        assert(idxs.size() == seq_ids.size());
+
+        std::vector<bool> seen(4*BS, false);
+        for (uint32_t idx : idxs) {
+            assert(cells.is_empty(idx) && !seen[idx]);
+            seen[idx] = true;
+        }
+    }
+
+    printf("%s: OK\n", __func__);
+}
+
+int main() {
+    test_blocks();
+    test_placement();
+
+    return 0;
+}
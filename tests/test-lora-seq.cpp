@@ -0,0 +1,189 @@
+// check that an adapter applied to a single sequence gives the same logits as the same adapter applied globally
+// the model is a tiny random MoE llama built on top of the vocab passed as the first argument
+#include "ggml.h"
+#include "gguf.h"
+#include "llama.h"
+#include "get-model.h"
+
+#undef NDEBUG
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+constexpr int n_embd   = 64;
+constexpr int n_ff     = 128;
+constexpr int n_layer  = 2;
+constexpr int n_expert = 4;
+constexpr int n_rank   = 8;
+
+static void add_tensor(gguf_context * gguf, ggml_context * ctx, std::mt19937 & rng, const std::string & name, std::vector<int64_t> ne, float stddev) {
+    ggml_tensor * t = ggml_new_tensor(ctx, GGML_TYPE_F32, ne.size(), ne.data());
+    ggml_set_name(t, name.c_str());
+
+    std::normal_distribution<float> dist(0.0f, stddev);
+    float * data = (float *) t->data;
+    for (int64_t i = 0; i < ggml_nelements(t); ++i) {
+        data[i] = stddev > 0.0f ? dist(rng) : 1.0f;
+    }
+
+    gguf_add_tensor(gguf, t);
+}
+
+// the adapter covers both the dense (mul_mat) and the expert (mul_mat_id) weights of the model
+static bool make_lora(const std::string & fname_lora) {
+    ggml_init_params ggml_params = { /*.mem_size =*/ 16ull*1024*1024, /*.mem_buffer =*/ nullptr, /*.no_alloc =*/ false };
+    ggml_context * ctx = ggml_init(ggml_params);
+
+    std::mt19937 rng(42);
+
+    gguf_context * lora = gguf_init_empty();
+    gguf_set_val_str(lora, "general.type", "adapter");
+    gguf_set_val_str(lora, "general.architecture", "llama");
+    gguf_set_val_str(lora, "adapter.type", "lora");
+    gguf_set_val_f32(lora, "adapter.lora.alpha", n_rank);
+
+    for (int il = 0; il < n_layer; ++il) {
+        const std::string blk = "blk." + std::to_string(il) + ".";
+
+        add_tensor(lora, ctx, rng, blk + "attn_q.weight.lora_a", { n_embd, n_rank }, 0.5f);
+        add_tensor(lora, ctx, rng, blk + "attn_q.weight.lora_b", { n_rank, n_embd }, 0.5f);
+        add_tensor(lora, ctx, rng, blk + "ffn_up_exps.weight.lora_a",   { n_embd, n_rank, n_expert }, 0.5f);
+        add_tensor(lora, ctx, rng, blk + "ffn_up_exps.weight.lora_b",   { n_rank, n_ff,   n_expert }, 0.5f);
+        add_tensor(lora, ctx, rng, blk + "ffn_down_exps.weight.lora_a", { n_ff,   n_rank, n_expert }, 0.5f);
+        add_tensor(lora, ctx, rng, blk + "ffn_down_exps.weight.lora_b", { n_rank, n_embd, n_expert }, 0.5f);
+    }
+
+    const bool ok = gguf_write_to_file(lora, fname_lora.c_str(), false);
+
+    gguf_free(lora);
+    ggml_free(ctx);
+
+    return ok;
+}
+
+// decode one token per sequence in a single batch and return the logits of each sequence
+static std::vector<std::vector<float>> eval(llama_model * model, llama_adapter_lora * adapter, bool global, const std::vector<llama_seq_id> & seq_with_adapter, int n_seq) {
+    llama_context_params cparams = llama_context_default_params();
+    cparams.n_ctx     = 256;
+    cparams.n_seq_max = n_seq;
+    cparams.n_threads = 2;
+    cparams.n_threads_batch = 2;
+
+    llama_context * ctx = llama_init_from_model(model, cparams);
+    assert(ctx);
+
+    if (global) {
+        assert(llama_set_adapter_lora(ctx, adapter, 1.0f) == 0);
+    }
+    for (llama_seq_id seq_id : seq_with_adapter) {
+        assert(llama_set_adapter_lora_seq(ctx, adapter, seq_id, 1.0f) == 0);
+    }
+
+    const int n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(model));
+
+    // a few single token steps, so that the batch has n_seq tokens and n_seq outputs
+    std::vector<std::vector<float>> res(n_seq);
+    for (int pos = 0; pos < 3; ++pos) {
+        llama_batch batch = llama_batch_init(n_seq, 0, 1);
+        for (int s = 0; s < n_seq; ++s) {
+            batch.token   [s]    = 100 + 7*pos + s;
+            batch.pos     [s]    = pos;
+            batch.n_seq_id[s]    = 1;
+            batch.seq_id  [s][0] = s;
+            batch.logits  [s]    = true;
+        }
+        batch.n_tokens = n_seq;
+
+        assert(llama_decode(ctx, batch) == 0);
+
+        for (int s = 0; s < n_seq; ++s) {
+            const float * logits = llama_get_logits_ith(ctx, s);
+            res[s].insert(res[s].end(), logits, logits + n_vocab);
+        }
+
+        llama_batch_free(batch);
+    }
+
+    llama_free(ctx);
+
+    return res;
+}
+
+static float max_diff(const std::vector<float> & a, const std::vector<float> & b) {
+    assert(a.size() == b.size());
+    float res = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        res = std::max(res, std::fabs(a[i] - b[i]));
+    }
+    return res;
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <vocab-file>\n", argv[0]);
+        return 1;
+    }
+
+    const std::string fname_model = "test-lora-seq-" + std::to_string(getpid()) + ".gguf";
+    const std::string fname_lora  = "test-lora-seq-" + std::to_string(getpid()) + "-lora.gguf";
+
+    random_model_params params;
+    params.n_embd   = n_embd;
+    params.n_ff     = n_ff;
+    params.n_layer  = n_layer;
+    params.n_expert = n_expert;
+
+    if (!make_random_model(argv[1], fname_model, params) || !make_lora(fname_lora)) {
+        fprintf(stderr, "%s: failed to create the test model from %s\n", __func__, argv[1]);
+        return 1;
+    }
+
+    llama_backend_init();
+
+    llama_model_params mparams = llama_model_default_params();
+    mparams.n_gpu_layers = 0;
+
+    llama_model * model = llama_model_load_from_file(fname_model.c_str(), mparams);
+    assert(model);
+
+    llama_adapter_lora * adapter = llama_adapter_lora_init(model, fname_lora.c_str());
+    assert(adapter);
+
+    constexpr float eps = 1e-4f;
+
+    // single token batches: the tokens of mul_mat_id results are in dim 2 while dim 1 holds n_expert_used
+    {
+        const auto ref  = eval(model, adapter, true,  {},  1);
+        const auto seq  = eval(model, adapter, false, {0}, 1);
+        const auto base = eval(model, adapter, false, {},  1);
+
+        printf("single token: seq vs global %g, seq vs base %g\n", max_diff(seq[0], ref[0]), max_diff(seq[0], base[0]));
+        assert(max_diff(seq[0], ref[0])  < eps);
+        assert(max_diff(seq[0], base[0]) > eps);
+    }
+
+    // sequences with and without the adapter in the same batch
+    {
+        const auto ref  = eval(model, adapter, true,  {},  2);
+        const auto seq  = eval(model, adapter, false, {1}, 2);
+        const auto base = eval(model, adapter, false, {},  2);
+
+        printf("mixed batch: seq 0 vs base %g, seq 1 vs global %g\n", max_diff(seq[0], base[0]), max_diff(seq[1], ref[1]));
+        assert(max_diff(seq[0], base[0]) < eps);
+        assert(max_diff(seq[1], ref[1])  < eps);
+    }
+
+    llama_adapter_lora_free(adapter);
+    llama_model_free(model);
+    llama_backend_free();
+
+    remove(fname_model.c_str());
+    remove(fname_lora.c_str());
+
+    return 0;
+}
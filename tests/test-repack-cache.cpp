@@ -0,0 +1,167 @@
+// check that the weights mapped from the repack cache give the same logits as the weights repacked at load time
+// the model is a tiny random IQ4_NL llama built on top of the vocab passed as the first argument
+#include "llama.h"
+#include "get-model.h"
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+static std::mutex  log_mutex;
+static std::string log_text;
+
+static void log_callback(ggml_log_level /*level*/, const char * text, void * /*user_data*/) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log_text += text;
+}
+
+static bool log_contains(const char * str) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    return log_text.find(str) != std::string::npos;
+}
+
+static void log_clear() {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    log_text.clear();
+}
+
+// load the model and return the logits of a short prompt
+static std::vector<float> eval(const std::string & fname_model, bool use_repack_cache) {
+    llama_model_params mparams = llama_model_default_params();
+    mparams.n_gpu_layers     = 0;
+    mparams.use_repack_cache = use_repack_cache;
+
+    llama_model * model = llama_model_load_from_file(fname_model.c_str(), mparams);
+    assert(model);
+
+    llama_context_params cparams = llama_context_default_params();
+    cparams.n_ctx     = 64;
+    cparams.n_threads = 1;
+    cparams.n_threads_batch = 1;
+
+    llama_context * ctx = llama_init_from_model(model, cparams);
+    assert(ctx);
+
+    const int n_tokens = 8;
+    const int n_vocab  = llama_vocab_n_tokens(llama_model_get_vocab(model));
+
+    llama_batch batch = llama_batch_init(n_tokens, 0, 1);
+    for (int i = 0; i < n_tokens; ++i) {
+        batch.token   [i]    = 100 + 13*i;
+        batch.pos     [i]    = i;
+        batch.n_seq_id[i]    = 1;
+        batch.seq_id  [i][0] = 0;
+        batch.logits  [i]    = true;
+    }
+    batch.n_tokens = n_tokens;
+
+    assert(llama_decode(ctx, batch) == 0);
+
+    std::vector<float> res;
+    for (int i = 0; i < n_tokens; ++i) {
+        const float * logits = llama_get_logits_ith(ctx, i);
+        res.insert(res.end(), logits, logits + n_vocab);
+    }
+
+    llama_batch_free(batch);
+    llama_free(ctx);
+    llama_model_free(model);
+
+    return res;
+}
+
+static float max_diff(const std::vector<float> & a, const std::vector<float> & b) {
+    assert(a.size() == b.size());
+    float res = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i) {
+        res = std::max(res, std::fabs(a[i] - b[i]));
+    }
+    return res;
+}
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <vocab-file>\n", argv[0]);
+        return 1;
+    }
+
+    // the cache files are written next to the model
+    const std::filesystem::path dir = "test-repack-cache-" + std::to_string(getpid());
+    std::filesystem::create_directory(dir);
+
+    const std::string fname_model = (dir / "model.gguf").string();
+
+    random_model_params params;
+    // a type repacked by the CPU_REPACK buffer but not taken by the AMX buffer
+    params.type = GGML_TYPE_IQ4_NL;
+
+    if (!make_random_model(argv[1], fname_model, params)) {
+        fprintf(stderr, "%s: failed to create the test model from %s\n", __func__, argv[1]);
+        std::filesystem::remove_all(dir);
+        return 1;
+    }
+
+    llama_log_set(log_callback, nullptr);
+    llama_backend_init();
+
+    const auto ref = eval(fname_model, false);
+
+    // two loads without a cache write it at the same time
+    log_clear();
+    {
+        std::vector<float> res[2];
+        std::thread threads[2];
+        for (int i = 0; i < 2; ++i) {
+            threads[i] = std::thread([&res, &fname_model, i]() { res[i] = eval(fname_model, true); });
+        }
+        for (auto & t : threads) {
+            t.join();
+        }
+
+        for (const auto & r : res) {
+            assert(max_diff(r, ref) == 0.0f);
+        }
+    }
+
+    if (!log_contains("wrote repack cache")) {
+        // the CPU backend does not repack IQ4_NL on this machine
+        printf("repack cache not written, skipping\n");
+        llama_backend_free();
+        std::filesystem::remove_all(dir);
+        return 0;
+    }
+
+    // no temporary file is left behind, and a single cache file is in place
+    int n_cache = 0;
+    for (const auto & entry : std::filesystem::directory_iterator(dir)) {
+        const std::string name = entry.path().filename().string();
+        printf("%s\n", name.c_str());
+        assert(name.find(".tmp") == std::string::npos);
+        n_cache += name.find(".repack-") != std::string::npos;
+    }
+    assert(n_cache == 1);
+
+    log_clear();
+    {
+        const auto res = eval(fname_model, true);
+        assert(log_contains("mapped repacked tensors"));
+
+        printf("cached vs repacked: %g\n", max_diff(res, ref));
+        assert(max_diff(res, ref) == 0.0f);
+    }
+
+    llama_backend_free();
+
+    std::filesystem::remove_all(dir);
+
+    return 0;
+}
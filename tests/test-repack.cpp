@@ -0,0 +1,202 @@
+// compare mul_mat and mul_mat_id with the weights repacked in the CPU_REPACK buffer with the plain CPU results
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+#include "ggml-cpu.h"
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr double MAX_NMSE = 1e-6;
+
+static ggml_backend_buffer_type_t get_repack_buft() {
+    ggml_backend_dev_t dev = ggml_backend_dev_by_type(GGML_BACKEND_DEVICE_TYPE_CPU);
+    ggml_backend_reg_t reg = ggml_backend_dev_backend_reg(dev);
+
+    auto get_extra_bufts = (ggml_backend_dev_get_extra_bufts_t) ggml_backend_reg_get_proc_address(reg, "ggml_backend_dev_get_extra_bufts");
+    if (!get_extra_bufts) {
+        return nullptr;
+    }
+
+    for (ggml_backend_buffer_type_t * buft = get_extra_bufts(dev); buft && *buft; ++buft) {
+        if (strcmp(ggml_backend_buft_name(*buft), "CPU_REPACK") == 0) {
+            return *buft;
+        }
+    }
+    return nullptr;
+}
+
+static double nmse(const std::vector<float> & a, const std::vector<float> & b) {
+    double mse = 0.0;
+    double ref = 0.0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        mse += (a[i] - b[i]) * (a[i] - b[i]);
+        ref += b[i] * b[i];
+    }
+    return mse / ref;
+}
+
+struct test_case {
+    ggml_type type;
+    int64_t k;      // row size of the weights
+    int64_t n;      // rows of the weights
+    int64_t m;      // tokens
+    int64_t n_as;   // experts for mul_mat_id, 0 for mul_mat
+};
+
+// returns the NMSE of the repacked result, or a negative value if the weights were not repacked
+static double run_test(const test_case & tc, ggml_backend_t backend, ggml_backend_buffer_type_t repack_buft, std::mt19937 & rng, int n_iter, double & t_repack_ms, double & t_plain_ms) {
+    const bool    is_id  = tc.n_as > 0;
+    const int64_t n_as   = is_id ? tc.n_as : 1;
+    const int64_t n_used = is_id ? 2 : 1;
+
+    ggml_init_params params = {
+        /* .mem_size   = */ 16*ggml_tensor_overhead() + 2*ggml_graph_overhead(),
+        /* .mem_buffer = */ nullptr,
+        /* .no_alloc   = */ true,
+    };
+
+    ggml_context * ctx_w = ggml_init(params);
+    ggml_context * ctx   = ggml_init(params);
+
+    ggml_tensor * w_repack = is_id ? ggml_new_tensor_3d(ctx_w, tc.type, tc.k, tc.n, n_as) : ggml_new_tensor_2d(ctx_w, tc.type, tc.k, tc.n);
+    ggml_tensor * w_plain  = is_id ? ggml_new_tensor_3d(ctx,   tc.type, tc.k, tc.n, n_as) : ggml_new_tensor_2d(ctx,   tc.type, tc.k, tc.n);
+
+    ggml_tensor * x   = is_id ? ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc.k, n_used, tc.m) : ggml_new_tensor_2d(ctx, GGML_TYPE_F32, tc.k, tc.m);
+    ggml_tensor * ids = is_id ? ggml_new_tensor_2d(ctx, GGML_TYPE_I32, n_used, tc.m) : nullptr;
+
+    ggml_tensor * out_repack = is_id ? ggml_mul_mat_id(ctx, w_repack, x, ids) : ggml_mul_mat(ctx, w_repack, x);
+    ggml_tensor * out_plain  = is_id ? ggml_mul_mat_id(ctx, w_plain,  x, ids) : ggml_mul_mat(ctx, w_plain,  x);
+
+    ggml_cgraph * gf_repack = ggml_new_graph(ctx);
+    ggml_cgraph * gf_plain  = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf_repack, out_repack);
+    ggml_build_forward_expand(gf_plain,  out_plain);
+
+    ggml_backend_buffer_t buf_w = ggml_backend_alloc_ctx_tensors_from_buft(ctx_w, repack_buft);
+    ggml_backend_buffer_t buf   = ggml_backend_alloc_ctx_tensors(ctx, backend);
+
+    double res = -1.0;
+
+    if (w_repack->extra) {
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+        std::vector<float> data(ggml_nelements(w_plain));
+        for (auto & v : data) {
+            v = dist(rng);
+        }
+        std::vector<uint8_t> qdata(ggml_nbytes(w_plain));
+        ggml_quantize_chunk(tc.type, data.data(), qdata.data(), 0, tc.n*n_as, tc.k, nullptr);
+        ggml_backend_tensor_set(w_plain,  qdata.data(), 0, qdata.size());
+        ggml_backend_tensor_set(w_repack, qdata.data(), 0, qdata.size());
+
+        data.resize(ggml_nelements(x));
+        for (auto & v : data) {
+            v = dist(rng);
+        }
+        ggml_backend_tensor_set(x, data.data(), 0, ggml_nbytes(x));
+
+        if (is_id) {
+            std::vector<int32_t> id_data(n_used*tc.m);
+            for (int64_t i = 0; i < tc.m; ++i) {
+                // distinct experts for each token
+                const int32_t e = rng() % n_as;
+                id_data[i*n_used + 0] = e;
+                id_data[i*n_used + 1] = (e + 1 + rng() % (n_as - 1)) % n_as;
+            }
+            ggml_backend_tensor_set(ids, id_data.data(), 0, ggml_nbytes(ids));
+        }
+
+        for (int i = 0; i < n_iter; ++i) {
+            int64_t t_start_us = ggml_time_us();
+            ggml_backend_graph_compute(backend, gf_repack);
+            t_repack_ms += (ggml_time_us() - t_start_us)/1000.0;
+
+            t_start_us = ggml_time_us();
+            ggml_backend_graph_compute(backend, gf_plain);
+            t_plain_ms += (ggml_time_us() - t_start_us)/1000.0;
+        }
+
+        std::vector<float> res_repack(ggml_nelements(out_repack));
+        std::vector<float> res_plain(ggml_nelements(out_plain));
+        ggml_backend_tensor_get(out_repack, res_repack.data(), 0, ggml_nbytes(out_repack));
+        ggml_backend_tensor_get(out_plain,  res_plain.data(),  0, ggml_nbytes(out_plain));
+
+        res = nmse(res_repack, res_plain);
+    }
+
+    ggml_backend_buffer_free(buf_w);
+    ggml_backend_buffer_free(buf);
+    ggml_free(ctx_w);
+    ggml_free(ctx);
+
+    return res;
+}
+
+int main(int argc, char ** argv) {
+    const bool perf = argc > 1 && std::string(argv[1]) == "--perf";
+
+    ggml_backend_buffer_type_t repack_buft = get_repack_buft();
+    if (!repack_buft) {
+        printf("%s : CPU_REPACK buffer type not available, skipping\n", __func__);
+        return 0;
+    }
+
+    ggml_backend_t backend = ggml_backend_cpu_init();
+    ggml_backend_cpu_set_n_threads(backend, std::max(1u, std::thread::hardware_concurrency()));
+
+    const ggml_type types[] = {
+        GGML_TYPE_Q4_0, GGML_TYPE_Q4_K, GGML_TYPE_Q2_K, GGML_TYPE_IQ4_NL,
+        GGML_TYPE_Q5_K, GGML_TYPE_Q6_K, GGML_TYPE_Q8_0, GGML_TYPE_MXFP4,
+    };
+
+    std::mt19937 rng(1234);
+
+    int n_fail = 0;
+
+    for (ggml_type type : types) {
+        std::vector<test_case> cases;
+        // m covers the gemv path, the gemm path and gemm with leftover rows
+        for (int64_t m : { 1, 4, 7, 32 }) {
+            cases.push_back({ type, 512, 64, m, 0 });
+            cases.push_back({ type, 256, 24, m, 4 });
+        }
+        if (perf) {
+            for (int64_t m : { 1, 32 }) {
+                cases.push_back({ type, 4096, 4096, m, 0 });
+            }
+        }
+
+        for (const auto & tc : cases) {
+            double t_repack_ms = 0.0;
+            double t_plain_ms  = 0.0;
+
+            const int n_iter = tc.k >= 4096 ? 10 : 1;
+
+            const double err = run_test(tc, backend, repack_buft, rng, n_iter, t_repack_ms, t_plain_ms);
+            if (err < 0.0) {
+                printf("%s : %-8s not repacked, skipping\n", __func__, ggml_type_name(type));
+                break;
+            }
+
+            const bool ok = err <= MAX_NMSE;
+            n_fail += !ok;
+
+            printf("%s : %-8s %-10s k = %5lld, n = %5lld, m = %3lld: nmse = %.2e %s, repack %8.3f ms, plain %8.3f ms\n", __func__,
+                    ggml_type_name(type), tc.n_as > 0 ? "mul_mat_id" : "mul_mat", (long long) tc.k, (long long) tc.n, (long long) tc.m,
+                    err, ok ? "ok" : "FAILED", t_repack_ms/n_iter, t_plain_ms/n_iter);
+        }
+    }
+
+    ggml_backend_free(backend);
+
+    return n_fail == 0 ? 0 : 1;
+}
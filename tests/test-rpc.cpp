@@ -0,0 +1,211 @@
+// run the RPC backend against two in-process servers, with the commands pipelined on the connections
+#include "ggml.h"
+#include "ggml-alloc.h"
+#include "ggml-backend.h"
+#include "ggml-cpu.h"
+#include "ggml-rpc.h"
+
+#undef NDEBUG
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static const char * ENDPOINT_A = "127.0.0.1:50152";
+static const char * ENDPOINT_B = "127.0.0.1:50153";
+
+// floats in x and y, 32 KiB so that a read of the whole tensor does not fit in the pending responses
+static const int64_t N = 8192;
+
+static ggml_backend_t start_server(const char * endpoint) {
+    std::thread([endpoint]() {
+        ggml_backend_t backend = ggml_backend_cpu_init();
+        ggml_backend_rpc_start_server(backend, endpoint, nullptr, 1ull << 30, 1ull << 30);
+        ggml_backend_free(backend);
+    }).detach();
+
+    // wait for the server to listen
+    for (int i = 0; i < 100; ++i) {
+        ggml_backend_t backend = ggml_backend_rpc_init(endpoint);
+        if (backend) {
+            return backend;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    return nullptr;
+}
+
+// y = 2*x on the server of a backend
+struct test_graph {
+    ggml_context        * ctx;
+    ggml_backend_buffer_t buf;
+    ggml_cgraph         * gf;
+    ggml_tensor         * x;
+    ggml_tensor         * y;
+
+    test_graph(ggml_backend_t backend) {
+        ggml_init_params params = {
+            /* .mem_size   = */ 8*ggml_tensor_overhead() + ggml_graph_overhead(),
+            /* .mem_buffer = */ nullptr,
+            /* .no_alloc   = */ true,
+        };
+        ctx = ggml_init(params);
+        x   = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, N);
+        y   = ggml_scale(ctx, x, 2.0f);
+        gf  = ggml_new_graph(ctx);
+        ggml_build_forward_expand(gf, y);
+        buf = ggml_backend_alloc_ctx_tensors(ctx, backend);
+    }
+
+    ~test_graph() {
+        ggml_backend_buffer_free(buf);
+        ggml_free(ctx);
+    }
+};
+
+static std::vector<float> make_data(int k) {
+    std::vector<float> data(N);
+    for (int64_t i = 0; i < N; ++i) {
+        data[i] = k*0.5f + i;
+    }
+    return data;
+}
+
+static bool check_data(const std::vector<float> & data, int k, float f) {
+    for (int64_t i = 0; i < (int64_t) data.size(); ++i) {
+        if (data[i] != f*(k*0.5f + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the responses of the reads and of the graph computes are matched to the commands in order
+static bool test_fifo(ggml_backend_t backend, test_graph & g) {
+    const int n_iter = 8;
+    const int64_t n_read = 256;
+
+    std::vector<std::vector<float>> res_x(n_iter, std::vector<float>(n_read));
+    std::vector<std::vector<float>> res_y(n_iter, std::vector<float>(n_read));
+
+    for (int k = 0; k < n_iter; ++k) {
+        const std::vector<float> data = make_data(k);
+        ggml_backend_tensor_set_async(backend, g.x, data.data(), 0, ggml_nbytes(g.x));
+        ggml_backend_graph_compute_async(backend, g.gf);
+        ggml_backend_tensor_get_async(backend, g.x, res_x[k].data(), 0, n_read*sizeof(float));
+        ggml_backend_tensor_get_async(backend, g.y, res_y[k].data(), 0, n_read*sizeof(float));
+    }
+    ggml_backend_synchronize(backend);
+
+    bool ok = true;
+    for (int k = 0; k < n_iter; ++k) {
+        ok = ok && check_data(res_x[k], k, 1.0f) && check_data(res_y[k], k, 2.0f);
+    }
+    return ok;
+}
+
+// more pending reads than MAX_PENDING_SIZE are flushed while they are sent, and a larger read is done in place
+static bool test_pending_size(ggml_backend_t backend, test_graph & g) {
+    const std::vector<float> data = make_data(1);
+    ggml_backend_tensor_set_async(backend, g.x, data.data(), 0, ggml_nbytes(g.x));
+    ggml_backend_graph_compute_async(backend, g.gf);
+
+    // 4 copies of y in chunks of 2 KiB: 128 KiB of responses
+    const int64_t n_chunk = 512;
+    std::vector<float> res(4*N);
+    for (int r = 0; r < 4; ++r) {
+        for (int64_t i = 0; i < N; i += n_chunk) {
+            ggml_backend_tensor_get_async(backend, g.y, res.data() + r*N + i, i*sizeof(float), n_chunk*sizeof(float));
+        }
+    }
+    std::vector<float> res_all(N);
+    ggml_backend_tensor_get_async(backend, g.y, res_all.data(), 0, ggml_nbytes(g.y));
+    ggml_backend_synchronize(backend);
+
+    bool ok = check_data(res_all, 1, 2.0f);
+    for (int r = 0; r < 4; ++r) {
+        ok = ok && check_data(std::vector<float>(res.begin() + r*N, res.begin() + (r + 1)*N), 1, 2.0f);
+    }
+    return ok;
+}
+
+// an event waits for the commands sent before it was recorded, on the same or on another connection
+static bool test_events(ggml_backend_t backend_a, ggml_backend_t backend_b, test_graph & g) {
+    ggml_backend_event_t event = ggml_backend_event_new(ggml_backend_get_device(backend_a));
+    if (!event) {
+        printf("%s: events not supported, skipping\n", __func__);
+        return true;
+    }
+
+    std::vector<float> res(N);
+
+    const std::vector<float> data_2 = make_data(2);
+    ggml_backend_tensor_set_async(backend_a, g.x, data_2.data(), 0, ggml_nbytes(g.x));
+    ggml_backend_graph_compute_async(backend_a, g.gf);
+    ggml_backend_tensor_get_async(backend_a, g.y, res.data(), 0, 256*sizeof(float));
+    ggml_backend_event_record(event, backend_a);
+    ggml_backend_event_synchronize(event);
+
+    bool ok = check_data(std::vector<float>(res.begin(), res.begin() + 256), 2, 2.0f);
+
+    const std::vector<float> data_3 = make_data(3);
+    ggml_backend_tensor_set_async(backend_a, g.x, data_3.data(), 0, ggml_nbytes(g.x));
+    ggml_backend_graph_compute_async(backend_a, g.gf);
+    ggml_backend_tensor_get_async(backend_a, g.y, res.data(), 0, 256*sizeof(float));
+    ggml_backend_event_record(event, backend_a);
+    ggml_backend_event_wait(backend_b, event);
+
+    ok = ok && check_data(std::vector<float>(res.begin(), res.begin() + 256), 3, 2.0f);
+
+    ggml_backend_synchronize(backend_a);
+    ggml_backend_event_free(event);
+    return ok;
+}
+
+// a copy between the servers reads the result of the queued work on the source server
+static bool test_cpy_tensor_async(ggml_backend_t backend_a, ggml_backend_t backend_b, test_graph & g_a, test_graph & g_b) {
+    const std::vector<float> data = make_data(4);
+    ggml_backend_tensor_set_async(backend_a, g_a.x, data.data(), 0, ggml_nbytes(g_a.x));
+    ggml_backend_graph_compute_async(backend_a, g_a.gf);
+    ggml_backend_tensor_copy_async(backend_a, backend_b, g_a.y, g_b.x);
+    ggml_backend_graph_compute_async(backend_b, g_b.gf);
+
+    std::vector<float> res(256);
+    ggml_backend_tensor_get_async(backend_b, g_b.y, res.data(), 0, 256*sizeof(float));
+    ggml_backend_synchronize(backend_b);
+    ggml_backend_synchronize(backend_a);
+
+    return check_data(res, 4, 4.0f);
+}
+
+int main() {
+    ggml_backend_t backend_a = start_server(ENDPOINT_A);
+    ggml_backend_t backend_b = start_server(ENDPOINT_B);
+    if (!backend_a || !backend_b) {
+        fprintf(stderr, "%s: failed to start the RPC servers\n", __func__);
+        return 1;
+    }
+
+    int n_fail = 0;
+
+    {
+        test_graph g_a(backend_a);
+        test_graph g_b(backend_b);
+
+        auto run = [&](const char * name, bool ok) {
+            printf("main: %-16s %s\n", name, ok ? "ok" : "FAILED");
+            n_fail += !ok;
+        };
+
+        run("fifo",             test_fifo(backend_a, g_a));
+        run("pending_size",     test_pending_size(backend_a, g_a));
+        run("events",           test_events(backend_a, backend_b, g_a));
+        run("cpy_tensor_async", test_cpy_tensor_async(backend_a, backend_b, g_a, g_b));
+    }
+
+    ggml_backend_free(backend_a);
+    ggml_backend_free(backend_b);
+
+    return n_fail == 0 ? 0 : 1;
+}
@@ -1,5 +1,7 @@
 #include "ggml.h"
 #include "llama.h"
+#include "get-model.h"
+#include "sampling.h"
 
 #ifdef NDEBUG
 #undef NDEBUG
@@ -7,9 +9,12 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
 #include <string>
 #include <vector>
 
+#include <unistd.h>
+
 extern struct llama_sampler * llama_sampler_init_dry_testing(int32_t context_size, float dry_multiplier, float dry_base, int32_t dry_allowed_length, int32_t dry_penalty_last_n, const std::vector<std::vector<llama_token>>& seq_breakers);
 
 static void dump(const llama_token_data_array * cur_p) {
@@ -267,6 +272,40 @@ static void test_sampler_queue(const size_t n_vocab, const std::string & sampler
            samplers_sequence.c_str(), n_vocab, top_k, top_p, min_p);
 }
 
+static void test_fill_candidates(const size_t n_vocab, const int top_k, const bool with_inf) {
+    std::vector<float> logits(n_vocab);
+    for (size_t i = 0; i < n_vocab; i++) {
+        logits[i] = with_inf && rand() % 4 == 0 ? -INFINITY : 8.0f*((double)(rand())/RAND_MAX - 0.5);
+    }
+
+    llama_sampler * chain = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(chain, llama_sampler_init_penalties(64, 1.0f, 0.0f, 0.0f)); // no-op
+    llama_sampler_chain_add(chain, llama_sampler_init_top_k(top_k));
+    llama_sampler_chain_add(chain, llama_sampler_init_top_p(0.9f, 1));
+
+    std::vector<llama_token_data> data(n_vocab);
+    llama_token_data_array cur_p;
+    llama_sampler_fill_candidates(chain, logits.data(), n_vocab, data.data(), &cur_p);
+    llama_sampler_apply(chain, &cur_p);
+
+    std::vector<llama_token_data> data_ref;
+    for (llama_token token_id = 0; token_id < (llama_token)n_vocab; token_id++) {
+        data_ref.emplace_back(llama_token_data{token_id, logits[token_id], 0.0f});
+    }
+    llama_token_data_array cur_p_ref = { data_ref.data(), data_ref.size(), -1, false };
+    llama_sampler_apply(chain, &cur_p_ref);
+
+    GGML_ASSERT(cur_p.size == cur_p_ref.size);
+    for (size_t i = 0; i < cur_p.size; i++) {
+        GGML_ASSERT(cur_p.data[i].logit == cur_p_ref.data[i].logit);
+        GGML_ASSERT(fabs(cur_p.data[i].p - cur_p_ref.data[i].p) < 1e-5);
+    }
+
+    llama_sampler_free(chain);
+
+    printf("Fill candidates OK with n_vocab=%06zu top_k=%05d with_inf=%d\n", n_vocab, top_k, with_inf);
+}
+
 static void bench(llama_sampler * cnstr, const char * cnstr_name, const std::vector<llama_token_data> & data, int n_iter) {
     std::vector<llama_token_data> cur(data.size());
     std::copy(data.begin(), data.end(), cur.begin());
@@ -287,6 +326,43 @@ static void bench(llama_sampler * cnstr, const char * cnstr_name, const std::vec
 
 #define BENCH(__cnstr, __data, __n_iter) bench((__cnstr), #__cnstr, (__data), (__n_iter))
 
+// candidates built from the raw logits and sampled with a top-k chain, with and without the top-k prefilter
+static void bench_fill_candidates(int top_k, const std::vector<float> & logits, int n_iter) {
+    const int n_vocab = logits.size();
+
+    llama_sampler * chain = llama_sampler_chain_init(llama_sampler_chain_default_params());
+    llama_sampler_chain_add(chain, llama_sampler_init_top_k(top_k));
+    llama_sampler_chain_add(chain, llama_sampler_init_top_p(0.95f, 1));
+    llama_sampler_chain_add(chain, llama_sampler_init_min_p(0.05f, 1));
+    llama_sampler_chain_add(chain, llama_sampler_init_temp (0.8f));
+    llama_sampler_chain_add(chain, llama_sampler_init_dist (1234));
+
+    std::vector<llama_token_data> cur(n_vocab);
+
+    int64_t t_start = ggml_time_us();
+    for (int i = 0; i < n_iter; i++) {
+        for (llama_token token_id = 0; token_id < n_vocab; token_id++) {
+            cur[token_id] = llama_token_data{token_id, logits[token_id], 0.0f};
+        }
+        llama_token_data_array cur_p = { cur.data(), cur.size(), -1, false };
+        llama_sampler_apply(chain, &cur_p);
+    }
+    const int64_t t_full = ggml_time_us() - t_start;
+
+    t_start = ggml_time_us();
+    for (int i = 0; i < n_iter; i++) {
+        llama_token_data_array cur_p;
+        llama_sampler_fill_candidates(chain, logits.data(), n_vocab, cur.data(), &cur_p);
+        llama_sampler_apply(chain, &cur_p);
+    }
+    const int64_t t_fill = ggml_time_us() - t_start;
+
+    llama_sampler_free(chain);
+
+    printf("%-43s: %8.3f us/iter (full vocab: %8.3f us/iter)\n", ("fill_candidates(top_k = " + std::to_string(top_k) + ")").c_str(),
+            t_fill / (float)n_iter, t_full / (float)n_iter);
+}
+
 static void test_perf() {
     const int n_vocab = 1 << 17;
 
@@ -303,9 +379,167 @@ static void test_perf() {
     BENCH(llama_sampler_init_min_p  (0.2f, 1),                data, 32);
     BENCH(llama_sampler_init_typical(0.5f, 1),                data, 32);
     BENCH(llama_sampler_init_xtc    (1.0f, 0.1f, 1, 1),       data, 32);
+
+    std::vector<float> logits(1 << 18);
+    for (auto & logit : logits) {
+        logit = 16.0f*((double)(rand())/RAND_MAX - 0.5);
+    }
+
+    bench_fill_candidates(40,   logits, 32);
+    bench_fill_candidates(1000, logits, 32);
+}
+
+static llama_sampler * make_chain(int kind, uint32_t seed) {
+    llama_sampler * chain = llama_sampler_chain_init(llama_sampler_chain_default_params());
+
+    switch (kind) {
+        case 0:
+            llama_sampler_chain_add(chain, llama_sampler_init_greedy());
+            break;
+        case 1:
+            llama_sampler_chain_add(chain, llama_sampler_init_top_k(40));
+            llama_sampler_chain_add(chain, llama_sampler_init_temp(0.8f));
+            llama_sampler_chain_add(chain, llama_sampler_init_dist(seed));
+            break;
+        default:
+            // no top-k, the candidates are the whole vocab
+            llama_sampler_chain_add(chain, llama_sampler_init_penalties(64, 1.5f, 0.0f, 0.0f));
+            llama_sampler_chain_add(chain, llama_sampler_init_temp(1.5f));
+            llama_sampler_chain_add(chain, llama_sampler_init_dist(seed));
+            break;
+    }
+
+    return chain;
+}
+
+// llama_sampler_sample_batch and common_sampler_sample_batch against the per-index sampling of the same outputs
+static void test_sample_batch(const char * fname_vocab) {
+    const std::string fname_model = "test-sampling-" + std::to_string(getpid()) + ".gguf";
+
+    GGML_ASSERT(make_random_model(fname_vocab, fname_model));
+
+    llama_backend_init();
+
+    llama_model_params mparams = llama_model_default_params();
+    mparams.n_gpu_layers = 0;
+
+    llama_model * model = llama_model_load_from_file(fname_model.c_str(), mparams);
+    GGML_ASSERT(model);
+
+    llama_context_params cparams = llama_context_default_params();
+    cparams.n_ctx           = 256;
+    cparams.n_batch         = 64;
+    cparams.n_threads       = 4;
+    cparams.n_threads_batch = 4;
+
+    llama_context * ctx = llama_init_from_model(model, cparams);
+    GGML_ASSERT(ctx);
+
+    const int n_tokens = 12;
+
+    llama_batch batch = llama_batch_init(n_tokens, 0, 1);
+    for (int i = 0; i < n_tokens; ++i) {
+        batch.token   [i]    = 100 + 17*i;
+        batch.pos     [i]    = i;
+        batch.n_seq_id[i]    = 1;
+        batch.seq_id  [i][0] = 0;
+        batch.logits  [i]    = true;
+    }
+    batch.n_tokens = n_tokens;
+
+    GGML_ASSERT(llama_decode(ctx, batch) == 0);
+
+    llama_batch_free(batch);
+
+    // the outputs are sampled out of order, with negative indices as well
+    std::vector<int32_t> idxs;
+    for (int i = 0; i < n_tokens; ++i) {
+        idxs.push_back(i % 2 == 0 ? n_tokens - 1 - i : -1 - i);
+    }
+
+    const int n = idxs.size();
+
+    {
+        std::vector<llama_sampler *> smpls;
+        std::vector<llama_sampler *> smpls_ref;
+        for (int i = 0; i < n; ++i) {
+            smpls    .push_back(make_chain(i % 3, 1234 + i));
+            smpls_ref.push_back(make_chain(i % 3, 1234 + i));
+        }
+
+        // the samplers keep their state (RNG, penalties) across the rounds
+        for (int round = 0; round < 4; ++round) {
+            std::vector<llama_token> tokens(n);
+            llama_sampler_sample_batch(smpls.data(), ctx, idxs.data(), tokens.data(), n);
+
+            for (int i = 0; i < n; ++i) {
+                const llama_token token_ref = llama_sampler_sample(smpls_ref[i], ctx, idxs[i]);
+                if (tokens[i] != token_ref) {
+                    fprintf(stderr, "%s: round %d, output %d: batched token %d != %d\n", __func__, round, idxs[i], tokens[i], token_ref);
+                    GGML_ABORT("llama_sampler_sample_batch mismatch");
+                }
+            }
+        }
+
+        for (int i = 0; i < n; ++i) {
+            llama_sampler_free(smpls[i]);
+            llama_sampler_free(smpls_ref[i]);
+        }
+    }
+
+    {
+        std::vector<common_sampler *> gsmpls;
+        std::vector<common_sampler *> gsmpls_ref;
+        for (int i = 0; i < n; ++i) {
+            common_params_sampling params;
+            params.seed           = 4321 + i;
+            params.temp           = i % 3 == 0 ? 0.0f : 0.8f;
+            params.penalty_repeat = 1.2f;
+            if (i % 3 == 2) {
+                params.grammar = "root ::= [a-z ]+";
+            }
+
+            gsmpls    .push_back(common_sampler_init(model, params));
+            gsmpls_ref.push_back(common_sampler_init(model, params));
+        }
+
+        const std::vector<int> idxs_c(idxs.begin(), idxs.end());
+
+        for (int round = 0; round < 4; ++round) {
+            const std::vector<llama_token> tokens = common_sampler_sample_batch(gsmpls, ctx, idxs_c);
+
+            for (int i = 0; i < n; ++i) {
+                const llama_token token_ref = common_sampler_sample(gsmpls_ref[i], ctx, idxs_c[i]);
+                if (tokens[i] != token_ref) {
+                    fprintf(stderr, "%s: round %d, output %d: batched common token %d != %d\n", __func__, round, idxs_c[i], tokens[i], token_ref);
+                    GGML_ABORT("common_sampler_sample_batch mismatch");
+                }
+
+                // the candidates of the batched sampling are those of the sampler
+                const llama_token_data_array * cur_p = common_sampler_get_candidates(gsmpls[i]);
+                GGML_ASSERT(cur_p->data[cur_p->selected].id == tokens[i]);
+
+                common_sampler_accept(gsmpls    [i], tokens[i], true);
+                common_sampler_accept(gsmpls_ref[i], token_ref, true);
+            }
+        }
+
+        for (int i = 0; i < n; ++i) {
+            common_sampler_free(gsmpls[i]);
+            common_sampler_free(gsmpls_ref[i]);
+        }
+    }
+
+    llama_free(ctx);
+    llama_model_free(model);
+    llama_backend_free();
+
+    remove(fname_model.c_str());
+
+    printf("%s: OK\n", __func__);
 }
 
-int main(void) {
+int main(int argc, char ** argv) {
     ggml_time_init();
 
     test_temp({0.1f, 0.2f, 0.3f, 0.4f}, {0.4f, 0.3f, 0.2f, 0.1f}, 1.0f);
@@ -392,8 +626,20 @@ int main(void) {
     test_sampler_queue(10000, "mkp", 100, 0.8f, 0.1f);
     test_sampler_queue(10000, "mpk", 100, 0.8f, 0.1f);
 
+    test_fill_candidates(100000,     1, false);
+    test_fill_candidates(100000,    40, false);
+    test_fill_candidates(100000,  1000, false);
+    test_fill_candidates(100000, 99999, false);
+    test_fill_candidates(100000,    40, true);
+    test_fill_candidates(100000,  1000, true);
+    test_fill_candidates(100000, 90000, true);
+
     printf("OK\n");
 
+    if (argc > 1) {
+        test_sample_batch(argv[1]);
+    }
+
     test_perf();
 
     return 0;
@@ -0,0 +1,82 @@
+// check that common_thread_pool::parallel_for runs each index exactly once, rethrows the errors and can be reused
+#include "common.h"
+
+#undef NDEBUG
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void test_indices(common_thread_pool & pool, int n) {
+    std::vector<std::atomic<int>> count(n);
+    for (auto & c : count) {
+        c = 0;
+    }
+
+    pool.parallel_for(n, [&](int i) {
+        assert(i >= 0 && i < n);
+        count[i]++;
+    });
+
+    for (int i = 0; i < n; ++i) {
+        assert(count[i] == 1);
+    }
+}
+
+static void test_exception(common_thread_pool & pool) {
+    bool caught = false;
+    try {
+        pool.parallel_for(100, [](int i) {
+            if (i == 42) {
+                throw std::runtime_error("42");
+            }
+        });
+    } catch (const std::runtime_error & e) {
+        caught = std::string(e.what()) == "42";
+    }
+    assert(caught);
+
+    // the pool is still usable after an error
+    test_indices(pool, 100);
+}
+
+// a call made while another thread uses the pool runs on the calling thread
+static void test_concurrent(common_thread_pool & pool) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool]() {
+            for (int k = 0; k < 50; ++k) {
+                test_indices(pool, 64);
+            }
+        });
+    }
+    for (auto & t : threads) {
+        t.join();
+    }
+}
+
+int main() {
+    for (int n_threads : { 1, 2, 4 }) {
+        common_thread_pool pool(n_threads);
+        assert(pool.n_threads() == n_threads);
+
+        for (int n : { 0, 1, 2, 7, 1000 }) {
+            test_indices(pool, n);
+        }
+
+        // the workers are kept across the calls
+        for (int k = 0; k < 1000; ++k) {
+            test_indices(pool, 8);
+        }
+
+        test_exception(pool);
+        test_concurrent(pool);
+
+        printf("n_threads = %d: OK\n", n_threads);
+    }
+
+    return 0;
+}
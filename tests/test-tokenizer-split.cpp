@@ -0,0 +1,146 @@
+// compare the hand-written pre-tokenizer splits with the general-purpose std::regex implementation
+#include "ggml.h"
+
+#include "../src/unicode.h"
+
+#undef NDEBUG
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// the regexes of the BPE pre-tokenizers, as in llama-vocab.cpp
+static const std::vector<std::pair<std::string, std::vector<std::string>>> k_pre_regexes = {
+    { "llama3", {
+        "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+    }},
+    { "deepseek-llm", {
+        "[\r\n]",
+        "\\s?[A-Za-zµÀ-ÖØ-öø-ƺƼ-ƿǄ-ʓʕ-ʯͰ-ͳͶͷͻ-ͽͿΆΈ-ΊΌΎ-ΡΣ-ϵϷ-ҁҊ-ԯԱ-ՖႠ-ჅᎠ-Ᏽᏸ-ᏽᲐ-ᲺᲽ-Ჿᴀ-ᴫᵫ-ᵷᵹ-ᶚḀ-ἕἘ-Ἕἠ-ὅὈ-Ὅὐ-ὗὙὛὝὟ-ώᾀ-ᾴᾶ-ᾼιῂ-ῄῆ-ῌῐ-ΐῖ-Ίῠ-Ῥῲ-ῴῶ-ῼℂℇℊ-ℓℕℙ-ℝℤΩℨK-ℭℯ-ℴℹℼ-ℿⅅ-ⅉⅎↃↄⰀ-ⱻⱾ-ⳤⳫ-ⳮⳲⳳꙀ-ꙭꚀ-ꚛꜢ-ꝯꝱ-ꞇꞋ-ꞎꭰ-ꮿﬀ-ﬆﬓ-ﬗＡ-Ｚａ-ｚ𐐀-𐑏𐒰-𐓓𐓘-𐓻𐲀-𐲲𐳀-𐳲𑢠-𑣟𞤀-𞥃]+",
+        "\\s?[!-/:-~！-／：-～‘-‟　-。]+",
+        "\\s+$",
+        "[一-龥ࠀ-一가-퟿]+",
+        "\\p{N}+",
+    }},
+    { "deepseek-coder", {
+        "[\r\n]",
+        "\\s?\\p{L}+",
+        "\\s?\\p{P}+",
+        "[一-龥ࠀ-一가-퟿]+",
+        "\\p{N}",
+    }},
+    { "deepseek3", {
+        "\\p{N}{1,3}",
+        "[一-龥぀-ゟ゠-ヿ]+",
+        "[!\"#$%&'()*+,\\-./:;<=>?@\\[\\\\\\]^_`{|}~][A-Za-z]+|[^\r\n\\p{L}\\p{P}\\p{S}]?[\\p{L}\\p{M}]+| ?[\\p{P}\\p{S}]+[\r\n]*|\\s*[\r\n]+|\\s+(?!\\S)|\\s+",
+    }},
+    { "falcon", {
+        "[\\p{P}\\$\\+<=>\\^~\\|`]+",
+        "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)",
+        "[0-9][0-9][0-9]",
+    }},
+    { "qwen2", {
+        "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+    }},
+    { "bloom", {
+        " ?[^(\\s|.,!?…。，、।۔،)]+",
+        "\\p{N}",
+    }},
+    { "tekken", {
+        "[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))*((?=[\\p{L}])([^A-Z]))+|[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))+((?=[\\p{L}])([^A-Z]))*|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n/]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+    }},
+    { "chameleon", {
+        "<sentinel:[0-9]+>",
+        "(IMGIMG)((A|B|C|D|E|F|G|H|I){1,4})Z",
+        "([\\t\\n]|    |  )",
+        "\\p{N}",
+        "[\\p{P}!-/:-@\\[-`{-~]",
+        "'s|'t|'re|'ve|'m|'ll|'d| ?\\p{L}+| ?\\p{N}+| ?[^\\s\\p{L}\\p{N}]+|\\s+(?!\\S)",
+    }},
+    { "gpt4o", {
+        "[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))*((?=[\\p{L}])([^A-Z]))+(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])?|[^\\r\\n\\p{L}\\p{N}]?((?=[\\p{L}])([^a-z]))+((?=[\\p{L}])([^A-Z]))*(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])?|\\p{N}{1,3}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n/]*|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+    }},
+    { "superbpe", {
+        "\\p{N}+",
+        "(?=(\\d{3})+(?!\\d))",
+    }},
+    { "bailingmoe", {
+        "'(?:[sSdDmMtT]|[lL][lL]|[vV][eE]|[rR][eE])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}| ?[^\\s\\p{L}\\p{N}]+[\\r\\n]*|\\s*[\\r\\n]|\\s+(?!\\S)|\\s+",
+    }},
+    { "seed-coder", {
+        "(?:'[sS]|'[tT]|'[rR][eE]|'[vV][eE]|'[mM]|'[lL][lL]|'[dD])|[^\\r\\n\\p{L}\\p{N}]?\\p{L}+|\\p{N}{1}| ?[^\\s\\p{L}\\p{N}\\r\\n]+|\\s*[\\r\\n]+|\\s+(?!\\S)|\\s+",
+    }},
+};
+
+// random text made of words from many scripts, with the edge cases of the regexes
+static std::string random_text(std::mt19937 & rng, size_t n_words) {
+    static const std::vector<std::string> k_words = {
+        "Hello", "world", "HELLO", "camelCase", "PascalCase", "ABCdef", "don't", "I'LL", "we've", "'re", "'S",
+        "123", "4567", "1000000", "3.14", "٣٤٥", "१२३", "Ⅻ", "½",
+        "Ünïcödé", "façade", "ÀÉÎÕÜ", "straße", "Ελληνικά", "ΑΒΓ", "Русский", "ПРИВЕТ", "ǅemal", "ﬁne",
+        "中文", "日本語", "ひらがな", "カタカナ", "한국어", "العربية", "עברית", "हिन्दी", "ไทย",
+        "é", "é", "a\u0301", "\u0301", "🦙", "👍🏽", "🇫🇷",
+        "!", "?", "...", "…", "。", "，", "、", "।", "۔", "،", "(", ")", "[", "]", "{", "}", "/", "\\",
+        "$", "+", "<", "=", ">", "^", "~", "|", "`", "@", "#", "%", "&", "*", "-", "_", "'", "\"", ";", ":",
+        "+=", "->", "::", "//", "/*", "*/", "<|endoftext|>", "<sentinel:12>", "<sentinel:>", "IMGIMGABZ", "IMGIMGABCDEZ",
+        "！", "～", "‘", "“", "€", "©", "°", "±", "×",
+        " ", "  ", "    ", "\t", "\n", "\r\n", "\n\n", " \n ", "\u00a0", "\u3000", "\u2028", "\u0085", "\v", "\f",
+    };
+
+    std::string res;
+    for (size_t i = 0; i < n_words; ++i) {
+        res += k_words[rng() % k_words.size()];
+        if (rng() % 2 == 0) {
+            res += ' ';
+        }
+    }
+    return res;
+}
+
+int main(int argc, char ** argv) {
+    const size_t n_texts = argc > 1 ? std::stoul(argv[1]) : 500;
+
+    std::mt19937 rng(1234);
+
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < n_texts; ++i) {
+        texts.push_back(random_text(rng, 1 + rng() % 64));
+    }
+
+    int n_fail = 0;
+
+    for (const auto & [name, regex_exprs] : k_pre_regexes) {
+        int64_t t_custom_us = 0;
+        int64_t t_regex_us  = 0;
+
+        for (const auto & text : texts) {
+            int64_t t_start_us = ggml_time_us();
+            const auto words_custom = unicode_regex_split(text, regex_exprs, true);
+            t_custom_us += ggml_time_us() - t_start_us;
+
+            t_start_us = ggml_time_us();
+            auto words_regex = unicode_regex_split(text, regex_exprs, false);
+            t_regex_us += ggml_time_us() - t_start_us;
+
+            // the empty matches of lookaheads produce empty words, which do not change the tokens
+            words_regex.erase(std::remove(words_regex.begin(), words_regex.end(), std::string()), words_regex.end());
+
+            if (words_custom != words_regex) {
+                fprintf(stderr, "%s : %s: mismatch for text '%s'\n", __func__, name.c_str(), text.c_str());
+                for (size_t i = 0; i < std::max(words_custom.size(), words_regex.size()); ++i) {
+                    fprintf(stderr, "  '%s' | '%s'\n",
+                            i < words_custom.size() ? words_custom[i].c_str() : "",
+                            i < words_regex.size()  ? words_regex[i].c_str()  : "");
+                }
+                n_fail++;
+                break;
+            }
+        }
+
+        printf("%s : %-16s custom %8.2f ms, std::regex %8.2f ms\n", __func__, name.c_str(), t_custom_us/1000.0, t_regex_us/1000.0);
+    }
+
+    return n_fail == 0 ? 0 : 1;
+}
@@ -8,6 +8,7 @@
 #include "log.h"
 #include "sampling.h"
 #include "speculative.h"
+#include "ngram-cache.h"
 #include "mtmd.h"
 #include "mtmd-helper.h"
 
@@ -24,6 +25,9 @@
 #include <cstddef>
 #include <cinttypes>
 #include <deque>
+#include <fstream>
+#include <future>
+#include <list>
 #include <memory>
 #include <mutex>
 #include <signal.h>
@@ -121,6 +125,8 @@ struct slot_params {
     int64_t t_max_prompt_ms  = -1; // TODO: implement
     int64_t t_max_predict_ms = -1; // if positive, limit the generation phase to this time limit
 
+    int32_t priority = 0; // prompts of slots with higher priority are processed first
+
     std::vector<common_adapter_lora_info> lora;
 
     std::vector<std::string> antiprompt;
@@ -188,6 +194,7 @@ struct slot_params {
             {"max_tokens",                n_predict}, // User configured n_predict
             {"n_keep",                    n_keep},
             {"n_discard",                 n_discard},
+            {"priority",                  priority},
             {"ignore_eos",                sampling.ignore_eos},
             {"stream",                    stream},
             {"logit_bias",                format_logit_bias(sampling.logit_bias)},
@@ -216,6 +223,8 @@ struct server_task {
     int id    = -1; // to be filled by server_queue
     int index = -1; // used when there are multiple prompts (batch request)
 
+    int64_t t_enqueue = 0; // time when the task was posted to the queue, set by server_queue
+
     server_task_type type;
 
     // used by SERVER_TASK_TYPE_CANCEL
@@ -243,11 +252,10 @@ struct server_task {
     server_task(server_task_type type) : type(type) {}
 
     static slot_params params_from_json_cmpl(
-            const llama_context * ctx,
+            const llama_vocab * vocab,
+            int32_t n_ctx,
             const common_params & params_base,
             const json & data) {
-        const llama_model * model = llama_get_model(ctx);
-        const llama_vocab * vocab = llama_model_get_vocab(model);
 
         slot_params params;
 
@@ -271,6 +279,7 @@ struct server_task {
         params.n_discard        = json_value(data, "n_discard",          defaults.n_discard);
       //params.t_max_prompt_ms  = json_value(data, "t_max_prompt_ms",    defaults.t_max_prompt_ms); // TODO: implement
         params.t_max_predict_ms = json_value(data, "t_max_predict_ms",   defaults.t_max_predict_ms);
+        params.priority         = json_value(data, "priority",           defaults.priority);
         params.response_fields  = json_value(data, "response_fields",   std::vector<std::string>());
 
         params.sampling.top_k              = json_value(data, "top_k",              defaults.sampling.top_k);
@@ -334,11 +343,11 @@ struct server_task {
 
         if (params.sampling.penalty_last_n == -1) {
             // note: should be the slot's context and not the full context, but it's ok
-            params.sampling.penalty_last_n = llama_n_ctx(ctx);
+            params.sampling.penalty_last_n = n_ctx;
         }
 
         if (params.sampling.dry_penalty_last_n == -1) {
-            params.sampling.dry_penalty_last_n = llama_n_ctx(ctx);
+            params.sampling.dry_penalty_last_n = n_ctx;
         }
 
         if (params.sampling.dry_base < 1.0f) {
@@ -574,6 +583,8 @@ struct result_timings {
     // Optional speculative metrics - only included when > 0
     int32_t draft_n = 0;
     int32_t draft_n_accepted = 0;
+    int32_t draft_n_tree = 0;            // drafts with more than one branch
+    int32_t draft_n_accepted_branch = 0; // accepted tokens that are not in the first branch
 
     json to_json() const {
         json base = {
@@ -591,6 +602,8 @@ struct result_timings {
         if (draft_n > 0) {
             base["draft_n"] = draft_n;
             base["draft_n_accepted"] = draft_n_accepted;
+            base["draft_n_tree"] = draft_n_tree;
+            base["draft_n_accepted_branch"] = draft_n_accepted_branch;
         }
 
         return base;
@@ -1200,6 +1213,28 @@ struct server_task_result_error : server_task_result {
     }
 };
 
+// cumulative histogram in the Prometheus format: counts[i] is the number of observations <= bounds[i],
+// the last entry of counts is the +Inf bucket
+// it is only updated from the main loop, so the observations do not need any locking
+struct server_histogram {
+    std::vector<double>   bounds;
+    std::vector<uint64_t> counts;
+
+    double   sum   = 0.0;
+    uint64_t count = 0;
+
+    server_histogram() = default;
+    server_histogram(std::vector<double> bounds) : bounds(std::move(bounds)), counts(this->bounds.size() + 1, 0) {}
+
+    void observe(double value, uint64_t n = 1) {
+        const size_t i = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+
+        counts[i] += n;
+        sum       += value*n;
+        count     += n;
+    }
+};
+
 struct server_task_result_metrics : server_task_result {
     int n_idle_slots;
     int n_processing_slots;
@@ -1223,6 +1258,13 @@ struct server_task_result_metrics : server_task_result {
     uint64_t n_decode_total     = 0;
     uint64_t n_busy_slots_total = 0;
 
+    std::vector<server_histogram> h_queue_wait;
+    std::vector<server_histogram> h_ttft;
+    std::vector<server_histogram> h_tpot;
+
+    server_histogram h_batch_size;
+    server_histogram h_kv_usage;
+
     // while we can also use std::vector<server_slot> this requires copying the slot object which can be quite messy
     // therefore, we use json to temporarily store the slot.to_json() result
     json slots_data = json::array();
@@ -1321,6 +1363,12 @@ struct server_slot {
 
     common_speculative * spec = nullptr;
 
+    // n-gram drafting, used when there is no draft model
+    bool               spec_ngram = false;
+    common_ngram_cache ngram_cache; // n-grams of ngram_inp
+    llama_tokens       ngram_inp;   // tokens added to ngram_cache so far
+    bool               ngram_check = false; // the tokens of the slot were rewritten, compare them with ngram_inp again
+
     std::vector<common_adapter_lora_info> lora;
 
     // the index relative to completion multi-task request
@@ -1380,8 +1428,10 @@ struct server_slot {
     // stats
     size_t n_sent_text        = 0; // number of sent text character
 
+    int64_t t_enqueue = 0; // time when the task was posted to the queue
     int64_t t_start_process_prompt;
     int64_t t_start_generation;
+    int64_t t_last_token = 0; // time when the last generated token was sampled
 
     double t_prompt_processing; // ms
     double t_token_generation;  // ms
@@ -1391,6 +1441,8 @@ struct server_slot {
     // Speculative decoding stats
     int32_t n_draft_total = 0;      // Total draft tokens generated
     int32_t n_draft_accepted = 0;   // Draft tokens actually accepted
+    int32_t n_draft_tree = 0;       // Drafts with more than one branch
+    int32_t n_draft_accepted_branch = 0; // Draft tokens accepted outside of the first branch
 
     void reset() {
         SLT_DBG(*this, "%s", "\n");
@@ -1404,6 +1456,7 @@ struct server_slot {
         stopping_word      = "";
         n_past             = 0;
         n_sent_text        = 0;
+        t_last_token       = 0;
         task_type          = SERVER_TASK_TYPE_COMPLETION;
         chat_format        = COMMON_CHAT_FORMAT_CONTENT_ONLY;
 
@@ -1416,6 +1469,8 @@ struct server_slot {
         // clear speculative decoding stats
         n_draft_total = 0;
         n_draft_accepted = 0;
+        n_draft_tree = 0;
+        n_draft_accepted_branch = 0;
     }
 
     bool need_embd() const {
@@ -1435,7 +1490,8 @@ struct server_slot {
     }
 
     bool can_batch_with(server_slot & other_slot) const {
-        return task_type == other_slot.task_type && are_lora_equal(lora, other_slot.lora);
+        // the LoRA adapters are applied per sequence, so slots with different adapters can share a batch
+        return task_type == other_slot.task_type;
     }
 
     bool has_budget(const common_params & global_params) {
@@ -1459,7 +1515,7 @@ struct server_slot {
     }
 
     bool can_speculate() const {
-        return ctx_dft && params.speculative.n_max > 0 && params.cache_prompt;
+        return (spec || spec_ngram) && params.speculative.n_max > 0 && params.cache_prompt;
     }
 
     void add_token(const completion_token_output & token) {
@@ -1497,6 +1553,8 @@ struct server_slot {
         if (n_draft_total > 0) {
             timings.draft_n = n_draft_total;
             timings.draft_n_accepted = n_draft_accepted;
+            timings.draft_n_tree = n_draft_tree;
+            timings.draft_n_accepted_branch = n_draft_accepted_branch;
         }
 
         return timings;
@@ -1613,8 +1671,55 @@ struct server_metrics {
     uint64_t n_decode_total     = 0;
     uint64_t n_busy_slots_total = 0;
 
-    void init() {
+    // latency distributions in seconds, one histogram per slot
+    std::vector<server_histogram> h_queue_wait; // from posting the task to launching it in a slot
+    std::vector<server_histogram> h_ttft;       // from posting the task to the first generated token
+    std::vector<server_histogram> h_tpot;       // between two consecutive generated tokens
+
+    server_histogram h_batch_size; // number of tokens per llama_decode() call
+    server_histogram h_kv_usage;   // fraction of the context in use, sampled at each llama_decode() call
+
+    int32_t n_ctx = 0;
+
+    void init(int n_slots, int32_t n_batch, int32_t n_ctx) {
         t_start = ggml_time_us();
+
+        this->n_ctx = n_ctx;
+
+        const std::vector<double> bounds_wait = { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0, 60.0 };
+        const std::vector<double> bounds_tpot = { 0.001, 0.0025, 0.005, 0.01, 0.02, 0.05, 0.1, 0.25, 0.5, 1.0 };
+
+        h_queue_wait.assign(n_slots, server_histogram(bounds_wait));
+        h_ttft      .assign(n_slots, server_histogram(bounds_wait));
+        h_tpot      .assign(n_slots, server_histogram(bounds_tpot));
+
+        std::vector<double> bounds_batch;
+        for (int32_t n = 1; n < n_batch; n *= 2) {
+            bounds_batch.push_back(n);
+        }
+        bounds_batch.push_back(n_batch);
+
+        h_batch_size = server_histogram(bounds_batch);
+        h_kv_usage   = server_histogram({ 0.1, 0.2, 0.3, 0.4, 0.5, 0.6, 0.7, 0.8, 0.9, 0.95, 1.0 });
+    }
+
+    void on_launch(const server_slot & slot) {
+        h_queue_wait[slot.id].observe((ggml_time_us() - slot.t_enqueue) / 1e6);
+    }
+
+    // n_tokens tokens were generated at once (> 1 with speculative decoding)
+    void on_token(server_slot & slot, int64_t t_current, size_t n_tokens) {
+        if (n_tokens == 0) {
+            return;
+        }
+
+        if (slot.t_last_token == 0) {
+            h_ttft[slot.id].observe((t_current - slot.t_enqueue) / 1e6);
+        } else {
+            h_tpot[slot.id].observe((t_current - slot.t_last_token) / 1e6 / n_tokens, n_tokens);
+        }
+
+        slot.t_last_token = t_current;
     }
 
     void on_prompt_eval(const server_slot & slot) {
@@ -1635,8 +1740,10 @@ struct server_metrics {
         t_tokens_generation_total  += slot.t_token_generation;
     }
 
-    void on_decoded(const std::vector<server_slot> & slots) {
+    void on_decoded(const std::vector<server_slot> & slots, int32_t n_tokens) {
         n_decode_total++;
+
+        size_t n_cached = 0;
         for (const auto & slot : slots) {
             if (slot.is_processing()) {
                 n_busy_slots_total++;
@@ -1644,6 +1751,13 @@ struct server_metrics {
             if (slot.n_past > 0) {
                 n_past_max = std::max(n_past_max, (uint64_t) slot.n_past);
             }
+            n_cached += slot.cache_tokens.size();
+        }
+
+        h_batch_size.observe(n_tokens);
+        if (n_ctx > 0) {
+            // cells shared between slots are counted once per slot
+            h_kv_usage.observe(std::min(1.0, (double) n_cached / n_ctx));
         }
     }
 
@@ -1679,6 +1793,7 @@ struct server_queue {
             cleanup_pending_task(task.id_target);
         }
         const int task_id = task.id;
+        task.t_enqueue = ggml_time_us();
         QUE_DBG("new task, id = %d, front = %d\n", task_id, front);
         if (front) {
             queue_tasks.push_front(std::move(task));
@@ -1700,6 +1815,7 @@ struct server_queue {
             if (task.type == SERVER_TASK_TYPE_CANCEL) {
                 cleanup_pending_task(task.id_target);
             }
+            task.t_enqueue = ggml_time_us();
             QUE_DBG("new task, id = %d/%d, front = %d\n", task.id, (int) tasks.size(), front);
             if (front) {
                 queue_tasks.push_front(std::move(task));
@@ -1712,10 +1828,15 @@ struct server_queue {
     }
 
     // Add a new task, but defer until one slot is available
-    void defer(server_task && task) {
+    // a task deferred to the front is the next one moved to the main queue by pop_deferred_task()
+    void defer(server_task && task, bool front = false) {
         std::unique_lock<std::mutex> lock(mutex_tasks);
-        QUE_DBG("defer task, id = %d\n", task.id);
-        queue_tasks_deferred.push_back(std::move(task));
+        QUE_DBG("defer task, id = %d, front = %d\n", task.id, front);
+        if (front) {
+            queue_tasks_deferred.push_front(std::move(task));
+        } else {
+            queue_tasks_deferred.push_back(std::move(task));
+        }
         condition_tasks.notify_one();
     }
 
@@ -1952,9 +2073,339 @@ struct server_response {
     }
 };
 
+// second tier for the KV cache of the slots
+// when the cells of a slot are about to be discarded, the sequence state is spilled to a bounded host-memory pool
+// entries that do not fit in the pool are moved to files on disk in LRU order, and dropped once the disk budget is exceeded
+// a later prompt that extends one of the entries restores it with llama_state_seq_set_data() instead of recomputing it
+struct server_seq_cache {
+    struct entry {
+        llama_tokens tokens;
+
+        std::vector<uint8_t> data; // empty when the entry is on disk
+
+        std::string path;
+        size_t      size = 0;
+
+        // pending read of a disk entry, started when a task that will likely use it is launched
+        std::shared_future<std::vector<uint8_t>> prefetch;
+
+        bool on_disk() const {
+            return !path.empty();
+        }
+    };
+
+    size_t limit_ram  = 0;
+    size_t limit_disk = 0;
+
+    std::string dir;
+
+    size_t size_ram  = 0;
+    size_t size_disk = 0;
+
+    uint32_t n_files = 0;
+
+    // most recently used first
+    std::list<entry> entries;
+
+    using iterator = std::list<entry>::iterator;
+
+    ~server_seq_cache() {
+        clear();
+    }
+
+    void init(const common_params & params) {
+        limit_ram  = params.cache_ram  * 1024 * 1024;
+        limit_disk = params.cache_disk * 1024 * 1024;
+
+        dir = params.cache_disk_path;
+
+        if (dir.empty()) {
+            limit_disk = 0;
+        }
+    }
+
+    bool enabled() const {
+        return limit_ram > 0;
+    }
+
+    // the position of the entry that shares the longest prefix with the tokens
+    iterator find(const llama_tokens & tokens, size_t & n_common) {
+        n_common = 0;
+
+        iterator res = entries.end();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            const size_t n_max = std::min(tokens.size(), it->tokens.size());
+
+            size_t n = 0;
+            while (n < n_max && tokens[n] == it->tokens[n]) {
+                n++;
+            }
+
+            if (n > n_common) {
+                n_common = n;
+                res = it;
+            }
+        }
+
+        return res;
+    }
+
+    void add(const llama_tokens & tokens, std::vector<uint8_t> && data) {
+        if (data.empty() || data.size() > limit_ram) {
+            return;
+        }
+
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            // an existing entry that extends the new one already covers it
+            if (it->tokens.size() >= tokens.size() && std::equal(tokens.begin(), tokens.end(), it->tokens.begin())) {
+                entries.splice(entries.begin(), entries, it);
+                return;
+            }
+
+            // the new entry covers an existing one
+            if (std::equal(it->tokens.begin(), it->tokens.end(), tokens.begin())) {
+                it = erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        entry cur;
+        cur.tokens = tokens;
+        cur.size   = data.size();
+        cur.data   = std::move(data);
+
+        size_ram += cur.size;
+
+        entries.push_front(std::move(cur));
+
+        evict();
+    }
+
+    // start reading the best entry for the tokens in the background if it has been moved to disk
+    void prefetch(const llama_tokens & tokens) {
+        size_t n_common = 0;
+
+        auto it = find(tokens, n_common);
+        if (it == entries.end() || !it->on_disk() || it->prefetch.valid()) {
+            return;
+        }
+
+        const std::string path = it->path;
+        const size_t      size = it->size;
+
+        it->prefetch = std::async(std::launch::async, [path, size]() {
+            return read_file(path, size);
+        }).share();
+    }
+
+    // remove the entry from the cache and return its state data
+    std::vector<uint8_t> take(iterator it) {
+        std::vector<uint8_t> data;
+
+        if (it->on_disk()) {
+            data = it->prefetch.valid() ? it->prefetch.get() : read_file(it->path, it->size);
+        } else {
+            data = std::move(it->data);
+        }
+
+        erase(it);
+
+        return data;
+    }
+
+    void clear() {
+        while (!entries.empty()) {
+            erase(entries.begin());
+        }
+    }
+
+private:
+    iterator erase(iterator it) {
+        if (it->on_disk()) {
+            if (it->prefetch.valid()) {
+                it->prefetch.wait();
+            }
+            std::remove(it->path.c_str());
+            size_disk -= it->size;
+        } else {
+            size_ram -= it->size;
+        }
+
+        return entries.erase(it);
+    }
+
+    // move the least recently used host entries to disk, and drop the ones that do not fit there either
+    void evict() {
+        for (auto it = entries.rbegin(); it != entries.rend() && size_ram > limit_ram; ++it) {
+            if (it->on_disk()) {
+                continue;
+            }
+
+            size_ram -= it->size;
+
+            if (it->size <= limit_disk) {
+                const std::string path = dir + string_format("kv-cache-%08u.bin", n_files++);
+                if (write_file(path, it->data)) {
+                    it->path = path;
+                    size_disk += it->size;
+
+                    SRV_DBG("moved cache entry to disk, path = '%s', n_tokens = %zu, size = %.3f MiB\n", path.c_str(), it->tokens.size(), it->size / 1024.0 / 1024.0);
+                } else {
+                    SRV_WRN("failed to write cache entry to '%s'\n", path.c_str());
+                }
+            }
+
+            it->data.clear();
+            it->data.shrink_to_fit();
+        }
+
+        // drop entries that are in neither of the tiers
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (!it->on_disk() && it->data.empty()) {
+                it = entries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        while (size_disk > limit_disk) {
+            auto it = std::prev(entries.end());
+            while (!it->on_disk()) {
+                --it;
+            }
+
+            SRV_DBG("dropping cache entry, path = '%s', n_tokens = %zu\n", it->path.c_str(), it->tokens.size());
+
+            erase(it);
+        }
+    }
+
+    static bool write_file(const std::string & path, const std::vector<uint8_t> & data) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+
+        file.write((const char *) data.data(), data.size());
+
+        return file.good();
+    }
+
+    static std::vector<uint8_t> read_file(const std::string & path, size_t size) {
+        std::vector<uint8_t> data(size);
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file || !file.read((char *) data.data(), size)) {
+            data.clear();
+        }
+
+        return data;
+    }
+};
+
+// models that requests can select by name with the "model" field (--model-pool)
+// a model is loaded on first use, names that refer to the same file share a single copy of the weights
+// when the loaded models exceed the memory budget, the least recently used ones that are not active are unloaded
+struct server_model_pool {
+    struct entry {
+        llama_model_ptr model;
+
+        size_t  size        = 0;
+        int64_t t_last_used = 0;
+    };
+
+    std::map<std::string, std::string> paths; // name -> file
+
+    // loaded models, by file
+    std::map<std::string, entry> loaded;
+
+    size_t limit = 0; // bytes, 0 = no limit
+
+    void init(const common_params & params) {
+        for (const auto & [name, path] : params.model_pool) {
+            paths[name] = path;
+        }
+
+        limit = params.model_pool_mem * 1024 * 1024;
+    }
+
+    bool enabled() const {
+        return !paths.empty();
+    }
+
+    // the file of the model with the given name, empty if the name does not belong to the pool
+    std::string find(const std::string & name) const {
+        const auto it = paths.find(name);
+
+        return it == paths.end() ? std::string() : it->second;
+    }
+
+    llama_model * get(const std::string & path, const llama_model_params & mparams) {
+        auto it = loaded.find(path);
+        if (it == loaded.end()) {
+            SRV_INF("loading pool model '%s'\n", path.c_str());
+
+            llama_model_ptr model(llama_model_load_from_file(path.c_str(), mparams));
+            if (model == nullptr) {
+                SRV_ERR("failed to load pool model '%s'\n", path.c_str());
+                return nullptr;
+            }
+
+            entry e;
+            e.size  = llama_model_size(model.get());
+            e.model = std::move(model);
+
+            it = loaded.emplace(path, std::move(e)).first;
+        }
+
+        it->second.t_last_used = ggml_time_us();
+
+        evict(path);
+
+        return it->second.model.get();
+    }
+
+    void unload(const std::string & path) {
+        loaded.erase(path);
+    }
+
+    // unload the least recently used models until the pool fits in the budget, keeping the given one
+    void evict(const std::string & path_keep) {
+        if (limit == 0) {
+            return;
+        }
+
+        while (true) {
+            size_t size = 0;
+            auto lru = loaded.end();
+            for (auto it = loaded.begin(); it != loaded.end(); ++it) {
+                size += it->second.size;
+                if (it->first != path_keep && (lru == loaded.end() || it->second.t_last_used < lru->second.t_last_used)) {
+                    lru = it;
+                }
+            }
+
+            if (size <= limit || lru == loaded.end()) {
+                break;
+            }
+
+            SRV_INF("unloading pool model '%s', size = %.2f MiB\n", lru->first.c_str(), lru->second.size / 1024.0 / 1024.0);
+
+            loaded.erase(lru);
+        }
+    }
+};
+
 struct server_context {
     common_params params_base;
 
+    // declared before llama_init, so that the context is freed before the pool models
+    server_model_pool model_pool;
+
+    std::string model_pool_active;          // file of the pool model in use, empty for the main model
+    bool        model_pool_pending = false; // a task waits for the slots to become idle to swap the model
+
     // note: keep these alive - they determine the lifetime of the model, context, etc.
     common_init_result llama_init;
     common_init_result llama_init_dft;
@@ -1972,6 +2423,10 @@ struct server_context {
 
     llama_context_params cparams_dft;
 
+    // n-gram drafting: the static cache is loaded from --lookup-cache-static, the dynamic one is not recorded by the server
+    common_ngram_cache ngram_cache_static;
+    common_ngram_cache ngram_cache_dynamic;
+
     llama_batch batch {};
 
     bool clean_kv_cache = true;
@@ -1979,10 +2434,24 @@ struct server_context {
 
     int32_t n_ctx; // total context for all clients / slots
 
+    enum llama_pooling_type pooling_type = LLAMA_POOLING_TYPE_UNSPECIFIED;
+
     // slots / clients
     std::vector<server_slot> slots;
     json default_generation_settings_for_props;
 
+    // threads that tokenize the documents of /tokenize/batch, used by one request at a time
+    std::unique_ptr<common_thread_pool> tokenize_pool;
+
+    // prompt prefixes held in the KV cache by each slot, shared across slots with --kv-prefix-share
+    server_prefix_tree prefix_tree;
+
+    // host-memory and disk tiers for the KV cache of evicted slots
+    server_seq_cache seq_cache;
+
+    // tokens of recent prompt strings, shared by the HTTP threads
+    server_tokenize_cache tokenize_cache;
+
     server_queue    queue_tasks;
     server_response queue_results;
 
@@ -2031,8 +2500,13 @@ struct server_context {
 
         vocab = llama_model_get_vocab(model);
 
+        // the LoRA adapters are applied to the sequence of each slot instead, see launch_slot_with_task()
+        llama_clear_adapter_lora(ctx);
+
         n_ctx = llama_n_ctx(ctx);
 
+        pooling_type = llama_pooling_type(ctx);
+
         add_bos_token = llama_vocab_get_add_bos(vocab);
 
         if (!params_base.speculative.model.path.empty() || !params_base.speculative.model.hf_repo.empty()) {
@@ -2071,6 +2545,17 @@ struct server_context {
             cparams_dft = common_context_params_to_llama(params_dft);
             cparams_dft.n_batch = n_ctx_dft;
 
+            if (params_base.speculative.n_branch > 1) {
+                // the branches of the draft trees are decoded as extra sequences of the target context
+                if (!vocab_dft_compatible || llama_n_seq_max(ctx) < (uint32_t) (params_base.n_parallel*params_base.speculative.n_branch)) {
+                    params_base.speculative.n_branch = 1;
+                    SRV_WRN("draft trees require a unified KV cache (--kv-unified), a draft model with the same vocab and at most %zu sequences in total, --draft-branches will be ignored\n", llama_max_parallel_sequences());
+                } else {
+                    cparams_dft.n_seq_max  = params_base.speculative.n_branch;
+                    cparams_dft.kv_unified = true;
+                }
+            }
+
             // the context is not needed - we will create one for each slot
             llama_init_dft.context.reset();
         }
@@ -2112,6 +2597,41 @@ struct server_context {
                 SRV_ERR("%s\n", "err: speculative decode is not supported by multimodal");
                 return false;
             }
+
+            if (params_base.speculative.ngram) {
+                params_base.speculative.ngram = false;
+                SRV_WRN("%s\n", "n-gram drafting is not supported by multimodal, it will be disabled");
+            }
+        }
+
+        if (params_base.speculative.ngram) {
+            if (model_dft) {
+                params_base.speculative.ngram = false;
+                SRV_WRN("%s\n", "n-gram drafting is not used with a draft model");
+            } else if (!params_base.lookup_cache_static.empty()) {
+                try {
+                    ngram_cache_static = common_ngram_cache_load(params_base.lookup_cache_static);
+                } catch (const std::exception &) {
+                    SRV_ERR("failed to open static lookup cache: %s\n", params_base.lookup_cache_static.c_str());
+                    return false;
+                }
+
+                SRV_INF("loaded static lookup cache '%s' with %zu n-grams\n", params_base.lookup_cache_static.c_str(), ngram_cache_static.size());
+            }
+        }
+
+        if (params_base.speculative.n_layer_self > 0) {
+            // the draft tokens are decoded in the KV cache of the slot and removed again, so the memory must support partial removal
+            if (model_dft || params_base.speculative.ngram) {
+                params_base.speculative.n_layer_self = 0;
+                SRV_WRN("%s\n", "self-speculative drafting is not used with a draft model or n-gram drafting");
+            } else if (mctx || !llama_get_memory(ctx) || llama_model_is_recurrent(model) || llama_model_is_hybrid(model)) {
+                params_base.speculative.n_layer_self = 0;
+                SRV_WRN("%s\n", "self-speculative drafting is not supported by this context, it will be disabled");
+            } else if (params_base.speculative.n_layer_self >= llama_model_n_layer(model)) {
+                params_base.speculative.n_layer_self = 0;
+                SRV_WRN("the draft must skip some of the %d layers of the model, --draft-layers will be ignored\n", llama_model_n_layer(model));
+            }
         }
 
         if (!llama_memory_can_shift(llama_get_memory(ctx))) {
@@ -2126,6 +2646,43 @@ struct server_context {
             }
         }
 
+        if (params_base.cache_ram > 0 && (mctx || !llama_get_memory(ctx))) {
+            params_base.cache_ram = 0;
+            SRV_WRN("%s\n", "cache_ram is not supported by this context, it will be disabled");
+        }
+
+        if (!params_base.model_pool.empty()) {
+            // the draft contexts, the projector and the adapters are tied to the main model
+            if (model_dft || params_base.speculative.n_layer_self > 0 || mctx || !params_base.lora_adapters.empty() || !params_base.control_vectors.empty()) {
+                params_base.model_pool.clear();
+                SRV_WRN("%s\n", "model_pool is not supported with a draft model, self-speculative drafting, a multimodal projector, LoRA adapters or control vectors, it will be disabled");
+            }
+        }
+
+        model_pool.init(params_base);
+
+        if (params_base.kv_prefix_share) {
+            // the shared cells are only visible to other sequences within the same KV stream and must stay at their positions
+            if (!params_base.kv_unified) {
+                params_base.kv_prefix_share = false;
+                SRV_WRN("%s\n", "kv_prefix_share requires a unified KV cache (--kv-unified), it will be disabled");
+            } else if (mctx || !llama_get_memory(ctx) || llama_model_is_recurrent(model) || llama_model_is_hybrid(model) || llama_model_n_swa(model) > 0) {
+                params_base.kv_prefix_share = false;
+                SRV_WRN("%s\n", "kv_prefix_share is not supported by this context, it will be disabled");
+            } else {
+                // shifting the positions of a shared cell would corrupt the other sequences that reference it
+                if (params_base.ctx_shift) {
+                    params_base.ctx_shift = false;
+                    SRV_WRN("%s\n", "ctx_shift is not supported with kv_prefix_share, it will be disabled");
+                }
+
+                if (params_base.n_cache_reuse) {
+                    params_base.n_cache_reuse = 0;
+                    SRV_WRN("%s\n", "cache_reuse is not supported with kv_prefix_share, it will be disabled");
+                }
+            }
+        }
+
         return true;
     }
 
@@ -2145,7 +2702,7 @@ struct server_context {
             slot.cache_tokens.has_mtmd = mctx != nullptr;
 
             if (model_dft) {
-                slot.batch_spec = llama_batch_init(params_base.speculative.n_max + 1, 0, 1);
+                slot.batch_spec = llama_batch_init(params_base.speculative.n_max + 1, 0, params_base.speculative.n_branch);
 
                 slot.ctx_dft = llama_init_from_model(model_dft, cparams_dft);
                 if (slot.ctx_dft == nullptr) {
@@ -2161,6 +2718,18 @@ struct server_context {
                 for (auto &pair : params_base.speculative.replacements) {
                     common_speculative_add_replacement_tgt_dft(slot.spec, pair.first.c_str(), pair.second.c_str());
                 }
+            } else if (params_base.speculative.ngram) {
+                slot.batch_spec = llama_batch_init(params_base.speculative.n_max + 1, 0, 1);
+
+                slot.spec_ngram = true;
+            } else if (params_base.speculative.n_layer_self > 0) {
+                slot.batch_spec = llama_batch_init(params_base.speculative.n_max + 1, 0, 1);
+
+                slot.spec = common_speculative_init_self(slot.ctx, slot.id, params_base.speculative.n_layer_self);
+                if (slot.spec == nullptr) {
+                    SRV_ERR("%s", "failed to create speculator\n");
+                    return;
+                }
             }
 
             SLT_INF(slot, "new slot n_ctx_slot = %d\n", slot.n_ctx);
@@ -2186,7 +2755,15 @@ struct server_context {
             batch = llama_batch_init(std::max(n_batch, params_base.n_parallel), 0, 1);
         }
 
-        metrics.init();
+        metrics.init(params_base.n_parallel, llama_n_batch(ctx), n_ctx);
+
+        tokenize_cache.init(params_base.cache_tokenize);
+        tokenize_pool = std::make_unique<common_thread_pool>(std::max(1, std::min(params_base.n_threads_http, cpu_get_num_math())));
+
+        seq_cache.init(params_base);
+        if (seq_cache.enabled()) {
+            SRV_INF("KV cache tiers: host = %zu MiB, disk = %zu MiB, path = '%s'\n", params_base.cache_ram, seq_cache.limit_disk / 1024 / 1024, seq_cache.dir.c_str());
+        }
 
         oai_parser_opt = {
             /* use_jinja             */ params_base.use_jinja,
@@ -2280,11 +2857,22 @@ struct server_context {
         slot.task_type     = task.type;
         slot.params        = std::move(task.params);
         slot.prompt_tokens = std::move(task.prompt_tokens);
+        slot.t_enqueue     = task.t_enqueue;
+
+        if (seq_cache.enabled() && slot.params.cache_prompt) {
+            // the read of a disk entry overlaps with the wait for the slot to be scheduled
+            seq_cache.prefetch(slot.prompt_tokens.get_text_tokens());
+        }
 
         if (!are_lora_equal(slot.params.lora, slot.lora)) {
             // if lora is changed, we cannot reuse cached tokens
             slot.cache_tokens.clear();
             slot.lora = slot.params.lora;
+
+            common_set_adapter_lora_seq(ctx, slot.id, slot.lora);
+
+            // the cells of the slot were computed with the previous adapters
+            prefix_tree.remove(slot.id);
         }
 
         if (!slot.prompt_tokens.validate(ctx)) {
@@ -2312,14 +2900,16 @@ struct server_context {
             }
         }
 
-        if (slot.ctx_dft) {
+        if (slot.spec || slot.spec_ngram) {
             llama_batch_free(slot.batch_spec);
 
-            slot.batch_spec = llama_batch_init(slot.params.speculative.n_max + 1, 0, 1);
+            slot.batch_spec = llama_batch_init(slot.params.speculative.n_max + 1, 0, params_base.speculative.n_branch);
         }
 
         slot.state = SLOT_STATE_STARTED;
 
+        metrics.on_launch(slot);
+
         SLT_INF(slot, "%s", "processing task\n");
 
         return true;
@@ -2330,9 +2920,274 @@ struct server_context {
 
         // clear the entire KV cache
         llama_memory_clear(llama_get_memory(ctx), true);
+        prefix_tree.clear();
         clean_kv_cache = false;
     }
 
+    // the pooling type in the metadata of the model, rerankers are converted with LLAMA_POOLING_TYPE_RANK
+    static enum llama_pooling_type model_pool_pooling_type(const llama_model * model) {
+        char arch[64];
+        char val[16];
+        if (llama_model_meta_val_str(model, "general.architecture", arch, sizeof(arch)) < 0 ||
+            llama_model_meta_val_str(model, (std::string(arch) + ".pooling_type").c_str(), val, sizeof(val)) < 0) {
+            return LLAMA_POOLING_TYPE_UNSPECIFIED;
+        }
+
+        return (enum llama_pooling_type) std::atoi(val);
+    }
+
+    // the prompts are tokenized with the vocab of the main model, so the pool models must use the same one
+    // the context of a pool model is created with the pooling type of the main model, so with --reranking the pool
+    // models must have a classification head as well
+    bool model_pool_compatible(const std::string & path, const llama_model * other) const {
+        if (params_base.embedding && pooling_type == LLAMA_POOLING_TYPE_RANK && model_pool_pooling_type(other) != LLAMA_POOLING_TYPE_RANK) {
+            SRV_ERR("pool model '%s' is not a reranker\n", path.c_str());
+            return false;
+        }
+
+        const llama_vocab * vocab_other = llama_model_get_vocab(other);
+
+        if (llama_vocab_type    (vocab) != llama_vocab_type    (vocab_other) ||
+            llama_vocab_n_tokens(vocab) != llama_vocab_n_tokens(vocab_other) ||
+            llama_vocab_bos     (vocab) != llama_vocab_bos     (vocab_other) ||
+            llama_vocab_eos     (vocab) != llama_vocab_eos     (vocab_other)) {
+            SRV_ERR("pool model '%s' does not use the vocab of the main model\n", path.c_str());
+            return false;
+        }
+
+        for (llama_token i = 0; i < llama_vocab_n_tokens(vocab); ++i) {
+            if (strcmp(llama_vocab_get_text(vocab, i), llama_vocab_get_text(vocab_other, i)) != 0) {
+                SRV_ERR("pool model '%s' does not use the vocab of the main model\n", path.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // swap the model used by the slots, path is empty for the main model
+    // the context is recreated with the same parameters, so the KV cache and the compute buffers of only one model are
+    // allocated at a time, while the cached prompts of the previous model are discarded
+    bool model_pool_switch(const std::string & path) {
+        SRV_INF("switching model, '%s' -> '%s'\n",
+                model_pool_active.empty() ? params_base.model.path.c_str() : model_pool_active.c_str(),
+                path.empty()              ? params_base.model.path.c_str() : path.c_str());
+
+        for (server_slot & slot : slots) {
+            slot.cache_tokens.clear();
+            slot.swa_checkpoints.clear();
+        }
+        prefix_tree.clear();
+        seq_cache.clear();
+
+        // free the context before the pool can unload its model
+        llama_init.context.reset();
+        ctx = nullptr;
+
+        bool ok = true;
+
+        llama_model * model_new = llama_init.model.get();
+        if (!path.empty()) {
+            model_new = model_pool.get(path, common_model_params_to_llama(params_base));
+            if (model_new != nullptr && !model_pool_compatible(path, model_new)) {
+                model_pool.unload(path);
+                model_new = nullptr;
+            }
+            if (model_new == nullptr) {
+                model_new = llama_init.model.get();
+                ok = false;
+            }
+        }
+
+        model_pool_active = model_new == llama_init.model.get() ? std::string() : path;
+
+        // the HTTP threads rely on the context size and the pooling type of the main model
+        auto cparams = common_context_params_to_llama(params_base);
+        cparams.n_ctx        = n_ctx;
+        cparams.pooling_type = pooling_type;
+
+        llama_init.context.reset(llama_init_from_model(model_new, cparams));
+        if (llama_init.context == nullptr) {
+            GGML_ABORT("failed to create the context for '%s'", model_pool_active.empty() ? params_base.model.path.c_str() : model_pool_active.c_str());
+        }
+
+        model = model_new;
+        ctx   = llama_init.context.get();
+
+        for (server_slot & slot : slots) {
+            slot.ctx = ctx;
+        }
+
+        clean_kv_cache = false;
+
+        return ok;
+    }
+
+    // draft the continuation of the last n-grams of the slot from the n-grams seen in its tokens
+    llama_tokens gen_draft_ngram(server_slot & slot, llama_token id_last, int n_draft) {
+        const llama_tokens & tokens = slot.cache_tokens.get_text_tokens();
+
+        // the n-gram cache can only be extended, so it is rebuilt when the tokens of the slot changed otherwise
+        // between two drafts the tokens are only appended to, so the whole prefix is compared only after they were rewritten
+        // ngram_inp ends with the previous id_last, which is now the last checked token of the slot
+        llama_tokens & inp = slot.ngram_inp;
+        if (inp.size() > tokens.size() || (!inp.empty() && inp.back() != tokens[inp.size() - 1]) ||
+            (slot.ngram_check && !std::equal(inp.begin(), inp.end(), tokens.begin()))) {
+            slot.ngram_cache.clear();
+            inp.clear();
+        }
+        slot.ngram_check = false;
+
+        const size_t n_old = inp.size();
+
+        inp.insert(inp.end(), tokens.begin() + n_old, tokens.end());
+        inp.push_back(id_last);
+
+        const int n_new = inp.size() - n_old;
+
+        common_ngram_cache_update(slot.ngram_cache, LLAMA_NGRAM_MIN, LLAMA_NGRAM_MAX, slot.ngram_inp, n_new, false);
+
+        llama_tokens draft = { id_last };
+        common_ngram_cache_draft(slot.ngram_inp, draft, n_draft, LLAMA_NGRAM_MIN, LLAMA_NGRAM_MAX, slot.ngram_cache, ngram_cache_dynamic, ngram_cache_static);
+
+        draft.erase(draft.begin());
+
+        return draft;
+    }
+
+    // sequence of the branch b of the draft tree of a slot, the main branch uses the sequence of the slot
+    llama_seq_id seq_id_branch(const server_slot & slot, int b) const {
+        return b == 0 ? slot.id : params_base.n_parallel + slot.id*(params_base.speculative.n_branch - 1) + b - 1;
+    }
+
+    // register the tokens in the KV cache of the slot as a prefix that other slots can attach to
+    void prefix_publish(const server_slot & slot) {
+        if (!params_base.kv_prefix_share) {
+            return;
+        }
+
+        prefix_tree.insert(slot.id, slot.cache_tokens.get_text_tokens());
+    }
+
+    // spill the KV cache of the slot to the host-memory tier before its cells are discarded
+    void seq_cache_spill(const server_slot & slot) {
+        if (!seq_cache.enabled() || slot.cache_tokens.empty()) {
+            return;
+        }
+
+        const size_t size = llama_state_seq_get_size(ctx, slot.id);
+
+        std::vector<uint8_t> data(size);
+
+        const size_t n = llama_state_seq_get_data(ctx, data.data(), size, slot.id);
+        if (n != size) {
+            SLT_WRN(slot, "failed to spill the KV cache, n = %zu, size = %zu\n", n, size);
+            return;
+        }
+
+        seq_cache.add(slot.cache_tokens.get_text_tokens(), std::move(data));
+
+        SLT_INF(slot, "spilled KV cache, n_tokens = %zu, size = %.3f MiB, host = %.3f MiB, disk = %.3f MiB\n",
+                slot.cache_tokens.size(), size / 1024.0 / 1024.0, seq_cache.size_ram / 1024.0 / 1024.0, seq_cache.size_disk / 1024.0 / 1024.0);
+    }
+
+    // restore the spilled sequence that shares the longest prefix with the prompt, if it is longer than what the slot already has
+    void seq_cache_restore(server_slot & slot, const server_tokens & prompt_tokens) {
+        size_t n_common = 0;
+
+        auto it = seq_cache.find(prompt_tokens.get_text_tokens(), n_common);
+        if (it == seq_cache.entries.end() || (int) n_common <= slot.n_past) {
+            return;
+        }
+
+        const llama_tokens tokens = it->tokens;
+        const std::vector<uint8_t> data = seq_cache.take(it);
+
+        // the current content of the slot is replaced entirely
+        seq_cache_spill(slot);
+        prefix_tree.remove(slot.id);
+
+        const size_t n = data.empty() ? 0 : llama_state_seq_set_data(ctx, data.data(), data.size(), slot.id);
+        if (n == 0) {
+            SLT_WRN(slot, "failed to restore KV cache, n_tokens = %zu, size = %.3f MiB\n", tokens.size(), data.size() / 1024.0 / 1024.0);
+
+            llama_memory_seq_rm(llama_get_memory(ctx), slot.id, -1, -1);
+            slot.cache_tokens.clear();
+            slot.n_past = 0;
+            return;
+        }
+
+        SLT_INF(slot, "restored KV cache, n_tokens = %zu, n_common = %zu, size = %.3f MiB\n", tokens.size(), n_common, data.size() / 1024.0 / 1024.0);
+
+        slot.cache_tokens.clear();
+        slot.cache_tokens.insert(tokens);
+        slot.swa_checkpoints.clear();
+
+        slot.n_past = n_common;
+
+        prefix_publish(slot);
+    }
+
+    // free the cells of the least recently used idle slot by spilling them to the host-memory tier
+    bool seq_cache_evict_idle() {
+        if (!seq_cache.enabled() || !params_base.kv_unified) {
+            return false;
+        }
+
+        server_slot * ret = nullptr;
+
+        for (server_slot & slot : slots) {
+            if (slot.is_processing() || slot.cache_tokens.empty()) {
+                continue;
+            }
+
+            if (!ret || slot.t_last_used < ret->t_last_used) {
+                ret = &slot;
+            }
+        }
+
+        if (ret == nullptr) {
+            return false;
+        }
+
+        seq_cache_spill(*ret);
+
+        llama_memory_seq_rm(llama_get_memory(ctx), ret->id, -1, -1);
+        ret->cache_tokens.clear();
+        ret->swa_checkpoints.clear();
+        prefix_tree.remove(ret->id);
+
+        return true;
+    }
+
+    // attach the slot to the longest prefix of the prompt that is held in the KV cache by any other slot
+    // the cells are shared through llama_memory_seq_cp(), so no data is copied
+    void prefix_attach(server_slot & slot, const server_tokens & prompt_tokens) {
+        const auto match = prefix_tree.find(prompt_tokens.get_text_tokens(), [&](llama_seq_id seq_id) {
+            return seq_id != slot.id && are_lora_equal(slots[seq_id].lora, slot.lora);
+        });
+
+        if (match.seq_id < 0 || (int) match.n_tokens <= slot.n_past) {
+            return;
+        }
+
+        SLT_INF(slot, "attaching to cached prefix of slot %d, n_tokens = %zu (own n_past = %d)\n", match.seq_id, match.n_tokens, slot.n_past);
+
+        llama_memory_t mem = llama_get_memory(ctx);
+
+        llama_memory_seq_rm(mem, slot.id, -1, -1);
+        llama_memory_seq_cp(mem, match.seq_id, slot.id, 0, match.n_tokens);
+
+        const llama_tokens & tokens = prompt_tokens.get_text_tokens();
+
+        slot.cache_tokens.clear();
+        slot.cache_tokens.insert(llama_tokens(tokens.begin(), tokens.begin() + match.n_tokens));
+
+        slot.n_past = match.n_tokens;
+
+        prefix_publish(slot);
+    }
+
     bool process_token(completion_token_output & result, server_slot & slot) {
         // remember which tokens were sampled - used for repetition penalties during sampling
         const std::string token_str = result.text_to_send;
@@ -2829,6 +3684,53 @@ struct server_context {
             case SERVER_TASK_TYPE_EMBEDDING:
             case SERVER_TASK_TYPE_RERANK:
                 {
+                    if (model_pool.enabled()) {
+                        std::string path = model_pool.find(task.params.oaicompat_model);
+                        if (path == params_base.model.path) {
+                            path.clear();
+                        }
+
+                        const bool busy = std::any_of(slots.begin(), slots.end(), [](const server_slot & slot) { return slot.is_processing(); });
+
+                        // the model is swapped once all slots are idle
+                        // while a swap is pending, no new task starts on the current model, so that the swap is not starved:
+                        // the task that requests the swap stays at the front of the deferred tasks, and the tasks for the
+                        // current model wait behind it, even if they reach an idle server first
+                        const bool swap = path != model_pool_active;
+                        if (swap ? busy : model_pool_pending) {
+                            SRV_DBG("waiting for the slots to become idle to swap the model, defer task, id_task = %d, swap = %d\n", task.id, swap);
+                            model_pool_pending = model_pool_pending || swap;
+                            queue_tasks.defer(std::move(task), swap);
+                            break;
+                        }
+
+                        if (swap) {
+                            model_pool_pending = false;
+
+                            if (!model_pool_switch(path)) {
+                                send_error(task, "Failed to load model '" + task.params.oaicompat_model + "'", ERROR_TYPE_SERVER);
+
+                                // the tasks deferred behind the failed swap can start on the current model
+                                for (size_t i = 0; i < slots.size(); ++i) {
+                                    queue_tasks.pop_deferred_task();
+                                }
+                                break;
+                            }
+
+                            // the other tasks deferred during the swap can start on the idle slots
+                            for (size_t i = 1; i < slots.size(); ++i) {
+                                queue_tasks.pop_deferred_task();
+                            }
+                        }
+
+                        // the capabilities checked by the HTTP handlers are those of the main model
+                        // note: multimodal prompts do not reach this point, the pool is disabled with a multimodal projector
+                        if ((task.type == SERVER_TASK_TYPE_COMPLETION || task.type == SERVER_TASK_TYPE_INFILL) && !llama_model_has_decoder(model)) {
+                            send_error(task, "Model '" + task.params.oaicompat_model + "' does not support text generation", ERROR_TYPE_NOT_SUPPORTED);
+                            break;
+                        }
+                    }
+
                     const int id_slot = task.id_selected_slot;
 
                     server_slot * slot = id_slot != -1 ? get_slot_by_id(id_slot) : get_available_slot(task);
@@ -2909,6 +3811,12 @@ struct server_context {
                     res->n_decode_total          = metrics.n_decode_total;
                     res->n_busy_slots_total      = metrics.n_busy_slots_total;
 
+                    res->h_queue_wait = metrics.h_queue_wait;
+                    res->h_ttft       = metrics.h_ttft;
+                    res->h_tpot       = metrics.h_tpot;
+                    res->h_batch_size = metrics.h_batch_size;
+                    res->h_kv_usage   = metrics.h_kv_usage;
+
                     if (task.metrics_reset_bucket) {
                         metrics.reset_bucket();
                     }
@@ -2979,6 +3887,7 @@ struct server_context {
                     llama_tokens tokens;
                     tokens.resize(slot->n_ctx);
                     size_t token_count = 0;
+                    prefix_tree.remove(slot->id);
                     size_t nread = llama_state_seq_load_file(ctx, filepath.c_str(), slot->id, tokens.data(), tokens.size(), &token_count);
                     if (nread == 0) {
                         slot->cache_tokens.clear(); // KV may already been invalidated?
@@ -2988,6 +3897,7 @@ struct server_context {
                     tokens.resize(token_count);
                     slot->cache_tokens.clear();
                     slot->cache_tokens.insert(tokens);
+                    prefix_publish(*slot);
 
                     const int64_t t_end = ggml_time_us();
                     const double t_restore_ms = (t_end - t_start) / 1000.0;
@@ -3022,6 +3932,7 @@ struct server_context {
                     const size_t n_erased = slot->cache_tokens.size();
                     llama_memory_seq_rm(llama_get_memory(ctx), slot->id, -1, -1);
                     slot->cache_tokens.clear();
+                    prefix_tree.remove(slot->id);
 
                     auto res = std::make_unique<server_task_result_slot_erase>();
                     res->id       = task.id;
@@ -3108,6 +4019,7 @@ struct server_context {
                     new_tokens.resize(slot.cache_tokens.size() - n_discard);
                     slot.cache_tokens.clear();
                     slot.cache_tokens.insert(new_tokens);
+                    slot.ngram_check = true;
                 }
 
                 slot.n_past -= n_discard;
@@ -3154,9 +4066,28 @@ struct server_context {
         int32_t n_batch  = llama_n_batch(ctx);
         int32_t n_ubatch = llama_n_ubatch(ctx);
 
+        // while there are tokens to generate, limit the number of prompt tokens in the batch
+        // this bounds the time between generated tokens when long prompts are being processed
+        int32_t n_batch_prompt = n_batch;
+        if (batch.n_tokens > 0 && params_base.n_prefill_budget > 0) {
+            n_batch_prompt = std::min(n_batch, batch.n_tokens + params_base.n_prefill_budget);
+        }
+
+        // process the prompts of the slots with higher priority first
+        std::vector<server_slot *> slots_prompt;
+        slots_prompt.reserve(slots.size());
+        for (auto & slot : slots) {
+            slots_prompt.push_back(&slot);
+        }
+        std::stable_sort(slots_prompt.begin(), slots_prompt.end(), [](const server_slot * a, const server_slot * b) {
+            return a->params.priority > b->params.priority;
+        });
+
         // next, batch any pending prompts without exceeding n_batch
         if (params_base.cont_batching || batch.n_tokens == 0) {
-            for (auto & slot : slots) {
+            for (auto * slot_ptr : slots_prompt) {
+                auto & slot = *slot_ptr;
+
                 // check if we can batch this slot with the previous one
                 if (slot.is_processing()) {
                     if (!slot_batched) {
@@ -3275,6 +4206,19 @@ struct server_context {
                                 // reuse any previously computed tokens that are common with the new prompt
                                 slot.n_past = slot.cache_tokens.get_common_prefix(prompt_tokens);
 
+                                if (params_base.kv_prefix_share) {
+                                    // the cells past the common part are about to be overwritten
+                                    prefix_tree.truncate(slot.id, slot.n_past);
+
+                                    // reuse a longer prefix if another slot has already computed it
+                                    prefix_attach(slot, prompt_tokens);
+                                }
+
+                                if (seq_cache.enabled()) {
+                                    // bring back a longer prefix that was spilled from the KV cache earlier
+                                    seq_cache_restore(slot, prompt_tokens);
+                                }
+
                                 // reuse chunks from the cached prompt by shifting their KV cache in the new position
                                 if (params_base.n_cache_reuse > 0) {
                                     size_t head_c = slot.n_past; // cache
@@ -3409,6 +4353,11 @@ struct server_context {
                         }
                     }
 
+                    // most of the cached tokens are about to be discarded - keep them in the host-memory tier
+                    if (seq_cache.enabled() && (size_t) slot.n_past * 2 < slot.cache_tokens.size()) {
+                        seq_cache_spill(slot);
+                    }
+
                     // keep only the common part
                     if (!llama_memory_seq_rm(llama_get_memory(ctx), slot.id, slot.n_past, -1)) {
                         // could not partially delete (likely using a non-Transformer model)
@@ -3422,6 +4371,8 @@ struct server_context {
 
                     // remove the non-common part from the cache
                     slot.cache_tokens.keep_first(slot.n_past);
+                    slot.ngram_check = true;
+                    prefix_tree.truncate(slot.id, slot.n_past);
 
                     // check if we should process the image
                     if (slot.n_past < slot.n_prompt_tokens && slot.prompt_tokens[slot.n_past] == LLAMA_TOKEN_NULL) {
@@ -3447,8 +4398,11 @@ struct server_context {
                         slot.n_prompt_tokens_processed += n_pos;
                     }
 
+                    // prompts that cannot be split are not subject to the prefill budget
+                    const int32_t n_batch_slot = slot.can_split() ? n_batch_prompt : n_batch;
+
                     // add prompt tokens for processing in the current batch
-                    while (slot.n_past < slot.n_prompt_tokens && batch.n_tokens < n_batch) {
+                    while (slot.n_past < slot.n_prompt_tokens && batch.n_tokens < n_batch_slot) {
                         // get next token to process
                         llama_token cur_tok = slot.prompt_tokens[slot.n_past];
                         if (cur_tok == LLAMA_TOKEN_NULL) {
@@ -3496,7 +4450,7 @@ struct server_context {
                     }
                 }
 
-                if (batch.n_tokens >= n_batch) {
+                if (batch.n_tokens >= n_batch_prompt) {
                     break;
                 }
             }
@@ -3510,9 +4464,6 @@ struct server_context {
         SRV_DBG("decoding batch, n_tokens = %d\n", batch.n_tokens);
 
         if (slot_batched) {
-            // apply lora, only need to do it once per batch
-            common_set_adapter_lora(ctx, slot_batched->lora);
-
             llama_set_embeddings(ctx, slot_batched->need_embd());
         }
 
@@ -3534,9 +4485,16 @@ struct server_context {
 
             const int ret = llama_decode(ctx, batch_view);
 
-            metrics.on_decoded(slots);
+            metrics.on_decoded(slots, n_tokens);
 
             if (ret != 0) {
+                // make room in the KV cache by evicting an idle slot before giving up on the batch size
+                if (ret == 1 && seq_cache_evict_idle()) {
+                    SRV_WRN("failed to find free space in the KV cache, evicted an idle slot, retrying, i = %d, n_batch = %d\n", i, n_batch);
+
+                    continue; // continue loop of n_batch
+                }
+
                 {
                     std::string err;
 
@@ -3579,12 +4537,20 @@ struct server_context {
             // on successful decode, restore the original batch size
             n_batch = llama_n_batch(ctx);
 
+            // the slots that sample a token from this batch, sampled together below
+            std::vector<server_slot *>    slots_sample;
+            std::vector<common_sampler *> slots_smpl;
+            std::vector<int>              slots_idx;
+
             for (auto & slot : slots) {
                 if (slot.i_batch < (int) i || slot.i_batch >= (int) (i + n_tokens)) {
                     continue; // continue loop of slots
                 }
 
                 if (slot.state == SLOT_STATE_DONE_PROMPT) {
+                    // the entire prompt is now in the KV cache
+                    prefix_publish(slot);
+
                     if (slot.task_type == SERVER_TASK_TYPE_EMBEDDING) {
                         // prompt evaluated for embedding
                         send_embedding(slot, batch_view);
@@ -3639,9 +4605,19 @@ struct server_context {
                     continue; // continue loop of slots
                 }
 
-                const int tok_idx = slot.i_batch - i;
+                slots_sample.push_back(&slot);
+                slots_smpl  .push_back(slot.smpl);
+                slots_idx   .push_back(slot.i_batch - i);
+            }
+
+            const std::vector<llama_token> ids = common_sampler_sample_batch(slots_smpl, ctx, slots_idx);
+
+            for (size_t k = 0; k < slots_sample.size(); ++k) {
+                auto & slot = *slots_sample[k];
 
-                llama_token id = common_sampler_sample(slot.smpl, ctx, tok_idx);
+                const int tok_idx = slots_idx[k];
+
+                llama_token id = ids[k];
 
                 slot.i_batch = -1;
 
@@ -3657,6 +4633,8 @@ struct server_context {
                     metrics.on_prompt_eval(slot);
                 }
 
+                metrics.on_token(slot, t_current, 1);
+
                 slot.t_token_generation = (t_current - slot.t_start_generation) / 1e3;
 
                 completion_token_output result;
@@ -3674,6 +4652,7 @@ struct server_context {
                     slot.print_timings();
                     send_final_response(slot);
                     metrics.on_prediction(slot);
+                    prefix_publish(slot);
                     continue;
                 }
             }
@@ -3714,13 +4693,23 @@ struct server_context {
 
                 llama_token id = slot.sampled;
 
-                struct common_speculative_params params_spec;
-                params_spec.n_draft   = n_draft_max;
-                params_spec.n_reuse   = llama_n_ctx(slot.ctx_dft) - slot.params.speculative.n_max;
-                params_spec.p_min     = slot.params.speculative.p_min;
+                common_speculative_tree tree;
+
+                if (slot.spec) {
+                    struct common_speculative_params params_spec;
+                    params_spec.n_draft   = n_draft_max;
+                    params_spec.n_reuse   = slot.ctx_dft ? llama_n_ctx(slot.ctx_dft) - slot.params.speculative.n_max : 0;
+                    params_spec.p_min     = slot.params.speculative.p_min;
+                    params_spec.n_branch  = params_base.speculative.n_branch;
+                    params_spec.p_split   = params_base.speculative.p_split;
+
+                    const llama_tokens & cached_text_tokens = slot.cache_tokens.get_text_tokens();
+                    tree = common_speculative_gen_draft_tree(slot.spec, params_spec, cached_text_tokens, id);
+                } else {
+                    tree = common_speculative_tree_from_tokens(gen_draft_ngram(slot, id, n_draft_max));
+                }
 
-                const llama_tokens & cached_text_tokens = slot.cache_tokens.get_text_tokens();
-                llama_tokens draft = common_speculative_gen_draft(slot.spec, params_spec, cached_text_tokens, id);
+                const llama_tokens & draft = tree.tokens;
 
                 // ignore small drafts
                 if (slot.params.speculative.n_min > (int) draft.size()) {
@@ -3731,32 +4720,80 @@ struct server_context {
 
                 // keep track of total number of drafted tokens tested
                 slot.n_draft_total += draft.size();
+                slot.n_draft_tree  += tree.n_branch > 1;
+
+                auto * mem = llama_get_memory(ctx);
+
+                // the other branches see the cells of the slot through their own sequence
+                for (int b = 1; b < tree.n_branch; ++b) {
+                    llama_memory_seq_rm(mem, seq_id_branch(slot, b), -1, -1);
+                    llama_memory_seq_cp(mem, slot.id, seq_id_branch(slot, b), -1, -1);
+                }
 
                 // construct the speculation batch
+                // each draft token is in the sequences of the branches that contain it, so it only attends to its ancestors
+                std::vector<llama_seq_id> seq_ids;
+                for (int b = 0; b < tree.n_branch; ++b) {
+                    seq_ids.push_back(seq_id_branch(slot, b));
+                }
+
                 common_batch_clear(slot.batch_spec);
-                common_batch_add  (slot.batch_spec, id, slot.n_past, { slot.id }, true);
+                common_batch_add  (slot.batch_spec, id, slot.n_past, seq_ids, true);
+
+                std::vector<int> depth(draft.size());
 
                 for (size_t i = 0; i < draft.size(); ++i) {
-                    common_batch_add(slot.batch_spec, draft[i], slot.n_past + 1 + i, { slot.id }, true);
+                    depth[i] = tree.parents[i] < 0 ? 0 : depth[tree.parents[i]] + 1;
+
+                    seq_ids.clear();
+                    for (int b : tree.branches[i]) {
+                        seq_ids.push_back(seq_id_branch(slot, b));
+                    }
+
+                    common_batch_add(slot.batch_spec, draft[i], slot.n_past + 1 + depth[i], seq_ids, true);
                 }
 
-                SLT_DBG(slot, "decoding speculative batch, size = %d\n", slot.batch_spec.n_tokens);
+                SLT_DBG(slot, "decoding speculative batch, size = %d, branches = %d\n", slot.batch_spec.n_tokens, tree.n_branch);
 
                 llama_decode(ctx, slot.batch_spec);
 
+                std::vector<int> idxs(draft.size() + 1);
+                for (size_t i = 0; i < idxs.size(); ++i) {
+                    idxs[i] = i;
+                }
+
                 // the accepted tokens from the speculation
-                const auto ids = common_sampler_sample_and_accept_n(slot.smpl, ctx, draft);
+                std::vector<int> path;
+                const auto ids = common_sampler_sample_and_accept_tree(slot.smpl, ctx, idxs, draft, tree.parents, path);
+
+                // keep the cells of the accepted path in the sequence of the slot
+                if (!path.empty() && tree.branches[path.back()][0] != 0) {
+                    for (int i : path) {
+                        slot.n_draft_accepted_branch += tree.branches[i][0] != 0;
+                    }
+
+                    const llama_seq_id seq_id = seq_id_branch(slot, tree.branches[path.back()][0]);
+
+                    llama_memory_seq_rm(mem, slot.id, slot.n_past + 1, -1);
+                    llama_memory_seq_cp(mem, seq_id,  slot.id, slot.n_past + 1, -1);
+                }
+
+                for (int b = 1; b < tree.n_branch; ++b) {
+                    llama_memory_seq_rm(mem, seq_id_branch(slot, b), -1, -1);
+                }
 
                 slot.n_past    += ids.size();
                 slot.n_decoded += ids.size();
 
+                metrics.on_token(slot, ggml_time_us(), ids.size());
+
                 // update how many tokens out of those tested were accepted
                 slot.n_draft_accepted += ids.size() - 1;
 
                 slot.cache_tokens.push_back(id);
                 slot.cache_tokens.insert({ids.begin(), ids.end() - 1});
 
-                llama_memory_seq_rm(llama_get_memory(ctx), slot.id, slot.n_past, -1);
+                llama_memory_seq_rm(mem, slot.id, slot.n_past, -1);
 
                 for (size_t i = 0; i < ids.size(); ++i) {
                     completion_token_output result;
@@ -3773,6 +4810,7 @@ struct server_context {
                         slot.print_timings();
                         send_final_response(slot);
                         metrics.on_prediction(slot);
+                        prefix_publish(slot);
                         break;
                     }
                 }
@@ -3785,6 +4823,9 @@ struct server_context {
     }
 
     json model_meta() const {
+        // called from the HTTP threads, so it describes the main model, which stays loaded
+        const llama_model * model = llama_init.model.get();
+
         return json {
             {"vocab_type",  llama_vocab_type       (vocab)},
             {"n_vocab",     llama_vocab_n_tokens   (vocab)},
@@ -4111,6 +5152,14 @@ int main(int argc, char ** argv) {
                     {"name",  "n_busy_slots_per_decode"},
                     {"help",  "Average number of busy slots per llama_decode() call"},
                     {"value",  (float) res_metrics->n_busy_slots_total / std::max((float) res_metrics->n_decode_total, 1.f)}
+            }, {
+                    {"name",  "tokenize_cache_hits_total"},
+                    {"help",  "Number of prompt strings found in the tokenize cache."},
+                    {"value",  ctx_server.tokenize_cache.n_hit.load()}
+            }, {
+                    {"name",  "tokenize_cache_misses_total"},
+                    {"help",  "Number of prompt strings tokenized and added to the tokenize cache."},
+                    {"value",  ctx_server.tokenize_cache.n_miss.load()}
             }}},
             {"gauge", {{
                     {"name",  "prompt_tokens_seconds"},
@@ -4148,6 +5197,40 @@ int main(int argc, char ** argv) {
             }
         }
 
+        // the latency histograms are reported per slot, with the slot id as a label
+        const auto add_histogram = [&prometheus](const std::string & name, const std::string & help, const std::vector<std::pair<std::string, const server_histogram *>> & series) {
+            prometheus << "# HELP llamacpp:" << name << " " << help << "\n"
+                       << "# TYPE llamacpp:" << name << " histogram\n";
+
+            for (const auto & [labels, h] : series) {
+                uint64_t n = 0;
+                for (size_t i = 0; i < h->counts.size(); ++i) {
+                    n += h->counts[i];
+
+                    const std::string le = i < h->bounds.size() ? string_format("%g", h->bounds[i]) : "+Inf";
+                    prometheus << "llamacpp:" << name << "_bucket{" << labels << (labels.empty() ? "" : ",") << "le=\"" << le << "\"} " << n << "\n";
+                }
+
+                const std::string lbl = labels.empty() ? "" : "{" + labels + "}";
+                prometheus << "llamacpp:" << name << "_sum"   << lbl << " " << h->sum   << "\n"
+                           << "llamacpp:" << name << "_count" << lbl << " " << h->count << "\n";
+            }
+        };
+
+        const auto per_slot = [](const std::vector<server_histogram> & hists) {
+            std::vector<std::pair<std::string, const server_histogram *>> series;
+            for (size_t i = 0; i < hists.size(); ++i) {
+                series.emplace_back(string_format("slot=\"%zu\"", i), &hists[i]);
+            }
+            return series;
+        };
+
+        add_histogram("queue_wait_seconds",            "Time from receiving a request to assigning it to a slot.", per_slot(res_metrics->h_queue_wait));
+        add_histogram("time_to_first_token_seconds",   "Time from receiving a request to its first generated token.", per_slot(res_metrics->h_ttft));
+        add_histogram("time_per_output_token_seconds", "Time between two consecutive generated tokens.", per_slot(res_metrics->h_tpot));
+        add_histogram("decode_batch_tokens",           "Number of tokens per llama_decode() call.", {{ "", &res_metrics->h_batch_size }});
+        add_histogram("kv_cache_usage_ratio",          "Fraction of the context in use at each llama_decode() call.", {{ "", &res_metrics->h_kv_usage }});
+
         res.set_header("Process-Start-Time-Unix", std::to_string(res_metrics->t_start));
 
         res.set_content(prometheus.str(), "text/plain; version=0.0.4");
@@ -4282,8 +5365,8 @@ int main(int argc, char ** argv) {
                 {"audio",  ctx_server.oai_parser_opt.allow_audio},
             } },
             { "chat_template",               common_chat_templates_source(ctx_server.chat_templates.get()) },
-            { "bos_token",                   common_token_to_piece(ctx_server.ctx, llama_vocab_bos(ctx_server.vocab), /* special= */ true)},
-            { "eos_token",                   common_token_to_piece(ctx_server.ctx, llama_vocab_eos(ctx_server.vocab), /* special= */ true)},
+            { "bos_token",                   common_token_to_piece(ctx_server.vocab, llama_vocab_bos(ctx_server.vocab), /* special= */ true)},
+            { "eos_token",                   common_token_to_piece(ctx_server.vocab, llama_vocab_eos(ctx_server.vocab), /* special= */ true)},
             { "build_info",                  build_info },
         };
         if (ctx_server.params_base.use_jinja) {
@@ -4365,7 +5448,7 @@ int main(int argc, char ** argv) {
                 inputs.push_back(process_mtmd_prompt(ctx_server.mctx, prompt.get<std::string>(), files));
             } else {
                 // Everything else, including multimodal completions.
-                inputs = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, prompt, true, true);
+                inputs = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, prompt, true, true, &ctx_server.tokenize_cache);
             }
 
             tasks.reserve(inputs.size());
@@ -4377,7 +5460,8 @@ int main(int argc, char ** argv) {
 
                 task.prompt_tokens    = std::move(inputs[i]);
                 task.params           = server_task::params_from_json_cmpl(
-                        ctx_server.ctx,
+                        ctx_server.vocab,
+                        ctx_server.n_ctx,
                         ctx_server.params_base,
                         data);
                 task.id_selected_slot = json_value(data, "id_slot", -1);
@@ -4534,7 +5618,7 @@ int main(int argc, char ** argv) {
         data["input_extra"] = input_extra; // default to empty array if it's not exist
 
         std::string prompt = json_value(data, "prompt", std::string());
-        std::vector<server_tokens> tokenized_prompts = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, prompt, false, true);
+        std::vector<server_tokens> tokenized_prompts = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, prompt, false, true, &ctx_server.tokenize_cache);
         SRV_DBG("creating infill tasks, n_prompts = %d\n", (int) tokenized_prompts.size());
         data["prompt"] = format_infill(
             ctx_server.vocab,
@@ -4630,10 +5714,51 @@ int main(int argc, char ** argv) {
             }}
         };
 
+        for (const auto & [name, path] : ctx_server.model_pool.paths) {
+            models["data"].push_back({
+                {"id",       name},
+                {"object",   "model"},
+                {"created",  std::time(0)},
+                {"owned_by", "llamacpp"},
+                {"meta",     nullptr},
+            });
+        }
+
         res_ok(res, models);
     };
 
-    const auto handle_tokenize = [&ctx_server, &res_ok](const httplib::Request & req, httplib::Response & res) {
+    // the tokens of a /tokenize response, as ids or as objects with the id and the piece
+    const auto format_tokens = [&ctx_server](const llama_tokens & tokens, bool with_pieces) {
+        if (!with_pieces) {
+            return json(tokens);
+        }
+
+        json tokens_response = json::array();
+        for (const auto& token : tokens) {
+            std::string piece = common_token_to_piece(ctx_server.vocab, token);
+            json piece_json;
+
+            // Check if the piece is valid UTF-8
+            if (is_valid_utf8(piece)) {
+                piece_json = piece;
+            } else {
+                // If not valid UTF-8, store as array of byte values
+                piece_json = json::array();
+                for (unsigned char c : piece) {
+                    piece_json.push_back(static_cast<int>(c));
+                }
+            }
+
+            tokens_response.push_back({
+                {"id", token},
+                {"piece", piece_json}
+            });
+        }
+
+        return tokens_response;
+    };
+
+    const auto handle_tokenize = [&ctx_server, &res_ok, &format_tokens](const httplib::Request & req, httplib::Response & res) {
         const json body = json::parse(req.body);
 
         json tokens_response = json::array();
@@ -4642,36 +5767,68 @@ int main(int argc, char ** argv) {
             const bool parse_special = json_value(body, "parse_special", true);
             const bool with_pieces = json_value(body, "with_pieces", false);
 
-            llama_tokens tokens = tokenize_mixed(ctx_server.vocab, body.at("content"), add_special, parse_special);
+            llama_tokens tokens = tokenize_mixed(ctx_server.vocab, body.at("content"), add_special, parse_special, &ctx_server.tokenize_cache);
 
-            if (with_pieces) {
-                for (const auto& token : tokens) {
-                    std::string piece = common_token_to_piece(ctx_server.ctx, token);
-                    json piece_json;
+            tokens_response = format_tokens(tokens, with_pieces);
+        }
 
-                    // Check if the piece is valid UTF-8
-                    if (is_valid_utf8(piece)) {
-                        piece_json = piece;
-                    } else {
-                        // If not valid UTF-8, store as array of byte values
-                        piece_json = json::array();
-                        for (unsigned char c : piece) {
-                            piece_json.push_back(static_cast<int>(c));
-                        }
-                    }
+        const json data = format_tokenizer_response(tokens_response);
+        res_ok(res, data);
+    };
 
-                    tokens_response.push_back({
-                        {"id", token},
-                        {"piece", piece_json}
-                    });
+    // tokenize many documents at once, spread over up to --threads-http threads
+    const auto handle_tokenize_batch = [&ctx_server, &res_error, &res_ok, &format_tokens](const httplib::Request & req, httplib::Response & res) {
+        const json body = json::parse(req.body);
+
+        if (!body.contains("content") || !body.at("content").is_array()) {
+            res_error(res, format_error_response("\"content\" must be an array of documents", ERROR_TYPE_INVALID_REQUEST));
+            return;
+        }
+
+        const json & docs = body.at("content");
+
+        const bool add_special = json_value(body, "add_special", false);
+        const bool parse_special = json_value(body, "parse_special", true);
+        const bool with_pieces = json_value(body, "with_pieces", false);
+
+        for (const auto & doc : docs) {
+            if (!doc.is_string() && !json_is_array_of_mixed_numbers_strings(doc) && !json_is_array_of_numbers(doc)) {
+                res_error(res, format_error_response("each document must be a string or a list of mixed strings & tokens", ERROR_TYPE_INVALID_REQUEST));
+                return;
+            }
+        }
+
+        const int32_t n_vocab = llama_vocab_n_tokens(ctx_server.vocab);
+
+        std::vector<json>        results(docs.size());
+        std::vector<std::string> errors (docs.size());
+
+        // errors are reported per document, an exception must not escape the worker threads of the pool
+        ctx_server.tokenize_pool->parallel_for(docs.size(), [&](int i) {
+            try {
+                const llama_tokens tokens = tokenize_mixed(ctx_server.vocab, docs[i], add_special, parse_special, &ctx_server.tokenize_cache);
+
+                for (const llama_token t : tokens) {
+                    if (t < 0 || t >= n_vocab) {
+                        errors[i] = string_format("document %d: token %d is out of the vocab range [0, %d)", i, t, n_vocab);
+                        return;
+                    }
                 }
-            } else {
-                tokens_response = tokens;
+
+                results[i] = format_tokenizer_response(format_tokens(tokens, with_pieces));
+            } catch (const std::exception & e) {
+                errors[i] = string_format("document %d: %s", i, e.what());
+            }
+        });
+
+        for (const auto & err : errors) {
+            if (!err.empty()) {
+                res_error(res, format_error_response(err, ERROR_TYPE_INVALID_REQUEST));
+                return;
             }
         }
 
-        const json data = format_tokenizer_response(tokens_response);
-        res_ok(res, data);
+        res_ok(res, json {{ "results", results }});
     };
 
     const auto handle_detokenize = [&ctx_server, &res_ok](const httplib::Request & req, httplib::Response & res) {
@@ -4680,7 +5837,7 @@ int main(int argc, char ** argv) {
         std::string content;
         if (body.count("tokens") != 0) {
             const llama_tokens tokens = body.at("tokens");
-            content = tokens_to_str(ctx_server.ctx, tokens.cbegin(), tokens.cend());
+            content = tokens_to_str(ctx_server.vocab, tokens.cbegin(), tokens.cend());
         }
 
         const json data = format_detokenized_response(content);
@@ -4693,7 +5850,7 @@ int main(int argc, char ** argv) {
             return;
         }
 
-        if (oaicompat != OAICOMPAT_TYPE_NONE && llama_pooling_type(ctx_server.ctx) == LLAMA_POOLING_TYPE_NONE) {
+        if (oaicompat != OAICOMPAT_TYPE_NONE && ctx_server.pooling_type == LLAMA_POOLING_TYPE_NONE) {
             res_error(res, format_error_response("Pooling type 'none' is not OAI compatible. Please use a different pooling type", ERROR_TYPE_INVALID_REQUEST));
             return;
         }
@@ -4723,7 +5880,7 @@ int main(int argc, char ** argv) {
             }
         }
 
-        auto tokenized_prompts = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, prompt, true, true);
+        auto tokenized_prompts = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, prompt, true, true, &ctx_server.tokenize_cache);
         for (const auto & tokens : tokenized_prompts) {
             // this check is necessary for models that do not add BOS token to the input
             if (tokens.empty()) {
@@ -4735,11 +5892,14 @@ int main(int argc, char ** argv) {
         int embd_normalize = 2; // default to Euclidean/L2 norm
         if (body.count("embd_normalize") != 0) {
             embd_normalize = body.at("embd_normalize");
-            if (llama_pooling_type(ctx_server.ctx) == LLAMA_POOLING_TYPE_NONE) {
-                SRV_DBG("embd_normalize is not supported by pooling type %d, ignoring it\n", llama_pooling_type(ctx_server.ctx));
+            if (ctx_server.pooling_type == LLAMA_POOLING_TYPE_NONE) {
+                SRV_DBG("embd_normalize is not supported by pooling type %d, ignoring it\n", ctx_server.pooling_type);
             }
         }
 
+        // selects the pool model, see --model-pool
+        const std::string model_name = json_value(body, "model", ctx_server.params_base.model_alias.empty() ? std::string(DEFAULT_OAICOMPAT_MODEL) : ctx_server.params_base.model_alias);
+
         // create and queue the task
         json responses = json::array();
         bool error = false;
@@ -4755,6 +5915,7 @@ int main(int argc, char ** argv) {
 
                 // OAI-compat
                 task.params.oaicompat = oaicompat;
+                task.params.oaicompat_model = model_name;
                 task.params.embd_normalize = embd_normalize;
 
                 tasks.push_back(std::move(task));
@@ -4838,7 +5999,10 @@ int main(int argc, char ** argv) {
             return;
         }
 
-        std::vector<server_tokens> tokenized_queries = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, query, /* add_special */ false, true);
+        // selects the pool model, see --model-pool
+        const std::string model_name = json_value(body, "model", ctx_server.params_base.model_alias.empty() ? std::string(DEFAULT_OAICOMPAT_MODEL) : ctx_server.params_base.model_alias);
+
+        std::vector<server_tokens> tokenized_queries = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, query, /* add_special */ false, true, &ctx_server.tokenize_cache);
         if (tokenized_queries.size() != 1) {
             res_error(res, format_error_response("\"query\" must contain only a single prompt", ERROR_TYPE_INVALID_REQUEST));
         }
@@ -4849,7 +6013,7 @@ int main(int argc, char ** argv) {
         std::unordered_set<int> task_ids;
         {
             std::vector<server_task> tasks;
-            auto tokenized_docs = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, documents, /* add_special */ false, true);
+            auto tokenized_docs = tokenize_input_prompts(ctx_server.vocab, ctx_server.mctx, documents, /* add_special */ false, true, &ctx_server.tokenize_cache);
             tasks.reserve(tokenized_docs.size());
             for (size_t i = 0; i < tokenized_docs.size(); i++) {
                 auto tmp = format_rerank(ctx_server.vocab, tokenized_queries[0], tokenized_docs[i]);
@@ -4857,6 +6021,7 @@ int main(int argc, char ** argv) {
                 task.id            = ctx_server.queue_tasks.get_new_id();
                 task.index         = i;
                 task.prompt_tokens = std::move(tmp);
+                task.params.oaicompat_model = model_name;
                 tasks.push_back(std::move(task));
             }
 
@@ -4989,6 +6154,7 @@ int main(int argc, char ** argv) {
     svr->Post(params.api_prefix + "/v1/rerank",           handle_rerank);
     svr->Post(params.api_prefix + "/v1/reranking",        handle_rerank);
     svr->Post(params.api_prefix + "/tokenize",            handle_tokenize);
+    svr->Post(params.api_prefix + "/tokenize/batch",      handle_tokenize_batch);
     svr->Post(params.api_prefix + "/detokenize",          handle_detokenize);
     svr->Post(params.api_prefix + "/apply-template",      handle_apply_template);
     // LoRA adapters hotswap
@@ -64,6 +64,26 @@ def test_server_slots():
     assert res.body[0]["params"]["seed"] == server.seed
 
 
+def test_server_metrics_histograms():
+    global server
+    server.server_metrics = True
+    server.n_slots = 2
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "n_predict": 8,
+        "prompt": "Hello",
+    })
+    assert res.status_code == 200
+    res = requests.get(f"http://{server.server_host}:{server.server_port}/metrics")
+    assert res.status_code == 200
+    assert "# TYPE llamacpp:time_to_first_token_seconds histogram" in res.text
+    assert 'llamacpp:time_per_output_token_seconds_bucket{slot="1",le="+Inf"}' in res.text
+    counts = [int(line.split()[-1]) for line in res.text.splitlines() if line.startswith("llamacpp:time_to_first_token_seconds_count")]
+    assert len(counts) == server.n_slots
+    assert sum(counts) == 1
+    assert "llamacpp:decode_batch_tokens_count" in res.text
+
+
 def test_load_split_model():
     global server
     server.model_hf_repo = "ggml-org/models"
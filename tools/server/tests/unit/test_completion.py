@@ -233,6 +233,74 @@ def test_nocache_long_input_prompt():
     })
     assert res.status_code == 400
 
+def test_kv_prefix_share():
+    global server
+    server.kv_unified = True
+    server.kv_prefix_share = True
+    server.temperature = 0.0
+    server.start()
+
+    # First prompt in slot 1 should be fully processed
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "What is the capital of France?",
+        "id_slot": 1,
+        "cache_prompt": True,
+    })
+    assert res.status_code == 200
+    assert res.body["timings"]["prompt_n"] == 21  # all tokens are processed
+
+    # slot 0 has never seen this prompt, but it can attach to the prefix computed by slot 1
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "What is the capital of Germany?",
+        "id_slot": 0,
+        "cache_prompt": True,
+    })
+    assert res.status_code == 200
+    assert match_regex("(Jack|said)+", res.body["content"])
+    assert res.body["timings"]["prompt_n"] == 6  # only different part is processed
+
+    # slot 1 must not be affected by the sharing
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "What is the capital of France?",
+        "id_slot": 1,
+        "cache_prompt": True,
+    })
+    assert res.status_code == 200
+    assert match_regex("(Whiskers|Flana)+", res.body["content"])
+    assert res.body["timings"]["prompt_n"] == 1
+
+
+def test_cache_ram():
+    global server
+    server.n_slots = 1
+    server.cache_ram = 64
+    server.temperature = 0.0
+    server.start()
+
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "What is the capital of France?",
+        "cache_prompt": True,
+    })
+    assert res.status_code == 200
+    assert res.body["timings"]["prompt_n"] == 21  # all tokens are processed
+
+    # a different prompt evicts the cache of the only slot
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "Once upon a time",
+        "cache_prompt": True,
+    })
+    assert res.status_code == 200
+
+    # the first prompt is restored from host memory instead of being recomputed
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "What is the capital of France?",
+        "cache_prompt": True,
+    })
+    assert res.status_code == 200
+    assert match_regex("(Whiskers|Flana)+", res.body["content"])
+    assert res.body["timings"]["prompt_n"] == 1
+
+
 def test_json_prompt_no_mtmd():
     global server
     server.start()
@@ -368,6 +436,62 @@ def test_completion_parallel_slots(n_slots: int, n_requests: int):
         # assert match_regex(re_content, res.body["content"])
 
 
+def test_completion_prefill_budget():
+    global server
+    server.n_slots = 2
+    server.prefill_budget = 4
+    server.temperature = 0.0
+    server.start()
+
+    # the long prompt is processed in small chunks while the other slot is generating
+    tasks = [
+        (server.make_request, ("POST", "/completion", {
+            "prompt": "I believe the meaning of life is",
+            "n_predict": 32,
+            "priority": 1,
+        })),
+        (server.make_request, ("POST", "/completion", {
+            "prompt": "Write a very long book. " * 8,
+            "n_predict": 8,
+        })),
+    ]
+    results = parallel_function_calls(tasks)
+    for res in results:
+        assert res.status_code == 200
+        assert len(res.body["content"]) > 0
+    assert results[0].body["generation_settings"]["priority"] == 1
+
+
+def test_completion_priority_order():
+    global server
+    server.n_slots = 2
+    server.n_ctx = 2048
+    server.n_batch = 64
+    server.n_ubatch = 1
+    server.temperature = 0.0
+    server.start()
+
+    def make_request(priority: int):
+        res = server.make_request("POST", "/completion", data={
+            "prompt": "Write a very long book. " * 40,
+            "n_predict": 8,
+            "priority": priority,
+        })
+        return res, time.time()
+
+    # both prompts take many batches, the prompt of the higher priority request is processed first
+    # even though the other request is sent first and both prompts have the same length
+    results = parallel_function_calls([
+        (make_request, (0,)),
+        (make_request, (1,)),
+    ])
+    (res_low, t_low), (res_high, t_high) = results
+    assert res_low.status_code == 200
+    assert res_high.status_code == 200
+    assert res_low.body["timings"]["prompt_n"] == res_high.body["timings"]["prompt_n"]
+    assert t_high < t_low
+
+
 @pytest.mark.parametrize(
     "prompt,n_predict,response_fields",
     [
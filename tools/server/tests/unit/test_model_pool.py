@@ -0,0 +1,158 @@
+import pytest
+import threading
+import time
+from utils import *
+
+server = ServerPreset.tinyllama2()
+
+# the pool models are separate files, so that selecting them swaps the model
+STORIES_FILE_URL = "https://huggingface.co/ggml-org/models/resolve/main/tinyllamas/stories260K.gguf"
+BGE_FILE_URL     = "https://huggingface.co/ggml-org/models/resolve/main/bert-bge-small/ggml-model-f16.gguf"
+JINA_FILE_URL    = "https://huggingface.co/ggml-org/models/resolve/main/jina-reranker-v1-tiny-en/ggml-model-f16.gguf"
+
+
+@pytest.fixture(autouse=True)
+def create_server():
+    global server
+    server = ServerPreset.tinyllama2()
+
+
+def test_model_pool_completion():
+    global server
+    server.model_pool = [
+        ("pool-stories", download_file(STORIES_FILE_URL, "./tmp/pool-stories260K.gguf")),
+        ("pool-bge",     download_file(BGE_FILE_URL,     "./tmp/pool-bge-small.gguf")),
+    ]
+    server.temperature = 0.0
+    server.start()
+
+    def complete(model: str | None):
+        data = {"prompt": "I believe the meaning of life is", "n_predict": 8}
+        if model is not None:
+            data["model"] = model
+        return server.make_request("POST", "/completion", data=data)
+
+    res_main = complete(None)
+    assert res_main.status_code == 200
+
+    # same weights in another file
+    res = complete("pool-stories")
+    assert res.status_code == 200
+    assert res.body["model"] == "pool-stories"
+    assert res.body["content"] == res_main.body["content"]
+
+    # different vocab
+    res = complete("pool-bge")
+    assert res.status_code != 200
+    assert "pool-bge" in res.body["error"]["message"]
+
+    # back to the main model
+    res = complete(None)
+    assert res.status_code == 200
+    assert res.body["content"] == res_main.body["content"]
+
+    res = server.make_request("GET", "/v1/models")
+    assert res.status_code == 200
+    ids = [m["id"] for m in res.body["data"]]
+    assert "pool-stories" in ids
+    assert "pool-bge" in ids
+
+
+def test_model_pool_swap_not_starved():
+    global server
+    server.model_pool = [
+        ("pool-stories", download_file(STORIES_FILE_URL, "./tmp/pool-stories260K.gguf")),
+    ]
+    server.n_slots = 2
+    server.start()
+
+    # a steady stream of requests for the main model keeps the slots busy
+    stop = threading.Event()
+    main_requests = []
+    def stream():
+        while not stop.is_set():
+            t_sent = time.time()
+            res = server.make_request("POST", "/completion", data={"prompt": "I believe the meaning of life is", "n_predict": 32})
+            assert res.status_code == 200
+            main_requests.append((t_sent, time.time()))
+
+    threads = [threading.Thread(target=stream) for _ in range(2 * server.n_slots)]
+    for t in threads:
+        t.start()
+    time.sleep(1.0)
+
+    t_pool = time.time()
+    res = server.make_request("POST", "/completion", data={"prompt": "I believe the meaning of life is", "n_predict": 8, "model": "pool-stories"})
+    t_pool_done = time.time()
+    stop.set()
+    for t in threads:
+        t.join()
+    assert res.status_code == 200
+    assert res.body["model"] == "pool-stories"
+
+    # once the swap is pending, no new request starts on the main model, so the requests sent after the pool
+    # request do not finish before it (up to the slots that pick one up right after it completes)
+    n_overtaking = sum(1 for t_sent, t_done in main_requests if t_sent > t_pool and t_done < t_pool_done)
+    assert n_overtaking <= server.n_slots
+
+
+def test_model_pool_embedding():
+    global server
+    server = ServerPreset.bert_bge_small()
+    server.model_pool = [
+        ("pool-bge",     download_file(BGE_FILE_URL,     "./tmp/pool-bge-small.gguf")),
+        ("pool-stories", download_file(STORIES_FILE_URL, "./tmp/pool-stories260K.gguf")),
+    ]
+    server.start()
+
+    def embed(model: str | None):
+        data = {"input": "I believe the meaning of life is"}
+        if model is not None:
+            data["model"] = model
+        return server.make_request("POST", "/v1/embeddings", data=data)
+
+    res_main = embed(None)
+    assert res_main.status_code == 200
+
+    res = embed("pool-bge")
+    assert res.status_code == 200
+    for x, y in zip(res.body["data"][0]["embedding"], res_main.body["data"][0]["embedding"]):
+        assert abs(x - y) < 1e-6
+
+    # the "model" field selects the pool model for embeddings too
+    res = embed("pool-stories")
+    assert res.status_code != 200
+    assert "pool-stories" in res.body["error"]["message"]
+
+
+def test_model_pool_rerank():
+    global server
+    server = ServerPreset.jina_reranker_tiny()
+    server.model_pool = [
+        ("pool-jina", download_file(JINA_FILE_URL, "./tmp/pool-jina-reranker.gguf")),
+        # not a reranker
+        ("pool-bge",  download_file(BGE_FILE_URL,  "./tmp/pool-bge-small.gguf")),
+    ]
+    server.start()
+
+    def rerank(model: str | None):
+        data = {
+            "query": "Machine learning is",
+            "documents": ["A machine", "Learning is", "Machine learning is a field of study"],
+        }
+        if model is not None:
+            data["model"] = model
+        return server.make_request("POST", "/rerank", data=data)
+
+    res_main = rerank(None)
+    assert res_main.status_code == 200
+
+    res = rerank("pool-jina")
+    assert res.status_code == 200
+    for x, y in zip(res.body["results"], res_main.body["results"]):
+        assert x["index"] == y["index"]
+        assert abs(x["relevance_score"] - y["relevance_score"]) < 1e-6
+
+    res = rerank("pool-bge")
+    assert res.status_code != 200
+    assert "pool-bge" in res.body["error"]["message"]
@@ -74,6 +74,98 @@ def test_different_draft_min_draft_max():
         last_content = res.body["content"]
 
 
+@pytest.mark.parametrize("n_slots", [1, 2])
+def test_draft_tree_same_output(n_slots: int):
+    global server
+    server.n_slots = n_slots
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "I believe the meaning of life is",
+        "temperature": 0.0,
+        "top_k": 1,
+    })
+    assert res.status_code == 200
+    content_linear = res.body["content"]
+    server.stop()
+
+    # the branches of the draft tree only change which tokens are tested
+    create_server()
+    server.n_slots = n_slots
+    server.kv_unified = True
+    server.draft_branches = 4
+    server.draft_p_split = 0.01
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "I believe the meaning of life is",
+        "temperature": 0.0,
+        "top_k": 1,
+        "speculative.p_min": 0.0,
+    })
+    assert res.status_code == 200
+    assert res.body["content"] == content_linear
+    # the drafts did fork into several branches
+    assert res.body["timings"]["draft_n"] > 0
+    assert res.body["timings"]["draft_n_tree"] > 0
+
+
+def test_ngram_draft_same_output():
+    global server
+    server.model_draft = None  # disable draft model
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "Once upon a time, there was a cat. The cat was happy. Once upon a time, there was a",
+        "temperature": 0.0,
+        "top_k": 1,
+    })
+    assert res.status_code == 200
+    content_no_draft = res.body["content"]
+    server.stop()
+
+    # the drafts come from the n-grams of the context, without a draft model
+    create_server()
+    server.model_draft = None
+    server.draft_ngram = True
+    server.draft_min = 1
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "Once upon a time, there was a cat. The cat was happy. Once upon a time, there was a",
+        "temperature": 0.0,
+        "top_k": 1,
+    })
+    assert res.status_code == 200
+    assert res.body["content"] == content_no_draft
+    assert res.body["timings"].get("draft_n", 0) > 0
+
+
+def test_self_draft_same_output():
+    global server
+    server.model_draft = None  # disable draft model
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "I believe the meaning of life is",
+        "temperature": 0.0,
+        "top_k": 1,
+    })
+    assert res.status_code == 200
+    content_no_draft = res.body["content"]
+    server.stop()
+
+    # the drafts come from the first layers of the main model, without a draft model
+    create_server()
+    server.model_draft = None
+    server.draft_layers = 4
+    server.start()
+    res = server.make_request("POST", "/completion", data={
+        "prompt": "I believe the meaning of life is",
+        "temperature": 0.0,
+        "top_k": 1,
+        "speculative.p_min": 0.0,
+    })
+    assert res.status_code == 200
+    assert res.body["content"] == content_no_draft
+    assert res.body["timings"].get("draft_n", 0) > 0
+
+
 def test_slot_ctx_not_exceeded():
     global server
     server.n_ctx = 64
@@ -57,3 +57,70 @@ def test_tokenize_with_pieces():
         assert token["id"] > 0
         assert "piece" in token
         assert len(token["piece"]) > 0
+
+
+def test_tokenize_batch():
+    global server
+    server.n_threads_http = 4
+    server.start()
+    # long documents go through the tokenize cache, sending them twice must not change the tokens
+    docs = [f"Document {i}: " + "the quick brown fox jumps over the lazy dog. " * (i + 5) for i in range(16)]
+    docs.append("short")
+    for _ in range(2):
+        res = server.make_request("POST", "/tokenize/batch", data={
+            "content": docs,
+            "add_special": True,
+        })
+        assert res.status_code == 200
+        assert len(res.body["results"]) == len(docs)
+        for doc, result in zip(docs, res.body["results"]):
+            res_tok = server.make_request("POST", "/tokenize", data={
+                "content": doc,
+                "add_special": True,
+            })
+            assert res_tok.status_code == 200
+            assert result["tokens"] == res_tok.body["tokens"]
+
+
+def test_tokenize_batch_invalid():
+    global server
+    server.start()
+    res = server.make_request("POST", "/tokenize/batch", data={
+        "content": "not an array",
+    })
+    assert res.status_code == 400
+
+
+def test_tokenize_batch_invalid_token():
+    global server
+    server.n_threads_http = 4
+    server.start()
+    # a token id outside the vocab fails the request instead of the worker thread that formats its piece
+    res = server.make_request("POST", "/tokenize/batch", data={
+        "content": ["hello", [1, 2, 10**9], "world"],
+        "with_pieces": True,
+    })
+    assert res.status_code == 400
+    assert "document 1" in res.body["error"]["message"]
+    # the server is still up
+    res = server.make_request("POST", "/tokenize/batch", data={
+        "content": ["hello", [1, 2, 3]],
+        "with_pieces": True,
+    })
+    assert res.status_code == 200
+    assert len(res.body["results"]) == 2
+
+
+def test_tokenize_cache_metrics():
+    global server
+    server.server_metrics = True
+    server.start()
+    doc = "the quick brown fox jumps over the lazy dog. " * 10
+    for _ in range(2):
+        res = server.make_request("POST", "/tokenize/batch", data={"content": [doc]})
+        assert res.status_code == 200
+    res = requests.get(f"http://{server.server_host}:{server.server_port}/metrics")
+    assert res.status_code == 200
+    metrics = {line.split()[0]: float(line.split()[1]) for line in res.text.splitlines() if line.startswith("llamacpp:tokenize_cache")}
+    assert metrics["llamacpp:tokenize_cache_misses_total"] == 1
+    assert metrics["llamacpp:tokenize_cache_hits_total"] == 1
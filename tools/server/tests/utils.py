@@ -67,9 +67,14 @@ class ServerProcess:
     id_slot: int | None = None
     cache_prompt: bool | None = None
     n_slots: int | None = None
+    n_threads_http: int | None = None
     ctk: str | None = None
     ctv: str | None = None
     fa: bool | None = None
+    kv_unified: bool | None = False
+    kv_prefix_share: bool | None = False
+    cache_ram: int | None = None
+    prefill_budget: int | None = None
     server_continuous_batching: bool | None = False
     server_embeddings: bool | None = False
     server_reranking: bool | None = False
@@ -79,9 +84,14 @@ class ServerProcess:
     draft: int | None = None
     api_key: str | None = None
     lora_files: List[str] | None = None
+    model_pool: List[Tuple[str, str]] | None = None
     enable_ctx_shift: int | None = False
     draft_min: int | None = None
     draft_max: int | None = None
+    draft_branches: int | None = None
+    draft_p_split: float | None = None
+    draft_ngram: bool | None = None
+    draft_layers: int | None = None
     no_webui: bool | None = None
     jinja: bool | None = None
     reasoning_format: Literal['deepseek', 'none', 'nothink'] | None = None
@@ -159,12 +169,22 @@ class ServerProcess:
             server_args.extend(["--ctx-size", self.n_ctx])
         if self.n_slots:
             server_args.extend(["--parallel", self.n_slots])
+        if self.n_threads_http:
+            server_args.extend(["--threads-http", self.n_threads_http])
         if self.ctk:
             server_args.extend(["-ctk", self.ctk])
         if self.ctv:
             server_args.extend(["-ctv", self.ctv])
         if self.fa is not None:
             server_args.append("-fa")
+        if self.kv_unified:
+            server_args.append("--kv-unified")
+        if self.kv_prefix_share:
+            server_args.append("--kv-prefix-share")
+        if self.cache_ram:
+            server_args.extend(["--cache-ram", self.cache_ram])
+        if self.prefill_budget:
+            server_args.extend(["--prefill-budget", self.prefill_budget])
         if self.n_predict:
             server_args.extend(["--n-predict", self.n_predict])
         if self.slot_save_path:
@@ -178,6 +198,9 @@ class ServerProcess:
         if self.lora_files:
             for lora_file in self.lora_files:
                 server_args.extend(["--lora", lora_file])
+        if self.model_pool:
+            for name, path in self.model_pool:
+                server_args.extend(["--model-pool", name, path])
         if self.enable_ctx_shift:
             server_args.append("--context-shift")
         if self.api_key:
@@ -186,6 +209,14 @@ class ServerProcess:
             server_args.extend(["--draft-max", self.draft_max])
         if self.draft_min:
             server_args.extend(["--draft-min", self.draft_min])
+        if self.draft_branches:
+            server_args.extend(["--draft-branches", self.draft_branches])
+        if self.draft_p_split is not None:
+            server_args.extend(["--draft-p-split", self.draft_p_split])
+        if self.draft_ngram:
+            server_args.append("--draft-ngram")
+        if self.draft_layers:
+            server_args.extend(["--draft-layers", self.draft_layers])
         if self.no_webui:
             server_args.append("--no-webui")
         if self.jinja:
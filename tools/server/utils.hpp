@@ -20,9 +20,17 @@
 #define JSON_ASSERT GGML_ASSERT
 #include <nlohmann/json.hpp>
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
 #include <random>
+#include <set>
 #include <sstream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <cinttypes>
@@ -158,16 +166,131 @@ static json json_get_nested_values(const std::vector<std::string> & paths, const
     return result;
 }
 
+// size-bounded LRU cache of the tokens of prompt strings, keyed by a hash of the content
+// it is split into shards with their own lock, so that the HTTP threads rarely wait for each other
+struct server_tokenize_cache {
+    static constexpr size_t N_SHARDS = 16;
+
+    // shorter strings are cheaper to tokenize than to look up
+    static constexpr size_t MIN_SIZE = 256;
+
+    struct entry {
+        uint64_t key;
+
+        const llama_vocab * vocab;
+
+        std::string text;
+
+        bool add_special;
+        bool parse_special;
+
+        llama_tokens tokens;
+
+        size_t size() const {
+            return sizeof(entry) + text.size() + tokens.size()*sizeof(llama_token);
+        }
+    };
+
+    struct shard {
+        std::mutex mutex;
+
+        // most recently used first
+        std::list<entry> entries;
+        std::unordered_map<uint64_t, std::list<entry>::iterator> index;
+
+        size_t size = 0;
+    };
+
+    size_t limit = 0; // bytes per shard
+
+    std::array<shard, N_SHARDS> shards;
+
+    std::atomic<uint64_t> n_hit  = 0;
+    std::atomic<uint64_t> n_miss = 0;
+
+    void init(size_t limit_mib) {
+        limit = limit_mib*1024*1024/N_SHARDS;
+    }
+
+    bool enabled() const {
+        return limit > 0;
+    }
+
+    llama_tokens tokenize(const llama_vocab * vocab, const std::string & text, bool add_special, bool parse_special) {
+        if (!enabled() || text.size() < MIN_SIZE) {
+            return common_tokenize(vocab, text, add_special, parse_special);
+        }
+
+        uint64_t key = std::hash<std::string>{}(text);
+        key ^= std::hash<const void *>{}(vocab) + 0x9e3779b97f4a7c15 + (key << 6) + (key >> 2);
+        key ^= (uint64_t(add_special) << 1) | uint64_t(parse_special);
+
+        auto & sh = shards[key % N_SHARDS];
+
+        auto matches = [&](const entry & e) {
+            return e.vocab == vocab && e.add_special == add_special && e.parse_special == parse_special && e.text == text;
+        };
+
+        {
+            std::lock_guard<std::mutex> lock(sh.mutex);
+
+            auto it = sh.index.find(key);
+            if (it != sh.index.end() && matches(*it->second)) {
+                sh.entries.splice(sh.entries.begin(), sh.entries, it->second);
+                n_hit++;
+
+                return it->second->tokens;
+            }
+        }
+
+        n_miss++;
+
+        // tokenize without holding the lock
+        llama_tokens tokens = common_tokenize(vocab, text, add_special, parse_special);
+
+        entry e = { key, vocab, text, add_special, parse_special, tokens };
+        if (e.size() > limit) {
+            return tokens;
+        }
+
+        std::lock_guard<std::mutex> lock(sh.mutex);
+
+        // replace the entry with the same key, either added by another thread meanwhile or a hash collision
+        auto it = sh.index.find(key);
+        if (it != sh.index.end()) {
+            sh.size -= it->second->size();
+            sh.entries.erase(it->second);
+            sh.index.erase(it);
+        }
+
+        sh.size += e.size();
+        sh.entries.push_front(std::move(e));
+        sh.index[key] = sh.entries.begin();
+
+        while (sh.size > limit) {
+            sh.size -= sh.entries.back().size();
+            sh.index.erase(sh.entries.back().key);
+            sh.entries.pop_back();
+        }
+
+        return tokens;
+    }
+};
+
 /**
  * this handles 2 cases:
  * - only string, example: "string"
  * - mixed string and tokens, example: [12, 34, "string", 56, 78]
  */
-static llama_tokens tokenize_mixed(const llama_vocab * vocab, const json & json_prompt, bool add_special, bool parse_special) {
+static llama_tokens tokenize_mixed(const llama_vocab * vocab, const json & json_prompt, bool add_special, bool parse_special, server_tokenize_cache * cache = nullptr) {
     // If `add_bos` is true, we only add BOS, when json_prompt is a string,
     // or the first element of the json_prompt array is a string.
     llama_tokens prompt_tokens;
 
+    auto tokenize = [&](const std::string & text, bool add_bos) {
+        return cache ? cache->tokenize(vocab, text, add_bos, parse_special) : common_tokenize(vocab, text, add_bos, parse_special);
+    };
+
     if (json_prompt.is_array()) {
         bool first = true;
         for (const auto & p : json_prompt) {
@@ -176,10 +299,10 @@ static llama_tokens tokenize_mixed(const llama_vocab * vocab, const json & json_
 
                 llama_tokens p;
                 if (first) {
-                    p = common_tokenize(vocab, s, add_special, parse_special);
+                    p = tokenize(s, add_special);
                     first = false;
                 } else {
-                    p = common_tokenize(vocab, s, false, parse_special);
+                    p = tokenize(s, false);
                 }
 
                 prompt_tokens.insert(prompt_tokens.end(), p.begin(), p.end());
@@ -193,7 +316,7 @@ static llama_tokens tokenize_mixed(const llama_vocab * vocab, const json & json_
         }
     } else {
         auto s = json_prompt.template get<std::string>();
-        prompt_tokens = common_tokenize(vocab, s, add_special, parse_special);
+        prompt_tokens = tokenize(s, add_special);
     }
 
     return prompt_tokens;
@@ -443,6 +566,16 @@ static std::string tokens_to_str(llama_context * ctx, Iter begin, Iter end) {
     return ret;
 }
 
+template <class Iter>
+static std::string tokens_to_str(const llama_vocab * vocab, Iter begin, Iter end) {
+    std::string ret;
+    for (; begin != end; ++begin) {
+        ret += common_token_to_piece(vocab, *begin);
+    }
+
+    return ret;
+}
+
 // format incomplete utf-8 multibyte character for output
 static std::string tokens_to_output_formatted_string(const llama_context * ctx, const llama_token token) {
     std::string out = token == LLAMA_TOKEN_NULL ? "" : common_token_to_piece(ctx, token);
@@ -1305,6 +1438,192 @@ public:
     }
 };
 
+// radix tree over the token prefixes that are currently stored in the KV cache, keyed by sequence
+// each node keeps the set of sequences whose cached tokens cover the entire path from the root to the end of the node edge
+// the sets shrink monotonically along any path, so a node with no sequences is removed together with its subtree
+struct server_prefix_tree {
+    struct node {
+        llama_tokens edge;
+
+        std::set<llama_seq_id> seqs;
+
+        std::map<llama_token, std::unique_ptr<node>> children;
+    };
+
+    node root;
+
+    // the prefix registered for each sequence
+    std::map<llama_seq_id, llama_tokens> entries;
+
+    struct match {
+        llama_seq_id seq_id = -1;
+        size_t       n_tokens = 0;
+    };
+
+    // register the tokens held by the sequence, replacing any previous entry
+    void insert(llama_seq_id seq_id, const llama_tokens & tokens) {
+        remove(seq_id);
+
+        if (tokens.empty()) {
+            return;
+        }
+
+        entries[seq_id] = tokens;
+
+        node * cur = &root;
+        size_t i = 0;
+
+        while (i < tokens.size()) {
+            auto it = cur->children.find(tokens[i]);
+            if (it == cur->children.end()) {
+                auto child = std::make_unique<node>();
+                child->edge.assign(tokens.begin() + i, tokens.end());
+                child->seqs.insert(seq_id);
+
+                cur->children[tokens[i]] = std::move(child);
+                return;
+            }
+
+            node * next = it->second.get();
+
+            const size_t n = common_prefix(next->edge, tokens, i);
+            if (n < next->edge.size()) {
+                split(next, n);
+            }
+
+            next->seqs.insert(seq_id);
+
+            cur = next;
+            i  += n;
+        }
+    }
+
+    // keep only the first n tokens of the entry of the sequence
+    void truncate(llama_seq_id seq_id, size_t n) {
+        auto it = entries.find(seq_id);
+        if (it == entries.end() || it->second.size() <= n) {
+            return;
+        }
+
+        const llama_tokens tokens(it->second.begin(), it->second.begin() + n);
+
+        insert(seq_id, tokens);
+    }
+
+    void remove(llama_seq_id seq_id) {
+        auto it = entries.find(seq_id);
+        if (it == entries.end()) {
+            return;
+        }
+
+        const llama_tokens tokens = std::move(it->second);
+        entries.erase(it);
+
+        // collect the nodes along the path of the entry
+        std::vector<node *> path = { &root };
+        for (size_t i = 0; i < tokens.size(); ) {
+            node * next = path.back()->children.at(tokens[i]).get();
+            next->seqs.erase(seq_id);
+            path.push_back(next);
+            i += next->edge.size();
+        }
+
+        // drop empty nodes and merge the ones that no longer branch, bottom-up
+        for (size_t k = path.size() - 1; k > 0; --k) {
+            node * cur    = path[k];
+            node * parent = path[k - 1];
+
+            if (cur->seqs.empty()) {
+                parent->children.erase(cur->edge[0]);
+                continue;
+            }
+
+            if (cur->children.size() == 1) {
+                auto child = std::move(cur->children.begin()->second);
+                if (child->seqs == cur->seqs) {
+                    cur->edge.insert(cur->edge.end(), child->edge.begin(), child->edge.end());
+                    cur->children = std::move(child->children);
+                } else {
+                    cur->children.begin()->second = std::move(child);
+                }
+            }
+        }
+    }
+
+    void clear() {
+        root.children.clear();
+        entries.clear();
+    }
+
+    // find the sequence holding the longest prefix of the tokens
+    // only the sequences accepted by the filter are considered
+    match find(const llama_tokens & tokens, const std::function<bool(llama_seq_id)> & filter) const {
+        match res;
+
+        const node * cur = &root;
+        size_t i = 0;
+
+        while (i < tokens.size()) {
+            auto it = cur->children.find(tokens[i]);
+            if (it == cur->children.end()) {
+                break;
+            }
+
+            const node * next = it->second.get();
+
+            // the sequences below this node are a subset of its own, so stop at the first node without a candidate
+            llama_seq_id seq_id = -1;
+            for (llama_seq_id s : next->seqs) {
+                if (filter(s)) {
+                    seq_id = s;
+                    break;
+                }
+            }
+
+            if (seq_id < 0) {
+                break;
+            }
+
+            const size_t n = common_prefix(next->edge, tokens, i);
+
+            res.seq_id   = seq_id;
+            res.n_tokens = i + n;
+
+            if (n < next->edge.size()) {
+                break;
+            }
+
+            cur = next;
+            i  += n;
+        }
+
+        return res;
+    }
+
+private:
+    static size_t common_prefix(const llama_tokens & edge, const llama_tokens & tokens, size_t offset) {
+        size_t n = 0;
+        while (n < edge.size() && offset + n < tokens.size() && edge[n] == tokens[offset + n]) {
+            n++;
+        }
+        return n;
+    }
+
+    // split the edge of the node after the first n tokens
+    static void split(node * cur, size_t n) {
+        GGML_ASSERT(n > 0 && n < cur->edge.size());
+
+        auto child = std::make_unique<node>();
+        child->edge.assign(cur->edge.begin() + n, cur->edge.end());
+        child->seqs     = cur->seqs;
+        child->children = std::move(cur->children);
+
+        cur->edge.resize(n);
+        cur->children.clear();
+        cur->children[child->edge[0]] = std::move(child);
+    }
+};
+
 // Computes FNV-1a hash of the data
 static std::string fnv_hash(const uint8_t * data, size_t len) {
     const uint64_t fnv_prime = 0x100000001b3ULL;
@@ -1388,13 +1707,13 @@ static server_tokens process_mtmd_prompt(mtmd_context * mctx, std::string prompt
  * - "prompt": [12, 34, "string", 56, 78]
  * - "prompt": { "prompt_string": "string", "multimodal_data": [ "base64" ] }
  */
-static server_tokens tokenize_input_subprompt(const llama_vocab * vocab, mtmd_context * mctx, const json & json_prompt, bool add_special, bool parse_special) {
+static server_tokens tokenize_input_subprompt(const llama_vocab * vocab, mtmd_context * mctx, const json & json_prompt, bool add_special, bool parse_special, server_tokenize_cache * cache = nullptr) {
     constexpr char JSON_STRING_PROMPT_KEY[] = "prompt_string";
     constexpr char JSON_MTMD_DATA_KEY[] = "multimodal_data";
     const bool has_mtmd = mctx != nullptr;
     if (json_prompt.is_string() || json_is_array_of_mixed_numbers_strings(json_prompt)) {
         // string or mixed
-        llama_tokens tmp = tokenize_mixed(vocab, json_prompt, add_special, parse_special);
+        llama_tokens tmp = tokenize_mixed(vocab, json_prompt, add_special, parse_special, cache);
         return server_tokens(tmp, false);
     } else if (json_is_array_of_numbers(json_prompt)) {
         // array of tokens
@@ -1414,7 +1733,7 @@ static server_tokens tokenize_input_subprompt(const llama_vocab * vocab, mtmd_co
             return process_mtmd_prompt(mctx, json_prompt.at(JSON_STRING_PROMPT_KEY), files);
         } else {
             // Not multimodal, but contains a subobject.
-            llama_tokens tmp = tokenize_mixed(vocab, json_prompt.at(JSON_STRING_PROMPT_KEY), add_special, parse_special);
+            llama_tokens tmp = tokenize_mixed(vocab, json_prompt.at(JSON_STRING_PROMPT_KEY), add_special, parse_special, cache);
             return server_tokens(tmp, false);
         }
    } else {
@@ -1435,15 +1754,15 @@ static server_tokens tokenize_input_subprompt(const llama_vocab * vocab, mtmd_co
  * - "prompt": [[12, 34, 56], [78, 90, 12]]
  * - "prompt": [[12, 34, "string", 56, 78], [12, 34, 56], { "prompt_string": "string", "multimodal_data": [ "base64" ]}]
  */
-static std::vector<server_tokens> tokenize_input_prompts(const llama_vocab * vocab, mtmd_context * mctx, const json & json_prompt, bool add_special, bool parse_special) {
+static std::vector<server_tokens> tokenize_input_prompts(const llama_vocab * vocab, mtmd_context * mctx, const json & json_prompt, bool add_special, bool parse_special, server_tokenize_cache * cache = nullptr) {
     std::vector<server_tokens> result;
     if (json_prompt.is_array() && !json_is_array_and_contains_numbers(json_prompt)) {
         result.reserve(json_prompt.size());
         for (const auto & p : json_prompt) {
-            result.push_back(tokenize_input_subprompt(vocab, mctx, p,add_special, parse_special));
+            result.push_back(tokenize_input_subprompt(vocab, mctx, p, add_special, parse_special, cache));
         }
     } else {
-        result.push_back(tokenize_input_subprompt(vocab, mctx, json_prompt, add_special, parse_special));
+        result.push_back(tokenize_input_subprompt(vocab, mctx, json_prompt, add_special, parse_special, cache));
     }
     if (result.empty()) {
         throw std::runtime_error("\"prompt\" must not be empty");